@@ -0,0 +1,330 @@
+// Benchmark of allocator.h against malloc/free, for list node sized objects (24 bytes).
+//
+// Throughput: allocate N objects then free them in random order (Mops/s, one op = allocate + free).
+// Arena has no free: N allocations then one reset. Same again with several threads churning on one shared
+// pool / the glibc heap, each thread allocating and freeing its own objects.
+// Locality: list of N nodes built while the program also allocates other objects of random size (as real
+// programs do between node insertions). malloc'ed nodes are spread among those, pool and arena nodes
+// are packed. Walking the list then costs ns per node.
+// std::list<int>: push_back N, sum, destroy, with std::allocator / PoolAllocator / ArenaAllocator.
+//
+// Typical result (1 core VM, glibc 2.36), N = 1M:
+//   allocate + free, random free order: malloc 10-15, pool 20-33, arena ~450 Mops/s. Random order makes
+//   every free a cache miss for both (free list link is written into the object)
+//   batch churn (1000 allocs then 1000 frees): malloc ~25, pool ~80-100 Mops/s, no lock on the common path
+//   walk list of 1M nodes: malloc'ed nodes ~60 ns (a miss per node), pool ~4-5 ns, arena ~3 ns per node.
+//   Pool slots are 32 bytes so no node crosses a line; walked in allocation order that reads a third more
+//   lines than the 24 byte nodes packed by the arena
+//   std::list push_back/sum/clear: std::allocator ~60 ms, PoolAllocator ~25 ms, ArenaAllocator ~13 ms
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <list>
+#include "allocator.h"
+#include "bench.h"
+
+#define NUM_OBJECTS (1 << 20)
+#define OBJECT_SIZE 24 // doubly linked Node
+#define ROUNDS 3
+#define CHURN_THREADS_MAX 4
+#define CHURN_BATCH 1000
+#define CHURN_OPS (4 << 20) // allocations per thread
+
+typedef struct _BenchNode
+{
+  int data;
+  struct _BenchNode *next;
+  struct _BenchNode *prev;
+} BenchNode;
+
+static uint64_t rnd = 88172645463325252ULL;
+
+static uint64_t nextRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+static void shuffle(void **p, size_t n)
+{
+  for (size_t i = n - 1; i > 0; i--)
+  {
+    size_t j = nextRandom() % (i + 1);
+    void *t = p[i];
+    p[i] = p[j];
+    p[j] = t;
+  }
+}
+
+// ---------------- throughput ----------------
+
+static double mallocMops(void **objs)
+{
+  double best = 0;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    for (size_t i = 0; i < NUM_OBJECTS; i++)
+      objs[i] = malloc(OBJECT_SIZE);
+    uint64_t t1 = nowNs();
+    shuffle(objs, NUM_OBJECTS); // not timed
+    uint64_t t2 = nowNs();
+    for (size_t i = 0; i < NUM_OBJECTS; i++)
+      free(objs[i]);
+    double mops = NUM_OBJECTS * 1e3 / (t1 - t0 + nowNs() - t2);
+    best = mops > best ? mops : best;
+  }
+  return best;
+}
+
+static double poolMops(void **objs)
+{
+  SlabPool pool(OBJECT_SIZE);
+  double best = 0;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    for (size_t i = 0; i < NUM_OBJECTS; i++)
+      objs[i] = pool.allocate();
+    uint64_t t1 = nowNs();
+    shuffle(objs, NUM_OBJECTS);
+    uint64_t t2 = nowNs();
+    for (size_t i = 0; i < NUM_OBJECTS; i++)
+      pool.deallocate(objs[i]);
+    double mops = NUM_OBJECTS * 1e3 / (t1 - t0 + nowNs() - t2);
+    best = mops > best ? mops : best;
+  }
+  return best;
+}
+
+static double arenaMops(void **objs)
+{
+  Arena arena(1 << 20);
+  double best = 0;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    for (size_t i = 0; i < NUM_OBJECTS; i++)
+      objs[i] = arena.allocate(OBJECT_SIZE, 8);
+    clobberMemory();
+    arena.reset();
+    double mops = NUM_OBJECTS * 1e3 / (nowNs() - t0);
+    best = mops > best ? mops : best;
+  }
+  return best;
+}
+
+typedef struct
+{
+  SlabPool *pool; // NULL: malloc
+  pthread_barrier_t *start;
+  uint64_t ns;
+} ChurnArg;
+
+static void *churnThread(void *p)
+{
+  ChurnArg *arg = (ChurnArg *)p;
+  void *objs[CHURN_BATCH];
+  pthread_barrier_wait(arg->start);
+  uint64_t t0 = nowNs();
+  for (int round = 0; round < CHURN_OPS / CHURN_BATCH; round++)
+  {
+    for (int i = 0; i < CHURN_BATCH; i++)
+      objs[i] = arg->pool ? arg->pool->allocate() : malloc(OBJECT_SIZE);
+    clobberMemory();
+    for (int i = 0; i < CHURN_BATCH; i++)
+    {
+      if (arg->pool)
+        arg->pool->deallocate(objs[i]);
+      else
+        free(objs[i]);
+    }
+  }
+  arg->ns = nowNs() - t0;
+  return NULL;
+}
+
+static double churnMops(SlabPool *pool, int numThreads)
+{
+  pthread_t threads[CHURN_THREADS_MAX];
+  ChurnArg args[CHURN_THREADS_MAX];
+  pthread_barrier_t start;
+  pthread_barrier_init(&start, NULL, numThreads);
+  uint64_t t0 = nowNs();
+  for (int t = 0; t < numThreads; t++)
+  {
+    args[t] = {pool, &start, 0};
+    pthread_create(&threads[t], NULL, churnThread, &args[t]);
+  }
+  for (int t = 0; t < numThreads; t++)
+    pthread_join(threads[t], NULL);
+  uint64_t ns = nowNs() - t0;
+  pthread_barrier_destroy(&start);
+  return (double)CHURN_OPS * numThreads * 1e3 / ns;
+}
+
+// ---------------- locality ----------------
+
+// other allocations between node insertions, half of them freed again later: leaves holes malloc refills
+template <typename AllocNode>
+static BenchNode *buildList(AllocNode allocNode, void **noise)
+{
+  BenchNode *head = NULL;
+  for (size_t i = 0; i < NUM_OBJECTS; i++)
+  {
+    noise[i] = malloc(16 + nextRandom() % 240);
+    BenchNode *n = allocNode();
+    n->data = (int)i;
+    n->prev = NULL;
+    n->next = head;
+    if (head)
+      head->prev = n;
+    head = n;
+  }
+  for (size_t i = 0; i < NUM_OBJECTS; i += 2)
+  {
+    free(noise[i]);
+    noise[i] = NULL;
+  }
+  return head;
+}
+
+static double walkNsPerNode(const BenchNode *head)
+{
+  double best = 1e9;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    int64_t sum = 0;
+    for (const BenchNode *n = head; n; n = n->next)
+      sum += n->data;
+    doNotOptimize(sum);
+    double ns = (double)(nowNs() - t0) / NUM_OBJECTS;
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+static void freeNoise(void **noise)
+{
+  for (size_t i = 0; i < NUM_OBJECTS; i++)
+    free(noise[i]);
+}
+
+static void benchLocality(void **noise)
+{
+  BenchNode *head = buildList([] { return (BenchNode *)malloc(sizeof(BenchNode)); }, noise);
+  double mallocNs = walkNsPerNode(head);
+  while (head)
+  {
+    BenchNode *next = head->next;
+    free(head);
+    head = next;
+  }
+  freeNoise(noise);
+
+  SlabPool pool(sizeof(BenchNode), alignof(BenchNode));
+  head = buildList([&] { return (BenchNode *)pool.allocate(); }, noise);
+  double poolNs = walkNsPerNode(head);
+  freeNoise(noise); // nodes go with the pool
+
+  Arena arena(1 << 20);
+  head = buildList([&] { return arena.create<BenchNode>(); }, noise);
+  double arenaNs = walkNsPerNode(head);
+  freeNoise(noise);
+
+  printf("\nwalk list of %d nodes built between other allocations (ns per node)\n", NUM_OBJECTS);
+  printf("%10s %10s %10s\n", "malloc", "pool", "arena");
+  printf("%10.2f %10.2f %10.2f\n", mallocNs, poolNs, arenaNs);
+}
+
+// ---------------- std::list ----------------
+
+template <typename List>
+static double listMs(List &list)
+{
+  uint64_t t0 = nowNs();
+  for (int i = 0; i < NUM_OBJECTS; i++)
+    list.push_back(i);
+  int64_t sum = 0;
+  for (int v : list)
+    sum += v;
+  doNotOptimize(sum);
+  list.clear();
+  return (nowNs() - t0) / 1e6;
+}
+
+static void benchStdList()
+{
+  double best[3] = {1e9, 1e9, 1e9};
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    std::list<int> plain;
+    std::list<int, PoolAllocator<int>> pooled;
+    Arena arena(1 << 20);
+    std::list<int, ArenaAllocator<int>> arenaList{ArenaAllocator<int>(&arena)};
+    double ms[3] = {listMs(plain), listMs(pooled), listMs(arenaList)};
+    for (int i = 0; i < 3; i++)
+      best[i] = ms[i] < best[i] ? ms[i] : best[i];
+  }
+  printf("\nstd::list<int> push_back %d, sum, clear (ms)\n", NUM_OBJECTS);
+  printf("%14s %14s %14s\n", "std::allocator", "PoolAllocator", "ArenaAllocator");
+  printf("%14.2f %14.2f %14.2f\n", best[0], best[1], best[2]);
+}
+
+int main_allocator_bench()
+{
+  void **objs = (void **)malloc(NUM_OBJECTS * sizeof(void *));
+
+  // pool hands out distinct, writable, aligned objects and reuses freed ones
+  SlabPool check(40, 32);
+  for (size_t i = 0; i < NUM_OBJECTS / 16; i++)
+  {
+    objs[i] = check.allocate();
+    if ((uintptr_t)objs[i] % 32)
+      printf("SlabPool alignment FAILED\n");
+    memset(objs[i], (int)i, 40);
+  }
+  for (size_t i = 0; i < NUM_OBJECTS / 16; i++)
+  {
+    if (((uint8_t *)objs[i])[39] != (uint8_t)i)
+      printf("SlabPool objects overlap\n");
+  }
+  size_t reserved = check.bytesReserved();
+  for (int r = 0; r < 4; r++)
+  {
+    for (size_t i = 0; i < NUM_OBJECTS / 16; i++)
+      check.deallocate(objs[i]);
+    for (size_t i = 0; i < NUM_OBJECTS / 16; i++)
+      objs[i] = check.allocate();
+  }
+  if (check.bytesReserved() != reserved)
+    printf("SlabPool didn't reuse freed objects\n");
+  SlabPool nodes(OBJECT_SIZE, 8);
+  for (size_t i = 0; i < 1000; i++)
+  {
+    uintptr_t p = (uintptr_t)nodes.allocate();
+    if (p / CACHE_LINE_SIZE != (p + OBJECT_SIZE - 1) / CACHE_LINE_SIZE)
+      printf("SlabPool object crosses a cache line\n");
+  }
+
+  printf("allocate + free of %d objects, %d bytes (Mops/s)\n", NUM_OBJECTS, OBJECT_SIZE);
+  printf("%10s %10s %10s\n", "malloc", "pool", "arena");
+  printf("%10.1f %10.1f %10.1f\n", mallocMops(objs), poolMops(objs), arenaMops(objs));
+
+  SlabPool shared(OBJECT_SIZE);
+  printf("\nthreads churning batches of %d on one shared pool / heap (Mops/s)\n", CHURN_BATCH);
+  printf("%8s %10s %10s\n", "threads", "malloc", "pool");
+  for (int t = 1; t <= CHURN_THREADS_MAX; t *= 2)
+    printf("%8d %10.1f %10.1f\n", t, churnMops(NULL, t), churnMops(&shared, t));
+
+  benchLocality(objs);
+  benchStdList();
+  free(objs);
+  return 0;
+}
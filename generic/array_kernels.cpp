@@ -0,0 +1,525 @@
+// Array min/max/abs/sign/clamp and min/max reductions of array_kernels.h, with runtime ISA dispatch like
+// popcount.cpp (GNU ifunc on x86-64 ELF).
+//
+// Kernels are written once on GCC vector extension types of W bytes (simd_vec.h): a < b ? a : b on vectors
+// is a lane wise select, so each kernel is the element function of array_kernels.h with vectors in place of
+// scalars, and compiles per target to the native instruction where there is one:
+//   min/max: pminsb/pminsw/pminsd (SSE4.1 for 8 and 32 bit), minps/maxps, vpminsq only on AVX-512;
+//     int64 before that is pcmpgtq + blend (SSE4.2), SSE2 has no 64 bit compare and emulates it
+//   abs: (x ^ mask) - mask with mask = x < 0, the absBranchless trick, on all lanes at once
+//   sign: two selects, x > 0 ? 1 : 0 then x < 0 ? -1 : that, NaN and -0.0f fall through to 0.0f
+// The last elements (fewer than one vector) go through the element functions, so there is nothing a vector
+// could compute differently.
+//
+// Reductions keep 4 vector accumulators (minps has 4 cycles latency, 1 accumulator would wait on it) folded at
+// the end. x < acc ? x : acc keeps acc when x is NaN, that is how NaNs are skipped. The result doesn't depend
+// on the order of the elements, except for float zeros: -0.0f == 0.0f, so any of them can end up in the
+// accumulators. For a zero result the first zero is looked up.
+// argmin/argmax: reduction first, then a search for the first element equal to the result, 4 vectors
+// compared per step like memchr. Up to 2 passes over the array, but no index vectors: lanes of int8_t
+// couldn't hold an index, and tracking one per lane costs a blend per vector in the hot loop.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits>
+#include "array_kernels.h"
+#include "simd_vec.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+template <typename T>
+static constexpr T minIdentity()
+{
+  return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+}
+
+template <typename T>
+static constexpr T maxIdentity()
+{
+  return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::min();
+}
+
+// ---------------- element operations, vector and scalar ----------------
+
+template <typename T, size_t W>
+struct OpMin
+{
+  template <typename V> // any width, for the fold of reductions
+  ALWAYS_INLINE V vec(const V &a, const V &b) const { return a < b ? a : b; }
+  ALWAYS_INLINE T scalar(T a, T b) const { return elementMin(a, b); }
+};
+
+template <typename T, size_t W>
+struct OpMax
+{
+  template <typename V>
+  ALWAYS_INLINE V vec(const V &a, const V &b) const { return a > b ? a : b; }
+  ALWAYS_INLINE T scalar(T a, T b) const { return elementMax(a, b); }
+};
+
+template <typename T, size_t W>
+struct OpAbs
+{
+  typedef typename ArrayAbs<T>::Type U;
+  typedef typename Lanes<T, W>::Vec Vec;
+  typedef typename Lanes<U, W>::Vec UVec;
+  ALWAYS_INLINE UVec vec(const Vec &x) const
+  {
+    UVec mask = (UVec)(x < 0);
+    return ((UVec)x ^ mask) - mask; // unsigned, INT_MIN wraps to its magnitude
+  }
+  ALWAYS_INLINE U scalar(T x) const { return elementAbs(x); }
+};
+
+template <size_t W>
+struct OpAbs<float, W>
+{
+  typedef typename Lanes<float, W>::Vec Vec;
+  typedef typename Lanes<uint32_t, W>::Vec Bits;
+  ALWAYS_INLINE Vec vec(const Vec &x) const { return (Vec)((Bits)x & 0x7fffffff); }
+  ALWAYS_INLINE float scalar(float x) const { return elementAbs(x); }
+};
+
+// selects between splats, not (x < 0) - (x > 0): GCC 12 builds 64 byte compare masks lane by lane (see
+// eqMask512), the selects become vpcmp to k and masked broadcasts
+template <typename T, size_t W>
+struct OpSign
+{
+  typedef typename Lanes<T, W>::Vec Vec;
+  ALWAYS_INLINE Vec vec(const Vec &x) const
+  {
+    Vec zero = splat<T, W>(0);
+    Vec y = x > zero ? splat<T, W>(1) : zero;
+    return x < zero ? splat<T, W>(-1) : y;
+  }
+  ALWAYS_INLINE T scalar(T x) const { return elementSign(x); }
+};
+
+template <typename T, size_t W>
+struct OpClamp
+{
+  typedef typename Lanes<T, W>::Vec Vec;
+  T lo, hi;
+  Vec vlo, vhi;
+  ALWAYS_INLINE OpClamp(T lo, T hi) : lo(lo), hi(hi), vlo(splat<T, W>(lo)), vhi(splat<T, W>(hi)) {}
+  ALWAYS_INLINE Vec vec(const Vec &x) const
+  {
+    Vec y = x > vlo ? x : vlo;
+    return y < vhi ? y : vhi;
+  }
+  ALWAYS_INLINE T scalar(T x) const { return elementClamp(x, lo, hi); }
+};
+
+// ---------------- elementwise ----------------
+
+// storeScalar for vectors, by reference: by value GCC notes the changed vector ABI on every instantiation
+template <class V>
+ALWAYS_INLINE void storeVec(void *p, const V &v)
+{
+  __builtin_memcpy(p, &v, sizeof(V));
+}
+
+template <typename T, size_t W, typename U, class Op>
+ALWAYS_INLINE void mapUnary(const T *a, U *out, size_t n, const Op &op)
+{
+  typedef typename Lanes<T, W>::Vec Vec;
+  const size_t N = Lanes<T, W>::N;
+  size_t i = 0;
+  for (; i + 2 * N <= n; i += 2 * N)
+  {
+    Vec x0 = loadScalar<Vec>(a + i), x1 = loadScalar<Vec>(a + i + N);
+    storeVec(out + i, op.vec(x0));
+    storeVec(out + i + N, op.vec(x1));
+  }
+  if (i + N <= n)
+  {
+    storeVec(out + i, op.vec(loadScalar<Vec>(a + i)));
+    i += N;
+  }
+  for (; i < n; i++)
+    out[i] = op.scalar(a[i]);
+}
+
+template <typename T, size_t W, class Op>
+ALWAYS_INLINE void mapBinary(const T *a, const T *b, T *out, size_t n, const Op &op)
+{
+  typedef typename Lanes<T, W>::Vec Vec;
+  const size_t N = Lanes<T, W>::N;
+  size_t i = 0;
+  for (; i + 2 * N <= n; i += 2 * N)
+  {
+    Vec a0 = loadScalar<Vec>(a + i), a1 = loadScalar<Vec>(a + i + N);
+    Vec b0 = loadScalar<Vec>(b + i), b1 = loadScalar<Vec>(b + i + N);
+    storeVec(out + i, op.vec(a0, b0));
+    storeVec(out + i + N, op.vec(a1, b1));
+  }
+  if (i + N <= n)
+  {
+    storeVec(out + i, op.vec(loadScalar<Vec>(a + i), loadScalar<Vec>(b + i)));
+    i += N;
+  }
+  for (; i < n; i++)
+    out[i] = op.scalar(a[i], b[i]);
+}
+
+// ---------------- reductions ----------------
+
+// op over all lanes of v: halves combined until one lane is left, log2(lanes) steps
+template <typename T, size_t W, class Op>
+ALWAYS_INLINE T foldLanes(const typename Lanes<T, W>::Vec &v, const Op &op)
+{
+  if constexpr (W == sizeof(T))
+    return v[0];
+  else
+  {
+    typename Lanes<T, W / 2>::Vec lo, hi;
+    __builtin_memcpy(&lo, &v, W / 2);
+    __builtin_memcpy(&hi, (const char *)&v + W / 2, W / 2);
+    return foldLanes<T, W / 2>(op.vec(lo, hi), op);
+  }
+}
+
+// Op(x, acc): x < acc ? x : acc for min, acc stays on NaN
+template <typename T, size_t W, class Op>
+ALWAYS_INLINE T reduce(const T *a, size_t n, T identity, const Op &op)
+{
+  typedef typename Lanes<T, W>::Vec Vec;
+  const size_t N = Lanes<T, W>::N;
+  Vec acc0 = splat<T, W>(identity), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+  size_t i = 0;
+  for (; i + 4 * N <= n; i += 4 * N)
+  {
+    acc0 = op.vec(loadScalar<Vec>(a + i), acc0);
+    acc1 = op.vec(loadScalar<Vec>(a + i + N), acc1);
+    acc2 = op.vec(loadScalar<Vec>(a + i + 2 * N), acc2);
+    acc3 = op.vec(loadScalar<Vec>(a + i + 3 * N), acc3);
+  }
+  for (; i + N <= n; i += N)
+    acc0 = op.vec(loadScalar<Vec>(a + i), acc0);
+  T r = foldLanes<T, W>(op.vec(op.vec(acc1, acc0), op.vec(acc3, acc2)), op);
+  for (; i < n; i++)
+    r = op.scalar(a[i], r);
+  return r;
+}
+
+// any bit set in a vector of W bytes
+template <size_t W>
+ALWAYS_INLINE bool anyLane(const typename Lanes<uint64_t, W>::Vec &v)
+{
+  if constexpr (W == 8)
+    return v[0] != 0;
+  else
+  {
+    typename Lanes<uint64_t, W / 2>::Vec lo, hi;
+    __builtin_memcpy(&lo, &v, W / 2);
+    __builtin_memcpy(&hi, (const char *)&v + W / 2, W / 2);
+    return anyLane<W / 2>(lo | hi);
+  }
+}
+
+#if defined(__x86_64__)
+// lanes of x equal to v as a bit mask, 64 byte vectors. GCC 12 compiles a 64 byte == lane by lane (sete per
+// element) when it is inlined from a template without the target attribute, the intrinsic gives vpcmpeq to k.
+// Plain inline, not always_inline: the target mismatch with anyEqual would be an error before anyEqual itself
+// is inlined into the avx512bw kernel
+template <typename T>
+__attribute__((target("avx512bw"))) inline uint64_t eqMask512(const typename Lanes<T, 64>::Vec &x,
+                                                               const typename Lanes<T, 64>::Vec &v)
+{
+  if constexpr (std::numeric_limits<T>::has_infinity)
+    return _mm512_cmpeq_ps_mask((__m512)x, (__m512)v); // ordered: NaN never equal, -0.0f == 0.0f like ==
+  else if constexpr (sizeof(T) == 1)
+    return _mm512_cmpeq_epi8_mask((__m512i)x, (__m512i)v);
+  else if constexpr (sizeof(T) == 2)
+    return _mm512_cmpeq_epi16_mask((__m512i)x, (__m512i)v);
+  else if constexpr (sizeof(T) == 4)
+    return _mm512_cmpeq_epi32_mask((__m512i)x, (__m512i)v);
+  else
+    return _mm512_cmpeq_epi64_mask((__m512i)x, (__m512i)v);
+}
+#endif
+
+// any lane of x0..x3 equal to v
+template <typename T, size_t W>
+ALWAYS_INLINE bool anyEqual(const typename Lanes<T, W>::Vec &x0, const typename Lanes<T, W>::Vec &x1,
+                            const typename Lanes<T, W>::Vec &x2, const typename Lanes<T, W>::Vec &x3,
+                            const typename Lanes<T, W>::Vec &v)
+{
+#if defined(__x86_64__)
+  if constexpr (W == 64)
+    return (eqMask512<T>(x0, v) | eqMask512<T>(x1, v) | eqMask512<T>(x2, v) | eqMask512<T>(x3, v)) != 0;
+  else
+#endif
+  {
+    typedef typename Lanes<uint64_t, W>::Vec Bits;
+    return anyLane<W>((Bits)((x0 == v) | (x1 == v) | (x2 == v) | (x3 == v)));
+  }
+}
+
+// index of the first element == value, n if none
+template <typename T, size_t W>
+ALWAYS_INLINE size_t findEqual(const T *a, size_t n, T value)
+{
+  typedef typename Lanes<T, W>::Vec Vec;
+  const size_t N = Lanes<T, W>::N;
+  Vec v = splat<T, W>(value);
+  size_t i = 0;
+  for (; i + 4 * N <= n; i += 4 * N)
+  {
+    if (anyEqual<T, W>(loadScalar<Vec>(a + i), loadScalar<Vec>(a + i + N), loadScalar<Vec>(a + i + 2 * N),
+                       loadScalar<Vec>(a + i + 3 * N), v))
+      break;
+  }
+  for (; i < n; i++)
+  {
+    if (a[i] == value)
+      return i;
+  }
+  return n;
+}
+
+template <typename T, size_t W, class Op>
+ALWAYS_INLINE T reduceExact(const T *a, size_t n, T identity, const Op &op)
+{
+  T r = reduce<T, W>(a, n, identity, op);
+  if (std::numeric_limits<T>::has_infinity && r == 0)
+    return a[findEqual<T, W>(a, n, r)]; // -0.0f or 0.0f, whichever comes first
+  return r;
+}
+
+template <typename T, size_t W, class Op>
+ALWAYS_INLINE size_t argReduce(const T *a, size_t n, T identity, const Op &op)
+{
+  size_t i = findEqual<T, W>(a, n, reduce<T, W>(a, n, identity, op));
+  return i < n ? i : 0;
+}
+
+// ---------------- variants ----------------
+
+// every kernel of one element type, for the ISA of ARRAY_TARGET and vectors of ARRAY_W bytes
+#define ARRAY_KERNEL_DEFINE(T)                                                                                    \
+  ARRAY_TARGET void array_min(const T *a, const T *b, T *out, size_t n)                                           \
+  {                                                                                                               \
+    mapBinary<T, ARRAY_W>(a, b, out, n, OpMin<T, ARRAY_W>());                                                     \
+  }                                                                                                               \
+  ARRAY_TARGET void array_max(const T *a, const T *b, T *out, size_t n)                                           \
+  {                                                                                                               \
+    mapBinary<T, ARRAY_W>(a, b, out, n, OpMax<T, ARRAY_W>());                                                     \
+  }                                                                                                               \
+  ARRAY_TARGET void array_abs(const T *a, ArrayAbs<T>::Type *out, size_t n)                                       \
+  {                                                                                                               \
+    mapUnary<T, ARRAY_W>(a, out, n, OpAbs<T, ARRAY_W>());                                                         \
+  }                                                                                                               \
+  ARRAY_TARGET void array_sign(const T *a, T *out, size_t n)                                                      \
+  {                                                                                                               \
+    mapUnary<T, ARRAY_W>(a, out, n, OpSign<T, ARRAY_W>());                                                        \
+  }                                                                                                               \
+  ARRAY_TARGET void array_clamp(const T *a, T lo, T hi, T *out, size_t n)                                         \
+  {                                                                                                               \
+    mapUnary<T, ARRAY_W>(a, out, n, OpClamp<T, ARRAY_W>(lo, hi));                                                 \
+  }                                                                                                               \
+  ARRAY_TARGET T array_reduce_min(const T *a, size_t n)                                                           \
+  {                                                                                                               \
+    return reduceExact<T, ARRAY_W>(a, n, minIdentity<T>(), OpMin<T, ARRAY_W>());                                  \
+  }                                                                                                               \
+  ARRAY_TARGET T array_reduce_max(const T *a, size_t n)                                                           \
+  {                                                                                                               \
+    return reduceExact<T, ARRAY_W>(a, n, maxIdentity<T>(), OpMax<T, ARRAY_W>());                                  \
+  }                                                                                                               \
+  ARRAY_TARGET size_t array_argmin(const T *a, size_t n)                                                          \
+  {                                                                                                               \
+    return argReduce<T, ARRAY_W>(a, n, minIdentity<T>(), OpMin<T, ARRAY_W>());                                    \
+  }                                                                                                               \
+  ARRAY_TARGET size_t array_argmax(const T *a, size_t n)                                                          \
+  {                                                                                                               \
+    return argReduce<T, ARRAY_W>(a, n, maxIdentity<T>(), OpMax<T, ARRAY_W>());                                    \
+  }
+
+#if defined(__x86_64__)
+
+#define ARRAY_W 16
+#define ARRAY_TARGET
+namespace array_sse2
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DEFINE)
+}
+#undef ARRAY_TARGET
+#define ARRAY_TARGET __attribute__((target("sse4.2")))
+namespace array_sse4
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DEFINE)
+}
+#undef ARRAY_TARGET
+#undef ARRAY_W
+
+#define ARRAY_W 32
+#define ARRAY_TARGET __attribute__((target("avx2")))
+namespace array_avx2
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DEFINE)
+}
+#undef ARRAY_TARGET
+#undef ARRAY_W
+
+#define ARRAY_W 64
+#define ARRAY_TARGET __attribute__((target("avx512bw")))
+namespace array_avx512
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DEFINE)
+}
+#undef ARRAY_TARGET
+#undef ARRAY_W
+
+// ---------------- dispatch ----------------
+
+template <typename T>
+using ArrayBinaryFn = void (*)(const T *, const T *, T *, size_t);
+template <typename T>
+using ArrayAbsFn = void (*)(const T *, typename ArrayAbs<T>::Type *, size_t);
+template <typename T>
+using ArrayUnaryFn = void (*)(const T *, T *, size_t);
+template <typename T>
+using ArrayClampFn = void (*)(const T *, T, T, T *, size_t);
+template <typename T>
+using ArrayReduceFn = T (*)(const T *, size_t);
+template <typename T>
+using ArrayIndexFn = size_t (*)(const T *, size_t);
+
+// 0 sse2, 1 sse4.2, 2 avx2, 3 avx512bw. Called from ifunc resolvers, so no global data
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE int arrayKernelsIsaLevel()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw"))
+    return 3;
+  if (__builtin_cpu_supports("avx2"))
+    return 2;
+  if (__builtin_cpu_supports("sse4.2"))
+    return 1;
+  return 0;
+}
+
+// the overload of name taking T, for the ISA level
+#define PICK_BY_LEVEL(name, Fn)                                                                                   \
+  switch (arrayKernelsIsaLevel())                                                                                 \
+  {                                                                                                               \
+  case 3:                                                                                                         \
+    return static_cast<Fn>(array_avx512::name);                                                                   \
+  case 2:                                                                                                         \
+    return static_cast<Fn>(array_avx2::name);                                                                     \
+  case 1:                                                                                                         \
+    return static_cast<Fn>(array_sse4::name);                                                                     \
+  default:                                                                                                        \
+    return static_cast<Fn>(array_sse2::name);                                                                     \
+  }
+
+#define ARRAY_KERNEL_RESOLVER(T, name, Fn)                                                                        \
+  IFUNC_RESOLVER Fn<T> resolve_##name##_##T()                                                                     \
+  {                                                                                                               \
+    PICK_BY_LEVEL(name, Fn<T>)                                                                                    \
+  }
+
+#define ARRAY_KERNEL_RESOLVERS(T)                                                                                 \
+  ARRAY_KERNEL_RESOLVER(T, array_min, ArrayBinaryFn)                                                              \
+  ARRAY_KERNEL_RESOLVER(T, array_max, ArrayBinaryFn)                                                              \
+  ARRAY_KERNEL_RESOLVER(T, array_abs, ArrayAbsFn)                                                                 \
+  ARRAY_KERNEL_RESOLVER(T, array_sign, ArrayUnaryFn)                                                              \
+  ARRAY_KERNEL_RESOLVER(T, array_clamp, ArrayClampFn)                                                             \
+  ARRAY_KERNEL_RESOLVER(T, array_reduce_min, ArrayReduceFn)                                                       \
+  ARRAY_KERNEL_RESOLVER(T, array_reduce_max, ArrayReduceFn)                                                       \
+  ARRAY_KERNEL_RESOLVER(T, array_argmin, ArrayIndexFn)                                                            \
+  ARRAY_KERNEL_RESOLVER(T, array_argmax, ArrayIndexFn)
+
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_RESOLVERS)
+
+#undef ARRAY_KERNEL_RESOLVERS
+#undef ARRAY_KERNEL_RESOLVER
+#undef PICK_BY_LEVEL
+
+#if defined(__ELF__)
+#define ARRAY_KERNEL_DISPATCH(T)                                                                                  \
+  void array_min(const T *a, const T *b, T *out, size_t n) __attribute__((ifunc("resolve_array_min_" #T)));      \
+  void array_max(const T *a, const T *b, T *out, size_t n) __attribute__((ifunc("resolve_array_max_" #T)));      \
+  void array_abs(const T *a, ArrayAbs<T>::Type *out, size_t n) __attribute__((ifunc("resolve_array_abs_" #T)));  \
+  void array_sign(const T *a, T *out, size_t n) __attribute__((ifunc("resolve_array_sign_" #T)));                \
+  void array_clamp(const T *a, T lo, T hi, T *out, size_t n) __attribute__((ifunc("resolve_array_clamp_" #T)));  \
+  T array_reduce_min(const T *a, size_t n) __attribute__((ifunc("resolve_array_reduce_min_" #T)));               \
+  T array_reduce_max(const T *a, size_t n) __attribute__((ifunc("resolve_array_reduce_max_" #T)));               \
+  size_t array_argmin(const T *a, size_t n) __attribute__((ifunc("resolve_array_argmin_" #T)));                  \
+  size_t array_argmax(const T *a, size_t n) __attribute__((ifunc("resolve_array_argmax_" #T)));
+#else
+#define ARRAY_KERNEL_DISPATCH(T)                                                                                  \
+  void array_min(const T *a, const T *b, T *out, size_t n)                                                        \
+  {                                                                                                               \
+    static ArrayBinaryFn<T> impl = resolve_array_min_##T();                                                       \
+    impl(a, b, out, n);                                                                                           \
+  }                                                                                                               \
+  void array_max(const T *a, const T *b, T *out, size_t n)                                                        \
+  {                                                                                                               \
+    static ArrayBinaryFn<T> impl = resolve_array_max_##T();                                                       \
+    impl(a, b, out, n);                                                                                           \
+  }                                                                                                               \
+  void array_abs(const T *a, ArrayAbs<T>::Type *out, size_t n)                                                    \
+  {                                                                                                               \
+    static ArrayAbsFn<T> impl = resolve_array_abs_##T();                                                          \
+    impl(a, out, n);                                                                                              \
+  }                                                                                                               \
+  void array_sign(const T *a, T *out, size_t n)                                                                   \
+  {                                                                                                               \
+    static ArrayUnaryFn<T> impl = resolve_array_sign_##T();                                                       \
+    impl(a, out, n);                                                                                              \
+  }                                                                                                               \
+  void array_clamp(const T *a, T lo, T hi, T *out, size_t n)                                                      \
+  {                                                                                                               \
+    static ArrayClampFn<T> impl = resolve_array_clamp_##T();                                                      \
+    impl(a, lo, hi, out, n);                                                                                      \
+  }                                                                                                               \
+  T array_reduce_min(const T *a, size_t n)                                                                        \
+  {                                                                                                               \
+    static ArrayReduceFn<T> impl = resolve_array_reduce_min_##T();                                                \
+    return impl(a, n);                                                                                            \
+  }                                                                                                               \
+  T array_reduce_max(const T *a, size_t n)                                                                        \
+  {                                                                                                               \
+    static ArrayReduceFn<T> impl = resolve_array_reduce_max_##T();                                                \
+    return impl(a, n);                                                                                            \
+  }                                                                                                               \
+  size_t array_argmin(const T *a, size_t n)                                                                       \
+  {                                                                                                               \
+    static ArrayIndexFn<T> impl = resolve_array_argmin_##T();                                                     \
+    return impl(a, n);                                                                                            \
+  }                                                                                                               \
+  size_t array_argmax(const T *a, size_t n)                                                                       \
+  {                                                                                                               \
+    static ArrayIndexFn<T> impl = resolve_array_argmax_##T();                                                     \
+    return impl(a, n);                                                                                            \
+  }
+#endif
+
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DISPATCH)
+
+#undef ARRAY_KERNEL_DISPATCH
+
+const char *array_kernels_isa()
+{
+  static const char *const names[] = {"sse2", "sse4.2", "avx2", "avx512bw"};
+  return names[arrayKernelsIsaLevel()];
+}
+
+#else
+
+// other architectures: 16 byte vectors, NEON on ARM
+#define ARRAY_W 16
+#define ARRAY_TARGET
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DEFINE)
+#undef ARRAY_TARGET
+#undef ARRAY_W
+
+const char *array_kernels_isa()
+{
+  return "generic";
+}
+
+#endif
+
+#undef ARRAY_KERNEL_DEFINE
@@ -0,0 +1,112 @@
+#ifndef __ARRAY_KERNELS_H
+#define __ARRAY_KERNELS_H
+
+// array_kernels.cpp: minBranchless, maxBranchless, absBranchless and sign of binary_hacks.h over whole arrays,
+// for int8_t to int64_t and float. Elementwise (min/max of two arrays, abs, sign, clamp) and reductions (min,
+// max, index of the first min/max). Widest available ISA is picked once at load time, like popcount_array:
+// AVX-512BW, AVX2, SSE4.2 or SSE2 (x86-64 baseline), NEON through the same code on ARM.
+//
+// Every kernel gives the same bits as the element functions below applied one by one, ISA doesn't matter:
+//   min/max: a < b ? a : b and a > b ? a : b, for float exactly what minps/maxps do (second operand when
+//     either is NaN or both are zero)
+//   abs: into the unsigned type, so abs(INT8_MIN) is 128 and doesn't overflow. float: sign bit cleared
+//   sign: -1, 0 or 1. float: -1.0f, 0.0f or 1.0f, NaN and -0.0f give 0.0f
+//   clamp: min(max(x, lo), hi), hi wins if lo > hi. float: NaN gives lo
+//   reduce_min/max: smallest/largest element, the identity (INT8_MAX, +inf, ...) if n == 0. float: NaNs are
+//     skipped (all NaN gives the identity), of -0.0f and 0.0f the first one is returned
+//   argmin/argmax: index of the first smallest/largest element, NaNs skipped. 0 if n == 0 or all NaN
+// Elementwise kernels may write in place (out == a or out == b), but not to partly overlapping arrays.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+template <typename T>
+struct ArrayAbs
+{
+  typedef typename std::make_unsigned<T>::type Type;
+};
+
+template <>
+struct ArrayAbs<float>
+{
+  typedef float Type;
+};
+
+template <typename T>
+static inline T elementMin(T a, T b)
+{
+  return a < b ? a : b;
+}
+
+template <typename T>
+static inline T elementMax(T a, T b)
+{
+  return a > b ? a : b;
+}
+
+template <typename T>
+static inline typename ArrayAbs<T>::Type elementAbs(T x)
+{
+  typedef typename ArrayAbs<T>::Type U;
+  return x < 0 ? (U)(0 - (U)x) : (U)x;
+}
+
+template <>
+inline float elementAbs<float>(float x)
+{
+  return __builtin_fabsf(x);
+}
+
+template <typename T>
+static inline T elementSign(T x)
+{
+  return (T)((x > 0) - (x < 0));
+}
+
+template <typename T>
+static inline T elementClamp(T x, T lo, T hi)
+{
+  return elementMin(elementMax(x, lo), hi);
+}
+
+// X(T) for every element type
+#define ARRAY_KERNEL_TYPES(X) X(int8_t) X(int16_t) X(int32_t) X(int64_t) X(float)
+
+#define ARRAY_KERNEL_DECLARE(T)                                                                                   \
+  void array_min(const T *a, const T *b, T *out, size_t n);                                                       \
+  void array_max(const T *a, const T *b, T *out, size_t n);                                                       \
+  void array_abs(const T *a, ArrayAbs<T>::Type *out, size_t n);                                                   \
+  void array_sign(const T *a, T *out, size_t n);                                                                  \
+  void array_clamp(const T *a, T lo, T hi, T *out, size_t n);                                                     \
+  T array_reduce_min(const T *a, size_t n);                                                                       \
+  T array_reduce_max(const T *a, size_t n);                                                                       \
+  size_t array_argmin(const T *a, size_t n);                                                                      \
+  size_t array_argmax(const T *a, size_t n);
+
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DECLARE)
+const char *array_kernels_isa();
+
+#if defined(__x86_64__)
+// individual variants, for benchmarking. Caller must check cpu support (__builtin_cpu_supports)
+namespace array_sse2
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DECLARE)
+}
+namespace array_sse4 // sse4.2: pminsb/pminsd/pblendvb, pcmpgtq for int64
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DECLARE)
+}
+namespace array_avx2
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DECLARE)
+}
+namespace array_avx512 // avx512bw
+{
+ARRAY_KERNEL_TYPES(ARRAY_KERNEL_DECLARE)
+}
+#endif
+
+#undef ARRAY_KERNEL_DECLARE
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+// Small timing helpers shared by the benchmark demos in this repo.
+// Header only so that demos in other folders can simply include "../generic/bench.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static inline uint64_t nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// cheapest available timestamp. On x86 this is TSC which ticks at constant rate (not actual core clock)
+// so it's good for measuring short intervals without the ~20ns cost of clock_gettime
+static inline uint64_t readCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return nowNs();
+#endif
+}
+
+// ticks of readCycles() per nanosecond. Calibrated once against monotonic clock
+static inline double cyclesPerNs()
+{
+  static double ratio = 0;
+  if (ratio == 0)
+  {
+    uint64_t t0 = nowNs();
+    uint64_t c0 = readCycles();
+    while (nowNs() - t0 < 20000000) // 20ms is enough to get 3 significant digits
+    {
+    }
+    ratio = (double)(readCycles() - c0) / (double)(nowNs() - t0);
+  }
+  return ratio;
+}
+
+// keep compiler from optimizing away a computed value or a store to memory
+template <typename T>
+static inline void doNotOptimize(T const &val)
+{
+  asm volatile("" : : "r,m"(val) : "memory");
+}
+
+static inline void clobberMemory()
+{
+  asm volatile("" : : : "memory");
+}
+
+static inline int compareU64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static inline void sortSamples(uint64_t *samples, size_t num)
+{
+  qsort(samples, num, sizeof(samples[0]), compareU64);
+}
+
+// p in [0, 100]. samples must already be sorted
+static inline uint64_t percentile(const uint64_t *samples, size_t num, double p)
+{
+  if (num == 0)
+    return 0;
+  size_t idx = (size_t)(p / 100.0 * (num - 1) + 0.5);
+  return samples[idx];
+}
+
+#endif
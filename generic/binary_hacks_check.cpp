@@ -0,0 +1,436 @@
+// Exhaustive check and microbenchmark of binary_hacks.h.
+//
+// Check: every function over all 2^32 values of its (first) argument, against a reference written the
+// obvious way (builtins, 64 bit arithmetic, definitions). Functions of two arguments get a second one derived
+// from the first by a hash, k-bit functions a k from 0 to 31 the same way, so each pairing is different
+// but the first argument still takes every value. The 2^32 inputs are cut into chunks that all cores take
+// from a shared counter. Failures are reported with the smallest failing input and both results.
+// Build with -O2: at -O0 the loop functions (countSetBits, reverseBits, interleaveBits, ...) over 2^32 inputs
+// take hours on one core. -DCHECK_STRIDE=n checks every n-th input only, for a quick run.
+// ceilDivision and roundToNearestDivision get divisors of every size (never 0) from the same hash.
+// The 32 bit bitops.h primitives are checked here too, builtin version against bitops::portable.
+//
+// Benchmark: ns per call over random 32 bit inputs
+//   throughput: independent calls, sum of results. What a loop over an array of inputs costs
+//   latency: each input depends on the previous result (x = input ^ f(previous x)). What a call on the
+//   critical path costs: branchless code has a fixed latency, a loop or a branch depends on the value
+//   (and a mispredicted branch costs ~15-20 cycles)
+// next to the builtin (bitops.h) or plain C version of the same operation.
+//
+// Found and fixed with it: reverseBits returned garbage for every input with bit 31 set (shift by 255),
+// interleaveBitsByMagicNumber never masked x and y (wrong for almost every input), numMod2PowK cut its result
+// to 8 bits, absBranchless(INT_MIN) overflowed int, and the k-bit functions shifted 1 << 31 into the sign.
+// ceilDivision wrapped in a + b - 1, roundToNearestDivision went through float (wrong from 2^24 on).
+//
+// Typical result (1 core VM, g++ -O2, whole check ~31 minutes on the one thread, 13 of them the bitops.h
+// cases), ns per call:
+//   function                       throughput  latency
+//   countSetBits (bit loop)        ~22         ~23
+//   fastCountSetBits (x &= x - 1)  ~20         ~20
+//   bitops::popcount (libgcc call) ~3.3        ~4.7    (hardware popcnt with -mpopcnt)
+//   getParity / bitops::parity     ~19 / ~0.7  ~21 / ~2.9
+//   reverseBits / bitops::         ~22 / ~1.5  ~24 / ~4
+//   log2ByShift (loop)             ~17         ~19
+//   log2LutMethod                  ~0.7        ~3
+//   bitops::log2Floor (bsr)        ~0.7        ~2
+//   log10ByCompare / bitops::      ~0.9 / ~3.4 ~1 / ~6
+//   grayToBinary / Fast            ~17 / ~0.4  ~17 / ~3.7
+//   interleaveBits / ByMagicNumber ~19 / ~1    ~19 / ~6.5
+//   minBranchless / x < y ? x : y  ~0.26       ~1
+// The bit loops run ~16-31 rounds on random inputs; the table, SWAR and builtin versions are 5-30x faster.
+// log10ByCompare wins here only because 76% of uniform inputs leave at the first, well predicted compare.
+// minBranchless / absBranchless gain nothing on x86: the compiler turns the plain compare into cmov itself.
+// log2LutMethod had its table as a non-static local, copied to the stack on every call (~5.7 ns).
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <atomic>
+#include "binary_hacks.h"
+#include "bitops.h"
+#include "morton.h"
+#include "bench.h"
+
+#define CHECK_CHUNK (1ULL << 22) // inputs per work item
+#ifndef CHECK_STRIDE
+#define CHECK_STRIDE 1 // check every input
+#endif
+#define BENCH_INPUTS 4096
+#define BENCH_ROUNDS 100
+
+// ---------------- helpers: functions with pointer arguments as values ----------------
+
+// second argument for two argument functions: odd multiplier, so a bijection of x
+static inline uint32_t partner(uint32_t x)
+{
+  return x * 0x9E3779B9u + 0x7F4A7C15u;
+}
+
+// 0 to 31
+static inline uint8_t kOf(uint32_t x)
+{
+  return (uint8_t)((x * 0x9E3779B9u) >> 27);
+}
+
+// divisor for the division functions: 1 to 2^32 - 1, small ones as often as large ones
+static inline uint32_t divisorOf(uint32_t x)
+{
+  uint32_t d = partner(x) >> kOf(partner(x));
+  return d ? d : 1;
+}
+
+static inline uint32_t setKthBitValue(uint32_t x, uint8_t k)
+{
+  setKthBit(&x, k);
+  return x;
+}
+
+static inline uint32_t unsetKthBitValue(uint32_t x, uint8_t k)
+{
+  unsetKthBit(&x, k);
+  return x;
+}
+
+static inline uint32_t toggleKthBitValue(uint32_t x, uint8_t k)
+{
+  toggleKthBit(&x, k);
+  return x;
+}
+
+static inline uint32_t setKLsbBitsValue(uint32_t x, uint8_t k)
+{
+  setKLsbBits(&x, k);
+  return x;
+}
+
+// both values after swap(&a, &b), a in the high half
+static inline uint64_t swapValues(uint32_t a, uint32_t b)
+{
+  swap(&a, &b);
+  return ((uint64_t)a << 32) | b;
+}
+
+static inline uint64_t swapMacroValues(uint32_t a, uint32_t b)
+{
+  SWAP(a, b);
+  return ((uint64_t)a << 32) | b;
+}
+
+// x toggled twice between x and y: y then x again
+static inline uint64_t toggleValues(uint32_t x, uint32_t y)
+{
+  uint32_t v = x;
+  toggle(&v, x, y);
+  uint32_t once = v;
+  toggle(&v, x, y);
+  return ((uint64_t)once << 32) | v;
+}
+
+// swapBitsSet needs two fields that don't overlap: cnt 1 to 8 bits, one in the low half, one in the high half
+static inline uint8_t setCount(uint32_t h)
+{
+  return 1 + (h & 7);
+}
+
+static inline uint8_t setLow(uint32_t h)
+{
+  return (h >> 3) % (17 - setCount(h));
+}
+
+static inline uint8_t setHigh(uint32_t h)
+{
+  return 16 + (h >> 8) % (17 - setCount(h));
+}
+
+static inline uint32_t swapBitsSetReference(uint32_t x, uint8_t i, uint8_t j, uint8_t cnt)
+{
+  uint32_t mask = (1U << cnt) - 1;
+  uint32_t a = (x >> i) & mask, b = (x >> j) & mask;
+  return (x & ~(mask << i) & ~(mask << j)) | (a << j) | (b << i);
+}
+
+static inline uint32_t swapBitsReference(uint32_t x, uint8_t i, uint8_t j)
+{
+  return swapBitsSetReference(x, i < j ? i : j, i < j ? j : i, 1) * (i != j) + x * (i == j);
+}
+
+// ---------------- check ----------------
+
+struct CheckFailures
+{
+  uint64_t count;
+  uint64_t first; // UINT64_MAX if none
+};
+
+template <typename Got, typename Want>
+static CheckFailures countFailures(uint64_t begin, uint64_t end, Got got, Want want)
+{
+  CheckFailures f = {0, UINT64_MAX};
+  for (uint64_t x = begin; x < end; x += CHECK_STRIDE)
+  {
+    if (got((uint32_t)x) != want((uint32_t)x))
+    {
+      f.first = f.count ? f.first : x;
+      f.count++;
+    }
+  }
+  return f;
+}
+
+struct CheckCase
+{
+  const char *name;
+  uint64_t (*got)(uint32_t x);
+  uint64_t (*want)(uint32_t x);
+  CheckFailures (*run)(uint64_t begin, uint64_t end); // inlined got/want, for speed
+};
+
+#define CHECK_CASE(name, gotExpr, wantExpr)                                                                       \
+  {                                                                                                               \
+    name, [](uint32_t x) -> uint64_t { return gotExpr; }, [](uint32_t x) -> uint64_t { return wantExpr; },       \
+        [](uint64_t begin, uint64_t end) {                                                                        \
+          return countFailures(                                                                                   \
+              begin, end, [](uint32_t x) -> uint64_t { return gotExpr; },                                         \
+              [](uint32_t x) -> uint64_t { return wantExpr; });                                                   \
+        }                                                                                                         \
+  }
+
+static const CheckCase checkCases[] = {
+    CHECK_CASE("isOdd", isOdd(x), x % 2),
+    CHECK_CASE("isPowerOfTwo", isPowerOfTwo(x), __builtin_popcount(x) == 1),
+    CHECK_CASE("isKthBitSet", isKthBitSet(x, kOf(x)), (x >> kOf(x)) & 1),
+    CHECK_CASE("setKthBit", setKthBitValue(x, kOf(x)), x | (1ULL << kOf(x))),
+    CHECK_CASE("unsetKthBit", unsetKthBitValue(x, kOf(x)), x & ~(1ULL << kOf(x))),
+    CHECK_CASE("toggleKthBit", toggleKthBitValue(x, kOf(x)), x ^ (1ULL << kOf(x))),
+    CHECK_CASE("setKLsbBits", setKLsbBitsValue(x, kOf(x)), x | ((1ULL << kOf(x)) - 1)),
+    CHECK_CASE("numMod2PowK", numMod2PowK(x, kOf(x)), x % (1ULL << kOf(x))),
+    CHECK_CASE("swap", swapValues(x, partner(x)), ((uint64_t)partner(x) << 32) | x),
+    CHECK_CASE("SWAP", swapMacroValues(x, partner(x)), ((uint64_t)partner(x) << 32) | x),
+    CHECK_CASE("toggle", toggleValues(x, partner(x)), ((uint64_t)partner(x) << 32) | x),
+    CHECK_CASE("sign", (int64_t)sign((int32_t)x), (int64_t)(((int32_t)x > 0) - ((int32_t)x < 0))),
+    CHECK_CASE("ifOppositeSign", ifOppositeSign((int32_t)x, (int32_t)partner(x)),
+               ((int32_t)x < 0) != ((int32_t)partner(x) < 0)),
+    CHECK_CASE("absBranchless", absBranchless((int32_t)x), (uint64_t)llabs((int64_t)(int32_t)x)),
+    CHECK_CASE("minBranchless", (int64_t)minBranchless((int32_t)x, (int32_t)partner(x)),
+               (int64_t)((int32_t)x < (int32_t)partner(x) ? (int32_t)x : (int32_t)partner(x))),
+    CHECK_CASE("maxBranchless", (int64_t)maxBranchless((int32_t)x, (int32_t)partner(x)),
+               (int64_t)((int32_t)x > (int32_t)partner(x) ? (int32_t)x : (int32_t)partner(x))),
+    CHECK_CASE("countSetBits", countSetBits(x), __builtin_popcount(x)),
+    CHECK_CASE("fastCountSetBits", fastCountSetBits(x), __builtin_popcount(x)),
+    CHECK_CASE("getParity", getParity(x), __builtin_parity(x)),
+    CHECK_CASE("lsb1Bit", lsb1Bit(x), x ? 1ULL << __builtin_ctz(x) : 0),
+    CHECK_CASE("swapNibbles", swapNibbles((uint8_t)x), ((x & 0xf) << 4) | ((x >> 4) & 0xf)),
+    CHECK_CASE("swapBits", swapBits(x, kOf(x), kOf(partner(x))), swapBitsReference(x, kOf(x), kOf(partner(x)))),
+    CHECK_CASE("swapBitsSet", swapBitsSet(x, setLow(partner(x)), setHigh(partner(x)), setCount(partner(x))),
+               swapBitsSetReference(x, setLow(partner(x)), setHigh(partner(x)), setCount(partner(x)))),
+    CHECK_CASE("reverseBits", reverseBits(x), bitops::portable::reverseBits(x)),
+    CHECK_CASE("log2ByShift", log2ByShift(x), x ? 31 - __builtin_clz(x) : 0),
+    CHECK_CASE("log2LutMethod", log2LutMethod(x), x ? 31 - __builtin_clz(x) : 255), // 0: lut[0] = -1
+    CHECK_CASE("log10ByCompare", log10ByCompare(x), bitops::portable::log10Floor(x)),
+    CHECK_CASE("countTrailingZeros", countTrailingZeros(x), x ? __builtin_ctz(x) : 32),
+    CHECK_CASE("roundUpPowerOfTwo", roundUpPowerOfTwo(x), // 0 when 2^32 is next
+               x <= 1 ? 1 : (uint32_t)(1ULL << (32 - __builtin_clz(x - 1)))),
+    CHECK_CASE("alignUp2PowK", alignUp2PowK(x, 1U << kOf(x)),
+               (uint32_t)(((uint64_t)x + (1ULL << kOf(x)) - 1) >> kOf(x) << kOf(x))),
+    CHECK_CASE("interleaveBits", interleaveBits(x & 0xffff, x >> 16), mortonEncode2DMagic(x & 0xffff, x >> 16)),
+    CHECK_CASE("interleaveBitsByMagicNumber", interleaveBitsByMagicNumber(x & 0xffff, x >> 16),
+               mortonEncode2DMagic(x & 0xffff, x >> 16)),
+    CHECK_CASE("ceilDivision", ceilDivision(x, divisorOf(x)), ((uint64_t)x + divisorOf(x) - 1) / divisorOf(x)),
+    CHECK_CASE("roundToNearestDivision", roundToNearestDivision(x, divisorOf(x)),
+               ((uint64_t)x + divisorOf(x) / 2) / divisorOf(x)),
+    CHECK_CASE("binaryToGray", binaryToGray(x), x ^ (x >> 1)),
+    // binaryToGray is a bijection, so the inverse is right if it maps back
+    CHECK_CASE("grayToBinary", binaryToGray(grayToBinary(x)), x),
+    CHECK_CASE("grayToBinaryFast", binaryToGray(grayToBinaryFast(x)), x),
+    // bitops.h: builtin versions against their portable loops (bitops_demo.cpp only samples 32 bit values)
+    CHECK_CASE("bitops::popcount", bitops::popcount(x), bitops::portable::popcount(x)),
+    CHECK_CASE("bitops::parity", bitops::parity(x), bitops::portable::parity(x)),
+    CHECK_CASE("bitops::countLeadingZeros", bitops::countLeadingZeros(x), bitops::portable::countLeadingZeros(x)),
+    CHECK_CASE("bitops::countTrailingZeros", bitops::countTrailingZeros(x),
+               bitops::portable::countTrailingZeros(x)),
+    CHECK_CASE("bitops::log2Floor", bitops::log2Floor(x), bitops::portable::log2Floor(x)),
+    CHECK_CASE("bitops::log2Ceil", bitops::log2Ceil(x), bitops::portable::log2Ceil(x)),
+    CHECK_CASE("bitops::log10Floor", bitops::log10Floor(x), bitops::portable::log10Floor(x)),
+    CHECK_CASE("bitops::roundUpPowerOfTwo", bitops::roundUpPowerOfTwo(x), bitops::portable::roundUpPowerOfTwo(x)),
+    CHECK_CASE("bitops::roundDownPowerOfTwo", bitops::roundDownPowerOfTwo(x),
+               bitops::portable::roundDownPowerOfTwo(x)),
+    CHECK_CASE("bitops::byteSwap", bitops::byteSwap(x), bitops::portable::byteSwap(x)),
+    CHECK_CASE("bitops::reverseBits", bitops::reverseBits(x), bitops::portable::reverseBits(x)),
+    CHECK_CASE("bitops::reverseBitsByTable", bitops::reverseBitsByTable(x), bitops::portable::reverseBits(x)),
+    CHECK_CASE("bitops::grayToBinary", bitops::grayToBinary(x), bitops::portable::grayToBinary(x)),
+    CHECK_CASE("bitops::rotateLeft", bitops::rotateLeft(x, kOf(x)), bitops::portable::rotateLeft(x, kOf(x))),
+};
+
+#undef CHECK_CASE
+
+struct CheckJob
+{
+  const CheckCase *c;
+  std::atomic<uint64_t> nextChunk;
+  std::atomic<uint64_t> failures;
+  std::atomic<uint64_t> firstFailure;
+};
+
+static void *checkWorker(void *arg)
+{
+  CheckJob *job = (CheckJob *)arg;
+  const uint64_t numChunks = (1ULL << 32) / CHECK_CHUNK;
+  for (uint64_t chunk; (chunk = job->nextChunk.fetch_add(1)) < numChunks;)
+  {
+    CheckFailures f = job->c->run(chunk * CHECK_CHUNK, (chunk + 1) * CHECK_CHUNK);
+    if (!f.count)
+      continue;
+    job->failures += f.count;
+    uint64_t first = job->firstFailure.load();
+    while (f.first < first && !job->firstFailure.compare_exchange_weak(first, f.first))
+      ;
+  }
+  return NULL;
+}
+
+// false if any function is wrong for any input
+static bool checkAll(int numThreads)
+{
+  bool ok = true;
+  pthread_t threads[256];
+  for (const CheckCase &c : checkCases)
+  {
+    CheckJob job;
+    job.c = &c;
+    job.nextChunk = 0;
+    job.failures = 0;
+    job.firstFailure = UINT64_MAX;
+    uint64_t t0 = nowNs();
+    int started = 0;
+    for (; started < numThreads - 1; started++)
+    {
+      if (pthread_create(&threads[started], NULL, checkWorker, &job) != 0)
+        break;
+    }
+    checkWorker(&job); // caller works too
+    for (int t = 0; t < started; t++)
+      pthread_join(threads[t], NULL);
+
+    printf("%-28s %6.1f s  ", c.name, (nowNs() - t0) / 1e9);
+    if (job.failures)
+    {
+      uint32_t x = (uint32_t)job.firstFailure;
+      printf("%llu inputs FAILED, first %u (0x%08x): 0x%llx, expected 0x%llx\n",
+             (unsigned long long)job.failures.load(), x, x, (unsigned long long)c.got(x),
+             (unsigned long long)c.want(x));
+      ok = false;
+    }
+    else
+      printf("ok\n");
+  }
+  return ok;
+}
+
+// ---------------- benchmark ----------------
+
+static uint32_t benchX[BENCH_INPUTS], benchY[BENCH_INPUTS];
+
+struct BenchCase
+{
+  const char *name;
+  uint64_t (*throughput)();
+  uint64_t (*latency)();
+};
+
+// expr of x and y, where y is a second random input
+#define BENCH_CASE(name, expr)                                                                                    \
+  {                                                                                                               \
+    name,                                                                                                         \
+        []() -> uint64_t {                                                                                        \
+          uint64_t sum = 0;                                                                                       \
+          for (int i = 0; i < BENCH_INPUTS; i++)                                                                  \
+          {                                                                                                       \
+            uint32_t x = benchX[i], y = benchY[i];                                                                \
+            (void)y;                                                                                              \
+            sum += (uint64_t)(expr);                                                                              \
+          }                                                                                                       \
+          return sum;                                                                                             \
+        },                                                                                                        \
+        []() -> uint64_t {                                                                                        \
+          uint32_t chain = 0;                                                                                     \
+          for (int i = 0; i < BENCH_INPUTS; i++)                                                                  \
+          {                                                                                                       \
+            uint32_t x = benchX[i] ^ chain, y = benchY[i];                                                        \
+            (void)y;                                                                                              \
+            chain = (uint32_t)(expr);                                                                             \
+          }                                                                                                       \
+          return chain;                                                                                           \
+        }                                                                                                         \
+  }
+
+static const BenchCase benchCases[] = {
+    BENCH_CASE("countSetBits", countSetBits(x)),
+    BENCH_CASE("fastCountSetBits", fastCountSetBits(x)),
+    BENCH_CASE("bitops::popcount", bitops::popcount(x)),
+    BENCH_CASE("getParity", getParity(x)),
+    BENCH_CASE("bitops::parity", bitops::parity(x)),
+    BENCH_CASE("reverseBits", reverseBits(x)),
+    BENCH_CASE("bitops::reverseBits", bitops::reverseBits(x)),
+    BENCH_CASE("log2ByShift", log2ByShift(x)),
+    BENCH_CASE("log2LutMethod", log2LutMethod(x)),
+    BENCH_CASE("bitops::log2Floor", bitops::log2Floor(x)),
+    BENCH_CASE("log10ByCompare", log10ByCompare(x)),
+    BENCH_CASE("bitops::log10Floor", bitops::log10Floor(x)),
+    BENCH_CASE("countTrailingZeros", countTrailingZeros(x)),
+    BENCH_CASE("bitops::countTrailingZeros", bitops::countTrailingZeros(x)),
+    BENCH_CASE("roundUpPowerOfTwo", roundUpPowerOfTwo(x)),
+    BENCH_CASE("bitops::roundUpPowerOfTwo", bitops::roundUpPowerOfTwo(x)),
+    BENCH_CASE("interleaveBits", interleaveBits(x, x >> 16)),
+    BENCH_CASE("interleaveBitsByMagicNumber", interleaveBitsByMagicNumber(x & 0xffff, x >> 16)),
+    BENCH_CASE("grayToBinary", grayToBinary(x)),
+    BENCH_CASE("grayToBinaryFast", grayToBinaryFast(x)),
+    BENCH_CASE("absBranchless", absBranchless((int32_t)x)),
+    BENCH_CASE("(int32_t)x < 0 ? -x : x", (int32_t)x < 0 ? 0u - x : x),
+    BENCH_CASE("minBranchless", minBranchless((int32_t)x, (int32_t)y)),
+    BENCH_CASE("x < y ? x : y", (int32_t)x < (int32_t)y ? (int32_t)x : (int32_t)y),
+    BENCH_CASE("sign", sign((int32_t)x)),
+    BENCH_CASE("swapBits", swapBits(x, y & 31, (y >> 5) & 31)),
+    BENCH_CASE("lsb1Bit", lsb1Bit(x)),
+    BENCH_CASE("alignUp2PowK", alignUp2PowK(x, 1U << (y & 31))),
+};
+
+#undef BENCH_CASE
+
+static double nsPerCall(uint64_t (*fn)())
+{
+  double best = 1e9;
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    doNotOptimize(fn());
+    double ns = (double)(nowNs() - t0) / BENCH_INPUTS;
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+int main_binary_hacks_check()
+{
+  int numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  numThreads = numThreads < 1 ? 1 : (numThreads > 256 ? 256 : numThreads);
+  printf("checking every function over 2^32 inputs%s, %d threads\n", CHECK_STRIDE > 1 ? " (strided)" : "",
+         numThreads);
+  bool ok = checkAll(numThreads);
+  printf(ok ? "all functions match their references\n\n" : "some functions are WRONG\n\n");
+
+  uint64_t seed = 88172645463325252ULL;
+  for (int i = 0; i < BENCH_INPUTS; i++)
+  {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    benchX[i] = (uint32_t)seed;
+    benchY[i] = (uint32_t)(seed >> 32);
+  }
+  printf("%-30s %12s %10s   ns per call, random inputs\n", "function", "throughput", "latency");
+  for (const BenchCase &b : benchCases)
+    printf("%-30s %12.2f %10.2f\n", b.name, nsPerCall(b.throughput), nsPerCall(b.latency));
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+// reverse_bits_array and the Gray code arrays of bit_reverse.h, with runtime ISA dispatch like
+// array_kernels.cpp (GNU ifunc on x86-64 ELF).
+//
+// Written on GCC vector extension types of W bytes (simd_vec.h), one element operation per kernel with a
+// vector and a scalar form; the last elements (fewer than one vector) go through the scalar one, bitops.h.
+// Shifts of uint8_t lanes don't exist on x86 either: GCC shifts 16 bit lanes (psrlw) and masks the bits
+// that crossed into the next byte.
+// The nibble lookups need pshufb by name: __builtin_shuffle with variable indices on 32 and 64 byte vectors
+// is a shuffle across the whole vector, which pshufb (per 16 byte lane) is not.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bit_reverse.h"
+#include "bitops.h"
+#include "simd_vec.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// bit pattern of s ones and s zeros repeated, from the low end: 0x55.. for 1, 0x33.. for 2, 0x0f.. for 4
+template <typename T>
+constexpr T swapMask(int s)
+{
+  return (T)((T)~(T)0 / (T)(((T)1 << s) + 1));
+}
+
+// ---------------- element operations, vector and scalar ----------------
+
+// halves of every lane of S bits swapped, then the halves of those, down to single bits. Unrolled by the
+// template: a loop over S is kept as a loop by GCC, with a division for every mask
+template <typename T, int S, typename V>
+ALWAYS_INLINE V swapHalves(const V &v)
+{
+  const T m = swapMask<T>(S);
+  V x = ((v >> S) & m) | ((v & m) << S);
+  if constexpr (S > 1)
+    return swapHalves<T, S / 2>(x);
+  else
+    return x;
+}
+
+// bitops::reverseBits with the byte swap written as steps too
+template <typename T>
+struct OpReverseSwar
+{
+  template <typename V>
+  ALWAYS_INLINE V vec(const V &x) const { return swapHalves<T, sizeof(T) * 4>(x); }
+  ALWAYS_INLINE T scalar(T x) const { return bitops::reverseBits(x); }
+};
+
+template <typename T>
+struct OpGrayEncode
+{
+  template <typename V>
+  ALWAYS_INLINE V vec(const V &x) const { return x ^ (x >> 1); }
+  ALWAYS_INLINE T scalar(T x) const { return bitops::binaryToGray(x); }
+};
+
+template <typename T>
+struct OpGrayDecode
+{
+  template <typename V>
+  ALWAYS_INLINE V vec(const V &x) const { return xorShifted<1>(x); }
+  ALWAYS_INLINE T scalar(T x) const { return bitops::grayToBinary(x); }
+
+  // x ^= x >> shift, for shift 1, 2, 4 .. up to the width
+  template <int Shift, typename V>
+  ALWAYS_INLINE static V xorShifted(const V &v)
+  {
+    V x = v ^ (v >> Shift);
+    if constexpr (Shift * 2 < (int)sizeof(T) * 8)
+      return xorShifted<Shift * 2>(x);
+    else
+      return x;
+  }
+};
+
+#if defined(__x86_64__)
+// pshufb: byte i of the result is table[index[i] & 15] within each 16 byte lane (0 if bit 7 of the index is
+// set, never the case here)
+__attribute__((target("avx2"))) inline VecOf<32>::Type shuffleBytes(const VecOf<32>::Type &table,
+                                                                     const VecOf<32>::Type &index)
+{
+  return (VecOf<32>::Type)_mm256_shuffle_epi8((__m256i)table, (__m256i)index);
+}
+
+__attribute__((target("avx512bw"))) inline VecOf<64>::Type shuffleBytes(const VecOf<64>::Type &table,
+                                                                         const VecOf<64>::Type &index)
+{
+  return (VecOf<64>::Type)_mm512_shuffle_epi8((__m512i)table, (__m512i)index);
+}
+
+// 16 bytes repeated over W
+template <size_t W>
+ALWAYS_INLINE typename VecOf<W>::Type repeat16(const uint8_t (&bytes)[16])
+{
+  typename VecOf<W>::Type v;
+  for (size_t i = 0; i < W; i++)
+    v[i] = bytes[i % 16];
+  return v;
+}
+
+// each nibble reversed through a table, bytes put in reverse order within lanes of T. The tables are
+// members, built once per call and not in the loop
+template <typename T, size_t W>
+struct OpReverseShuffle
+{
+  typedef typename VecOf<W>::Type B;
+  B low, high, order;
+  ALWAYS_INLINE OpReverseShuffle()
+  {
+    static const uint8_t lowBytes[16] = {0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, // i reversed, high nibble
+                                         0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0};
+    static const uint8_t highBytes[16] = {0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, // i reversed, low nibble
+                                          0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf};
+    uint8_t orderBytes[16]; // byte j of lane k from byte sizeof(T) - 1 - j
+    for (size_t i = 0; i < 16; i++)
+      orderBytes[i] = (uint8_t)(i - i % sizeof(T) + sizeof(T) - 1 - i % sizeof(T));
+    low = repeat16<W>(lowBytes);
+    high = repeat16<W>(highBytes);
+    order = repeat16<W>(orderBytes);
+  }
+  template <typename V>
+  ALWAYS_INLINE V vec(const V &x) const
+  {
+    B bytes = (B)x, nibble = (B){} + 0x0f;
+    B r = shuffleBytes(low, bytes & nibble) | shuffleBytes(high, (bytes >> 4) & nibble);
+    if constexpr (sizeof(T) > 1)
+      r = shuffleBytes(r, order);
+    return (V)r;
+  }
+  ALWAYS_INLINE T scalar(T x) const { return bitops::reverseBits(x); }
+};
+#endif
+
+// ---------------- loop ----------------
+
+template <typename T, size_t W, typename Op>
+ALWAYS_INLINE void mapUnary(const T *in, T *out, size_t n, const Op &op)
+{
+  typedef typename Lanes<T, W>::Vec V;
+  size_t i = 0;
+  for (; i + Lanes<T, W>::N <= n; i += Lanes<T, W>::N)
+  {
+    V x;
+    __builtin_memcpy(&x, in + i, W);
+    V y = op.vec(x);
+    __builtin_memcpy(out + i, &y, W);
+  }
+  for (; i < n; i++)
+    out[i] = op.scalar(in[i]);
+}
+
+// ---------------- variants ----------------
+
+// every kernel of one element type, for the ISA of BIT_REVERSE_TARGET, vectors of BIT_REVERSE_W bytes and
+// bit reversal by BIT_REVERSE_OP
+#define BIT_REVERSE_DEFINE(T)                                                                                     \
+  BIT_REVERSE_TARGET void reverse_bits_array(const T *in, T *out, size_t n)                                       \
+  {                                                                                                               \
+    mapUnary<T, BIT_REVERSE_W>(in, out, n, BIT_REVERSE_OP(T)());                                                  \
+  }                                                                                                               \
+  BIT_REVERSE_TARGET void gray_encode_array(const T *in, T *out, size_t n)                                        \
+  {                                                                                                               \
+    mapUnary<T, BIT_REVERSE_W>(in, out, n, OpGrayEncode<T>());                                                    \
+  }                                                                                                               \
+  BIT_REVERSE_TARGET void gray_decode_array(const T *in, T *out, size_t n)                                        \
+  {                                                                                                               \
+    mapUnary<T, BIT_REVERSE_W>(in, out, n, OpGrayDecode<T>());                                                    \
+  }
+
+#if defined(__x86_64__)
+
+#define BIT_REVERSE_W 16
+#define BIT_REVERSE_TARGET
+#define BIT_REVERSE_OP(T) OpReverseSwar<T>
+namespace bit_reverse_sse2
+{
+BIT_REVERSE_TYPES(BIT_REVERSE_DEFINE)
+}
+#undef BIT_REVERSE_OP
+#undef BIT_REVERSE_TARGET
+#undef BIT_REVERSE_W
+
+#define BIT_REVERSE_W 32
+#define BIT_REVERSE_TARGET __attribute__((target("avx2")))
+#define BIT_REVERSE_OP(T) OpReverseShuffle<T, 32>
+namespace bit_reverse_avx2
+{
+BIT_REVERSE_TYPES(BIT_REVERSE_DEFINE)
+}
+#undef BIT_REVERSE_OP
+#undef BIT_REVERSE_TARGET
+#undef BIT_REVERSE_W
+
+#define BIT_REVERSE_W 64
+#define BIT_REVERSE_TARGET __attribute__((target("avx512bw")))
+#define BIT_REVERSE_OP(T) OpReverseShuffle<T, 64>
+namespace bit_reverse_avx512
+{
+BIT_REVERSE_TYPES(BIT_REVERSE_DEFINE)
+}
+#undef BIT_REVERSE_OP
+#undef BIT_REVERSE_TARGET
+#undef BIT_REVERSE_W
+
+// ---------------- dispatch ----------------
+
+template <typename T>
+using BitReverseArrayFn = void (*)(const T *, T *, size_t);
+
+// 0 sse2, 1 avx2, 2 avx512bw. Called from ifunc resolvers, so no global data
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE int bitReverseIsaLevel()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw"))
+    return 2;
+  if (__builtin_cpu_supports("avx2"))
+    return 1;
+  return 0;
+}
+
+#define BIT_REVERSE_RESOLVER(T, name)                                                                             \
+  IFUNC_RESOLVER BitReverseArrayFn<T> resolve_##name##_##T()                                                      \
+  {                                                                                                               \
+    switch (bitReverseIsaLevel())                                                                                 \
+    {                                                                                                             \
+    case 2:                                                                                                       \
+      return static_cast<BitReverseArrayFn<T>>(bit_reverse_avx512::name);                                         \
+    case 1:                                                                                                       \
+      return static_cast<BitReverseArrayFn<T>>(bit_reverse_avx2::name);                                           \
+    default:                                                                                                      \
+      return static_cast<BitReverseArrayFn<T>>(bit_reverse_sse2::name);                                           \
+    }                                                                                                             \
+  }
+
+#define BIT_REVERSE_RESOLVERS(T)                                                                                  \
+  BIT_REVERSE_RESOLVER(T, reverse_bits_array)                                                                     \
+  BIT_REVERSE_RESOLVER(T, gray_encode_array)                                                                      \
+  BIT_REVERSE_RESOLVER(T, gray_decode_array)
+
+BIT_REVERSE_TYPES(BIT_REVERSE_RESOLVERS)
+
+#undef BIT_REVERSE_RESOLVERS
+#undef BIT_REVERSE_RESOLVER
+
+#if defined(__ELF__)
+#define BIT_REVERSE_DISPATCH(T)                                                                                   \
+  void reverse_bits_array(const T *in, T *out, size_t n) __attribute__((ifunc("resolve_reverse_bits_array_" #T))); \
+  void gray_encode_array(const T *in, T *out, size_t n) __attribute__((ifunc("resolve_gray_encode_array_" #T)));   \
+  void gray_decode_array(const T *in, T *out, size_t n) __attribute__((ifunc("resolve_gray_decode_array_" #T)));
+#else
+#define BIT_REVERSE_DISPATCH_ONE(T, name)                                                                         \
+  void name(const T *in, T *out, size_t n)                                                                        \
+  {                                                                                                               \
+    static BitReverseArrayFn<T> impl = resolve_##name##_##T();                                                    \
+    impl(in, out, n);                                                                                             \
+  }
+#define BIT_REVERSE_DISPATCH(T)                                                                                   \
+  BIT_REVERSE_DISPATCH_ONE(T, reverse_bits_array)                                                                 \
+  BIT_REVERSE_DISPATCH_ONE(T, gray_encode_array)                                                                  \
+  BIT_REVERSE_DISPATCH_ONE(T, gray_decode_array)
+#endif
+
+BIT_REVERSE_TYPES(BIT_REVERSE_DISPATCH)
+
+#undef BIT_REVERSE_DISPATCH
+#undef BIT_REVERSE_DISPATCH_ONE
+
+const char *bit_reverse_isa()
+{
+  static const char *const names[] = {"sse2", "avx2", "avx512bw"};
+  return names[bitReverseIsaLevel()];
+}
+
+#else
+
+// other architectures: 16 byte vectors, NEON on ARM
+#define BIT_REVERSE_W 16
+#define BIT_REVERSE_TARGET
+#define BIT_REVERSE_OP(T) OpReverseSwar<T>
+BIT_REVERSE_TYPES(BIT_REVERSE_DEFINE)
+#undef BIT_REVERSE_OP
+#undef BIT_REVERSE_TARGET
+#undef BIT_REVERSE_W
+
+const char *bit_reverse_isa()
+{
+  return "generic";
+}
+
+#endif
+
+#undef BIT_REVERSE_DEFINE
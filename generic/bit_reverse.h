@@ -0,0 +1,135 @@
+#ifndef __BIT_REVERSE_H
+#define __BIT_REVERSE_H
+
+// Bit reversal and Gray code over arrays of uint8_t to uint64_t (bit reversed FFT indices, encoder readouts),
+// and the bit reversal permutation of an array in place. Scalar versions are in bitops.h.
+//
+// reverse_bits_array: out[i] = bitops::reverseBits(in[i]). x86 has no bit reverse, for vectors neither
+// (before GFNI), but pshufb looks up 16 bytes in a 16 entry table at once: each byte is reversed by 2 lookups
+// of its nibbles (low nibble reversed is the high nibble of the result and the other way round), one more
+// pshufb puts the bytes of every lane in reverse order. 4 instructions per vector for every width. SSE2 has
+// no pshufb (SSSE3), there the mask and shift steps of bitops::reverseBits run on all lanes.
+// gray_encode_array / gray_decode_array: bitops::binaryToGray / grayToBinary on all lanes, decode is
+// log2(width) shift and xor steps.
+// Widest available ISA is picked once at load time, like array_kernels.h: AVX-512BW, AVX2 or SSE2 (x86-64
+// baseline), NEON through the generic code on ARM. out may be in, but not partly overlap it.
+//
+// bit_reverse_permute: a[i] and a[r(i)] swapped for every i, r(i) the log2n bit reverse of i. The plain loop
+// (swap when i < r(i)) reads a[r(i)] 2^(log2n-1) elements after a[r(i - 1)]: once the array is larger than
+// the caches every one of those is a cache miss, and a TLB miss, for one element of the 64 byte line.
+// Blocked instead (Carter, Gatlin: Towards an optimal bit-reversal permutation program): index bits are split
+// into b high, the middle and b low bits, the 2^2b elements with the same middle bits m are a tile of 2^b rows
+// of 2^b consecutive elements (rows 2^(log2n-b) apart). The permutation moves tile m onto tile r(m),
+// transposed with rows and columns in bit reversed order. Both tiles are copied to a buffer row by row and
+// written into each other's place row by row, so every line is read and written once and used in full.
+// b is picked so a row is at least a cache line and the 2 tiles and their buffers (4 KB each) stay in L1.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitops.h"
+
+// X(T) for every element type
+#define BIT_REVERSE_TYPES(X) X(uint8_t) X(uint16_t) X(uint32_t) X(uint64_t)
+
+#define BIT_REVERSE_DECLARE(T)                                                                                    \
+  void reverse_bits_array(const T *in, T *out, size_t n);                                                         \
+  void gray_encode_array(const T *in, T *out, size_t n);                                                          \
+  void gray_decode_array(const T *in, T *out, size_t n);
+
+BIT_REVERSE_TYPES(BIT_REVERSE_DECLARE)
+const char *bit_reverse_isa();
+
+#if defined(__x86_64__)
+// individual variants, for benchmarking. Caller must check cpu support (__builtin_cpu_supports)
+namespace bit_reverse_sse2
+{
+BIT_REVERSE_TYPES(BIT_REVERSE_DECLARE)
+}
+namespace bit_reverse_avx2
+{
+BIT_REVERSE_TYPES(BIT_REVERSE_DECLARE)
+}
+namespace bit_reverse_avx512 // avx512bw
+{
+BIT_REVERSE_TYPES(BIT_REVERSE_DECLARE)
+}
+#endif
+
+#undef BIT_REVERSE_DECLARE
+
+// low bits of x reversed
+static inline size_t reverseIndex(size_t x, unsigned bits)
+{
+  return bits ? (size_t)(bitops::reverseBits((uint64_t)x) >> (64 - bits)) : 0;
+}
+
+// b of the tiles: rows of at least 64 bytes, tiles of at most 4 KB
+template <typename T>
+constexpr unsigned bitReverseTileBits()
+{
+  unsigned b = 0;
+  while ((sizeof(T) << (2 * b + 2)) <= 4096)
+    b++;
+  return b;
+}
+
+// a has 2^log2n elements. Anything assignable: complex numbers of an FFT, structs
+template <typename T>
+void bit_reverse_permute(T *a, unsigned log2n)
+{
+  const unsigned b = bitReverseTileBits<T>();
+  const size_t rows = (size_t)1 << b;
+  if (log2n < 2 * b + 1) // a few tiles at most: in L1 anyway
+  {
+    for (size_t i = 0; i < ((size_t)1 << log2n); i++)
+    {
+      size_t j = reverseIndex(i, log2n);
+      if (i < j)
+      {
+        T t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+      }
+    }
+    return;
+  }
+  const unsigned midBits = log2n - 2 * b;
+  const size_t stride = (size_t)1 << (log2n - b); // from one row of a tile to the next
+  alignas(64) T bufA[rows * rows], bufB[rows * rows];
+  uint8_t rev[rows];
+  for (size_t i = 0; i < rows; i++)
+    rev[i] = (uint8_t)reverseIndex(i, b);
+  // element (row r, column c) of the tile with middle bits m lands at (rev[c], rev[r]) of tile r(m)
+  auto load = [&](T *buf, const T *tile) {
+    for (size_t r = 0; r < rows; r++)
+    {
+      for (size_t c = 0; c < rows; c++)
+        buf[r * rows + c] = tile[r * stride + c];
+    }
+  };
+  auto store = [&](T *tile, const T *buf) {
+    for (size_t r = 0; r < rows; r++)
+    {
+      for (size_t c = 0; c < rows; c++)
+        tile[r * stride + c] = buf[rev[c] * rows + rev[r]];
+    }
+  };
+  for (size_t m = 0; m < ((size_t)1 << midBits); m++)
+  {
+    size_t rm = reverseIndex(m, midBits);
+    if (rm < m)
+      continue; // swapped with rm already
+    T *tileA = a + (m << b), *tileB = a + (rm << b);
+    load(bufA, tileA);
+    if (rm == m)
+    {
+      store(tileA, bufA);
+      continue;
+    }
+    load(bufB, tileB);
+    store(tileB, bufA);
+    store(tileA, bufB);
+  }
+}
+
+#endif
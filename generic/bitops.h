@@ -0,0 +1,377 @@
+#ifndef __BITOPS_H
+#define __BITOPS_H
+
+// Bit operations of binary_hacks.cpp as templates for every unsigned width (uint8_t to uint64_t).
+//
+// bitops::fn(x) uses compiler builtins: constexpr when x is a constant (static_assert(bitops::log2Floor(64u)
+// == 6)), and a single instruction at run time when the target has one:
+//   countLeadingZeros   lzcnt (x86 with -mlzcnt, in -march=haswell and later), else bsr; clz on ARM
+//   countTrailingZeros  tzcnt (-mbmi), else bsf; rbit + clz on ARM
+//   popcount, parity    popcnt (-mpopcnt), else a libgcc call; cnt on ARM
+//   byteSwap            bswap / rev
+//   reverseBits         rbit on ARM; bswap + 3 mask and shift steps on x86, which has no bit reverse
+//   reverseBitsByTable  one load from a 256 byte table per byte: fewer instructions than the mask steps
+//                       for uint8_t/uint16_t, more for wider types (bit_reverse.h has the array versions)
+//   grayToBinary        log2(width) shift and xor steps instead of one per bit
+//   rotateLeft/Right    rol / ror
+// So build with -march=native (or the flags above) to get them, the code doesn't change.
+// Results for 0 are defined: countLeadingZeros(0) = countTrailingZeros(0) = width, log2Floor(0) =
+// log10Floor(0) = 0 like log2ByShift/log10ByCompare of binary_hacks.h, roundUpPowerOfTwo(0) = 1.
+//
+// bitops::portable::fn(x) are the loop and SWAR versions of binary_hacks.cpp for the same widths,
+// the reference the fast versions are checked against (bitops_demo.cpp).
+
+#include <stdint.h>
+#include <type_traits>
+
+namespace bitops
+{
+
+template <typename T>
+concept Unsigned = std::is_unsigned<T>::value && !std::is_same<T, bool>::value && sizeof(T) <= 8;
+
+template <Unsigned T>
+constexpr int numBits = sizeof(T) * 8;
+
+template <Unsigned T>
+constexpr int popcount(T x)
+{
+  return sizeof(T) <= 4 ? __builtin_popcount(x) : __builtin_popcountll(x);
+}
+
+template <Unsigned T>
+constexpr bool parity(T x)
+{
+  return sizeof(T) <= 4 ? __builtin_parity(x) : __builtin_parityll(x);
+}
+
+template <Unsigned T>
+constexpr int countLeadingZeros(T x)
+{
+  if (x == 0)
+    return numBits<T>;
+  return sizeof(T) <= 4 ? __builtin_clz(x) - (32 - numBits<T>) : __builtin_clzll(x);
+}
+
+template <Unsigned T>
+constexpr int countTrailingZeros(T x)
+{
+  if (x == 0)
+    return numBits<T>;
+  return sizeof(T) <= 4 ? __builtin_ctz(x) : __builtin_ctzll(x);
+}
+
+// position of most significant set bit
+template <Unsigned T>
+constexpr int log2Floor(T x)
+{
+  return x ? numBits<T> - 1 - countLeadingZeros(x) : 0;
+}
+
+template <Unsigned T>
+constexpr int log2Ceil(T x)
+{
+  return x > 1 ? numBits<T> - countLeadingZeros((T)(x - 1)) : 0;
+}
+
+inline constexpr uint64_t powersOf10[] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+                                          10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+                                          100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+                                          100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+                                          100000000000000000ULL, 1000000000000000000ULL,
+                                          10000000000000000000ULL};
+
+// log10 from log2: log10(x) ~ (log2(x) + 1) * log10(2), 1233 / 4096 ~ 0.30103. That is either right or one
+// too many, one compare with the power of 10 tells which. The table is at namespace scope: a constexpr
+// array local to the function would be rebuilt on the stack at every call
+template <Unsigned T>
+constexpr int log10Floor(T x)
+{
+  int t = ((log2Floor(x) + 1) * 1233) >> 12;
+  return x ? t - (x < powersOf10[t]) : 0;
+}
+
+template <Unsigned T>
+constexpr bool isPowerOfTwo(T x)
+{
+  return x && !(x & (T)(x - 1));
+}
+
+// 0 when the result doesn't fit in T
+template <Unsigned T>
+constexpr T roundUpPowerOfTwo(T x)
+{
+  if (x <= 1)
+    return 1;
+  int shift = numBits<T> - countLeadingZeros((T)(x - 1));
+  return shift < numBits<T> ? (T)((T)1 << shift) : 0;
+}
+
+template <Unsigned T>
+constexpr T roundDownPowerOfTwo(T x)
+{
+  return x ? (T)((T)1 << log2Floor(x)) : 0;
+}
+
+// alignment must be a power of 2
+template <Unsigned T>
+constexpr T alignUp(T x, T alignment)
+{
+  return (T)((x + alignment - 1) & (T)~(T)(alignment - 1));
+}
+
+template <Unsigned T>
+constexpr T lowestSetBit(T x)
+{
+  return (T)(x & (T)(0 - x)); // blsi
+}
+
+template <Unsigned T>
+constexpr T clearLowestSetBit(T x)
+{
+  return (T)(x & (T)(x - 1)); // blsr
+}
+
+template <Unsigned T>
+constexpr bool isKthBitSet(T x, int k)
+{
+  return (x >> k) & 1;
+}
+
+template <Unsigned T>
+constexpr T setKthBit(T x, int k)
+{
+  return (T)(x | (T)((T)1 << k));
+}
+
+template <Unsigned T>
+constexpr T unsetKthBit(T x, int k)
+{
+  return (T)(x & (T)~(T)((T)1 << k));
+}
+
+template <Unsigned T>
+constexpr T toggleKthBit(T x, int k)
+{
+  return (T)(x ^ (T)((T)1 << k));
+}
+
+// k taken modulo width, both shifts stay below width: GCC turns this into rol/ror
+template <Unsigned T>
+constexpr T rotateLeft(T x, int k)
+{
+  const int mask = numBits<T> - 1;
+  return (T)((T)(x << (k & mask)) | (T)(x >> (-k & mask)));
+}
+
+template <Unsigned T>
+constexpr T rotateRight(T x, int k)
+{
+  const int mask = numBits<T> - 1;
+  return (T)((T)(x >> (k & mask)) | (T)(x << (-k & mask)));
+}
+
+template <Unsigned T>
+constexpr T byteSwap(T x)
+{
+  if constexpr (sizeof(T) == 1)
+    return x;
+  else if constexpr (sizeof(T) == 2)
+    return __builtin_bswap16(x);
+  else if constexpr (sizeof(T) == 4)
+    return __builtin_bswap32(x);
+  else
+    return __builtin_bswap64(x);
+}
+
+template <Unsigned T>
+constexpr T reverseBits(T x)
+{
+#if defined(__aarch64__)
+  if (!std::is_constant_evaluated())
+  {
+    uint64_t r;
+    asm("rbit %x0, %x1" : "=r"(r) : "r"((uint64_t)x));
+    return (T)(r >> (64 - numBits<T>));
+  }
+#endif
+  // bytes reversed, then nibbles, bit pairs and bits inside each byte. Masks cut to width of T
+  x = byteSwap(x);
+  x = (T)(((x >> 4) & (T)0x0f0f0f0f0f0f0f0fULL) | ((x & (T)0x0f0f0f0f0f0f0f0fULL) << 4));
+  x = (T)(((x >> 2) & (T)0x3333333333333333ULL) | ((x & (T)0x3333333333333333ULL) << 2));
+  x = (T)(((x >> 1) & (T)0x5555555555555555ULL) | ((x & (T)0x5555555555555555ULL) << 1));
+  return x;
+}
+
+// byte i reversed at i. Built at compile time, at namespace scope like powersOf10
+struct ReversedBytes
+{
+  uint8_t table[256];
+  constexpr ReversedBytes() : table()
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      for (int bit = 0; bit < 8; bit++)
+        table[i] |= (uint8_t)(((i >> bit) & 1) << (7 - bit));
+    }
+  }
+};
+
+inline constexpr ReversedBytes reversedBytes;
+
+// bytes in reverse order, each through the table
+template <Unsigned T>
+constexpr T reverseBitsByTable(T x)
+{
+  T r = 0;
+  for (int i = 0; i < (int)sizeof(T); i++, x = (T)(x >> 8)) // uint8_t is promoted to int, so >> 8 is fine
+    r = (T)((r << 8) | reversedBytes.table[x & 0xff]);
+  return r;
+}
+
+template <Unsigned T>
+constexpr T binaryToGray(T x)
+{
+  return (T)(x ^ (x >> 1));
+}
+
+// bit i of the result is the xor of bits i and above: folded in by shifts 1, 2, 4, ... like a prefix sum
+template <Unsigned T>
+constexpr T grayToBinary(T x)
+{
+  for (int shift = 1; shift < numBits<T>; shift *= 2)
+    x ^= (T)(x >> shift);
+  return x;
+}
+
+// ---------------- portable reference versions ----------------
+
+namespace portable
+{
+
+template <Unsigned T>
+constexpr int popcount(T x)
+{
+  int cnt = 0;
+  for (; x; cnt++)
+    x &= (T)(x - 1); // clears rightmost set bit
+  return cnt;
+}
+
+template <Unsigned T>
+constexpr bool parity(T x)
+{
+  bool p = false;
+  for (; x; x &= (T)(x - 1))
+    p = !p;
+  return p;
+}
+
+template <Unsigned T>
+constexpr int countLeadingZeros(T x)
+{
+  int cnt = 0;
+  for (T bit = (T)((T)1 << (numBits<T> - 1)); bit && !(x & bit); bit >>= 1)
+    cnt++;
+  return cnt;
+}
+
+template <Unsigned T>
+constexpr int countTrailingZeros(T x)
+{
+  if (!x)
+    return numBits<T>;
+  int cnt = 0;
+  for (x = (T)((x ^ (x - 1)) >> 1); x; cnt++) // trailing 0s to 1s, rest zero
+    x >>= 1;
+  return cnt;
+}
+
+template <Unsigned T>
+constexpr int log2Floor(T x)
+{
+  int cnt = 0;
+  while (x >>= 1)
+    cnt++;
+  return cnt;
+}
+
+template <Unsigned T>
+constexpr int log2Ceil(T x)
+{
+  int floor = log2Floor(x);
+  return floor + (x > ((T)1 << floor));
+}
+
+template <Unsigned T>
+constexpr int log10Floor(T x)
+{
+  int cnt = 0;
+  while (x >= 10)
+  {
+    x /= 10;
+    cnt++;
+  }
+  return cnt;
+}
+
+// SWAR: fold upper bits into lower bits, all 1s below most significant bit, + 1
+template <Unsigned T>
+constexpr T roundUpPowerOfTwo(T x)
+{
+  x += (x == 0);
+  x--;
+  for (int shift = 1; shift < numBits<T>; shift *= 2)
+    x |= (T)(x >> shift);
+  return (T)(x + 1);
+}
+
+template <Unsigned T>
+constexpr T roundDownPowerOfTwo(T x)
+{
+  for (int shift = 1; shift < numBits<T>; shift *= 2)
+    x |= (T)(x >> shift);
+  return (T)(x - (x >> 1));
+}
+
+template <Unsigned T>
+constexpr T byteSwap(T x)
+{
+  T r = 0;
+  for (int i = 0; i < (int)sizeof(T); i++, x >>= 8)
+    r = (T)((r << 8) | (x & 0xff));
+  return r;
+}
+
+template <Unsigned T>
+constexpr T reverseBits(T x)
+{
+  T r = 0;
+  for (int i = 0; i < numBits<T>; i++, x >>= 1)
+    r = (T)((r << 1) | (x & 1));
+  return r;
+}
+
+// one step per bit below the highest set one, grayToBinary of binary_hacks.h
+template <Unsigned T>
+constexpr T grayToBinary(T x)
+{
+  T binary = x;
+  while (x >>= 1)
+    binary ^= x;
+  return binary;
+}
+
+template <Unsigned T>
+constexpr T rotateLeft(T x, int k)
+{
+  for (k &= numBits<T> - 1; k; k--)
+    x = (T)((x << 1) | (x >> (numBits<T> - 1)));
+  return x;
+}
+
+} // namespace portable
+
+} // namespace bitops
+
+#endif
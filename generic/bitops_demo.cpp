@@ -0,0 +1,132 @@
+// Checks of bitops.h: every fast (builtin) version against its portable loop version.
+// uint8_t and uint16_t: every value (and every k for k-bit operations). uint32_t and uint64_t: every value
+// with up to 2 bits set, their neighbours and complements, plus CHECK_RANDOM random values. All 2^32 values
+// of the uint32_t versions are checked by binary_hacks_check.cpp (too slow for a demo); uint64_t stays
+// sampled, 2^64 can't be enumerated.
+// The static_asserts show the same functions evaluated at compile time.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "bitops.h"
+
+#define CHECK_RANDOM (1 << 20)
+
+static_assert(bitops::log2Floor(64u) == 6 && bitops::log2Ceil(65u) == 7);
+static_assert(bitops::log10Floor((uint64_t)18446744073709551615ULL) == 19);
+static_assert(bitops::countLeadingZeros((uint8_t)1) == 7 && bitops::countTrailingZeros((uint16_t)0) == 16);
+static_assert(bitops::reverseBits((uint8_t)0x01) == 0x80 && bitops::byteSwap(0x11223344u) == 0x44332211u);
+static_assert(bitops::reverseBitsByTable(0x00000001u) == 0x80000000u && bitops::grayToBinary((uint8_t)0x80) == 0xff);
+static_assert(bitops::roundUpPowerOfTwo((uint8_t)129) == 0 && bitops::roundUpPowerOfTwo(1000u) == 1024u);
+
+static uint64_t rnd = 88172645463325252ULL;
+
+static uint64_t nextRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+static uint64_t failures = 0;
+
+#define EXPECT(T, x, cond)                                                                                        \
+  if (!(cond))                                                                                                    \
+  {                                                                                                               \
+    if (failures++ < 10)                                                                                          \
+      printf("uint%d_t %llu: %s FAILED\n", bitops::numBits<T>, (unsigned long long)(x), #cond);                  \
+  }
+
+template <typename T>
+static void checkValue(T x)
+{
+  namespace p = bitops::portable;
+  const int W = bitops::numBits<T>;
+  EXPECT(T, x, bitops::popcount(x) == p::popcount(x));
+  EXPECT(T, x, bitops::parity(x) == p::parity(x));
+  EXPECT(T, x, bitops::countLeadingZeros(x) == p::countLeadingZeros(x));
+  EXPECT(T, x, bitops::countTrailingZeros(x) == p::countTrailingZeros(x));
+  EXPECT(T, x, bitops::log2Floor(x) == p::log2Floor(x));
+  EXPECT(T, x, bitops::log2Ceil(x) == p::log2Ceil(x));
+  EXPECT(T, x, bitops::log10Floor(x) == p::log10Floor(x));
+  EXPECT(T, x, bitops::isPowerOfTwo(x) == (p::popcount(x) == 1));
+  EXPECT(T, x, bitops::roundUpPowerOfTwo(x) == p::roundUpPowerOfTwo(x));
+  EXPECT(T, x, bitops::roundDownPowerOfTwo(x) == p::roundDownPowerOfTwo(x));
+  EXPECT(T, x, bitops::byteSwap(x) == p::byteSwap(x));
+  EXPECT(T, x, bitops::reverseBits(x) == p::reverseBits(x));
+  EXPECT(T, x, bitops::reverseBitsByTable(x) == p::reverseBits(x));
+  EXPECT(T, x, bitops::grayToBinary(x) == p::grayToBinary(x));
+  EXPECT(T, x, bitops::grayToBinary(bitops::binaryToGray(x)) == x);
+  EXPECT(T, x, bitops::lowestSetBit(x) == (x ? (T)((T)1 << p::countTrailingZeros(x)) : 0));
+  EXPECT(T, x, bitops::clearLowestSetBit(x) == (T)(x - bitops::lowestSetBit(x)));
+  for (int k = 0; k < W; k++)
+  {
+    T bit = (T)((T)1 << k);
+    EXPECT(T, x, bitops::isKthBitSet(x, k) == ((x & bit) != 0));
+    EXPECT(T, x, bitops::setKthBit(x, k) == (T)(x | bit));
+    EXPECT(T, x, bitops::unsetKthBit(x, k) == (T)(x - (x & bit)));
+    EXPECT(T, x, bitops::toggleKthBit(x, k) == (T)(x & bit ? x - bit : x + bit));
+    EXPECT(T, x, bitops::rotateLeft(x, k) == p::rotateLeft(x, k));
+    EXPECT(T, x, bitops::rotateRight(x, k) == p::rotateLeft(x, W - k));
+  }
+  T alignment = (T)((T)1 << (x % W));
+  EXPECT(T, x, bitops::alignUp((T)(x / 2), alignment) == (T)((x / 2 + alignment - 1) / alignment * alignment));
+}
+
+template <typename T>
+static void checkExhaustive()
+{
+  uint64_t last = (T)~(T)0;
+  for (uint64_t x = 0; x <= last; x++)
+    checkValue((T)x);
+}
+
+template <typename T>
+static void checkSampled()
+{
+  const int W = bitops::numBits<T>;
+  for (int i = 0; i < W; i++)
+  {
+    for (int j = i; j < W; j++)
+    {
+      T x = (T)(((T)1 << i) | ((T)1 << j));
+      T samples[] = {x, (T)(x - 1), (T)(x + 1), (T)~x, (T)((T)1 << i), (T)(((T)1 << i) - 1)};
+      for (T s : samples)
+        checkValue(s);
+    }
+  }
+  checkValue((T)0);
+  checkValue((T)~(T)0);
+  for (int i = 0; i < CHECK_RANDOM; i++)
+  {
+    T x = (T)nextRandom();
+    checkValue(x);
+    checkValue((T)(x >> (nextRandom() % W))); // small values too, for logs
+  }
+}
+
+int main_bitops_demo()
+{
+  checkExhaustive<uint8_t>();
+  checkExhaustive<uint16_t>();
+  checkSampled<uint32_t>();
+  checkSampled<uint64_t>();
+  if (failures)
+  {
+    printf("bitops: %llu checks FAILED\n", (unsigned long long)failures);
+    return 1;
+  }
+  printf("bitops: all 8 and 16 bit values, sampled 32 and 64 bit values match portable versions\n");
+
+  uint64_t x = 0x00f0000000000400ULL;
+  printf("x = 0x%016llx: clz %d ctz %d popcount %d log2 %d..%d log10 %d\n", (unsigned long long)x,
+         bitops::countLeadingZeros(x), bitops::countTrailingZeros(x), bitops::popcount(x), bitops::log2Floor(x),
+         bitops::log2Ceil(x), bitops::log10Floor(x));
+  printf("reverseBits 0x%016llx byteSwap 0x%016llx roundUpPowerOfTwo 0x%016llx\n",
+         (unsigned long long)bitops::reverseBits(x), (unsigned long long)bitops::byteSwap(x),
+         (unsigned long long)bitops::roundUpPowerOfTwo(x));
+  uint8_t b = 0x96;
+  printf("b = 0x%02x: reverseBits 0x%02x rotateLeft(b, 3) 0x%02x unsetKthBit(b, 7) 0x%02x\n", b,
+         bitops::reverseBits(b), bitops::rotateLeft(b, 3), bitops::unsetKthBit(b, 7));
+  return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef __BITPACK_H
+#define __BITPACK_H
+
+// Bit packing of 32 bit integers that need fewer bits (page numbers, PIDs, counters in traces: mostly 10-20
+// bits), to shrink them in memory and on disk.
+//
+// Horizontal (bitpack_pack/unpack): n values of `bits` bits (1 to 32) one after the other, value i in bits
+// [i * bits, (i + 1) * bits) of the stream, bit 0 of a byte first. The layout of most file formats; any n, and
+// value i can be read without the others (bitpack_get). Unpacking is scalar: one unaligned 64 bit load, shift
+// and mask per value, 8 values per bits bytes so the shifts are constants (bitpack.cpp).
+//
+// Vertical (bitpack_pack128/unpack128), the layout of SIMD-BP128 (Lemire, Boytsov: Decoding billions of
+// integers per second through vectorization): blocks of 128 values in 4 lanes of 32 bits, value 4 * j + l
+// in lane l. Each lane packs its 32 values into `bits` words, word k of all 4 lanes stored together, so one
+// 16 byte vector holds word k of every lane. A block takes 16 * bits bytes and unpacks with one vector
+// shift, or and and per 4 values: SSE2 on x86-64 (baseline, no dispatch needed), NEON on ARM.
+//
+// Sequences (bitpack_encode/decode): delta + zigzag + vertical packing for sorted (or mostly sorted)
+// values, like timestamps or page numbers of a sorted trace. Deltas are to the value 4 positions before (the
+// first 4 to 0), one per lane, so decoding adds vectors instead of prefix summing inside them; they are small
+// where the values are not. Zigzag maps a negative delta to an odd number, so an unsorted run costs bits
+// instead of breaking the format. Every 16 blocks (2048 values) start with 16 bytes of widths, one per
+// block, each block packed at the width of its largest zigzag delta. The last n % 128 values are packed
+// horizontally after one more width byte. Decoding fuses unpack, zigzag and the add, so the
+// deltas never go through memory.
+// n is not stored: the caller keeps it (like the length of any other buffer).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BITPACK_BLOCK 128
+#define BITPACK_GROUP 16 // blocks per width header
+
+// bytes for n values of bits bits
+static inline size_t bitpack_bytes(size_t n, unsigned bits)
+{
+  return (n * bits + 7) / 8;
+}
+
+// bytes for a block of BITPACK_BLOCK values of bits bits
+static inline size_t bitpack_bytes128(unsigned bits)
+{
+  return 16 * bits;
+}
+
+// largest size bitpack_encode can write for n values
+static inline size_t bitpack_encode_bound(size_t n)
+{
+  size_t blocks = n / BITPACK_BLOCK;
+  return (blocks + BITPACK_GROUP - 1) / BITPACK_GROUP * BITPACK_GROUP + blocks * bitpack_bytes128(32) + 1 +
+         bitpack_bytes(n % BITPACK_BLOCK, 32);
+}
+
+static inline uint32_t zigzagEncode(int32_t x)
+{
+  return ((uint32_t)x << 1) ^ (uint32_t)(x >> 31);
+}
+
+static inline int32_t zigzagDecode(uint32_t x)
+{
+  return (int32_t)((x >> 1) ^ (0 - (x & 1)));
+}
+
+// bitpack.cpp. bits is 0 to 32 (0 writes and reads nothing, unpacks zeros). Values with more than bits bits
+// are cut to their low bits.
+
+// bits needed for the largest of n values, 0 if all are 0
+unsigned bitpack_max_bits(const uint32_t *in, size_t n);
+void bitpack_pack(const uint32_t *in, size_t n, unsigned bits, uint8_t *out);
+void bitpack_unpack(const uint8_t *in, size_t n, unsigned bits, uint32_t *out);
+// value i of a horizontal stream of bits bits, reads at most the bytes holding it
+uint32_t bitpack_get(const uint8_t *in, size_t i, unsigned bits);
+
+// one block of BITPACK_BLOCK values. in/out of the packed side hold 4 * bits words
+void bitpack_pack128(const uint32_t *in, unsigned bits, uint32_t *out);
+void bitpack_unpack128(const uint32_t *in, unsigned bits, uint32_t *out);
+
+// returns bytes written, at most bitpack_encode_bound(n)
+size_t bitpack_encode(const uint32_t *in, size_t n, uint8_t *out);
+// in as written by bitpack_encode, n as given to it. Returns bytes read
+size_t bitpack_decode(const uint8_t *in, size_t n, uint32_t *out);
+
+#endif
@@ -0,0 +1,294 @@
+// Check and benchmark of bitpack.h.
+// Checks: for every width 0 to 32, horizontal and vertical packing against a bit by bit reference packer
+// (so the layouts, not only the round trip, are checked), unpacking and bitpack_get of every value, values
+// wider than the width cut to their low bits, and no byte written past bitpack_bytes. Sequences: sorted ones
+// with small, large and mixed gaps, unsorted ones, ones wrapping around 2^32, lengths 0 to 300 and a few
+// thousand, round trip, the size decode reads equal to the size encode wrote and within the bound.
+// Benchmark: values per ns for NUM_VALUES values (in L1/L2) against memcpy of the unpacked values, and a
+// trace like sequence (sorted page numbers) against its 4 bytes per value.
+//
+// Typical result (1 core VM, g++ -O2), values per ns:
+//   bits   pack128   unpack128   pack   unpack      memcpy of 32 bit values ~9.5
+//   1      ~9.5      ~12.5       ~3.4   ~2.7
+//   8      ~11       ~12.8       ~4.7   ~4.8
+//   12     ~9.2      ~10.5       ~3     ~3.1
+//   20     ~8.7      ~7.1        ~2.8   ~3.1
+//   32     ~4.8      ~7.7        ~3.4   ~3.3
+//   sorted page numbers, gaps up to 1000: encode ~3.2, decode ~3.8, 13.2 bits per value (2.4x smaller)
+// Vertical unpacking runs at about the speed of copying the unpacked values, 7-13 billion values per second,
+// a little slower for the widths that split more values over two words. Horizontal unpacking costs a load,
+// shift and mask per value, ~3x slower: it is for random access and exchange formats. Sequence decoding adds
+// zigzag and the delta add to vertical unpacking.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "bitpack.h"
+#include "bench.h"
+
+#define NUM_VALUES (64 * BITPACK_BLOCK)
+#define ROUNDS 200
+#define CHECK_MAX_LEN 300
+#define GUARD 0xa5
+
+static uint64_t rnd = 88172645463325252ULL;
+
+static uint64_t nextRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+static uint64_t failures = 0;
+
+static uint32_t lowBitsOf(uint32_t x, unsigned bits)
+{
+  return bits == 32 ? x : x & ((1U << bits) - 1);
+}
+
+// bit b of the stream, b counted from bit 0 of byte 0
+static void setStreamBit(uint8_t *stream, size_t b)
+{
+  stream[b / 8] |= (uint8_t)(1 << (b % 8));
+}
+
+// horizontal reference: value i in bits [i * bits, (i + 1) * bits)
+static void refPack(const uint32_t *in, size_t n, unsigned bits, uint8_t *out)
+{
+  memset(out, 0, bitpack_bytes(n, bits));
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned k = 0; k < bits; k++)
+    {
+      if ((in[i] >> k) & 1)
+        setStreamBit(out, i * bits + k);
+    }
+  }
+}
+
+// vertical reference: lane l holds values 4j + l, its bit stream continues in word k of the lane, stored at
+// out[4k + l]
+static void refPack128(const uint32_t *in, unsigned bits, uint32_t *out)
+{
+  memset(out, 0, bitpack_bytes128(bits));
+  for (unsigned l = 0; l < 4; l++)
+  {
+    for (unsigned j = 0; j < 32; j++)
+    {
+      for (unsigned k = 0; k < bits; k++)
+      {
+        if ((in[4 * j + l] >> k) & 1)
+        {
+          unsigned b = j * bits + k;
+          out[4 * (b / 32) + l] |= 1U << (b % 32);
+        }
+      }
+    }
+  }
+}
+
+static void expect(bool ok, const char *what, unsigned bits, size_t n)
+{
+  if (!ok && failures++ < 10)
+    printf("%s, %u bits, %zu values FAILED\n", what, bits, n);
+}
+
+static void checkHorizontal(unsigned bits, size_t n)
+{
+  std::vector<uint32_t> in(n + 1), want(n + 1), got(n + 1);
+  for (size_t i = 0; i < n; i++)
+  {
+    uint32_t r = (uint32_t)nextRandom();
+    in[i] = (i % 5 == 4) ? r : lowBitsOf(r, bits); // every 5th too wide, must be cut
+    want[i] = lowBitsOf(in[i], bits);
+  }
+  size_t bytes = bitpack_bytes(n, bits);
+  std::vector<uint8_t> ref(bytes + 1), packed(bytes + 16, GUARD);
+  refPack(in.data(), n, bits, ref.data());
+  bitpack_pack(in.data(), n, bits, packed.data());
+  expect(memcmp(packed.data(), ref.data(), bytes) == 0, "pack layout", bits, n);
+  bool guardOk = true;
+  for (size_t i = bytes; i < packed.size(); i++)
+    guardOk &= packed[i] == GUARD;
+  expect(guardOk, "pack wrote past bitpack_bytes", bits, n);
+
+  bitpack_unpack(ref.data(), n, bits, got.data());
+  expect(memcmp(got.data(), want.data(), n * 4) == 0, "unpack", bits, n);
+  bool getOk = true;
+  for (size_t i = 0; i < n; i++)
+    getOk &= bitpack_get(ref.data(), i, bits) == want[i];
+  expect(getOk, "get", bits, n);
+}
+
+static void checkVertical(unsigned bits)
+{
+  uint32_t in[BITPACK_BLOCK], want[BITPACK_BLOCK], got[BITPACK_BLOCK];
+  uint32_t ref[4 * 32], packed[4 * 32 + 4];
+  for (size_t i = 0; i < BITPACK_BLOCK; i++)
+  {
+    uint32_t r = (uint32_t)nextRandom();
+    in[i] = (i % 5 == 4) ? r : lowBitsOf(r, bits);
+    want[i] = lowBitsOf(in[i], bits);
+  }
+  memset(packed, GUARD, sizeof(packed));
+  refPack128(in, bits, ref);
+  bitpack_pack128(in, bits, packed);
+  expect(memcmp(packed, ref, bitpack_bytes128(bits)) == 0, "pack128 layout", bits, BITPACK_BLOCK);
+  bool guardOk = true;
+  for (size_t i = bitpack_bytes128(bits); i < sizeof(packed); i++)
+    guardOk &= ((uint8_t *)packed)[i] == GUARD;
+  expect(guardOk, "pack128 wrote past 16 * bits bytes", bits, BITPACK_BLOCK);
+  bitpack_unpack128(ref, bits, got);
+  expect(memcmp(got, want, sizeof(want)) == 0, "unpack128", bits, BITPACK_BLOCK);
+}
+
+// sorted with gaps below maxGap, a decrease every so often if unsorted
+static void fillSequence(uint32_t *v, size_t n, uint32_t start, uint32_t maxGap, bool sorted)
+{
+  uint32_t x = start;
+  for (size_t i = 0; i < n; i++)
+  {
+    uint64_t r = nextRandom();
+    if (!sorted && r % 7 == 0)
+      x -= maxGap ? (uint32_t)(r >> 8) % maxGap : 1;
+    else
+      x += maxGap ? (uint32_t)(r >> 8) % maxGap : 0;
+    if (maxGap == 0 && r % 97 == 0)
+      x += (uint32_t)(r >> 32); // long runs of equal values, then a jump
+    v[i] = x;
+  }
+}
+
+static void expectSequence(bool ok, const char *what, uint32_t maxGap, size_t n)
+{
+  if (!ok && failures++ < 10)
+    printf("%s, gaps up to %u, %zu values FAILED\n", what, maxGap, n);
+}
+
+static void checkSequence(size_t n, uint32_t start, uint32_t maxGap, bool sorted)
+{
+  std::vector<uint32_t> in(n + 1), got(n + 1);
+  fillSequence(in.data(), n, start, maxGap, sorted);
+  size_t bound = bitpack_encode_bound(n);
+  std::vector<uint8_t> packed(bound + 16, GUARD);
+  size_t written = bitpack_encode(in.data(), n, packed.data());
+  expectSequence(written <= bound, "encode bound", maxGap, n);
+  bool guardOk = true;
+  for (size_t i = written; i < packed.size(); i++)
+    guardOk &= packed[i] == GUARD;
+  expectSequence(guardOk, "encode wrote past its size", maxGap, n);
+  size_t read = bitpack_decode(packed.data(), n, got.data());
+  expectSequence(read == written, "decode size", maxGap, n);
+  const char *what = sorted ? "decode sorted" : "decode unsorted";
+  expectSequence(memcmp(got.data(), in.data(), n * 4) == 0, what, maxGap, n);
+}
+
+static bool checkAll()
+{
+  for (unsigned bits = 0; bits <= 32; bits++)
+  {
+    for (size_t n = 0; n <= CHECK_MAX_LEN; n++)
+      checkHorizontal(bits, n);
+    checkHorizontal(bits, 4099);
+    for (int i = 0; i < 20; i++)
+      checkVertical(bits);
+  }
+
+  const uint32_t gaps[] = {0, 1, 2, 100, 1000, 65536, 1U << 24, 0x80000000U, 0xffffffffU};
+  for (uint32_t gap : gaps)
+  {
+    for (size_t n = 0; n <= CHECK_MAX_LEN; n++)
+    {
+      checkSequence(n, 0, gap, true);
+      checkSequence(n, 0xfffff000U, gap, true); // wraps around 2^32
+      checkSequence(n, (uint32_t)nextRandom(), gap, false);
+    }
+    const size_t group = BITPACK_BLOCK * BITPACK_GROUP; // values per width header
+    for (size_t n : {group - 1, group, group + 1, (size_t)50001})
+    {
+      checkSequence(n, (uint32_t)nextRandom(), gap, true);
+      checkSequence(n, (uint32_t)nextRandom(), gap, false);
+    }
+  }
+  // small gaps with a few huge jumps: blocks of very different widths in one group
+  std::vector<uint32_t> in(10000), got(10000);
+  std::vector<uint8_t> packed(bitpack_encode_bound(in.size()));
+  fillSequence(in.data(), in.size(), 0, 16, true);
+  for (size_t i = 0; i < in.size(); i += 997)
+    in[i] ^= 0x80000000U;
+  bitpack_encode(in.data(), in.size(), packed.data());
+  bitpack_decode(packed.data(), in.size(), got.data());
+  expectSequence(got == in, "decode with jumps", 16, in.size());
+
+  if (failures)
+    printf("bitpack: %llu checks FAILED\n", (unsigned long long)failures);
+  return failures == 0;
+}
+
+// best of ROUNDS, values per ns
+template <typename Fn>
+static double valuesPerNs(size_t n, Fn fn)
+{
+  double best = 1e30;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    fn();
+    clobberMemory();
+    double ns = (double)(nowNs() - t0);
+    best = ns < best ? ns : best;
+  }
+  return n / best;
+}
+
+static uint32_t values[NUM_VALUES], unpacked[NUM_VALUES];
+static uint8_t packed[NUM_VALUES * 4 + 64];
+
+static void benchWidth(unsigned bits)
+{
+  for (size_t i = 0; i < NUM_VALUES; i++)
+    values[i] = lowBitsOf((uint32_t)nextRandom(), bits);
+  const size_t blocks = NUM_VALUES / BITPACK_BLOCK;
+  uint32_t *words = (uint32_t *)packed;
+  printf("  %-4u %9.2f", bits, valuesPerNs(NUM_VALUES, [=] {
+           for (size_t b = 0; b < blocks; b++)
+             bitpack_pack128(values + b * BITPACK_BLOCK, bits, words + b * 4 * bits);
+         }));
+  printf(" %11.2f", valuesPerNs(NUM_VALUES, [=] {
+           for (size_t b = 0; b < blocks; b++)
+             bitpack_unpack128(words + b * 4 * bits, bits, unpacked + b * BITPACK_BLOCK);
+         }));
+  printf(" %6.2f", valuesPerNs(NUM_VALUES, [=] { bitpack_pack(values, NUM_VALUES, bits, packed); }));
+  printf(" %8.2f\n", valuesPerNs(NUM_VALUES, [=] { bitpack_unpack(packed, NUM_VALUES, bits, unpacked); }));
+}
+
+int main_bitpack_bench()
+{
+  if (!checkAll())
+    return 1;
+  printf("bitpack: layouts and round trips of every width and of sequences match\n\n");
+
+  printf("values per ns, %d values\n", NUM_VALUES);
+  for (size_t i = 0; i < NUM_VALUES; i++)
+    values[i] = (uint32_t)nextRandom();
+  printf("  memcpy of 32 bit values %.2f\n",
+         valuesPerNs(NUM_VALUES, [] { memcpy(unpacked, values, sizeof(values)); }));
+  printf("  %-4s %9s %11s %6s %8s\n", "bits", "pack128", "unpack128", "pack", "unpack");
+  for (unsigned bits : {1, 4, 8, 12, 16, 20, 24, 32})
+    benchWidth(bits);
+
+  // page numbers of a sorted trace: mostly nearby pages, sometimes far
+  fillSequence(values, NUM_VALUES, 1 << 20, 1000, true);
+  std::vector<uint8_t> encoded(bitpack_encode_bound(NUM_VALUES));
+  size_t bytes = 0;
+  double enc = valuesPerNs(NUM_VALUES, [&] { bytes = bitpack_encode(values, NUM_VALUES, encoded.data()); });
+  double dec = valuesPerNs(NUM_VALUES, [&] { bitpack_decode(encoded.data(), NUM_VALUES, unpacked); });
+  printf("\nsorted page numbers, gaps up to 1000: encode %.2f, decode %.2f values per ns, %.1f bits per value "
+         "(%.1fx smaller)\n",
+         enc, dec, 8.0 * bytes / NUM_VALUES, 4.0 * NUM_VALUES / bytes);
+  return memcmp(unpacked, values, sizeof(values)) != 0;
+}
@@ -0,0 +1,339 @@
+// divide_array of divider.h, with runtime ISA dispatch like array_kernels.cpp (GNU ifunc on x86-64 ELF).
+//
+// Written once on GCC vector extension types of W bytes (simd_vec.h): the Divider members with vectors in
+// place of scalars, the branches on d hoisted out of the loop (one loop per kind and op), the conditions
+// turned into selects. What is left to build by hand is mulhi, the one thing vectors don't have:
+//   32 bit lanes: pmuludq multiplies the even lanes into 64 bit products, a second one the odd lanes
+//     (shifted down), the high halves are blended back together. 2 multiplies per vector
+//   64 bit lanes: 4 pmuludq of 32 bit halves (lo*lo, lo*hi, hi*lo, hi*hi) and the carries of their middle sum
+//   signed: unsigned mulhi minus the corrections for negative operands, n if m < 0 and m if n < 0 (the
+//     n < 0 mask is the arithmetic shift n >> (N - 1), no compare)
+// The remainder multiplies q by d in the low half: pmulld for 32 bits (SSE2 has none, 2 pmuludq), 3 pmuludq
+// for 64 bits. AVX-512 is BW, not DQ: with DQ GCC turns every 64 bit lane multiply into vpmullq (3 uops,
+// 15 cycles latency), the 32x32 bit ones too.
+// The last elements (fewer than one vector) go through the Divider members.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "divider.h"
+#include "simd_vec.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// ---------------- mulhi by a constant, per lane ----------------
+
+// low 32 bits of each 64 bit lane multiplied into 64 bits. GCC multiplies vectors of uint64_t in full even
+// when both factors are masked to 32 bits (6 pmuludq, or a vpmullq), so pmuludq is asked for by name
+#if defined(__x86_64__)
+inline Lanes<uint64_t, 16>::Vec mulEven(const Lanes<uint64_t, 16>::Vec &a, const Lanes<uint64_t, 16>::Vec &b)
+{
+  return (Lanes<uint64_t, 16>::Vec)_mm_mul_epu32((__m128i)a, (__m128i)b);
+}
+
+__attribute__((target("avx2"))) inline Lanes<uint64_t, 32>::Vec mulEven(const Lanes<uint64_t, 32>::Vec &a,
+                                                                        const Lanes<uint64_t, 32>::Vec &b)
+{
+  return (Lanes<uint64_t, 32>::Vec)_mm256_mul_epu32((__m256i)a, (__m256i)b);
+}
+
+__attribute__((target("avx512bw"))) inline Lanes<uint64_t, 64>::Vec mulEven(const Lanes<uint64_t, 64>::Vec &a,
+                                                                            const Lanes<uint64_t, 64>::Vec &b)
+{
+  return (Lanes<uint64_t, 64>::Vec)_mm512_maskz_mul_epu32((__mmask8)-1, (__m512i)a, (__m512i)b);
+}
+#else
+template <typename V>
+ALWAYS_INLINE V mulEven(const V &a, const V &b)
+{
+  return (a & 0xffffffff) * (b & 0xffffffff);
+}
+#endif
+
+template <size_t W>
+ALWAYS_INLINE typename Lanes<uint32_t, W>::Vec mulHi(const typename Lanes<uint32_t, W>::Vec &n, uint32_t m)
+{
+  typedef typename Lanes<uint64_t, W>::Vec V64;
+  V64 x = (V64)n;
+  V64 mm = splat<uint64_t, W>(m);
+  V64 even = mulEven(x, mm);
+  V64 odd = mulEven(x >> 32, mm);
+  return (typename Lanes<uint32_t, W>::Vec)((even >> 32) | (odd & ~splat<uint64_t, W>(0xffffffff)));
+}
+
+template <size_t W>
+ALWAYS_INLINE typename Lanes<uint64_t, W>::Vec mulHi(const typename Lanes<uint64_t, W>::Vec &n, uint64_t m)
+{
+  typedef typename Lanes<uint64_t, W>::Vec V64;
+  const V64 low = splat<uint64_t, W>(0xffffffff);
+  V64 mLow = splat<uint64_t, W>(m), mHigh = mLow >> 32, nHigh = n >> 32;
+  V64 ll = mulEven(n, mLow), lh = mulEven(n, mHigh), hl = mulEven(nHigh, mLow), hh = mulEven(nHigh, mHigh);
+  V64 mid = (ll >> 32) + (lh & low) + (hl & low); // below 3 * 2^32
+  return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+// mulhi of signed a, b from the unsigned one: (a + 2^N [a < 0]) (b + 2^N [b < 0]) has 2^N (a [b < 0] + b [a < 0])
+// too much in its high half (the 2^2N term falls out)
+template <typename T, size_t W>
+ALWAYS_INLINE typename Lanes<T, W>::Vec mulHiSigned(const typename Lanes<T, W>::Vec &n, T m)
+{
+  typedef typename std::make_unsigned<T>::type U;
+  typedef typename Lanes<U, W>::Vec VU;
+  VU hi = mulHi<W>((VU)n, (U)m);
+  hi -= (VU)(n >> (sizeof(T) * 8 - 1)) & splat<U, W>((U)m);
+  if (m < 0)
+    hi -= (VU)n;
+  return (typename Lanes<T, W>::Vec)hi;
+}
+
+// ---------------- Divider on vectors ----------------
+
+template <typename T, size_t W, int kind>
+ALWAYS_INLINE typename Lanes<T, W>::Vec quotient(const typename Lanes<T, W>::Vec &x, const Divider<T> &d)
+{
+  typedef typename std::make_unsigned<T>::type U;
+  typedef typename Lanes<T, W>::Vec V;
+  typedef typename Lanes<U, W>::Vec VU;
+  const int N = sizeof(T) * 8;
+  if constexpr (std::is_signed<T>::value)
+  {
+    const V sign = splat<T, W>(d.d < 0 ? -1 : 0); // (y ^ sign) - sign: -y for negative d
+    if constexpr (kind == DIVIDER_SHIFT)
+    {
+      VU bias = (VU)(x >> (N - 1)) & splat<U, W>(((U)1 << d.shift) - 1);
+      V q = (V)((VU)x + bias) >> d.shift;
+      return (V)(((VU)q ^ (VU)sign) - (VU)sign);
+    }
+    VU t = (VU)mulHiSigned<T, W>(x, d.magic);
+    if constexpr (kind == DIVIDER_MUL_ADD)
+      t += ((VU)x ^ (VU)sign) - (VU)sign;
+    V q = (V)t >> d.shift;
+    return (V)((VU)q + ((VU)q >> (N - 1)));
+  }
+  else
+  {
+    if constexpr (kind == DIVIDER_SHIFT)
+      return x >> d.shift;
+    V t = mulHi<W>(x, d.magic);
+    if constexpr (kind == DIVIDER_MUL)
+      return t >> d.shift;
+    return (((x - t) >> 1) + t) >> d.shift;
+  }
+}
+
+// op of x from its quotient q, the Divider members on lanes
+template <typename T, size_t W, int op>
+ALWAYS_INLINE typename Lanes<T, W>::Vec applyOp(const typename Lanes<T, W>::Vec &x,
+                                                const typename Lanes<T, W>::Vec &q, const Divider<T> &d)
+{
+  typedef typename std::make_unsigned<T>::type U;
+  typedef typename Lanes<T, W>::Vec V;
+  typedef typename Lanes<U, W>::Vec VU;
+  if constexpr (op == DIVIDER_QUOTIENT)
+    return q;
+  const V zero = splat<T, W>(0), one = splat<T, W>(1), vd = splat<T, W>(d.d);
+  V r = (V)((VU)x - (VU)q * (VU)vd);
+  if constexpr (op == DIVIDER_REMAINDER)
+    return r;
+  if constexpr (std::is_signed<T>::value)
+  {
+    const V minusOne = splat<T, W>(-1);
+    V adjust;
+    if constexpr (op == DIVIDER_FLOOR)
+      adjust = (r ^ vd) < zero ? minusOne : zero;
+    else if constexpr (op == DIVIDER_CEIL)
+      adjust = (r ^ vd) < zero ? zero : one;
+    else
+    {
+      VU absR = (VU)(r < zero ? -r : r);
+      VU absD = splat<U, W>(d.d < 0 ? 0 - (U)d.d : (U)d.d);
+      V away = (x ^ vd) < zero ? minusOne : one;
+      return (V)((VU)q + (VU)(absR >= absD - absR ? away : zero));
+    }
+    return (V)((VU)q + (VU)(r != zero ? adjust : zero));
+  }
+  else
+  {
+    if constexpr (op == DIVIDER_FLOOR)
+      return q;
+    if constexpr (op == DIVIDER_CEIL)
+      return q + (r != zero ? one : zero);
+    return q + (r >= vd - r ? one : zero);
+  }
+}
+
+template <typename T, int op>
+ALWAYS_INLINE T applyOpScalar(T x, const Divider<T> &d)
+{
+  if constexpr (op == DIVIDER_QUOTIENT)
+    return d.quotient(x);
+  else if constexpr (op == DIVIDER_FLOOR)
+    return d.floor(x);
+  else if constexpr (op == DIVIDER_CEIL)
+    return d.ceil(x);
+  else if constexpr (op == DIVIDER_ROUND)
+    return d.round(x);
+  else
+    return d.remainder(x);
+}
+
+template <typename T, size_t W, int kind, int op>
+ALWAYS_INLINE void divideLoop(const T *in, const Divider<T> &d, T *out, size_t n)
+{
+  typedef typename Lanes<T, W>::Vec V;
+  size_t i = 0;
+  for (; i + Lanes<T, W>::N <= n; i += Lanes<T, W>::N)
+  {
+    V x;
+    __builtin_memcpy(&x, in + i, W);
+    V y = applyOp<T, W, op>(x, quotient<T, W, kind>(x, d), d);
+    __builtin_memcpy(out + i, &y, W);
+  }
+  for (; i < n; i++)
+    out[i] = applyOpScalar<T, op>(in[i], d);
+}
+
+template <typename T, size_t W, int kind>
+ALWAYS_INLINE void divideByOp(const T *in, const Divider<T> &d, DividerOp op, T *out, size_t n)
+{
+  switch (op)
+  {
+  case DIVIDER_QUOTIENT:
+    return divideLoop<T, W, kind, DIVIDER_QUOTIENT>(in, d, out, n);
+  case DIVIDER_FLOOR:
+    return divideLoop<T, W, kind, DIVIDER_FLOOR>(in, d, out, n);
+  case DIVIDER_CEIL:
+    return divideLoop<T, W, kind, DIVIDER_CEIL>(in, d, out, n);
+  case DIVIDER_ROUND:
+    return divideLoop<T, W, kind, DIVIDER_ROUND>(in, d, out, n);
+  default:
+    return divideLoop<T, W, kind, DIVIDER_REMAINDER>(in, d, out, n);
+  }
+}
+
+template <typename T, size_t W>
+ALWAYS_INLINE void divideArray(const T *in, const Divider<T> &divider, DividerOp op, T *out, size_t n)
+{
+  const Divider<T> d = divider; // a copy: stores to out could alias the members, reloaded on every vector
+  switch (d.kind)
+  {
+  case DIVIDER_SHIFT:
+    return divideByOp<T, W, DIVIDER_SHIFT>(in, d, op, out, n);
+  case DIVIDER_MUL:
+    return divideByOp<T, W, DIVIDER_MUL>(in, d, op, out, n);
+  default:
+    return divideByOp<T, W, DIVIDER_MUL_ADD>(in, d, op, out, n);
+  }
+}
+
+// ---------------- variants ----------------
+
+#define DIVIDER_DEFINE(T)                                                                                         \
+  DIVIDER_TARGET void divide_array(const T *in, const Divider<T> &d, DividerOp op, T *out, size_t n)              \
+  {                                                                                                               \
+    divideArray<T, DIVIDER_W>(in, d, op, out, n);                                                                 \
+  }
+
+#if defined(__x86_64__)
+
+#define DIVIDER_W 16
+#define DIVIDER_TARGET
+namespace divider_sse2
+{
+DIVIDER_TYPES(DIVIDER_DEFINE)
+}
+#undef DIVIDER_TARGET
+#undef DIVIDER_W
+
+#define DIVIDER_W 32
+#define DIVIDER_TARGET __attribute__((target("avx2")))
+namespace divider_avx2
+{
+DIVIDER_TYPES(DIVIDER_DEFINE)
+}
+#undef DIVIDER_TARGET
+#undef DIVIDER_W
+
+#define DIVIDER_W 64
+#define DIVIDER_TARGET __attribute__((target("avx512bw")))
+namespace divider_avx512
+{
+DIVIDER_TYPES(DIVIDER_DEFINE)
+}
+#undef DIVIDER_TARGET
+#undef DIVIDER_W
+
+// ---------------- dispatch ----------------
+
+template <typename T>
+using DivideArrayFn = void (*)(const T *, const Divider<T> &, DividerOp, T *, size_t);
+
+// 0 sse2, 1 avx2, 2 avx512bw. Called from ifunc resolvers, so no global data
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE int dividerIsaLevel()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw"))
+    return 2;
+  if (__builtin_cpu_supports("avx2"))
+    return 1;
+  return 0;
+}
+
+#define DIVIDER_RESOLVER(T)                                                                                       \
+  IFUNC_RESOLVER DivideArrayFn<T> resolve_divide_array_##T()                                                      \
+  {                                                                                                               \
+    switch (dividerIsaLevel())                                                                                    \
+    {                                                                                                             \
+    case 2:                                                                                                       \
+      return static_cast<DivideArrayFn<T>>(divider_avx512::divide_array);                                         \
+    case 1:                                                                                                       \
+      return static_cast<DivideArrayFn<T>>(divider_avx2::divide_array);                                           \
+    default:                                                                                                      \
+      return static_cast<DivideArrayFn<T>>(divider_sse2::divide_array);                                           \
+    }                                                                                                             \
+  }
+
+DIVIDER_TYPES(DIVIDER_RESOLVER)
+
+#undef DIVIDER_RESOLVER
+
+#if defined(__ELF__)
+#define DIVIDER_DISPATCH(T)                                                                                       \
+  void divide_array(const T *in, const Divider<T> &d, DividerOp op, T *out, size_t n)                             \
+      __attribute__((ifunc("resolve_divide_array_" #T)));
+#else
+#define DIVIDER_DISPATCH(T)                                                                                       \
+  void divide_array(const T *in, const Divider<T> &d, DividerOp op, T *out, size_t n)                             \
+  {                                                                                                               \
+    static DivideArrayFn<T> impl = resolve_divide_array_##T();                                                    \
+    impl(in, d, op, out, n);                                                                                      \
+  }
+#endif
+
+DIVIDER_TYPES(DIVIDER_DISPATCH)
+
+#undef DIVIDER_DISPATCH
+
+const char *divider_isa()
+{
+  static const char *const names[] = {"sse2", "avx2", "avx512bw"};
+  return names[dividerIsaLevel()];
+}
+
+#else
+
+// other architectures: 16 byte vectors, NEON on ARM
+#define DIVIDER_W 16
+#define DIVIDER_TARGET
+DIVIDER_TYPES(DIVIDER_DEFINE)
+#undef DIVIDER_TARGET
+#undef DIVIDER_W
+
+const char *divider_isa()
+{
+  return "generic";
+}
+
+#endif
+
+#undef DIVIDER_DEFINE
@@ -0,0 +1,226 @@
+#ifndef __DIVIDER_H
+#define __DIVIDER_H
+
+// Division by a divisor that is known only at run time but used for many dividends (hash table size, stride,
+// sample rate, unit of a counter) without the divide instruction. div costs 20-90 cycles of latency for
+// 64 bit operands (cpu and size of the quotient decide), ~10-26 for 32 bit, and doesn't vectorize at all.
+// The method of Granlund, Montgomery (Division by invariant integers using multiplication) in the form of
+// libdivide: the constructor does one wide division to find a magic number m and a shift s, every
+// division after that is a high multiply, a shift and a couple of adds.
+//
+// Unsigned, N bits, 2^l < d < 2^(l+1): n / d = mulhi(m, n) >> l with m = 2^(N+l) / d rounded up, when
+// rounding up added little enough. Otherwise (d = 7 is one) m = 2^(N+l+1) / d rounded up, which needs N + 1
+// bits: m - 2^N is kept, t = mulhi(m - 2^N, n), and (((n - t) >> 1) + t) >> l adds the missing n back,
+// halved first so it can't wrap.
+// Signed: the same with |d| and one bit less, mulhi signed, the quotient rounded toward 0 by adding its sign
+// bit, m negated for d < 0. Powers of 2 (and 1) are shifts, signed ones add |d| - 1 to negative n first.
+//
+// Exact for every dividend and divisor (d != 0), the same results as / and % (divider_bench.cpp checks
+// thousands of divisors per type, and all 2^32 dividends for a few 32 bit ones). INT_MIN / -1 (undefined
+// for /) wraps to INT_MIN, remainder 0.
+// Rounding, for a quotient q and remainder r of n / d:
+//   quotient: toward 0, n / d      remainder: n % d, sign of n
+//   floor: toward -inf             ceil: toward +inf
+//   round: to nearest, halves away from 0 (up for unsigned, (n + d / 2) / d without its wrap)
+//
+// divide_array: one divisor over an array, vectorized (divider.cpp). x86 has no vector divide for integers
+// at all, so this is where it is far ahead of div: 32 bit lanes multiply with pmuludq (even and odd lanes);
+// 64 bit lanes have no high multiply before AVX-512 IFMA (and that one is 52 bits), so they do it in 4
+// pmuludq of 32 bit halves.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+enum DividerKind : uint8_t
+{
+  DIVIDER_SHIFT,   // d a power of 2 (or -2^k): magic unused
+  DIVIDER_MUL,     // mulhi and shift
+  DIVIDER_MUL_ADD, // mulhi, add of n and shift: magic needed N + 1 bits
+};
+
+// double width unsigned integer, for the magic number and mulhi
+template <typename T>
+struct DividerWide;
+template <>
+struct DividerWide<uint32_t>
+{
+  typedef uint64_t Type;
+};
+template <>
+struct DividerWide<uint64_t>
+{
+  typedef unsigned __int128 Type;
+};
+
+// high half of the full product
+static inline uint32_t dividerMulHi(uint32_t a, uint32_t b)
+{
+  return (uint32_t)(((uint64_t)a * b) >> 32);
+}
+
+static inline int32_t dividerMulHi(int32_t a, int32_t b)
+{
+  return (int32_t)(((int64_t)a * b) >> 32);
+}
+
+static inline uint64_t dividerMulHi(uint64_t a, uint64_t b)
+{
+  return (uint64_t)(((unsigned __int128)a * b) >> 64);
+}
+
+static inline int64_t dividerMulHi(int64_t a, int64_t b)
+{
+  return (int64_t)(((__int128)a * b) >> 64);
+}
+
+// T: uint32_t, uint64_t, int32_t or int64_t
+template <typename T>
+struct Divider
+{
+  typedef typename std::make_unsigned<T>::type U;
+  static const int N = sizeof(T) * 8;
+  static const bool isSigned = std::is_signed<T>::value;
+
+  T d;
+  T magic;
+  uint8_t shift;
+  uint8_t kind; // DividerKind
+
+  Divider() : Divider(1) {}
+  // d != 0
+  explicit Divider(T divisor) : d(divisor), magic(0), shift(0), kind(DIVIDER_SHIFT)
+  {
+    U absD = isSigned && d < 0 ? 0 - (U)d : (U)d;
+    int l = N - 1 - (N == 32 ? __builtin_clz((uint32_t)absD) : __builtin_clzll((uint64_t)absD));
+    if ((absD & (absD - 1)) == 0)
+    {
+      shift = (uint8_t)l;
+      return;
+    }
+    // 2^l < |d| < 2^(l+1), so m = 2^p / |d| fits N bits, and N + 1 when doubled
+    typedef typename DividerWide<U>::Type W;
+    W p = (W)1 << (isSigned ? N - 1 + l : N + l);
+    U m = (U)(p / absD), rem = (U)(p % absD);
+    if (absD - rem < (U)1 << l) // rounding m up adds less than 2^l / |d|: small enough for every N bit n
+    {
+      kind = DIVIDER_MUL;
+      shift = (uint8_t)(isSigned ? l - 1 : l);
+    }
+    else // one more bit: 2^(p+1) / |d| rounded up, mod 2^N
+    {
+      U twiceRem = rem + rem;
+      m += m;
+      if (twiceRem >= absD || twiceRem < rem)
+        m++;
+      kind = DIVIDER_MUL_ADD;
+      shift = (uint8_t)l;
+    }
+    m++;
+    magic = isSigned && d < 0 ? (T)(0 - m) : (T)m;
+  }
+
+  T divisor() const { return d; }
+
+  T quotient(T n) const
+  {
+    if constexpr (isSigned)
+    {
+      if (kind == DIVIDER_SHIFT)
+      {
+        U bias = (U)(n >> (N - 1)) & (((U)1 << shift) - 1); // d - 1 for negative n: rounds toward 0
+        T q = (T)((U)n + bias) >> shift;
+        return d < 0 ? (T)(0 - (U)q) : q;
+      }
+      U t = (U)dividerMulHi(magic, n);
+      if (kind == DIVIDER_MUL_ADD)
+        t += d < 0 ? 0 - (U)n : (U)n;
+      T q = (T)t >> shift;
+      return (T)((U)q + ((U)q >> (N - 1))); // + 1 for negative: toward 0
+    }
+    else
+    {
+      if (kind == DIVIDER_SHIFT)
+        return n >> shift;
+      T t = dividerMulHi(magic, n);
+      if (kind == DIVIDER_MUL)
+        return t >> shift;
+      return (((n - t) >> 1) + t) >> shift;
+    }
+  }
+
+  T remainder(T n) const { return (T)((U)n - (U)quotient(n) * (U)d); }
+
+  T floor(T n) const
+  {
+    T q = quotient(n);
+    if constexpr (isSigned)
+    {
+      T r = (T)((U)n - (U)q * (U)d);
+      return q - (r != 0 && (r ^ d) < 0); // r has the sign of n: signs differ, q was rounded up
+    }
+    return q;
+  }
+
+  T ceil(T n) const
+  {
+    T q = quotient(n);
+    T r = (T)((U)n - (U)q * (U)d);
+    if constexpr (isSigned)
+      return q + (r != 0 && (r ^ d) >= 0);
+    return q + (r != 0);
+  }
+
+  T round(T n) const
+  {
+    T q = quotient(n);
+    T r = (T)((U)n - (U)q * (U)d);
+    if constexpr (isSigned)
+    {
+      U absR = r < 0 ? 0 - (U)r : (U)r, absD = d < 0 ? 0 - (U)d : (U)d;
+      if (absR >= absD - absR)
+        return (n ^ d) < 0 ? q - 1 : q + 1;
+      return q;
+    }
+    return q + (r >= d - r);
+  }
+};
+
+enum DividerOp
+{
+  DIVIDER_QUOTIENT,
+  DIVIDER_FLOOR,
+  DIVIDER_CEIL,
+  DIVIDER_ROUND,
+  DIVIDER_REMAINDER,
+};
+
+// X(T) for every divider type
+#define DIVIDER_TYPES(X) X(uint32_t) X(uint64_t) X(int32_t) X(int64_t)
+
+// out[i] = op of in[i] by d, the same as the Divider member of that name. out may be in, but not partly
+// overlap it. Widest available ISA is picked once at load time, like array_kernels.h
+#define DIVIDER_DECLARE(T) void divide_array(const T *in, const Divider<T> &d, DividerOp op, T *out, size_t n);
+
+DIVIDER_TYPES(DIVIDER_DECLARE)
+const char *divider_isa();
+
+#if defined(__x86_64__)
+// individual variants, for benchmarking. Caller must check cpu support (__builtin_cpu_supports)
+namespace divider_sse2
+{
+DIVIDER_TYPES(DIVIDER_DECLARE)
+}
+namespace divider_avx2
+{
+DIVIDER_TYPES(DIVIDER_DECLARE)
+}
+namespace divider_avx512 // avx512bw
+{
+DIVIDER_TYPES(DIVIDER_DECLARE)
+}
+#endif
+
+#undef DIVIDER_DECLARE
+
+#endif
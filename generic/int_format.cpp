@@ -0,0 +1,141 @@
+// Array formatting of int_format.h.
+//
+// formatU32 and friends loop once per two digits, so on values of mixed length the loop exit and the 1 or 2
+// digit tail are mispredicted. The array versions have no branch on the digit count: every value is converted
+// to its full width (10 digits for 32 bit, 20 for 64 bit) with leading zeros, by SWAR on 8 digit pieces,
+// shifted right by the leading zeros and written with fixed size stores. The next value overwrites what the
+// stores wrote past the last digit. 64 bit values that fit 32 bits take the 32 bit path: a mispredicted
+// branch now and then costs less than the 20 digit conversion for every value.
+//
+// 8 digits in one 64 bit word (v < 10^8), first digit in the lowest byte so a store puts it first in memory:
+//   v / 10^4 and v % 10^4 in the two 32 bit halves
+//   each half / 100 (x * 10486 >> 20, exact below 10^4) and % 100 into 16 bit lanes
+//   each 16 bit lane / 10 (x * 103 >> 10, exact below 100) and % 10 into bytes, + '0' to every byte
+// Lanes never carry into each other: the products stay below 2^28 and 2^14.
+
+#include <stdint.h>
+#include <string.h>
+#include "int_format.h"
+
+static inline uint64_t eightDigits(uint32_t v)
+{
+  uint64_t x = (v / 10000) | ((uint64_t)(v % 10000) << 32);
+  uint64_t q = ((x * 10486) >> 20) & 0x0000007F0000007FULL;
+  x = q | ((x - q * 100) << 16);
+  q = ((x * 103) >> 10) & 0x000F000F000F000FULL;
+  x = q | ((x - q * 10) << 8);
+  return x + 0x3030303030303030ULL;
+}
+
+static inline uint16_t digitPair(uint32_t v)
+{
+  uint16_t d;
+  memcpy(&d, digitPairs + v * 2, 2);
+  return d;
+}
+
+// The full width digits are kept in registers and shifted right by the leading zeros before the store, a
+// store of them to a buffer and an unaligned reload at the first digit would miss store forwarding (the load
+// spans several stores) and stall.
+
+// 10 digits of x, leading zeros shifted out, at out. Writes 16 bytes
+static inline void storeU32(uint32_t x, int len, char *out)
+{
+  unsigned __int128 digits = digitPair(x / 100000000);
+  digits |= (unsigned __int128)eightDigits(x % 100000000) << 16;
+  digits >>= 8 * (INT_FORMAT_MAX_U32 - len);
+  memcpy(out, &digits, 16);
+}
+
+// 20 digits of x, leading zeros shifted out, at out. Writes up to 24 bytes: digits 1-12 and 13-20 as two
+// stores, the second overwriting the zeros the first shifted in
+static inline void storeU64(uint64_t x, int len, char *out)
+{
+  uint64_t top = x / 100000000; // < 1.9 * 10^11
+  uint32_t hi = (uint32_t)(top / 100000000); // < 1845
+  uint64_t lo = eightDigits((uint32_t)(x % 100000000));
+  unsigned __int128 first = digitPair(hi / 100);
+  first |= (unsigned __int128)digitPair(hi % 100) << 16;
+  first |= (unsigned __int128)eightDigits((uint32_t)(top % 100000000)) << 32;
+  int skip = INT_FORMAT_MAX_U64 - len;
+  int skipFirst = skip < 12 ? skip : 12; // all of the first 12 digits are zeros for values below 10^8
+  first >>= 8 * skipFirst;               // 96 bits of digits, shifting all of them out leaves 0
+  lo >>= 8 * (skip - skipFirst);
+  memcpy(out, &first, 16);
+  memcpy(out + 12 - skipFirst, &lo, 8);
+}
+
+// Stores of 16 (32 bit) or 24 bytes (64 bit) from the value at out: safe while at least two more values
+// follow, whose INT_FORMAT_MAX + 1 bytes of room in out are overwritten next. The last two use the scalar
+// formatter.
+
+size_t format_u32_array(const uint32_t *values, size_t n, char sep, char *out)
+{
+  char *p = out;
+  size_t i = 0;
+  for (; i + 2 < n; i++)
+  {
+    int len = countDigits32(values[i]);
+    storeU32(values[i], len, p);
+    p += len;
+    *p++ = sep;
+  }
+  for (; i < n; i++)
+  {
+    p = formatU32(values[i], p);
+    if (i + 1 < n)
+      *p++ = sep;
+  }
+  return p - out;
+}
+
+size_t format_u64_array(const uint64_t *values, size_t n, char sep, char *out)
+{
+  char *p = out;
+  size_t i = 0;
+  for (; i + 2 < n; i++)
+  {
+    int len = countDigits64(values[i]);
+    if (values[i] <= UINT32_MAX)
+      storeU32((uint32_t)values[i], len, p);
+    else
+      storeU64(values[i], len, p);
+    p += len;
+    *p++ = sep;
+  }
+  for (; i < n; i++)
+  {
+    p = formatU64(values[i], p);
+    if (i + 1 < n)
+      *p++ = sep;
+  }
+  return p - out;
+}
+
+size_t format_i64_array(const int64_t *values, size_t n, char sep, char *out)
+{
+  char *p = out;
+  size_t i = 0;
+  for (; i + 2 < n; i++)
+  {
+    // the '-' is always written and kept only for negative values
+    uint64_t negative = values[i] < 0;
+    uint64_t magnitude = negative ? 0 - (uint64_t)values[i] : (uint64_t)values[i];
+    *p = '-';
+    p += negative;
+    int len = countDigits64(magnitude);
+    if (magnitude <= UINT32_MAX)
+      storeU32((uint32_t)magnitude, len, p);
+    else
+      storeU64(magnitude, len, p);
+    p += len;
+    *p++ = sep;
+  }
+  for (; i < n; i++)
+  {
+    p = formatI64(values[i], p);
+    if (i + 1 < n)
+      *p++ = sep;
+  }
+  return p - out;
+}
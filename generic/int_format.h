@@ -0,0 +1,102 @@
+#ifndef __INT_FORMAT_H
+#define __INT_FORMAT_H
+
+// Decimal digit counting and integer to text, for output heavy code (logs, CSV, the demos' printf("%d")).
+//
+// countDigits: bitops::log10Floor + 1, the clz * 1233 >> 12 estimate of log10 and one compare with a power of
+//   10 to correct it. No loop and no compare chain (log10ByCompare of binary_hacks.h).
+// formatU32/U64/I64: digits written to out, no terminating NUL, returns the end (like std::to_chars). The
+//   digit count is known up front, so digits are written from the end backwards two at a time from a 200 byte
+//   table "00".."99": one division by 100 (a multiply and shift) per two digits instead of one per digit.
+//   snprintf parses the format string, handles locale and flags and copies through a FILE like buffer; this is
+//   several times faster (int_format_bench.cpp).
+// Arrays (int_format.cpp): values separated by sep, no terminating NUL, returns bytes written. out must hold
+//   n * (INT_FORMAT_MAX_... + 1) bytes.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "bitops.h"
+
+#define INT_FORMAT_MAX_U32 10
+#define INT_FORMAT_MAX_U64 20
+#define INT_FORMAT_MAX_I64 20 // "-9223372036854775808"
+
+static inline int countDigits32(uint32_t x)
+{
+  return bitops::log10Floor(x) + 1;
+}
+
+static inline int countDigits64(uint64_t x)
+{
+  return bitops::log10Floor(x) + 1;
+}
+
+static const char digitPairs[201] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+
+// digits of x, ending just before end
+static inline void formatDigits32Backwards(uint32_t x, char *end)
+{
+  while (x >= 100)
+  {
+    end -= 2;
+    memcpy(end, digitPairs + (x % 100) * 2, 2);
+    x /= 100;
+  }
+  if (x >= 10)
+    memcpy(end - 2, digitPairs + x * 2, 2);
+  else
+    end[-1] = (char)('0' + x);
+}
+
+static inline char *formatU32(uint32_t x, char *out)
+{
+  char *end = out + countDigits32(x);
+  formatDigits32Backwards(x, end);
+  return end;
+}
+
+static inline char *formatU64(uint64_t x, char *out)
+{
+  if (x <= UINT32_MAX)
+    return formatU32((uint32_t)x, out);
+  char *end = out + countDigits64(x);
+  char *p = end;
+  // 64 bit divisions only until the rest fits 32 bits: at most 5 rounds
+  while (x > UINT32_MAX)
+  {
+    p -= 2;
+    memcpy(p, digitPairs + (x % 100) * 2, 2);
+    x /= 100;
+  }
+  formatDigits32Backwards((uint32_t)x, p);
+  return end;
+}
+
+static inline char *formatI64(int64_t x, char *out)
+{
+  // magnitude as unsigned, so INT64_MIN doesn't overflow
+  uint64_t magnitude = (uint64_t)x;
+  if (x < 0)
+  {
+    *out++ = '-';
+    magnitude = 0 - magnitude;
+  }
+  return formatU64(magnitude, out);
+}
+
+// int_format.cpp
+size_t format_u32_array(const uint32_t *values, size_t n, char sep, char *out);
+size_t format_u64_array(const uint64_t *values, size_t n, char sep, char *out);
+size_t format_i64_array(const int64_t *values, size_t n, char sep, char *out);
+
+#endif
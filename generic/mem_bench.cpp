@@ -0,0 +1,438 @@
+// Benchmark of copy routines against glibc memcpy, 1 B to 1 MB, hot cache.
+// Before timing, every routine is checked against memcpy for all sizes up to 1 KB and all src/dst offsets in a cache line.
+// memmove routines are checked against glibc memmove for every overlap distance up to 136 bytes either way,
+// then timed without overlap (simd_memmove stays within a few % of simd_memcpy) and with overlap
+//
+// Second part compares cached and streaming (non temporal) copies of 4 MB - 256 MB:
+// bandwidth, and cache pollution seen by another workload. The victim keeps a working set hot in cache,
+// a large copy runs, then victim re-scans its working set. Time of that re-scan shows how much of it the
+// copy evicted. Run on one core the victim and copy take turns; a victim on another core sharing the
+// LLC sees the same evictions.
+//
+// Typical result (AVX-512 server VM, 2 MB L2, 1 core):
+//   64 MB copy: cached ~5.5 GB/s, streaming ~10 GB/s. Destination lines are not read before being written
+//   working set in LLC, re-scan after copy: no copy 2.9, cached 4.3, streaming 3.5 ns per line
+//   working set in L2: evicted in both modes (~6 ns per line). Source reads still pass through the core's
+//   caches; non temporal stores only keep the destination out, so the gain is in the shared LLC
+//
+// Last part: parallel_memcpy of 256 MB with 1, 2, 4 ... workers, then the async handle: caller does its own
+// (memory free) work while workers copy. On the 1 core VM above there is a single worker, so only the
+// overlap can be seen: copy 35 ms + work 37 ms, serial 72 ms, async 68 ms, as both share one core.
+// Multi core hosts scale with workers until memory controllers saturate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "mem_operation.h"
+#include "bench.h"
+
+#define BENCH_MAX_SIZE (1 << 20)
+#define BENCH_BYTES_PER_POINT (64ULL << 20) // each point copies at least this much in total
+#define CHECK_MAX_SIZE 1024
+#define LARGE_MIN_SIZE (4 << 20)
+#define LARGE_MAX_SIZE (256 << 20)
+#define POLLUTION_COPY_SIZE (64 << 20)
+#define POLLUTION_ROUNDS 8
+#define MOVE_CHECK_MAX_SIZE 600
+#define MOVE_CHECK_MAX_DISTANCE 136 // beyond 2 AVX-512 vectors
+#define PARALLEL_COPY_SIZE (256 << 20)
+#define PARALLEL_ROUNDS 3
+
+typedef void *(*CopyFn)(void *, const void *, size_t);
+
+typedef struct
+{
+  const char *name;
+  CopyFn fn;
+} CopyRoutine;
+
+static void *glibcMemcpy(void *dst, const void *src, size_t len)
+{
+  return memcpy(dst, src, len);
+}
+
+static void *simdMemcpy(void *dst, const void *src, size_t len)
+{
+  return simd_memcpy(dst, src, len);
+}
+
+static void *cachedMemcpy(void *dst, const void *src, size_t len)
+{
+  return simd_memcpy_mode(dst, src, len, COPY_CACHED);
+}
+
+static void *streamingMemcpy(void *dst, const void *src, size_t len)
+{
+  return simd_memcpy_mode(dst, src, len, COPY_STREAMING);
+}
+
+static bool checkRoutine(const CopyRoutine *r)
+{
+  // guard bytes around destination catch writes outside [dst, dst + len)
+  static uint8_t src[CHECK_MAX_SIZE + 128];
+  static uint8_t dst[CHECK_MAX_SIZE + 256];
+  static uint8_t expect[CHECK_MAX_SIZE + 256];
+  for (size_t i = 0; i < sizeof(src); i++)
+    src[i] = (uint8_t)(i * 131 + 7);
+  for (size_t len = 0; len <= CHECK_MAX_SIZE; len++)
+  {
+    for (size_t so = 0; so < 64; so++)
+    {
+      for (size_t d = 0; d < 64; d += (len > 256 ? 7 : 1))
+      {
+        memset(dst, 0xAA, sizeof(dst));
+        memset(expect, 0xAA, sizeof(expect));
+        memcpy(expect + 64 + d, src + so, len);
+        void *ret = r->fn(dst + 64 + d, src + so, len);
+        if (ret != dst + 64 + d || memcmp(dst, expect, sizeof(dst)))
+        {
+          printf("%s FAILED: len %zu src offset %zu dst offset %zu\n", r->name, len, so, d);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static double measureGBs(CopyFn fn, uint8_t *dst, const uint8_t *src, size_t len)
+{
+  uint64_t iters = BENCH_BYTES_PER_POINT / len;
+  iters = iters < 16 ? 16 : (iters > 2000000 ? 2000000 : iters);
+  fn(dst, src, len); // warm up caches and TLB
+  uint64_t t0 = nowNs();
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    fn(dst, src, len);
+    clobberMemory();
+  }
+  uint64_t elapsed = nowNs() - t0;
+  return (double)len * iters / elapsed;
+}
+
+// ---------------- memmove ----------------
+
+static void *glibcMemmove(void *dst, const void *src, size_t len)
+{
+  return memmove(dst, src, len);
+}
+
+// every size up to 600 bytes moved by every distance in [-136, 136], from a few start offsets
+static bool checkMove(const CopyRoutine *r)
+{
+  static uint8_t buf[MOVE_CHECK_MAX_SIZE + 4 * MOVE_CHECK_MAX_DISTANCE];
+  static uint8_t expect[sizeof(buf)];
+  for (size_t len = 0; len <= MOVE_CHECK_MAX_SIZE; len++)
+  {
+    for (int dist = -MOVE_CHECK_MAX_DISTANCE; dist <= MOVE_CHECK_MAX_DISTANCE; dist++)
+    {
+      for (size_t base = MOVE_CHECK_MAX_DISTANCE; base < MOVE_CHECK_MAX_DISTANCE + 64; base += 21)
+      {
+        for (size_t i = 0; i < sizeof(buf); i++)
+          buf[i] = (uint8_t)(i * 131 + 7);
+        memcpy(expect, buf, sizeof(buf));
+        memmove(expect + base + dist, expect + base, len);
+        void *ret = r->fn(buf + base + dist, buf + base, len);
+        if (ret != buf + base + dist || memcmp(buf, expect, sizeof(buf)))
+        {
+          printf("%s FAILED: len %zu distance %d\n", r->name, len, dist);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static void benchMove()
+{
+  CopyRoutine routines[6];
+  int num = 0;
+  routines[num++] = {"glibc memmove", glibcMemmove};
+  routines[num++] = {"simd_memmove", simd_memmove};
+  routines[num++] = {"my_memmove", my_memmove};
+  for (int r = 0; r < num; r++)
+  {
+    if (!checkMove(&routines[r]))
+      return;
+  }
+  printf("\nmemmove routines verified for sizes 0..%d and distances -%d..%d\n", MOVE_CHECK_MAX_SIZE,
+         MOVE_CHECK_MAX_DISTANCE, MOVE_CHECK_MAX_DISTANCE);
+
+  // non overlapping: compare with simd_memcpy. Overlapping: dst 1 byte (less than any vector) and 100 bytes
+  // after src (backward), 100 bytes before src (forward)
+  const size_t sizes[] = {64, 1024, 16384, 262144};
+  const long distances[] = {0, 1, 100, -100};
+  uint8_t *buf = (uint8_t *)aligned_alloc(4096, 3 * 262144);
+  memset(buf, 1, 3 * 262144);
+  printf("%9s %9s %14s", "size", "distance", "simd_memcpy");
+  for (int r = 0; r < num; r++)
+    printf(" %14s", routines[r].name);
+  printf("   (GB/s, distance 0 = no overlap)\n");
+  for (size_t len : sizes)
+  {
+    for (long dist : distances)
+    {
+      uint8_t *src = buf + 262144 + 3;
+      uint8_t *dst = dist ? src + dist : buf + 2 * 262144;
+      printf("%9zu %9ld", len, dist);
+      if (dist == 0)
+        printf(" %14.2f", measureGBs(simdMemcpy, dst, src, len));
+      else
+        printf(" %14s", "-");
+      for (int r = 0; r < num; r++)
+        printf(" %14.2f", measureGBs(routines[r].fn, dst, src, len));
+      printf("\n");
+    }
+  }
+  free(buf);
+}
+
+// ---------------- large copies ----------------
+
+static void benchLargeCopies()
+{
+  const CopyRoutine routines[] = {
+      {"glibc", glibcMemcpy}, {"cached", cachedMemcpy}, {"streaming", streamingMemcpy}, {"simd_memcpy", simdMemcpy}};
+  const int num = sizeof(routines) / sizeof(routines[0]);
+  uint8_t *src = (uint8_t *)aligned_alloc(4096, LARGE_MAX_SIZE + 4096);
+  uint8_t *dst = (uint8_t *)aligned_alloc(4096, LARGE_MAX_SIZE + 4096);
+  for (size_t i = 0; i < LARGE_MAX_SIZE + 4096; i++)
+    src[i] = (uint8_t)(i * 131 + 7);
+  memset(dst, 0, LARGE_MAX_SIZE + 4096);
+
+  // large streaming copy with odd offsets, small sizes were covered by checkRoutine
+  size_t checkLen = LARGE_MIN_SIZE + 77;
+  streamingMemcpy(dst + 13, src + 5, checkLen);
+  if (memcmp(dst + 13, src + 5, checkLen) || dst[12] != 0 || dst[13 + checkLen] != 0)
+    printf("streaming FAILED for %zu bytes\n", checkLen);
+
+  printf("\nstream threshold %zu KB\n%9s", simd_memcpy_stream_threshold() >> 10, "size");
+  for (int r = 0; r < num; r++)
+    printf(" %14s", routines[r].name);
+  printf("   (GB/s)\n");
+  for (size_t len = LARGE_MIN_SIZE; len <= LARGE_MAX_SIZE; len *= 4)
+  {
+    printf("%7zuMB", len >> 20);
+    for (int r = 0; r < num; r++)
+      printf(" %14.2f", measureGBs(routines[r].fn, dst, src, len));
+    printf("\n");
+  }
+  free(src);
+  free(dst);
+}
+
+// touch one byte per cache line, returns ns per line
+static double scanWorkingSet(const uint8_t *ws, size_t size)
+{
+  uint64_t t0 = nowNs();
+  uint64_t sum = 0;
+  for (size_t i = 0; i < size; i += 64)
+    sum += ws[i];
+  doNotOptimize(sum);
+  return (double)(nowNs() - t0) / (size / 64);
+}
+
+// mode < 0: no copy between scans, baseline
+static double measurePollution(uint8_t *ws, size_t wsSize, uint8_t *dst, const uint8_t *src, int mode)
+{
+  double total = 0;
+  for (int round = 0; round < POLLUTION_ROUNDS; round++)
+  {
+    scanWorkingSet(ws, wsSize); // bring working set into cache
+    scanWorkingSet(ws, wsSize);
+    if (mode >= 0)
+      simd_memcpy_mode(dst, src, POLLUTION_COPY_SIZE, (CopyMode)mode);
+    total += scanWorkingSet(ws, wsSize);
+  }
+  return total / POLLUTION_ROUNDS;
+}
+
+static void benchPollution()
+{
+  long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  l2 = l2 > 0 ? l2 : (256 << 10);
+  llc = llc > 0 ? llc : l2;
+  // one working set that lives in private L2, one in shared LLC (capped, VMs report whole socket)
+  size_t wsSizes[2] = {(size_t)l2 / 2, (size_t)(llc / 4 < (32 << 20) ? llc / 4 : (32 << 20))};
+
+  uint8_t *src = (uint8_t *)aligned_alloc(4096, POLLUTION_COPY_SIZE);
+  uint8_t *dst = (uint8_t *)aligned_alloc(4096, POLLUTION_COPY_SIZE);
+  uint8_t *ws = (uint8_t *)aligned_alloc(4096, wsSizes[1] > wsSizes[0] ? wsSizes[1] : wsSizes[0]);
+  memset(src, 1, POLLUTION_COPY_SIZE);
+  memset(dst, 2, POLLUTION_COPY_SIZE);
+  memset(ws, 3, wsSizes[1] > wsSizes[0] ? wsSizes[1] : wsSizes[0]);
+
+  printf("\nvictim working set re-scan after %d MB copy (ns per cache line)\n", POLLUTION_COPY_SIZE >> 20);
+  printf("%12s %10s %10s %10s\n", "working set", "no copy", "cached", "streaming");
+  for (size_t wsSize : wsSizes)
+  {
+    printf("%10zuKB %10.2f %10.2f %10.2f\n", wsSize >> 10, measurePollution(ws, wsSize, dst, src, -1),
+           measurePollution(ws, wsSize, dst, src, COPY_CACHED), measurePollution(ws, wsSize, dst, src, COPY_STREAMING));
+  }
+  free(src);
+  free(dst);
+  free(ws);
+}
+
+// ---------------- parallel copy ----------------
+
+static double bestParallelGBs(uint8_t *dst, const uint8_t *src, size_t len, int threads)
+{
+  double best = 0;
+  for (int round = 0; round < PARALLEL_ROUNDS; round++)
+  {
+    uint64_t t0 = nowNs();
+    parallel_memcpy(dst, src, len, threads);
+    double gbs = (double)len / (nowNs() - t0);
+    best = gbs > best ? gbs : best;
+  }
+  return best;
+}
+
+// stands for caller's own work: hashing a small hot buffer, no memory traffic
+static uint64_t callerWork(const uint8_t *buf, size_t size, uint64_t rounds)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (uint64_t r = 0; r < rounds; r++)
+  {
+    for (size_t i = 0; i < size; i++)
+      h = (h ^ buf[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+static void benchParallelCopy()
+{
+  const size_t len = PARALLEL_COPY_SIZE;
+  uint8_t *src = (uint8_t *)aligned_alloc(4096, len + 4096);
+  uint8_t *dst = (uint8_t *)aligned_alloc(4096, len + 4096);
+  for (size_t i = 0; i < len + 4096; i++)
+    src[i] = (uint8_t)(i * 131 + 7);
+  memset(dst, 0, len + 4096);
+  int workers = parallel_copy_workers();
+
+  // odd offsets and sizes around chunk boundaries; destination not faulted in yet (first touch by workers)
+  size_t checkLens[] = {(8 << 20) - 1, (8 << 20) + 4095, (64 << 20) + 77};
+  for (size_t checkLen : checkLens)
+  {
+    parallel_memcpy(dst + 13, src + 5, checkLen, 0);
+    if (memcmp(dst + 13, src + 5, checkLen) || dst[12] != 0 || dst[13 + checkLen] != 0)
+      printf("parallel_memcpy FAILED for %zu bytes\n", checkLen);
+    memset(dst, 0, checkLen + 4096);
+  }
+  uint8_t *fresh = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (fresh != MAP_FAILED)
+  {
+    parallel_memcpy(fresh + 1, src, len - 1, 0);
+    if (memcmp(fresh + 1, src, len - 1))
+      printf("parallel_memcpy FAILED to fresh mapping\n");
+    munmap(fresh, len);
+  }
+
+  printf("\nparallel copy of %zu MB, %d workers (GB/s, best of %d)\n", len >> 20, workers, PARALLEL_ROUNDS);
+  printf("%12s %8.2f\n", "streaming", measureGBs(streamingMemcpy, dst, src, len));
+  for (int threads = 1;; threads *= 2)
+  {
+    threads = threads < workers ? threads : workers; // 1, 2, 4 ... and all workers
+    printf("%9d thr %8.2f\n", threads, bestParallelGBs(dst, src, len, threads));
+    if (threads == workers)
+      break;
+  }
+
+  // overlap: caller works about as long as copy takes, serial vs async
+  uint64_t t0 = nowNs();
+  parallel_memcpy(dst, src, len, 0);
+  uint64_t copyNs = nowNs() - t0;
+  uint64_t rounds = 1;
+  t0 = nowNs();
+  doNotOptimize(callerWork(src, 64 << 10, rounds));
+  uint64_t roundNs = nowNs() - t0;
+  rounds = copyNs / (roundNs ? roundNs : 1) + 1;
+  t0 = nowNs();
+  doNotOptimize(callerWork(src, 64 << 10, rounds));
+  uint64_t workNs = nowNs() - t0;
+
+  t0 = nowNs();
+  ParallelCopy *copy = parallel_memcpy_async(dst, src, len, 0);
+  doNotOptimize(callerWork(src, 64 << 10, rounds));
+  bool doneBeforeWait = parallel_copy_done(copy);
+  parallel_copy_wait(copy);
+  uint64_t asyncNs = nowNs() - t0;
+  if (memcmp(dst, src, len))
+    printf("parallel_memcpy_async FAILED\n");
+  printf("copy %.1f ms + caller work %.1f ms: serial %.1f ms, async %.1f ms (copy %s when caller was done)\n",
+         copyNs / 1e6, workNs / 1e6, (copyNs + workNs) / 1e6, asyncNs / 1e6, doneBeforeWait ? "finished" : "unfinished");
+  free(src);
+  free(dst);
+}
+
+int main_mem_bench()
+{
+  CopyRoutine routines[12];
+  int num = 0;
+  routines[num++] = {"glibc", glibcMemcpy};
+  routines[num++] = {"simd_memcpy", simdMemcpy};
+#if defined(__x86_64__)
+  routines[num++] = {"memcpy_sse2", (CopyFn)memcpy_sse2};
+  if (__builtin_cpu_supports("avx2"))
+    routines[num++] = {"memcpy_avx2", (CopyFn)memcpy_avx2};
+  if (__builtin_cpu_supports("avx512f"))
+    routines[num++] = {"memcpy_avx512", (CopyFn)memcpy_avx512};
+#endif
+  routines[num++] = {"fast_memcpy", fast_memcpy};
+  routines[num++] = {"faster_memcopy", faster_memcopy};
+  routines[num++] = {"smerge", (CopyFn)shift_merge_memcpy};
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("ssse3"))
+    routines[num++] = {"smerge_ssse3", (CopyFn)shift_merge_memcpy_ssse3};
+  if (__builtin_cpu_supports("avx2"))
+    routines[num++] = {"smerge_avx2", (CopyFn)shift_merge_memcpy_avx2};
+#endif
+  routines[num++] = {"streaming", streamingMemcpy};
+
+  printf("simd_memcpy dispatched to %s\n", simd_memcpy_isa());
+  for (int r = 0; r < num; r++)
+  {
+    if (!checkRoutine(&routines[r]))
+      return 1;
+  }
+  printf("all routines verified for sizes 0..%d and all src/dst offsets\n\n", CHECK_MAX_SIZE);
+
+  // page aligned buffers + small offset so that size is the only variable
+  uint8_t *src = (uint8_t *)aligned_alloc(4096, BENCH_MAX_SIZE + 4096);
+  uint8_t *dst = (uint8_t *)aligned_alloc(4096, BENCH_MAX_SIZE + 4096);
+  memset(src, 1, BENCH_MAX_SIZE + 4096);
+  memset(dst, 2, BENCH_MAX_SIZE + 4096);
+
+  printf("%9s", "size");
+  for (int r = 0; r < num; r++)
+    printf(" %14s", routines[r].name);
+  printf("   (GB/s, src +3 / dst +0 from page)\n");
+  for (size_t len = 1; len <= BENCH_MAX_SIZE; len *= 2)
+  {
+    // power of 2 and an odd size in between
+    size_t sizes[2] = {len, len + len / 2 + 1};
+    for (size_t sz : sizes)
+    {
+      if (sz > BENCH_MAX_SIZE || (sz != len && sz >= 2 * len))
+        continue;
+      printf("%9zu", sz);
+      for (int r = 0; r < num; r++)
+        printf(" %14.2f", measureGBs(routines[r].fn, dst, src + 3, sz));
+      printf("\n");
+    }
+  }
+  free(src);
+  free(dst);
+
+  benchMove();
+  benchLargeCopies();
+  benchPollution();
+  benchParallelCopy();
+  return 0;
+}
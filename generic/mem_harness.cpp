@@ -0,0 +1,404 @@
+// Test and timing harness for the copy routines of mem_operation.cpp (plus glibc and simd versions for reference)
+//
+// 1. Differential fuzzer: random sizes (log uniform up to 16 KB), random offsets and random overlap.
+//    Buffers live in an mmap area with PROT_NONE guard pages on both sides and the src/dst span is often
+//    placed flush against a guard, so a read or write past either end faults. SIGSEGV is caught with
+//    sigsetjmp and reported as out of bounds. Bytes around the span are compared too, which catches small
+//    overruns that stay inside the page. Result is checked against a byte loop reference.
+//    memcpy style routines only get non overlapping inputs, memmove style ones get any overlap.
+// 2. Benchmark: sizes 1 B to 1 GB (limited to a quarter of RAM per buffer), hot and cold cache.
+//    Hot repeats copy on same buffers; cold evicts both buffers (clflush) before each timed copy.
+//    Reports GB/s and TSC cycles per byte (TSC ticks at nominal frequency, not actual core clock).
+// 3. Alignment sweep: every src/dst offset pair within a cache line (64 x 64) at 4 KB, hot.
+//    Prints min/median/max per routine and 8x8 matrix of average GB/s by (src % 8, dst % 8)
+//
+// Build with -O2 -fno-tree-loop-distribute-patterns: otherwise GCC recognizes the byte loop of my_memcpy
+// and replaces it with a call to memcpy, and the benchmark would time glibc twice
+
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mem_operation.h"
+#include "bench.h"
+
+#define FUZZ_ITERATIONS 200000
+#define FUZZ_MAX_SIZE (16 << 10)
+#define FUZZ_MARGIN 256 // bytes compared around src/dst span
+#define FUZZ_MAX_REPORTS 10
+#define HARNESS_MAX_SIZE (1ULL << 30)
+#define HOT_BYTES_PER_POINT (64ULL << 20)
+#define COLD_BYTES_PER_POINT (256ULL << 20)
+#define COLD_MAX_REPEATS 20
+#define ALIGN_SWEEP_SIZE 4096
+#define ALIGN_SWEEP_REPEATS 64
+#define ALIGN_SWEEP_RUNS 3 // best of, filters out interrupts
+
+typedef void *(*CopyFn)(void *, const void *, size_t);
+
+typedef struct
+{
+  const char *name;
+  CopyFn fn;
+  bool allowsOverlap;
+} MemRoutine;
+
+static void *glibcMemcpy(void *dst, const void *src, size_t len)
+{
+  return memcpy(dst, src, len);
+}
+
+static void *glibcMemmove(void *dst, const void *src, size_t len)
+{
+  return memmove(dst, src, len);
+}
+
+static void *myMemcpy(void *dst, const void *src, size_t len)
+{
+  return my_memcpy(dst, src, len);
+}
+
+static void *simdMemcpy(void *dst, const void *src, size_t len)
+{
+  return simd_memcpy(dst, src, len);
+}
+
+static void *streamingMemcpy(void *dst, const void *src, size_t len)
+{
+  return simd_memcpy_mode(dst, src, len, COPY_STREAMING);
+}
+
+static void *shiftMergeMemcpy(void *dst, const void *src, size_t len)
+{
+  return shift_merge_memcpy(dst, src, len);
+}
+
+static const MemRoutine fuzzRoutines[] = {
+    {"glibc memcpy", glibcMemcpy, false},
+    {"glibc memmove", glibcMemmove, true},
+    {"my_memcpy", myMemcpy, false},
+    {"fast_memcpy", fast_memcpy, false},
+    {"faster_memcopy", faster_memcopy, false},
+    {"my_memmove", my_memmove, true},
+    {"simd_memcpy", simdMemcpy, false},
+    {"simd_memmove", simd_memmove, true},
+    {"shift_merge", shiftMergeMemcpy, false},
+    {"streaming", streamingMemcpy, false},
+};
+
+static const MemRoutine benchRoutines[] = {
+    {"glibc", glibcMemcpy, false},
+    {"my_memcpy", myMemcpy, false},
+    {"fast_memcpy", fast_memcpy, false},
+    {"faster_memcopy", faster_memcopy, false},
+    {"my_memmove", my_memmove, true},
+    {"simd_memcpy", simdMemcpy, false},
+};
+
+// ---------------- differential fuzzer ----------------
+
+static sigjmp_buf faultJump;
+
+static void faultHandler(int sig)
+{
+  siglongjmp(faultJump, sig);
+}
+
+// false if call faulted. Kept separate so that no local of the caller lives across sigsetjmp
+static bool guardedCall(CopyFn fn, void *dst, const void *src, size_t len, void **ret)
+{
+  if (sigsetjmp(faultJump, 1))
+    return false;
+  *ret = fn(dst, src, len);
+  return true;
+}
+
+static uint64_t fuzzRandom(uint64_t *state)
+{
+  // xorshift64*
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static void refMove(uint8_t *dst, const uint8_t *src, size_t len)
+{
+  if (dst > src)
+  {
+    while (len--)
+      dst[len] = src[len];
+  }
+  else
+  {
+    for (size_t i = 0; i < len; i++)
+      dst[i] = src[i];
+  }
+}
+
+// size mostly small: log uniform in [0, FUZZ_MAX_SIZE]
+static size_t fuzzSize(uint64_t *rnd)
+{
+  int bits = fuzzRandom(rnd) % 15; // 2^14 = FUZZ_MAX_SIZE
+  return fuzzRandom(rnd) & ((1ULL << bits) - 1);
+}
+
+static int fuzzRoutine(const MemRoutine *r, uint8_t *area, size_t areaSize, uint64_t seed)
+{
+  static uint8_t expect[2 * FUZZ_MAX_SIZE + 8192 + 2 * FUZZ_MARGIN];
+  uint64_t rnd = seed;
+  int failures = 0;
+  for (int iter = 0; iter < FUZZ_ITERATIONS && failures < FUZZ_MAX_REPORTS; iter++)
+  {
+    size_t len = fuzzSize(&rnd);
+    // dst relative to src. memmove: any overlap (and a bit beyond). memcpy: disjoint, up to 4 KB apart
+    long delta;
+    if (r->allowsOverlap)
+      delta = (long)(fuzzRandom(&rnd) % (2 * len + 129)) - (long)(len + 64);
+    else
+      delta = (long)(len + fuzzRandom(&rnd) % 4096) * ((fuzzRandom(&rnd) & 1) ? 1 : -1);
+    long lo = delta < 0 ? delta : 0;
+    long hi = delta + (long)len > (long)len ? delta + (long)len : (long)len;
+    size_t span = hi - lo;
+
+    // span flush with start of area, flush with end, or anywhere in between
+    size_t base;
+    int placement = fuzzRandom(&rnd) % 3;
+    if (placement == 0)
+      base = 0;
+    else if (placement == 1)
+      base = areaSize - span;
+    else
+      base = fuzzRandom(&rnd) % (areaSize - span + 1);
+    uint8_t *src = area + base - lo;
+    uint8_t *dst = src + delta;
+
+    // randomize window around span, build expected result on copy of it
+    size_t winStart = base > FUZZ_MARGIN ? base - FUZZ_MARGIN : 0;
+    size_t winEnd = base + span + FUZZ_MARGIN < areaSize ? base + span + FUZZ_MARGIN : areaSize;
+    for (size_t i = winStart; i < winEnd; i++)
+      area[i] = (uint8_t)fuzzRandom(&rnd);
+    memcpy(expect, area + winStart, winEnd - winStart);
+    refMove(expect + (dst - area - winStart), expect + (src - area - winStart), len);
+
+    const char *error = NULL;
+    void *ret;
+    if (!guardedCall(r->fn, dst, src, len, &ret))
+      error = "out of bounds access hit guard page";
+    else if (ret != dst)
+      error = "wrong return value";
+    else if (memcmp(area + winStart, expect, winEnd - winStart))
+      error = "wrong result or write outside dst";
+    if (error)
+    {
+      printf("  %s FAILED (%s): len %zu src offset %zu dst offset %zu (area of %zu bytes, seed %llu iter %d)\n",
+             r->name, error, len, (size_t)(src - area), (size_t)(dst - area), areaSize, (unsigned long long)seed, iter);
+      failures++;
+    }
+  }
+  return failures;
+}
+
+static bool fuzzAll(uint64_t seed)
+{
+  long pageSize = sysconf(_SC_PAGESIZE);
+  size_t areaSize = (2 * FUZZ_MAX_SIZE + 4096 + pageSize - 1) / pageSize * pageSize;
+  // [guard page][area][guard page]
+  uint8_t *map = (uint8_t *)mmap(NULL, areaSize + 2 * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+  {
+    perror("mmap");
+    return false;
+  }
+  mprotect(map, pageSize, PROT_NONE);
+  mprotect(map + pageSize + areaSize, pageSize, PROT_NONE);
+  uint8_t *area = map + pageSize;
+
+  struct sigaction sa, oldSegv, oldBus;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = faultHandler;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGSEGV, &sa, &oldSegv);
+  sigaction(SIGBUS, &sa, &oldBus);
+
+  printf("fuzzing %d cases per routine, sizes 0..%d, seed %llu\n", FUZZ_ITERATIONS, FUZZ_MAX_SIZE, (unsigned long long)seed);
+  bool ok = true;
+  for (const MemRoutine &r : fuzzRoutines)
+  {
+    int failures = fuzzRoutine(&r, area, areaSize, seed);
+    printf("  %-16s %s\n", r.name, failures ? "FAILED" : "ok");
+    ok = ok && failures == 0;
+  }
+
+  sigaction(SIGSEGV, &oldSegv, NULL);
+  sigaction(SIGBUS, &oldBus, NULL);
+  munmap(map, areaSize + 2 * pageSize);
+  return ok;
+}
+
+// ---------------- benchmark ----------------
+
+static void evictFromCache(const uint8_t *p, size_t len)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  for (uintptr_t a = (uintptr_t)p & ~(uintptr_t)63; a < (uintptr_t)p + len; a += 64)
+    _mm_clflush((const void *)a);
+  _mm_mfence();
+#else
+  // no user space flush: overwrite cache with unrelated data
+  static uint8_t *evictBuffer = (uint8_t *)malloc(64 << 20);
+  (void)p;
+  (void)len;
+  memset(evictBuffer, (int)nowNs(), 64 << 20);
+  clobberMemory();
+#endif
+}
+
+typedef struct
+{
+  double gbs;
+  double cyclesPerByte;
+} CopyResult;
+
+// timed with readCycles only: clock_gettime costs about as much as a cold copy of a few bytes
+static CopyResult measureCopy(CopyFn fn, uint8_t *dst, const uint8_t *src, size_t len, bool cold)
+{
+  uint64_t cycles = 0;
+  uint64_t iters;
+  if (cold)
+  {
+    iters = COLD_BYTES_PER_POINT / len;
+    iters = iters < 1 ? 1 : (iters > COLD_MAX_REPEATS ? COLD_MAX_REPEATS : iters);
+    for (uint64_t i = 0; i < iters; i++)
+    {
+      evictFromCache(src, len);
+      evictFromCache(dst, len);
+      uint64_t c0 = readCycles();
+      fn(dst, src, len);
+      clobberMemory();
+      cycles += readCycles() - c0;
+    }
+  }
+  else
+  {
+    iters = HOT_BYTES_PER_POINT / len;
+    iters = iters < 1 ? 1 : (iters > 1000000 ? 1000000 : iters);
+    fn(dst, src, len);
+    uint64_t c0 = readCycles();
+    for (uint64_t i = 0; i < iters; i++)
+    {
+      fn(dst, src, len);
+      clobberMemory();
+    }
+    cycles = readCycles() - c0;
+  }
+  double bytes = (double)len * iters;
+  cycles = cycles ? cycles : 1;
+  return {bytes / (cycles / cyclesPerNs()), cycles / bytes};
+}
+
+static void benchSizes(uint8_t *dst, const uint8_t *src, size_t maxSize, bool cold)
+{
+  const int num = sizeof(benchRoutines) / sizeof(benchRoutines[0]);
+  printf("\n%s cache, GB/s / TSC cycles per byte\n%9s", cold ? "cold" : "hot", "size");
+  for (int r = 0; r < num; r++)
+    printf(" %16s", benchRoutines[r].name);
+  printf("\n");
+  for (size_t len = 1; len <= maxSize; len *= 4)
+  {
+    if (len >= (1 << 20))
+      printf("%7zuMB", len >> 20);
+    else
+      printf("%9zu", len);
+    for (int r = 0; r < num; r++)
+    {
+      CopyResult res = measureCopy(benchRoutines[r].fn, dst, src, len, cold);
+      printf("   %6.2f/%6.3f", res.gbs, res.cyclesPerByte);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+}
+
+static void benchAlignment(uint8_t *dst, const uint8_t *src)
+{
+  static double gbs[64][64];
+  printf("\nalignment sweep, %d bytes, all src/dst offsets 0..63 (GB/s, hot)\n", ALIGN_SWEEP_SIZE);
+  for (const MemRoutine &r : benchRoutines)
+  {
+    double samples[64 * 64];
+    double byWord[8][8] = {};
+    int worstSrc = 0, worstDst = 0;
+    for (int s = 0; s < 64; s++)
+    {
+      for (int d = 0; d < 64; d++)
+      {
+        r.fn(dst + d, src + s, ALIGN_SWEEP_SIZE);
+        uint64_t best = UINT64_MAX;
+        for (int run = 0; run < ALIGN_SWEEP_RUNS; run++)
+        {
+          uint64_t t0 = nowNs();
+          for (int i = 0; i < ALIGN_SWEEP_REPEATS; i++)
+          {
+            r.fn(dst + d, src + s, ALIGN_SWEEP_SIZE);
+            clobberMemory();
+          }
+          uint64_t elapsed = nowNs() - t0;
+          best = elapsed < best ? elapsed : best;
+        }
+        gbs[s][d] = (double)ALIGN_SWEEP_SIZE * ALIGN_SWEEP_REPEATS / best;
+        samples[s * 64 + d] = gbs[s][d];
+        byWord[s % 8][d % 8] += gbs[s][d] / 64;
+        if (gbs[s][d] < gbs[worstSrc][worstDst])
+        {
+          worstSrc = s;
+          worstDst = d;
+        }
+      }
+    }
+    qsort(samples, 64 * 64, sizeof(double), [](const void *a, const void *b) {
+      double x = *(const double *)a, y = *(const double *)b;
+      return x < y ? -1 : (x > y ? 1 : 0);
+    });
+    printf("%s: min %.2f (src +%d dst +%d) median %.2f max %.2f\n", r.name, samples[0], worstSrc, worstDst,
+           samples[64 * 64 / 2], samples[64 * 64 - 1]);
+    printf("  src%%8\\dst%%8");
+    for (int d = 0; d < 8; d++)
+      printf(" %7d", d);
+    printf("\n");
+    for (int s = 0; s < 8; s++)
+    {
+      printf("  %11d", s);
+      for (int d = 0; d < 8; d++)
+        printf(" %7.2f", byWord[s][d]);
+      printf("\n");
+    }
+  }
+}
+
+int main_mem_harness()
+{
+  if (!fuzzAll(nowNs()))
+    return 1;
+
+  // two buffers of up to 1 GB, but not more than a quarter of RAM each
+  size_t ram = (size_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+  size_t maxSize = HARNESS_MAX_SIZE;
+  while (maxSize > ram / 4)
+    maxSize /= 2;
+  uint8_t *src = (uint8_t *)aligned_alloc(4096, maxSize + 4096);
+  uint8_t *dst = (uint8_t *)aligned_alloc(4096, maxSize + 4096);
+  memset(src, 1, maxSize + 4096);
+  memset(dst, 2, maxSize + 4096);
+
+  benchAlignment(dst, src);
+  benchSizes(dst, src, maxSize, false);
+  benchSizes(dst, src, maxSize, true);
+  free(src);
+  free(dst);
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include "mem_operation.h"
 
 void *my_memcpy(void *__restrict dst, const void *__restrict src, size_t count)
 {
@@ -13,6 +14,8 @@ void *my_memcpy(void *__restrict dst, const void *__restrict src, size_t count)
   return dst;
 }
 
+// word at a time copy. For buffers of many MB every destination line is read into cache before being written
+// and the copy evicts whole LLC; simd_memcpy_mode(dst, src, len, COPY_STREAMING) avoids both (simd_memcpy.cpp)
 void *fast_memcpy(void *dst, const void *src, size_t len)
 {
   void *dstOrig = dst;
@@ -65,7 +68,9 @@ void *fast_memcpy(void *dst, const void *src, size_t len)
   return dstOrig;
 }
 
-void *faster_memcopy(void *dst, const void *src, size_t len)
+// aligned loads in mismatched branch may read a few bytes outside src (never outside its words, hence never
+// across a page), which address sanitizer would report
+__attribute__((no_sanitize("address"))) void *faster_memcopy(void *dst, const void *src, size_t len)
 {
   // reading word from address not aligned to word size is slower
   // instead copy first few bytes till address gets aligned to word boundary
@@ -75,7 +80,7 @@ void *faster_memcopy(void *dst, const void *src, size_t len)
   uintptr_t dstP = (uintptr_t)dst;
   uintptr_t srcP = (uintptr_t)src;
   // check if source and destination are unaligned by number of bytes with respect to Word coundary
-  uint8_t wordBytes = sizeof(uint32_t);
+  uint8_t wordBytes = sizeof(uint64_t);
   if((srcP & (wordBytes - 1)) == (dstP & (wordBytes - 1)))
   {
     // copy few bytes to align dst to word boundary
@@ -108,31 +113,36 @@ void *faster_memcopy(void *dst, const void *src, size_t len)
         dst = (void*)((uint8_t*)dst + 1);
         src = (void*)((uint8_t*)src + 1);
       }
-      //now dst is aligned on word boundary
-      if(len > wordBytes)
+      //now dst is aligned on word boundary, src is sh bytes past a word boundary (sh != 0)
+      // Read aligned words lWord, rWord around src; wanted word is last (wordBytes - sh) bytes of lWord
+      // followed by first sh bytes of rWord. rWord becomes lWord of next step, so each source word is loaded once
+      // e.g. sh = 3 on little endian: lWord = [x x x a b c d e], rWord = [f g h . . . . .] -> [a b c d e f g h]
+      srcP = (uintptr_t)src;
+      uint8_t sh = srcP % wordBytes;
+      const uint64_t *srcWordPtr = (const uint64_t *)(srcP - sh);
+      uint64_t *dstWordPtr = (uint64_t *)dst;
+      size_t words = len / wordBytes;
+      uint64_t lWord = *srcWordPtr++;
+      for (size_t i = 0; i < words; i++)
       {
-        srcP = (uintptr_t)src;
-        uint8_t sh1 = srcP % wordBytes;
-        uint8_t sh2 = wordBytes - sh1;
-        uint32_t *lWord = (uint32_t*)(srcP - sh1);
-        uint32_t *rWord = (uint32_t*)(srcP + sh2);
-        uint32_t srcWord = ((*lWord) << sh1) | ((*rWord) >> sh2);
-        *((uint32_t*)dst) = *((uint32_t*)src);
-        dst = (void*)((uint32_t*)dst + 1);
-        src = (void*)((uint32_t*)src + 1);
-        len -= wordBytes;
-        fast_memcpy(dst, src, len);
-      }
-      else
-      {
-        // bytecopy remaining few bytes
-        while (len--)
-        {
-          *((uint8_t*)dst) = *((uint8_t*)src);
-          dst = (void*)((uint8_t*)dst + 1);
-          src = (void*)((uint8_t*)src + 1);
-        }
+        uint64_t rWord = *srcWordPtr++;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        *dstWordPtr++ = (lWord >> (8 * sh)) | (rWord << (8 * (wordBytes - sh)));
+#else
+        *dstWordPtr++ = (lWord << (8 * sh)) | (rWord >> (8 * (wordBytes - sh)));
+#endif
+        lWord = rWord;
       }
+      dst = (void *)dstWordPtr;
+      src = (void *)((uint8_t *)src + words * wordBytes);
+      len -= words * wordBytes;
+    }
+    // bytecopy remaining few bytes
+    while (len--)
+    {
+      *((uint8_t*)dst) = *((uint8_t*)src);
+      dst = (void*)((uint8_t*)dst + 1);
+      src = (void*)((uint8_t*)src + 1);
     }
   }
   return dstOrig;
@@ -153,11 +163,30 @@ void *my_memmove(void *dst, const void *src, size_t len)
   //{
   //  memcpy(dst, src, len);
   //}
-  // bytecopy can be optimized to chunk copy. Need to consider alignement and trailing bytes
+  // chunk copy: bytes until dst is word aligned, then words, then trailing bytes. Every word is loaded
+  // before it is stored and earlier stores only hit source bytes already read (they are behind us in
+  // direction of copy), so this is correct even if dst and src are closer than a word, e.g. 1 byte apart.
+  // Vector version with 16/32/64 byte chunks is simd_memmove (simd_memcpy.cpp)
+  const size_t wordBytes = sizeof(uint64_t);
   if (dstP > srcP && (dstP - srcP) < len) // need back to front copying
   {
     dstPtr += len;
     srcPtr += len;
+    // align end of dst
+    while (len && ((uintptr_t)dstPtr & (wordBytes - 1)))
+    {
+      *(--dstPtr) = *(--srcPtr);
+      len--;
+    }
+    while (len >= wordBytes)
+    {
+      dstPtr -= wordBytes;
+      srcPtr -= wordBytes;
+      uint64_t word;
+      memcpy(&word, srcPtr, wordBytes); // src may be unaligned, memcpy of constant size compiles to single load
+      *((uint64_t *)dstPtr) = word;
+      len -= wordBytes;
+    }
     while (len--)
     {
       *(--dstPtr) = *(--srcPtr);
@@ -165,6 +194,20 @@ void *my_memmove(void *dst, const void *src, size_t len)
   }
   else // safe front to back copying
   {
+    while (len && ((uintptr_t)dstPtr & (wordBytes - 1)))
+    {
+      *dstPtr++ = *srcPtr++;
+      len--;
+    }
+    while (len >= wordBytes)
+    {
+      uint64_t word;
+      memcpy(&word, srcPtr, wordBytes);
+      *((uint64_t *)dstPtr) = word;
+      dstPtr += wordBytes;
+      srcPtr += wordBytes;
+      len -= wordBytes;
+    }
     while (len--)
     {
       *dstPtr++ = *srcPtr++;
@@ -173,6 +216,7 @@ void *my_memmove(void *dst, const void *src, size_t len)
   return dst;
 }
 
+// visual demo of overlap behaviour. Randomized checking with guard pages and timing of these routines: mem_harness.cpp
 int main()
 {
   char buffer0[16] = "123456781234567";
@@ -0,0 +1,65 @@
+#ifndef __MEM_OPERATION_H
+#define __MEM_OPERATION_H
+
+#include <stddef.h>
+
+// mem_operation.cpp: reference implementations explained step by step
+void *my_memcpy(void *__restrict dst, const void *__restrict src, size_t count);
+void *fast_memcpy(void *dst, const void *src, size_t len);
+void *faster_memcopy(void *dst, const void *src, size_t len);
+void *my_memmove(void *dst, const void *src, size_t len);
+
+// shift_merge_copy.cpp: memcpy with only aligned loads and stores, for src/dst misaligned to each other.
+// palignr (SSSE3) / vpalignr (AVX2) / vext (NEON) merge of neighbouring aligned vectors
+void *shift_merge_memcpy(void *__restrict dst, const void *__restrict src, size_t len);
+
+// simd_memcpy.cpp: vector copy engine. Widest available ISA (SSE2/AVX2/AVX-512 on x86) is picked once at load time
+void *simd_memcpy(void *__restrict dst, const void *__restrict src, size_t len);
+void *simd_memmove(void *dst, const void *src, size_t len);
+const char *simd_memcpy_isa();
+
+// Large copies: simd_memcpy switches to non temporal (cache bypassing) stores at stream threshold,
+// 3/4 of detected last level cache by default. Mode forces either path regardless of size
+typedef enum
+{
+  COPY_AUTO,      // same as simd_memcpy
+  COPY_CACHED,    // normal stores, destination ends up in cache. Best when data is used right after copy
+  COPY_STREAMING, // non temporal stores + prefetch + sfence. Best when data won't be touched soon
+} CopyMode;
+void *simd_memcpy_mode(void *__restrict dst, const void *__restrict src, size_t len, CopyMode mode);
+size_t simd_memcpy_stream_threshold();
+void simd_memcpy_set_stream_threshold(size_t bytes);
+
+// simd_scan.cpp: vector memset/memcmp/memchr/strlen, same dispatch as simd_memcpy.
+// Scans use only aligned loads (or loads that can't cross a page), safe at end of mapped memory
+void *simd_memset(void *dst, int c, size_t len);
+int simd_memcmp(const void *a, const void *b, size_t len);
+void *simd_memchr(const void *s, int c, size_t len);
+size_t simd_strlen(const char *s);
+// multi byte memchr: first byte of buf[0, len) that is any of set[0, setLen). NULL if none
+void *simd_memchr_any(const void *buf, size_t len, const char *set, size_t setLen);
+const char *simd_scan_isa();
+
+// parallel_copy.cpp: multi threaded copy for hundreds of MB and more. Page aligned chunks, streaming stores,
+// workers pinned one per cpu; each chunk is copied by a worker on the NUMA node of its destination page.
+// threads <= 0 uses every worker. Copies below 8 MB are done by the caller before async returns
+typedef struct ParallelCopy ParallelCopy;
+ParallelCopy *parallel_memcpy_async(void *__restrict dst, const void *__restrict src, size_t len, int threads);
+bool parallel_copy_done(const ParallelCopy *copy); // non blocking
+void parallel_copy_wait(ParallelCopy *copy);        // helps copy what's left, blocks till done, frees handle
+void *parallel_memcpy(void *__restrict dst, const void *__restrict src, size_t len, int threads);
+int parallel_copy_workers();
+
+#if defined(__x86_64__)
+// individual variants, for benchmarking. Caller must check cpu support (__builtin_cpu_supports)
+void *memcpy_sse2(void *__restrict dst, const void *__restrict src, size_t len);
+void *memcpy_avx2(void *__restrict dst, const void *__restrict src, size_t len);
+void *memcpy_avx512(void *__restrict dst, const void *__restrict src, size_t len);
+void *memmove_sse2(void *dst, const void *src, size_t len);
+void *memmove_avx2(void *dst, const void *src, size_t len);
+void *memmove_avx512(void *dst, const void *src, size_t len);
+void *shift_merge_memcpy_ssse3(void *__restrict dst, const void *__restrict src, size_t len);
+void *shift_merge_memcpy_avx2(void *__restrict dst, const void *__restrict src, size_t len);
+#endif
+
+#endif
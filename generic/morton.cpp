@@ -0,0 +1,339 @@
+// Batch Morton encode/decode of morton.h, with runtime ISA dispatch like simd_scan.cpp.
+//
+// generic: magic numbers one key at a time. bmi2: pdep/pext one key at a time.
+// AVX2 2D: nibble lookup with vpshufb, 8 keys per iteration.
+//   encode: a nibble abcd spreads to the byte 0a0b0c0d, so a table of 16 spread nibbles (and the same
+//   shifted left by 1 for y) turns every coordinate byte into two key bytes. Low and high nibbles are looked
+//   up separately, x and y lookups ORed, then bytes from low and high nibbles interleaved (vpunpck*bw).
+//   decode: the reverse. A key byte holds 4 bits of x and 4 of y. Its low and high nibbles are looked up
+//   in two tables that gather them into one byte, x nibble low, y nibble high. Pairs of nibbles are then
+//   merged into bytes with vpmaddubsw (lo * 1 + hi * 16) and packed.
+// AVX2 3D: no byte aligned pattern (3 bits per coordinate bit), so magic numbers on four 64 bit lanes.
+//
+// pdep/pext do a whole coordinate in one instruction but only one per cycle, the vector versions spend a
+// few instructions per key but on 4 to 8 keys at once. Which wins depends on the key type and the CPU
+// (and on Zen 1/2 pdep is microcoded and slow), see morton_bench.cpp. The dispatch below follows it.
+
+#include <stdint.h>
+#include <string.h>
+#include "morton.h"
+#include "simd_vec.h"
+
+template <typename Encode>
+ALWAYS_INLINE void encode2D(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n, Encode encode)
+{
+  for (size_t i = 0; i < n; i++)
+    keys[i] = encode(x[i], y[i]);
+}
+
+template <typename Decode>
+ALWAYS_INLINE void decode2D(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n, Decode decode)
+{
+  for (size_t i = 0; i < n; i++)
+    decode(keys[i], x + i, y + i);
+}
+
+template <typename Encode>
+ALWAYS_INLINE void encode3D(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys, size_t n,
+                            Encode encode)
+{
+  for (size_t i = 0; i < n; i++)
+    keys[i] = encode(x[i], y[i], z[i]);
+}
+
+template <typename Decode>
+ALWAYS_INLINE void decode3D(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n, Decode decode)
+{
+  for (size_t i = 0; i < n; i++)
+    decode(keys[i], x + i, y + i, z + i);
+}
+
+static void morton_encode_2d_generic(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n)
+{
+  encode2D(x, y, keys, n, mortonEncode2DMagic);
+}
+
+static void morton_decode_2d_generic(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n)
+{
+  decode2D(keys, x, y, n, mortonDecode2DMagic);
+}
+
+static void morton_encode_3d_generic(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys,
+                                     size_t n)
+{
+  encode3D(x, y, z, keys, n, mortonEncode3DMagic);
+}
+
+static void morton_decode_3d_generic(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n)
+{
+  decode3D(keys, x, y, z, n, mortonDecode3DMagic);
+}
+
+#if defined(__x86_64__)
+
+// ---------------- BMI2 ----------------
+
+#define BMI2 __attribute__((target("bmi2")))
+
+BMI2 static void morton_encode_2d_bmi2(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n)
+{
+  encode2D(x, y, keys, n, [](uint32_t a, uint32_t b) BMI2 { return mortonEncode2DPdep(a, b); });
+}
+
+BMI2 static void morton_decode_2d_bmi2(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n)
+{
+  decode2D(keys, x, y, n, [](uint64_t k, uint32_t *a, uint32_t *b) BMI2 { mortonDecode2DPdep(k, a, b); });
+}
+
+BMI2 static void morton_encode_3d_bmi2(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys,
+                                       size_t n)
+{
+  encode3D(x, y, z, keys, n, [](uint32_t a, uint32_t b, uint32_t c) BMI2 { return mortonEncode3DPdep(a, b, c); });
+}
+
+BMI2 static void morton_decode_3d_bmi2(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n)
+{
+  decode3D(keys, x, y, z, n,
+           [](uint64_t k, uint32_t *a, uint32_t *b, uint32_t *c) BMI2 { mortonDecode3DPdep(k, a, b, c); });
+}
+
+#undef BMI2
+
+// ---------------- AVX2 ----------------
+
+#define AVX2 __attribute__((target("avx2")))
+#define AVX2_INLINE __attribute__((target("avx2"), always_inline)) inline
+
+// 16 byte table in both lanes
+AVX2_INLINE __m256i nibbleTable(const uint8_t *t)
+{
+  return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t));
+}
+
+// nibble abcd -> byte 0a0b0c0d
+static const uint8_t spreadNibble[16] = {0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15,
+                                         0x40, 0x41, 0x44, 0x45, 0x50, 0x51, 0x54, 0x55};
+
+// key nibble y1 x1 y0 x0 -> byte (y1 y0) << 4 | (x1 x0), same for the high nibble shifted by 2
+static const uint8_t gatherLow[16] = {0x00, 0x01, 0x10, 0x11, 0x02, 0x03, 0x12, 0x13,
+                                      0x20, 0x21, 0x30, 0x31, 0x22, 0x23, 0x32, 0x33};
+static const uint8_t gatherHigh[16] = {0x00, 0x04, 0x40, 0x44, 0x08, 0x0c, 0x48, 0x4c,
+                                       0x80, 0x84, 0xc0, 0xc4, 0x88, 0x8c, 0xc8, 0xcc};
+
+AVX2 void morton_encode_2d_avx2(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n)
+{
+  const __m256i tableX = nibbleTable(spreadNibble);
+  const __m256i tableY = _mm256_slli_epi16(tableX, 1);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i vx = _mm256_loadu_si256((const __m256i *)(x + i));
+    __m256i vy = _mm256_loadu_si256((const __m256i *)(y + i));
+    // key bits from low / high nibble of every coordinate byte
+    __m256i lo = _mm256_or_si256(_mm256_shuffle_epi8(tableX, _mm256_and_si256(vx, nibble)),
+                                 _mm256_shuffle_epi8(tableY, _mm256_and_si256(vy, nibble)));
+    __m256i hi = _mm256_or_si256(_mm256_shuffle_epi8(tableX, _mm256_and_si256(_mm256_srli_epi16(vx, 4), nibble)),
+                                 _mm256_shuffle_epi8(tableY, _mm256_and_si256(_mm256_srli_epi16(vy, 4), nibble)));
+    // per 128 bit lane: unpacklo gives keys of the first 2 coordinates, unpackhi of the last 2
+    __m256i k01 = _mm256_unpacklo_epi8(lo, hi); // keys 0 1 | 4 5
+    __m256i k23 = _mm256_unpackhi_epi8(lo, hi); // keys 2 3 | 6 7
+    _mm256_storeu_si256((__m256i *)(keys + i), _mm256_permute2x128_si256(k01, k23, 0x20));
+    _mm256_storeu_si256((__m256i *)(keys + i + 4), _mm256_permute2x128_si256(k01, k23, 0x31));
+  }
+  encode2D(x + i, y + i, keys + i, n - i, mortonEncode2DMagic);
+}
+
+// 4 keys -> 16 words, word j of key k = x bits 8j..8j+7 (and y in ySum)
+AVX2_INLINE void gatherWords(__m256i k, __m256i tableLo, __m256i tableHi, __m256i &xWords, __m256i &yWords)
+{
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i weights = _mm256_set1_epi16(0x1001); // bytes 1, 16: even byte + odd byte * 16
+  __m256i g = _mm256_or_si256(_mm256_shuffle_epi8(tableLo, _mm256_and_si256(k, nibble)),
+                              _mm256_shuffle_epi8(tableHi, _mm256_and_si256(_mm256_srli_epi16(k, 4), nibble)));
+  xWords = _mm256_maddubs_epi16(_mm256_and_si256(g, nibble), weights);
+  yWords = _mm256_maddubs_epi16(_mm256_and_si256(_mm256_srli_epi16(g, 4), nibble), weights);
+}
+
+AVX2 void morton_decode_2d_avx2(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n)
+{
+  const __m256i tableLo = nibbleTable(gatherLow);
+  const __m256i tableHi = nibbleTable(gatherHigh);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i xa, ya, xb, yb;
+    gatherWords(_mm256_loadu_si256((const __m256i *)(keys + i)), tableLo, tableHi, xa, ya);
+    gatherWords(_mm256_loadu_si256((const __m256i *)(keys + i + 4)), tableLo, tableHi, xb, yb);
+    // packus per lane: x0 x1 x4 x5 | x2 x3 x6 x7, put 64 bit pairs back in order
+    __m256i vx = _mm256_permute4x64_epi64(_mm256_packus_epi16(xa, xb), _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i vy = _mm256_permute4x64_epi64(_mm256_packus_epi16(ya, yb), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i *)(x + i), vx);
+    _mm256_storeu_si256((__m256i *)(y + i), vy);
+  }
+  decode2D(keys + i, x + i, y + i, n - i, mortonDecode2DMagic);
+}
+
+// mortonSpread3 / mortonCompact3 on 4 lanes
+AVX2_INLINE __m256i spread3(__m128i coords)
+{
+  __m256i v = _mm256_and_si256(_mm256_cvtepu32_epi64(coords), _mm256_set1_epi64x(0x1fffff));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi64(v, 32)), _mm256_set1_epi64x(0x001f00000000ffffULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi64(v, 16)), _mm256_set1_epi64x(0x001f0000ff0000ffULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi64(v, 8)), _mm256_set1_epi64x(0x100f00f00f00f00fULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi64(v, 4)), _mm256_set1_epi64x(0x10c30c30c30c30c3ULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi64(v, 2)), _mm256_set1_epi64x(0x1249249249249249ULL));
+  return v;
+}
+
+AVX2_INLINE __m128i compact3(__m256i v)
+{
+  v = _mm256_and_si256(v, _mm256_set1_epi64x(0x1249249249249249ULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 2)), _mm256_set1_epi64x(0x10c30c30c30c30c3ULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 4)), _mm256_set1_epi64x(0x100f00f00f00f00fULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 8)), _mm256_set1_epi64x(0x001f0000ff0000ffULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 16)), _mm256_set1_epi64x(0x001f00000000ffffULL));
+  v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi64(v, 32)), _mm256_set1_epi64x(0x1fffff));
+  // low 32 bits of the 4 lanes
+  return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+}
+
+AVX2 void morton_encode_3d_avx2(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256i k = spread3(_mm_loadu_si128((const __m128i *)(x + i)));
+    k = _mm256_or_si256(k, _mm256_slli_epi64(spread3(_mm_loadu_si128((const __m128i *)(y + i))), 1));
+    k = _mm256_or_si256(k, _mm256_slli_epi64(spread3(_mm_loadu_si128((const __m128i *)(z + i))), 2));
+    _mm256_storeu_si256((__m256i *)(keys + i), k);
+  }
+  encode3D(x + i, y + i, z + i, keys + i, n - i, mortonEncode3DMagic);
+}
+
+AVX2 void morton_decode_3d_avx2(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256i k = _mm256_loadu_si256((const __m256i *)(keys + i));
+    _mm_storeu_si128((__m128i *)(x + i), compact3(k));
+    _mm_storeu_si128((__m128i *)(y + i), compact3(_mm256_srli_epi64(k, 1)));
+    _mm_storeu_si128((__m128i *)(z + i), compact3(_mm256_srli_epi64(k, 2)));
+  }
+  decode3D(keys + i, x + i, y + i, z + i, n - i, mortonDecode3DMagic);
+}
+
+#undef AVX2
+#undef AVX2_INLINE
+
+// ---------------- dispatch ----------------
+
+typedef void (*Encode2DFn)(const uint32_t *, const uint32_t *, uint64_t *, size_t);
+typedef void (*Decode2DFn)(const uint64_t *, uint32_t *, uint32_t *, size_t);
+typedef void (*Encode3DFn)(const uint32_t *, const uint32_t *, const uint32_t *, uint64_t *, size_t);
+typedef void (*Decode3DFn)(const uint64_t *, uint32_t *, uint32_t *, uint32_t *, size_t);
+
+// pdep/pext usable: BMI2 and not microcoded (AMD before Zen 3). Called from ifunc resolvers, so no global data
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE bool fastPdep()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2");
+}
+
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE bool hasAvx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+// 2D: byte lookups beat one pdep per coordinate. 3D: pdep beats magic numbers, even on 4 lanes
+IFUNC_RESOLVER Encode2DFn resolveEncode2D()
+{
+  return hasAvx2() ? morton_encode_2d_avx2 : (fastPdep() ? morton_encode_2d_bmi2 : morton_encode_2d_generic);
+}
+
+IFUNC_RESOLVER Decode2DFn resolveDecode2D()
+{
+  return hasAvx2() ? morton_decode_2d_avx2 : (fastPdep() ? morton_decode_2d_bmi2 : morton_decode_2d_generic);
+}
+
+IFUNC_RESOLVER Encode3DFn resolveEncode3D()
+{
+  return fastPdep() ? morton_encode_3d_bmi2 : (hasAvx2() ? morton_encode_3d_avx2 : morton_encode_3d_generic);
+}
+
+IFUNC_RESOLVER Decode3DFn resolveDecode3D()
+{
+  return fastPdep() ? morton_decode_3d_bmi2 : (hasAvx2() ? morton_decode_3d_avx2 : morton_decode_3d_generic);
+}
+
+#if defined(__ELF__)
+void morton_encode_2d(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n)
+    __attribute__((ifunc("resolveEncode2D")));
+void morton_decode_2d(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n)
+    __attribute__((ifunc("resolveDecode2D")));
+void morton_encode_3d(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys, size_t n)
+    __attribute__((ifunc("resolveEncode3D")));
+void morton_decode_3d(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n)
+    __attribute__((ifunc("resolveDecode3D")));
+#else
+static Encode2DFn encode2DImpl = resolveEncode2D();
+static Decode2DFn decode2DImpl = resolveDecode2D();
+static Encode3DFn encode3DImpl = resolveEncode3D();
+static Decode3DFn decode3DImpl = resolveDecode3D();
+
+void morton_encode_2d(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n)
+{
+  encode2DImpl(x, y, keys, n);
+}
+
+void morton_decode_2d(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n)
+{
+  decode2DImpl(keys, x, y, n);
+}
+
+void morton_encode_3d(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys, size_t n)
+{
+  encode3DImpl(x, y, z, keys, n);
+}
+
+void morton_decode_3d(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n)
+{
+  decode3DImpl(keys, x, y, z, n);
+}
+#endif
+
+const char *morton_isa()
+{
+  return hasAvx2() ? "avx2" : (fastPdep() ? "bmi2" : "generic");
+}
+
+#else
+
+void morton_encode_2d(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n)
+{
+  morton_encode_2d_generic(x, y, keys, n);
+}
+
+void morton_decode_2d(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n)
+{
+  morton_decode_2d_generic(keys, x, y, n);
+}
+
+void morton_encode_3d(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys, size_t n)
+{
+  morton_encode_3d_generic(x, y, z, keys, n);
+}
+
+void morton_decode_3d(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n)
+{
+  morton_decode_3d_generic(keys, x, y, z, n);
+}
+
+const char *morton_isa()
+{
+  return "generic";
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef __MORTON_H
+#define __MORTON_H
+
+// Morton (Z-order) keys: bits of the coordinates interleaved, x in bit 0, y in bit 1 (, z in bit 2), ...
+// Points close in 2D/3D mostly get close keys, so sorting or tiling by key keeps neighbours together.
+//   2D: two 32 bit coordinates -> 64 bit key
+//   3D: three 21 bit coordinates -> 63 bit key (higher coordinate bits are ignored)
+//
+// Single keys (inline, this header):
+//   magic numbers: spread the bits of a coordinate apart in log2(bits) shift/or/and steps, like
+//   interleaveBitsByMagicNumber of binary_hacks.cpp but for 64 bit keys, and the reverse steps to decode.
+//   constexpr, any CPU.
+//   pdep/pext (BMI2): deposit the coordinate bits into the positions of a mask in one instruction, and
+//   extract them back. 1 cycle on Intel since Haswell and on AMD Zen 3, but microcoded (~20-250 cycles,
+//   depending on the mask) on Zen 1/2.
+//   mortonEncode2D etc. use pdep/pext when compiled with BMI2 (-mbmi2, -march=haswell or native), else
+//   magic numbers. ...Magic and ...Pdep variants name one method explicitly.
+// Batches of coordinate arrays (morton.cpp): picked at load time between AVX2, BMI2 and generic versions.
+
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define MORTON_MASK_2D_X 0x5555555555555555ULL
+#define MORTON_MASK_2D_Y 0xAAAAAAAAAAAAAAAAULL
+#define MORTON_MASK_3D_X 0x1249249249249249ULL
+#define MORTON_MASK_3D_Y 0x2492492492492492ULL
+#define MORTON_MASK_3D_Z 0x4924924924924924ULL
+#define MORTON_BITS_3D 21
+
+// ---------------- magic numbers ----------------
+
+// bit i of x to bit 2i
+static constexpr inline uint64_t mortonSpread2(uint64_t x)
+{
+  x &= 0xffffffffULL;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+  x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+  x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x << 2)) & 0x3333333333333333ULL;
+  x = (x | (x << 1)) & 0x5555555555555555ULL;
+  return x;
+}
+
+// bit 2i of x to bit i
+static constexpr inline uint32_t mortonCompact2(uint64_t x)
+{
+  x &= 0x5555555555555555ULL;
+  x = (x | (x >> 1)) & 0x3333333333333333ULL;
+  x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+  x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+  x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+  return (uint32_t)x;
+}
+
+// bit i of x (i < 21) to bit 3i
+static constexpr inline uint64_t mortonSpread3(uint64_t x)
+{
+  x &= 0x1fffffULL;
+  x = (x | (x << 32)) & 0x001f00000000ffffULL;
+  x = (x | (x << 16)) & 0x001f0000ff0000ffULL;
+  x = (x | (x << 8)) & 0x100f00f00f00f00fULL;
+  x = (x | (x << 4)) & 0x10c30c30c30c30c3ULL;
+  x = (x | (x << 2)) & 0x1249249249249249ULL;
+  return x;
+}
+
+static constexpr inline uint32_t mortonCompact3(uint64_t x)
+{
+  x &= 0x1249249249249249ULL;
+  x = (x | (x >> 2)) & 0x10c30c30c30c30c3ULL;
+  x = (x | (x >> 4)) & 0x100f00f00f00f00fULL;
+  x = (x | (x >> 8)) & 0x001f0000ff0000ffULL;
+  x = (x | (x >> 16)) & 0x001f00000000ffffULL;
+  x = (x | (x >> 32)) & 0x1fffffULL;
+  return (uint32_t)x;
+}
+
+static constexpr inline uint64_t mortonEncode2DMagic(uint32_t x, uint32_t y)
+{
+  return mortonSpread2(x) | (mortonSpread2(y) << 1);
+}
+
+static inline void mortonDecode2DMagic(uint64_t key, uint32_t *x, uint32_t *y)
+{
+  *x = mortonCompact2(key);
+  *y = mortonCompact2(key >> 1);
+}
+
+static constexpr inline uint64_t mortonEncode3DMagic(uint32_t x, uint32_t y, uint32_t z)
+{
+  return mortonSpread3(x) | (mortonSpread3(y) << 1) | (mortonSpread3(z) << 2);
+}
+
+static inline void mortonDecode3DMagic(uint64_t key, uint32_t *x, uint32_t *y, uint32_t *z)
+{
+  *x = mortonCompact3(key);
+  *y = mortonCompact3(key >> 1);
+  *z = mortonCompact3(key >> 2);
+}
+
+// ---------------- pdep / pext ----------------
+
+#if defined(__x86_64__)
+#define MORTON_BMI2 __attribute__((target("bmi2")))
+
+MORTON_BMI2 static inline uint64_t mortonEncode2DPdep(uint32_t x, uint32_t y)
+{
+  return _pdep_u64(x, MORTON_MASK_2D_X) | _pdep_u64(y, MORTON_MASK_2D_Y);
+}
+
+MORTON_BMI2 static inline void mortonDecode2DPdep(uint64_t key, uint32_t *x, uint32_t *y)
+{
+  *x = (uint32_t)_pext_u64(key, MORTON_MASK_2D_X);
+  *y = (uint32_t)_pext_u64(key, MORTON_MASK_2D_Y);
+}
+
+MORTON_BMI2 static inline uint64_t mortonEncode3DPdep(uint32_t x, uint32_t y, uint32_t z)
+{
+  return _pdep_u64(x, MORTON_MASK_3D_X) | _pdep_u64(y, MORTON_MASK_3D_Y) | _pdep_u64(z, MORTON_MASK_3D_Z);
+}
+
+MORTON_BMI2 static inline void mortonDecode3DPdep(uint64_t key, uint32_t *x, uint32_t *y, uint32_t *z)
+{
+  *x = (uint32_t)_pext_u64(key, MORTON_MASK_3D_X);
+  *y = (uint32_t)_pext_u64(key, MORTON_MASK_3D_Y);
+  *z = (uint32_t)_pext_u64(key, MORTON_MASK_3D_Z);
+}
+#undef MORTON_BMI2
+#endif
+
+// ---------------- best for the build target ----------------
+
+#if defined(__BMI2__)
+static inline uint64_t mortonEncode2D(uint32_t x, uint32_t y)
+{
+  return mortonEncode2DPdep(x, y);
+}
+
+static inline void mortonDecode2D(uint64_t key, uint32_t *x, uint32_t *y)
+{
+  mortonDecode2DPdep(key, x, y);
+}
+
+static inline uint64_t mortonEncode3D(uint32_t x, uint32_t y, uint32_t z)
+{
+  return mortonEncode3DPdep(x, y, z);
+}
+
+static inline void mortonDecode3D(uint64_t key, uint32_t *x, uint32_t *y, uint32_t *z)
+{
+  mortonDecode3DPdep(key, x, y, z);
+}
+#else
+static inline uint64_t mortonEncode2D(uint32_t x, uint32_t y)
+{
+  return mortonEncode2DMagic(x, y);
+}
+
+static inline void mortonDecode2D(uint64_t key, uint32_t *x, uint32_t *y)
+{
+  mortonDecode2DMagic(key, x, y);
+}
+
+static inline uint64_t mortonEncode3D(uint32_t x, uint32_t y, uint32_t z)
+{
+  return mortonEncode3DMagic(x, y, z);
+}
+
+static inline void mortonDecode3D(uint64_t key, uint32_t *x, uint32_t *y, uint32_t *z)
+{
+  mortonDecode3DMagic(key, x, y, z);
+}
+#endif
+
+// ---------------- batches (morton.cpp) ----------------
+
+// keys[i] from x[i], y[i] (, z[i]). Coordinates as separate arrays (structure of arrays, see soa.h)
+void morton_encode_2d(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n);
+void morton_decode_2d(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n);
+void morton_encode_3d(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys, size_t n);
+void morton_decode_3d(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n);
+const char *morton_isa(); // of encode 2d
+
+#if defined(__x86_64__)
+// individual variants, for benchmarking. Caller must check cpu support (__builtin_cpu_supports)
+void morton_encode_2d_avx2(const uint32_t *x, const uint32_t *y, uint64_t *keys, size_t n);
+void morton_decode_2d_avx2(const uint64_t *keys, uint32_t *x, uint32_t *y, size_t n);
+void morton_encode_3d_avx2(const uint32_t *x, const uint32_t *y, const uint32_t *z, uint64_t *keys, size_t n);
+void morton_decode_3d_avx2(const uint64_t *keys, uint32_t *x, uint32_t *y, uint32_t *z, size_t n);
+#endif
+
+#endif
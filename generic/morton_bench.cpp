@@ -0,0 +1,237 @@
+// Check and benchmark of morton.h / morton.cpp against interleaveBits and interleaveBitsByMagicNumber of
+// binary_hacks.h.
+// Checks: magic, pdep and batch versions agree with a bit by bit reference on random and edge coordinates,
+// decode(encode(x)) == x, at every batch length up to 40 (vector body + scalar tail).
+// Benchmark: ns per key over NUM_KEYS coordinates (in L2), 2D with 16 bit coordinates so the binary_hacks
+// versions can take part, then 2D 32 bit and 3D 21 bit.
+//
+// Typical result (1 core VM, AVX-512 capable Intel, g++ -O2), ns per key:
+//   2D 16 bit encode: interleaveBits loop ~22, interleaveBitsByMagicNumber ~2.8, dispatched batch ~0.35
+//   2D 32 bit encode: magic ~2.4, pdep ~1.5, AVX2 batch ~0.3     decode: magic ~2.3, pext ~1.5, AVX2 ~0.5
+//   3D 21 bit encode: magic ~5.3, pdep ~1.7, AVX2 batch ~2.0     decode: magic ~3.5, pext ~2.3, AVX2 ~1.9
+//   3D batch with pdep/pext: encode ~1.2, decode ~1.6
+// vpshufb nibble lookup handles 8 keys in ~20 instructions, 3-5x faster than pdep per coordinate.
+// In 3D the vector version has to fall back to magic numbers and loses to the pdep loop, so dispatch keeps
+// pdep there (and AVX2 on AMD Zen 1/2, where pdep is microcoded).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "binary_hacks.h"
+#include "morton.h"
+#include "bench.h"
+
+#define NUM_KEYS 16384
+#define ROUNDS 200
+#define CHECK_MAX_BATCH 40
+
+// bit by bit reference, dims coordinates
+static uint64_t refEncode(const uint32_t *c, int dims, int bits)
+{
+  uint64_t key = 0;
+  for (int b = 0; b < bits; b++)
+  {
+    for (int d = 0; d < dims; d++)
+      key |= (uint64_t)((c[d] >> b) & 1) << (b * dims + d);
+  }
+  return key;
+}
+
+static uint64_t rnd = 88172645463325252ULL;
+
+static uint64_t nextRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+static uint32_t xs[NUM_KEYS], ys[NUM_KEYS], zs[NUM_KEYS];
+static uint32_t outX[NUM_KEYS], outY[NUM_KEYS], outZ[NUM_KEYS];
+static uint64_t keys[NUM_KEYS];
+
+static void fillCoordinates(int bits)
+{
+  uint32_t mask = bits == 32 ? ~0U : (1U << bits) - 1;
+  for (int i = 0; i < NUM_KEYS; i++)
+  {
+    xs[i] = (uint32_t)nextRandom() & mask;
+    ys[i] = (uint32_t)nextRandom() & mask;
+    zs[i] = (uint32_t)nextRandom() & mask;
+  }
+  xs[0] = ys[1] = zs[2] = mask; // all ones
+  xs[3] = ys[3] = zs[3] = 0;
+}
+
+static bool checkMorton()
+{
+  bool ok = true;
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  bool bmi2 = __builtin_cpu_supports("bmi2");
+  bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+  fillCoordinates(32);
+  for (int i = 0; i < NUM_KEYS && ok; i++)
+  {
+    uint32_t c[3] = {xs[i], ys[i], zs[i] & 0x1fffff};
+    uint32_t c3[3] = {xs[i] & 0x1fffff, ys[i] & 0x1fffff, zs[i] & 0x1fffff};
+    uint64_t k2 = refEncode(c, 2, 32);
+    uint64_t k3 = refEncode(c3, 3, MORTON_BITS_3D);
+    uint32_t x, y, z;
+    ok = mortonEncode2DMagic(xs[i], ys[i]) == k2 && mortonEncode3DMagic(xs[i], ys[i], zs[i]) == k3;
+    mortonDecode2DMagic(k2, &x, &y);
+    ok = ok && x == xs[i] && y == ys[i];
+    mortonDecode3DMagic(k3, &x, &y, &z);
+    ok = ok && x == c3[0] && y == c3[1] && z == c3[2];
+#if defined(__x86_64__)
+    if (bmi2)
+    {
+      ok = ok && mortonEncode2DPdep(xs[i], ys[i]) == k2 && mortonEncode3DPdep(xs[i], ys[i], zs[i]) == k3;
+      mortonDecode2DPdep(k2, &x, &y);
+      ok = ok && x == xs[i] && y == ys[i];
+      mortonDecode3DPdep(k3, &x, &y, &z);
+      ok = ok && x == c3[0] && y == c3[1] && z == c3[2];
+    }
+#endif
+    ok = ok && interleaveBits((uint16_t)xs[i], (uint16_t)ys[i]) == (uint32_t)mortonEncode2D(xs[i] & 0xffff, ys[i] & 0xffff);
+    ok = ok && interleaveBitsByMagicNumber(xs[i] & 0xffff, ys[i] & 0xffff) == (uint32_t)mortonEncode2D(xs[i] & 0xffff, ys[i] & 0xffff);
+  }
+  if (!ok)
+    printf("single key Morton encode/decode FAILED\n");
+
+  // batches of every length, dispatched and AVX2 kernels
+  for (int n = 0; n <= CHECK_MAX_BATCH && ok; n++)
+  {
+    for (int variant = 0; variant < 2 && ok; variant++)
+    {
+#if defined(__x86_64__)
+      if (variant == 1 && !avx2)
+        break;
+      auto enc2 = variant ? morton_encode_2d_avx2 : morton_encode_2d;
+      auto dec2 = variant ? morton_decode_2d_avx2 : morton_decode_2d;
+      auto enc3 = variant ? morton_encode_3d_avx2 : morton_encode_3d;
+      auto dec3 = variant ? morton_decode_3d_avx2 : morton_decode_3d;
+#else
+      if (variant == 1)
+        break;
+      auto enc2 = morton_encode_2d;
+      auto dec2 = morton_decode_2d;
+      auto enc3 = morton_encode_3d;
+      auto dec3 = morton_decode_3d;
+#endif
+      keys[n] = outX[n] = outY[n] = outZ[n] = 0xdead; // guard
+      enc2(xs, ys, keys, n);
+      for (int i = 0; i < n; i++)
+        ok = ok && keys[i] == mortonEncode2DMagic(xs[i], ys[i]);
+      dec2(keys, outX, outY, n);
+      for (int i = 0; i < n; i++)
+        ok = ok && outX[i] == xs[i] && outY[i] == ys[i];
+      enc3(xs, ys, zs, keys, n);
+      for (int i = 0; i < n; i++)
+        ok = ok && keys[i] == mortonEncode3DMagic(xs[i], ys[i], zs[i]);
+      dec3(keys, outX, outY, outZ, n);
+      for (int i = 0; i < n; i++)
+        ok = ok && outX[i] == (xs[i] & 0x1fffff) && outY[i] == (ys[i] & 0x1fffff) && outZ[i] == (zs[i] & 0x1fffff);
+      ok = ok && keys[n] == 0xdead && outX[n] == 0xdead && outY[n] == 0xdead && outZ[n] == 0xdead;
+      if (!ok)
+        printf("Morton batch %s FAILED: n %d\n", variant ? "avx2" : "dispatched", n);
+    }
+  }
+  return ok;
+}
+
+// best ns per key of fn() over ROUNDS
+template <typename Fn>
+static double nsPerKey(Fn fn)
+{
+  double best = 1e9;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    fn();
+    clobberMemory();
+    double ns = (double)(nowNs() - t0) / NUM_KEYS;
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+int main_morton_bench()
+{
+  printf("Morton batches dispatched to %s\n", morton_isa());
+  if (!checkMorton())
+    return 1;
+  printf("magic, pdep/pext and batch versions verified\n\n");
+
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  bool bmi2 = __builtin_cpu_supports("bmi2");
+  bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+  // the keys[i] stores keep the loops from being optimized away
+  fillCoordinates(16);
+  printf("ns per key, 2D encode of 16 bit coordinates\n");
+  printf("%16s %16s %16s\n", "interleaveBits", "magic (16 bit)", "dispatched batch");
+  printf("%16.2f", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) keys[i] = interleaveBits(xs[i], ys[i]); }));
+  printf(" %16.2f", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) keys[i] = interleaveBitsByMagicNumber(xs[i], ys[i]); }));
+  printf(" %16.2f\n", nsPerKey([] { morton_encode_2d(xs, ys, keys, NUM_KEYS); }));
+
+  printf("\nns per key %19s %8s %8s %8s\n", "magic", "pdep", "avx2", "batch");
+  fillCoordinates(32);
+  printf("%-20s %8.2f", "2D encode", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) keys[i] = mortonEncode2DMagic(xs[i], ys[i]); }));
+#if defined(__x86_64__)
+  if (bmi2)
+    printf(" %8.2f", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) keys[i] = mortonEncode2DPdep(xs[i], ys[i]); }));
+  else
+    printf(" %8s", "-");
+  if (avx2)
+    printf(" %8.2f", nsPerKey([] { morton_encode_2d_avx2(xs, ys, keys, NUM_KEYS); }));
+  else
+    printf(" %8s", "-");
+#endif
+  printf(" %8.2f\n", nsPerKey([] { morton_encode_2d(xs, ys, keys, NUM_KEYS); }));
+
+  printf("%-20s %8.2f", "2D decode", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) mortonDecode2DMagic(keys[i], outX + i, outY + i); }));
+#if defined(__x86_64__)
+  if (bmi2)
+    printf(" %8.2f", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) mortonDecode2DPdep(keys[i], outX + i, outY + i); }));
+  else
+    printf(" %8s", "-");
+  if (avx2)
+    printf(" %8.2f", nsPerKey([] { morton_decode_2d_avx2(keys, outX, outY, NUM_KEYS); }));
+  else
+    printf(" %8s", "-");
+#endif
+  printf(" %8.2f\n", nsPerKey([] { morton_decode_2d(keys, outX, outY, NUM_KEYS); }));
+
+  fillCoordinates(MORTON_BITS_3D);
+  printf("%-20s %8.2f", "3D encode", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) keys[i] = mortonEncode3DMagic(xs[i], ys[i], zs[i]); }));
+#if defined(__x86_64__)
+  if (bmi2)
+    printf(" %8.2f", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) keys[i] = mortonEncode3DPdep(xs[i], ys[i], zs[i]); }));
+  else
+    printf(" %8s", "-");
+  if (avx2)
+    printf(" %8.2f", nsPerKey([] { morton_encode_3d_avx2(xs, ys, zs, keys, NUM_KEYS); }));
+  else
+    printf(" %8s", "-");
+#endif
+  printf(" %8.2f\n", nsPerKey([] { morton_encode_3d(xs, ys, zs, keys, NUM_KEYS); }));
+
+  printf("%-20s %8.2f", "3D decode", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) mortonDecode3DMagic(keys[i], outX + i, outY + i, outZ + i); }));
+#if defined(__x86_64__)
+  if (bmi2)
+    printf(" %8.2f", nsPerKey([] { for (int i = 0; i < NUM_KEYS; i++) mortonDecode3DPdep(keys[i], outX + i, outY + i, outZ + i); }));
+  else
+    printf(" %8s", "-");
+  if (avx2)
+    printf(" %8.2f", nsPerKey([] { morton_decode_3d_avx2(keys, outX, outY, outZ, NUM_KEYS); }));
+  else
+    printf(" %8s", "-");
+#endif
+  printf(" %8.2f\n", nsPerKey([] { morton_decode_3d(keys, outX, outY, outZ, NUM_KEYS); }));
+  return 0;
+}
@@ -0,0 +1,380 @@
+// Multi threaded copy for hundreds of MB and more.
+//
+// One core can't saturate memory bandwidth: it is limited by how many cache misses it can keep in flight
+// (line fill buffers), not by the memory controllers. Several cores copying disjoint parts add up until
+// controllers (or the socket interconnect) are the limit.
+//
+// Copy is split into page aligned chunks (boundaries are page aligned in destination, so every chunk's
+// streaming stores cover whole pages and a chunk never shares a page with another chunk).
+// A pool of workers, one pinned to each cpu, copies chunks with non temporal stores (simd_memcpy_mode
+// COPY_STREAMING): the destination isn't read before being written and doesn't evict anyone's cache.
+//
+// NUMA: chunks are queued per node. Node of a chunk is the node holding its destination page; if
+// destination isn't faulted in yet, node of its source page (then the worker's first touch places the
+// destination page on that same node, and both read and write stay local). Workers take chunks of
+// their own node first and steal from other nodes only when their node has none left.
+// Topology comes from /sys/devices/system/node and page placement from move_pages(2) without target
+// nodes (which only reports, moves nothing), so no libnuma is needed. Single node machines skip all of it.
+//
+// Async: parallel_memcpy_async() queues the copy and returns a handle right away. Caller does other work,
+// may poll parallel_copy_done() and finally calls parallel_copy_wait(), which copies remaining chunks on
+// the calling thread too (no point in sleeping while there is work left), then blocks for chunks still
+// in progress on workers and frees the handle.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include "mem_operation.h"
+
+#define COPY_PAGE_SIZE 4096
+#define PARALLEL_MIN_SIZE (8 << 20) // below this caller copies alone: thread handoff costs more than it saves
+#define CHUNK_MIN_SIZE (1 << 20)
+#define CHUNKS_PER_WORKER 4 // more chunks than workers, so workers finishing early take over the rest
+#define MAX_WORKERS 256
+#define MAX_NODES 64
+#define NO_CHUNK SIZE_MAX
+
+typedef struct alignas(64)
+{
+  std::atomic<size_t> next; // next position in ParallelCopy::order, may run past end
+  size_t end;
+} NodeQueue;
+
+struct ParallelCopy
+{
+  uint8_t *dst;
+  const uint8_t *src;
+  size_t len;
+  uint8_t *base; // dst rounded down to page, chunk i starts at base + i * chunkSize
+  size_t chunkSize;
+  size_t numChunks;
+  size_t *order;     // chunk numbers grouped by node
+  NodeQueue *queues; // one per node, ranges of order
+  int numQueues;
+  int maxWorkers;
+  // guarded by pool lock
+  int joined;          // workers that took part so far
+  int active;          // workers copying chunks right now
+  bool queued;         // in pool job list
+  ParallelCopy *next;  // pool job list
+  alignas(64) std::atomic<size_t> copied; // chunks finished
+};
+
+typedef struct
+{
+  pthread_t thread;
+  int cpu;
+  int node;
+} Worker;
+
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work;     // new job queued
+  pthread_cond_t finished; // a worker left a job
+  ParallelCopy *jobs;      // jobs with chunks left to claim
+  int numWorkers;
+  int numNodes;
+  int cpuNode[CPU_SETSIZE];
+  Worker workers[MAX_WORKERS];
+} pool;
+
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+
+// ---------------- NUMA topology ----------------
+
+// "0-3,8-11" list of /sys/devices/system/node/nodeN/cpulist
+static void parseCpuList(const char *list, int node)
+{
+  const char *p = list;
+  while (*p >= '0' && *p <= '9')
+  {
+    char *e;
+    long first = strtol(p, &e, 10);
+    long last = first;
+    if (*e == '-')
+      last = strtol(e + 1, &e, 10);
+    for (long c = first; c <= last && c < CPU_SETSIZE; c++)
+      pool.cpuNode[c] = node;
+    p = *e == ',' ? e + 1 : e;
+  }
+}
+
+static void detectNodes()
+{
+  pool.numNodes = 1;
+  for (int node = 0; node < MAX_NODES; node++)
+  {
+    char path[64];
+    char list[4096];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (!f)
+      continue;
+    if (fgets(list, sizeof(list), f))
+      parseCpuList(list, node);
+    fclose(f);
+    if (node + 1 > pool.numNodes)
+      pool.numNodes = node + 1;
+  }
+}
+
+// node of each page, -1 if not faulted in (or unknown). move_pages with nodes == NULL only reports
+static void pageNodes(const void **pages, size_t count, int *nodes)
+{
+  if (syscall(SYS_move_pages, 0, count, pages, NULL, nodes, 0) != 0)
+  {
+    for (size_t i = 0; i < count; i++)
+      nodes[i] = -1;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    if (nodes[i] < 0 || nodes[i] >= pool.numNodes)
+      nodes[i] = -1;
+  }
+}
+
+static int currentNode()
+{
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || (int)node >= pool.numNodes)
+    return 0;
+  return node;
+}
+
+// ---------------- chunks ----------------
+
+static size_t claimChunk(ParallelCopy *job, int node)
+{
+  for (int i = 0; i < job->numQueues; i++)
+  {
+    NodeQueue *q = &job->queues[(node + i) % job->numQueues];
+    if (q->next.load(std::memory_order_relaxed) >= q->end)
+      continue;
+    size_t pos = q->next.fetch_add(1, std::memory_order_relaxed);
+    if (pos < q->end)
+      return job->order[pos];
+  }
+  return NO_CHUNK;
+}
+
+static void copyChunk(ParallelCopy *job, size_t chunk)
+{
+  uint8_t *end = job->dst + job->len;
+  uint8_t *from = job->base + chunk * job->chunkSize;
+  uint8_t *to = from + job->chunkSize;
+  if (from < job->dst)
+    from = job->dst;
+  if (to > end)
+    to = end;
+  // ends with sfence: stores are globally visible before the release below
+  simd_memcpy_mode(from, job->src + (from - job->dst), to - from, COPY_STREAMING);
+  job->copied.fetch_add(1, std::memory_order_release);
+}
+
+// group chunks by node of destination page (source page if destination isn't there yet)
+static void assignNodes(ParallelCopy *job)
+{
+  int numQueues = pool.numNodes;
+  job->numQueues = numQueues;
+  job->queues = new NodeQueue[numQueues];
+  job->order = (size_t *)malloc(job->numChunks * sizeof(size_t));
+  int *node = (int *)malloc(job->numChunks * sizeof(int));
+  if (numQueues == 1)
+  {
+    memset(node, 0, job->numChunks * sizeof(int));
+  }
+  else
+  {
+    const void **pages = (const void **)malloc(2 * job->numChunks * sizeof(void *));
+    int *found = (int *)malloc(2 * job->numChunks * sizeof(int));
+    for (size_t i = 0; i < job->numChunks; i++)
+    {
+      uint8_t *d = job->base + i * job->chunkSize;
+      if (d < job->dst)
+        d = job->dst;
+      pages[i] = d;
+      pages[job->numChunks + i] = job->src + (d - job->dst);
+    }
+    pageNodes(pages, 2 * job->numChunks, found);
+    for (size_t i = 0; i < job->numChunks; i++)
+    {
+      node[i] = found[i] >= 0 ? found[i] : found[job->numChunks + i];
+      if (node[i] < 0)
+        node[i] = 0;
+    }
+    free(pages);
+    free(found);
+  }
+  // chunks of node 0 first, then node 1...
+  size_t pos = 0;
+  for (int n = 0; n < numQueues; n++)
+  {
+    job->queues[n].next.store(pos, std::memory_order_relaxed);
+    for (size_t i = 0; i < job->numChunks; i++)
+    {
+      if (node[i] == n)
+        job->order[pos++] = i;
+    }
+    job->queues[n].end = pos;
+  }
+  free(node);
+}
+
+// ---------------- worker pool ----------------
+
+static void unlinkJob(ParallelCopy *job)
+{
+  if (!job->queued)
+    return;
+  ParallelCopy **p = &pool.jobs;
+  while (*p != job)
+    p = &(*p)->next;
+  *p = job->next;
+  job->queued = false;
+}
+
+static void *workerLoop(void *arg)
+{
+  Worker *self = (Worker *)arg;
+  pthread_mutex_lock(&pool.lock);
+  for (;;)
+  {
+    ParallelCopy *job = pool.jobs;
+    while (job && job->joined >= job->maxWorkers)
+      job = job->next;
+    if (!job)
+    {
+      pthread_cond_wait(&pool.work, &pool.lock);
+      continue;
+    }
+    job->joined++;
+    job->active++;
+    pthread_mutex_unlock(&pool.lock);
+
+    size_t chunk;
+    while ((chunk = claimChunk(job, self->node)) != NO_CHUNK)
+      copyChunk(job, chunk);
+
+    pthread_mutex_lock(&pool.lock);
+    unlinkJob(job); // nothing left to claim
+    if (--job->active == 0)
+      pthread_cond_broadcast(&pool.finished);
+  }
+  return NULL;
+}
+
+// one worker per cpu the process may run on, pinned. Workers stay blocked on condition variable when idle
+// and live till process exit
+static void startPool()
+{
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.work, NULL);
+  pthread_cond_init(&pool.finished, NULL);
+  detectNodes();
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    CPU_SET(0, &allowed);
+  for (int cpu = 0; cpu < CPU_SETSIZE && pool.numWorkers < MAX_WORKERS; cpu++)
+  {
+    if (!CPU_ISSET(cpu, &allowed))
+      continue;
+    Worker *w = &pool.workers[pool.numWorkers];
+    w->cpu = cpu;
+    w->node = pool.cpuNode[cpu];
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(one), &one); // pinned from the first instruction
+    int err = pthread_create(&w->thread, &attr, workerLoop, w);
+    pthread_attr_destroy(&attr);
+    if (err)
+      break;
+    pool.numWorkers++;
+  }
+}
+
+// ---------------- API ----------------
+
+int parallel_copy_workers()
+{
+  pthread_once(&poolOnce, startPool);
+  return pool.numWorkers;
+}
+
+ParallelCopy *parallel_memcpy_async(void *__restrict dst, const void *__restrict src, size_t len, int threads)
+{
+  pthread_once(&poolOnce, startPool);
+  ParallelCopy *job = new ParallelCopy();
+  job->dst = (uint8_t *)dst;
+  job->src = (const uint8_t *)src;
+  job->len = len;
+  job->copied.store(0, std::memory_order_relaxed);
+  if (len < PARALLEL_MIN_SIZE || pool.numWorkers == 0)
+  {
+    simd_memcpy(dst, src, len); // handle is complete on return
+    return job;
+  }
+
+  int workers = threads > 0 && threads < pool.numWorkers ? threads : pool.numWorkers;
+  size_t chunk = len / ((size_t)workers * CHUNKS_PER_WORKER);
+  chunk = (chunk + COPY_PAGE_SIZE - 1) & ~(size_t)(COPY_PAGE_SIZE - 1);
+  if (chunk < CHUNK_MIN_SIZE)
+    chunk = CHUNK_MIN_SIZE;
+  job->base = (uint8_t *)((uintptr_t)dst & ~(uintptr_t)(COPY_PAGE_SIZE - 1));
+  job->chunkSize = chunk;
+  job->numChunks = (job->dst + len - job->base + chunk - 1) / chunk;
+  job->maxWorkers = workers;
+  assignNodes(job);
+
+  pthread_mutex_lock(&pool.lock);
+  ParallelCopy **tail = &pool.jobs;
+  while (*tail)
+    tail = &(*tail)->next;
+  *tail = job;
+  job->queued = true;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.lock);
+  return job;
+}
+
+bool parallel_copy_done(const ParallelCopy *copy)
+{
+  return copy->copied.load(std::memory_order_acquire) == copy->numChunks;
+}
+
+void parallel_copy_wait(ParallelCopy *copy)
+{
+  if (copy->numChunks)
+  {
+    size_t chunk;
+    int node = currentNode();
+    while ((chunk = claimChunk(copy, node)) != NO_CHUNK)
+      copyChunk(copy, chunk);
+
+    pthread_mutex_lock(&pool.lock);
+    unlinkJob(copy); // no worker can join any more
+    while (copy->active)
+      pthread_cond_wait(&pool.finished, &pool.lock);
+    pthread_mutex_unlock(&pool.lock); // pairs with workers' unlock after their last chunk
+    delete[] copy->queues;
+    free(copy->order);
+  }
+  delete copy;
+}
+
+void *parallel_memcpy(void *__restrict dst, const void *__restrict src, size_t len, int threads)
+{
+  parallel_copy_wait(parallel_memcpy_async(dst, src, len, threads));
+  return dst;
+}
@@ -0,0 +1,382 @@
+// Population count of whole buffers, plain or after AND/OR/XOR with a second buffer, with runtime ISA
+// dispatch like simd_scan.cpp (GNU ifunc on x86-64 ELF).
+//
+// countSetBits/fastCountSetBits of binary_hacks.cpp loop over the bits of one word. For arrays:
+// - generic: SWAR on 64 bit words, adds bits in pairs, nibbles, bytes, then one multiply sums the 8 bytes
+//   (12 ops per word, what __builtin_popcountll compiles to without popcnt instruction)
+// - popcnt: 1 instruction per word. Intel before Cannon Lake wrongly waits for the old value of the
+//   destination register, four independent accumulators keep that false dependency out of the loop
+// - AVX2 has no vector popcount. vpshufb looks up the count of each nibble in a 16 entry table
+//   (count of byte = table[low nibble] + table[high nibble]), vpsadbw sums bytes into 64 bit lanes.
+//   Harley-Seal saves most of those lookups: 16 vectors go through a tree of carry save adders
+//   (full adders made of and/or/xor, one bit position per vector bit) giving ones, twos, fours, eights
+//   and sixteens. Only the sixteens vector is counted per 16 input vectors, the rest once at the end:
+//   total = 16 * sum(sixteens) + 8 * eights + 4 * fours + 2 * twos + ones
+// - AVX-512 VPOPCNTDQ: vpopcntq counts each 64 bit lane directly, masked load for the tail
+//
+// Combined counts (|a & b| etc.) combine each loaded vector with the one from b before counting, so an
+// intersection count reads both bitmaps once and writes nothing.
+
+#include <stdint.h>
+#include <string.h>
+#include "popcount.h"
+#include "simd_vec.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define WORD 8
+#define HARLEY_SEAL_BLOCK 16 // vectors per carry save adder tree
+
+// what is counted: bits of a, of a & b, a | b, a ^ b
+enum
+{
+  POP_ONE,
+  POP_AND,
+  POP_OR,
+  POP_XOR,
+};
+
+template <int OP>
+ALWAYS_INLINE uint64_t combine(uint64_t a, uint64_t b)
+{
+  if (OP == POP_AND)
+    return a & b;
+  if (OP == POP_OR)
+    return a | b;
+  if (OP == POP_XOR)
+    return a ^ b;
+  return a;
+}
+
+// ---------------- scalar ----------------
+
+ALWAYS_INLINE uint64_t popcountSwar(uint64_t x)
+{
+  x = x - ((x >> 1) & 0x5555555555555555ULL);                           // 2 bit counts
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL); // 4 bit counts
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;                           // byte counts
+  return (x * 0x0101010101010101ULL) >> 56;                             // sum of bytes lands in top byte
+}
+
+// HW: __builtin_popcountll, a single instruction when inlined into target("popcnt") or on ARM
+template <int OP, bool HW>
+ALWAYS_INLINE uint64_t popcountWord(const uint8_t *a, const uint8_t *b)
+{
+  uint64_t w = combine<OP>(loadScalar<uint64_t>(a), OP == POP_ONE ? 0 : loadScalar<uint64_t>(b));
+  return HW ? (uint64_t)__builtin_popcountll(w) : popcountSwar(w);
+}
+
+template <int OP, bool HW>
+ALWAYS_INLINE uint64_t countScalar(const uint8_t *a, const uint8_t *b, size_t len)
+{
+  uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+  size_t i = 0;
+  for (; i + 4 * WORD <= len; i += 4 * WORD)
+  {
+    c0 += popcountWord<OP, HW>(a + i, b + i);
+    c1 += popcountWord<OP, HW>(a + i + WORD, b + i + WORD);
+    c2 += popcountWord<OP, HW>(a + i + 2 * WORD, b + i + 2 * WORD);
+    c3 += popcountWord<OP, HW>(a + i + 3 * WORD, b + i + 3 * WORD);
+  }
+  for (; i + WORD <= len; i += WORD)
+    c0 += popcountWord<OP, HW>(a + i, b + i);
+  if (i < len)
+  {
+    // last bytes into zeroed words
+    uint8_t lastA[WORD] = {0}, lastB[WORD] = {0};
+    memcpy(lastA, a + i, len - i);
+    memcpy(lastB, b + i, len - i);
+    c0 += popcountWord<OP, HW>(lastA, lastB);
+  }
+  return c0 + c1 + c2 + c3;
+}
+
+#if defined(__x86_64__)
+
+// ---------------- AVX2 Harley-Seal ----------------
+
+#define AVX2_INLINE __attribute__((target("avx2,popcnt"), always_inline)) inline
+
+template <int OP>
+AVX2_INLINE __m256i loadAvx2(const uint8_t *a, const uint8_t *b)
+{
+  __m256i x = _mm256_loadu_si256((const __m256i *)a);
+  if (OP == POP_ONE)
+    return x;
+  __m256i y = _mm256_loadu_si256((const __m256i *)b);
+  if (OP == POP_AND)
+    return _mm256_and_si256(x, y);
+  if (OP == POP_OR)
+    return _mm256_or_si256(x, y);
+  return _mm256_xor_si256(x, y);
+}
+
+// bit counts of the 4 64 bit lanes
+AVX2_INLINE __m256i popcountLanesAvx2(__m256i v)
+{
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, // lookup works per
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4); // 16 byte lane
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+  __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+  return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+// carry save adder: per bit position, a + b + c = 2 * high + low
+AVX2_INLINE void csa(__m256i &high, __m256i &low, __m256i a, __m256i b, __m256i c)
+{
+  __m256i u = _mm256_xor_si256(a, b);
+  high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+  low = _mm256_xor_si256(u, c);
+}
+
+template <int OP>
+AVX2_INLINE uint64_t countAvx2(const uint8_t *a, const uint8_t *b, size_t len)
+{
+  const size_t W = 32;
+  __m256i total = _mm256_setzero_si256();
+  __m256i ones = total, twos = total, fours = total, eights = total;
+  __m256i twosA, twosB, foursA, foursB, eightsA, eightsB, sixteens;
+  size_t i = 0;
+  for (; i + HARLEY_SEAL_BLOCK * W <= len; i += HARLEY_SEAL_BLOCK * W)
+  {
+    const uint8_t *pa = a + i;
+    const uint8_t *pb = b + i;
+    csa(twosA, ones, ones, loadAvx2<OP>(pa, pb), loadAvx2<OP>(pa + W, pb + W));
+    csa(twosB, ones, ones, loadAvx2<OP>(pa + 2 * W, pb + 2 * W), loadAvx2<OP>(pa + 3 * W, pb + 3 * W));
+    csa(foursA, twos, twos, twosA, twosB);
+    csa(twosA, ones, ones, loadAvx2<OP>(pa + 4 * W, pb + 4 * W), loadAvx2<OP>(pa + 5 * W, pb + 5 * W));
+    csa(twosB, ones, ones, loadAvx2<OP>(pa + 6 * W, pb + 6 * W), loadAvx2<OP>(pa + 7 * W, pb + 7 * W));
+    csa(foursB, twos, twos, twosA, twosB);
+    csa(eightsA, fours, fours, foursA, foursB);
+    csa(twosA, ones, ones, loadAvx2<OP>(pa + 8 * W, pb + 8 * W), loadAvx2<OP>(pa + 9 * W, pb + 9 * W));
+    csa(twosB, ones, ones, loadAvx2<OP>(pa + 10 * W, pb + 10 * W), loadAvx2<OP>(pa + 11 * W, pb + 11 * W));
+    csa(foursA, twos, twos, twosA, twosB);
+    csa(twosA, ones, ones, loadAvx2<OP>(pa + 12 * W, pb + 12 * W), loadAvx2<OP>(pa + 13 * W, pb + 13 * W));
+    csa(twosB, ones, ones, loadAvx2<OP>(pa + 14 * W, pb + 14 * W), loadAvx2<OP>(pa + 15 * W, pb + 15 * W));
+    csa(foursB, twos, twos, twosA, twosB);
+    csa(eightsB, fours, fours, foursA, foursB);
+    csa(sixteens, eights, eights, eightsA, eightsB);
+    total = _mm256_add_epi64(total, popcountLanesAvx2(sixteens));
+  }
+  total = _mm256_slli_epi64(total, 4);
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(popcountLanesAvx2(eights), 3));
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(popcountLanesAvx2(fours), 2));
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(popcountLanesAvx2(twos), 1));
+  total = _mm256_add_epi64(total, popcountLanesAvx2(ones));
+  for (; i + W <= len; i += W)
+    total = _mm256_add_epi64(total, popcountLanesAvx2(loadAvx2<OP>(a + i, b + i)));
+
+  uint64_t count = (uint64_t)_mm256_extract_epi64(total, 0) + (uint64_t)_mm256_extract_epi64(total, 1) +
+                   (uint64_t)_mm256_extract_epi64(total, 2) + (uint64_t)_mm256_extract_epi64(total, 3);
+  return count + countScalar<OP, true>(a + i, b + i, len - i);
+}
+
+// ---------------- AVX-512 VPOPCNTQ ----------------
+
+#define AVX512_INLINE __attribute__((target("avx512bw,avx512vpopcntdq,popcnt"), always_inline)) inline
+
+// masked off bytes are not read (no fault) and are zero
+template <int OP>
+AVX512_INLINE __m512i loadAvx512(const uint8_t *a, const uint8_t *b, __mmask64 mask)
+{
+  __m512i x = _mm512_maskz_loadu_epi8(mask, a);
+  if (OP == POP_ONE)
+    return x;
+  __m512i y = _mm512_maskz_loadu_epi8(mask, b);
+  if (OP == POP_AND)
+    return _mm512_and_si512(x, y);
+  if (OP == POP_OR)
+    return _mm512_or_si512(x, y);
+  return _mm512_xor_si512(x, y);
+}
+
+template <int OP>
+AVX512_INLINE uint64_t countAvx512(const uint8_t *a, const uint8_t *b, size_t len)
+{
+  const size_t W = 64;
+  const __mmask64 all = ~0ULL;
+  // vpopcntq has 3 cycle latency: 4 accumulators keep one in flight per cycle
+  __m512i c0 = _mm512_setzero_si512(), c1 = c0, c2 = c0, c3 = c0;
+  size_t i = 0;
+  for (; i + 4 * W <= len; i += 4 * W)
+  {
+    c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(loadAvx512<OP>(a + i, b + i, all)));
+    c1 = _mm512_add_epi64(c1, _mm512_popcnt_epi64(loadAvx512<OP>(a + i + W, b + i + W, all)));
+    c2 = _mm512_add_epi64(c2, _mm512_popcnt_epi64(loadAvx512<OP>(a + i + 2 * W, b + i + 2 * W, all)));
+    c3 = _mm512_add_epi64(c3, _mm512_popcnt_epi64(loadAvx512<OP>(a + i + 3 * W, b + i + 3 * W, all)));
+  }
+  for (; i + W <= len; i += W)
+    c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(loadAvx512<OP>(a + i, b + i, all)));
+  if (i < len)
+  {
+    __mmask64 tail = (1ULL << (len - i)) - 1;
+    c1 = _mm512_add_epi64(c1, _mm512_popcnt_epi64(loadAvx512<OP>(a + i, b + i, tail)));
+  }
+  uint64_t lanes[8];
+  _mm512_storeu_si512(lanes, _mm512_add_epi64(_mm512_add_epi64(c0, c1), _mm512_add_epi64(c2, c3)));
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+// ---------------- per ISA entry points ----------------
+
+template <int OP>
+ALWAYS_INLINE uint64_t countGeneric(const uint8_t *a, const uint8_t *b, size_t len)
+{
+  return countScalar<OP, false>(a, b, len);
+}
+
+template <int OP>
+ALWAYS_INLINE uint64_t countPopcnt(const uint8_t *a, const uint8_t *b, size_t len)
+{
+  return countScalar<OP, true>(a, b, len);
+}
+
+// plain count (exported for benchmarking) and the combined counts of one ISA.
+// Plain count passes buf as b too, it is never read
+#define POPCOUNT_VARIANTS(isa, target, kernel)                                                                    \
+  target uint64_t popcount_##isa(const void *buf, size_t len)                                                     \
+  {                                                                                                               \
+    return kernel<POP_ONE>((const uint8_t *)buf, (const uint8_t *)buf, len);                                      \
+  }                                                                                                               \
+  target static uint64_t popcount_and_##isa(const void *a, const void *b, size_t len)                             \
+  {                                                                                                               \
+    return kernel<POP_AND>((const uint8_t *)a, (const uint8_t *)b, len);                                          \
+  }                                                                                                               \
+  target static uint64_t popcount_or_##isa(const void *a, const void *b, size_t len)                              \
+  {                                                                                                               \
+    return kernel<POP_OR>((const uint8_t *)a, (const uint8_t *)b, len);                                           \
+  }                                                                                                               \
+  target static uint64_t popcount_xor_##isa(const void *a, const void *b, size_t len)                             \
+  {                                                                                                               \
+    return kernel<POP_XOR>((const uint8_t *)a, (const uint8_t *)b, len);                                          \
+  }
+
+POPCOUNT_VARIANTS(generic, , countGeneric)
+POPCOUNT_VARIANTS(popcnt, __attribute__((target("popcnt"))), countPopcnt)
+POPCOUNT_VARIANTS(avx2, __attribute__((target("avx2,popcnt"))), countAvx2)
+POPCOUNT_VARIANTS(avx512, __attribute__((target("avx512bw,avx512vpopcntdq,popcnt"))), countAvx512)
+
+#undef POPCOUNT_VARIANTS
+
+// ---------------- dispatch ----------------
+
+typedef uint64_t (*PopcountFn)(const void *, size_t);
+typedef uint64_t (*PopcountPairFn)(const void *, const void *, size_t);
+
+// 0 generic, 1 popcnt, 2 avx2, 3 avx512 vpopcntq. Called from ifunc resolvers, so no global data
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE int popcountIsaLevel()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512bw"))
+    return 3;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    return 2;
+  if (__builtin_cpu_supports("popcnt"))
+    return 1;
+  return 0;
+}
+
+#define PICK_BY_LEVEL(name)                                                                                       \
+  switch (popcountIsaLevel())                                                                                     \
+  {                                                                                                               \
+  case 3:                                                                                                         \
+    return name##_avx512;                                                                                         \
+  case 2:                                                                                                         \
+    return name##_avx2;                                                                                           \
+  case 1:                                                                                                         \
+    return name##_popcnt;                                                                                         \
+  default:                                                                                                        \
+    return name##_generic;                                                                                        \
+  }
+
+IFUNC_RESOLVER PopcountFn resolvePopcount()
+{
+  PICK_BY_LEVEL(popcount)
+}
+
+IFUNC_RESOLVER PopcountPairFn resolvePopcountAnd()
+{
+  PICK_BY_LEVEL(popcount_and)
+}
+
+IFUNC_RESOLVER PopcountPairFn resolvePopcountOr()
+{
+  PICK_BY_LEVEL(popcount_or)
+}
+
+IFUNC_RESOLVER PopcountPairFn resolvePopcountXor()
+{
+  PICK_BY_LEVEL(popcount_xor)
+}
+
+#undef PICK_BY_LEVEL
+
+#if defined(__ELF__)
+uint64_t popcount_array(const void *buf, size_t len) __attribute__((ifunc("resolvePopcount")));
+uint64_t popcount_and(const void *a, const void *b, size_t len) __attribute__((ifunc("resolvePopcountAnd")));
+uint64_t popcount_or(const void *a, const void *b, size_t len) __attribute__((ifunc("resolvePopcountOr")));
+uint64_t popcount_xor(const void *a, const void *b, size_t len) __attribute__((ifunc("resolvePopcountXor")));
+#else
+static PopcountFn popcountImpl = resolvePopcount();
+static PopcountPairFn popcountAndImpl = resolvePopcountAnd();
+static PopcountPairFn popcountOrImpl = resolvePopcountOr();
+static PopcountPairFn popcountXorImpl = resolvePopcountXor();
+
+uint64_t popcount_array(const void *buf, size_t len)
+{
+  return popcountImpl(buf, len);
+}
+
+uint64_t popcount_and(const void *a, const void *b, size_t len)
+{
+  return popcountAndImpl(a, b, len);
+}
+
+uint64_t popcount_or(const void *a, const void *b, size_t len)
+{
+  return popcountOrImpl(a, b, len);
+}
+
+uint64_t popcount_xor(const void *a, const void *b, size_t len)
+{
+  return popcountXorImpl(a, b, len);
+}
+#endif
+
+const char *popcount_isa()
+{
+  static const char *const names[] = {"generic", "popcnt", "avx2", "avx512vpopcntdq"};
+  return names[popcountIsaLevel()];
+}
+
+#else
+
+// other architectures: __builtin_popcountll is the native instruction where there is one (cnt on ARM)
+uint64_t popcount_array(const void *buf, size_t len)
+{
+  return countScalar<POP_ONE, true>((const uint8_t *)buf, (const uint8_t *)buf, len);
+}
+
+uint64_t popcount_and(const void *a, const void *b, size_t len)
+{
+  return countScalar<POP_AND, true>((const uint8_t *)a, (const uint8_t *)b, len);
+}
+
+uint64_t popcount_or(const void *a, const void *b, size_t len)
+{
+  return countScalar<POP_OR, true>((const uint8_t *)a, (const uint8_t *)b, len);
+}
+
+uint64_t popcount_xor(const void *a, const void *b, size_t len)
+{
+  return countScalar<POP_XOR, true>((const uint8_t *)a, (const uint8_t *)b, len);
+}
+
+const char *popcount_isa()
+{
+  return "generic";
+}
+
+#endif
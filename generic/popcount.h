@@ -0,0 +1,25 @@
+#ifndef __POPCOUNT_H
+#define __POPCOUNT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// popcount.cpp: number of set bits in len bytes of memory (bitmaps, filters, page occupancy maps).
+// Widest available ISA is picked once at load time, like simd_memcpy: AVX-512 VPOPCNTQ, AVX2 Harley-Seal,
+// popcnt instruction, or portable SWAR. No alignment required
+uint64_t popcount_array(const void *buf, size_t len);
+// combined with a second bitmap of same length before counting, without writing the combination anywhere
+uint64_t popcount_and(const void *a, const void *b, size_t len); // intersection size
+uint64_t popcount_or(const void *a, const void *b, size_t len);  // union size
+uint64_t popcount_xor(const void *a, const void *b, size_t len); // hamming distance
+const char *popcount_isa();
+
+#if defined(__x86_64__)
+// individual variants, for benchmarking. Caller must check cpu support (__builtin_cpu_supports)
+uint64_t popcount_generic(const void *buf, size_t len);
+uint64_t popcount_popcnt(const void *buf, size_t len);
+uint64_t popcount_avx2(const void *buf, size_t len);
+uint64_t popcount_avx512(const void *buf, size_t len); // avx512bw + avx512vpopcntdq
+#endif
+
+#endif
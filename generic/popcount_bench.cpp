@@ -0,0 +1,217 @@
+// Check and benchmark of popcount.cpp.
+// Checks: every variant the cpu supports, plain and AND/OR/XOR, every size up to 600 bytes at every offset
+// in a cache line, against a bit by bit loop like countSetBits of binary_hacks.cpp. Then a last byte
+// flush against a PROT_NONE page, where the AVX-512 masked tail load must not fault.
+// Benchmark: GB/s of input (both bitmaps for AND/OR/XOR) from 1 KB in L1 to 64 MB in DRAM.
+//
+// Typical result (1 core VM, AVX-512 with VPOPCNTDQ, g++ -O2), GB/s:
+//   size      bit loop  generic  popcnt   avx2   avx512    and/or/xor (avx512, both inputs counted)
+//   1 KB      ~0.18     ~4       ~13      ~28    ~80       ~100
+//   16 KB               ~4       ~14      ~34    ~125      ~160
+//   256 KB              ~4       ~14      ~39    ~100      ~110
+//   4 MB                ~4       ~14      ~21    ~24       ~22
+//   64 MB               ~3       ~5       ~7     ~11-15    ~11
+// Harley-Seal AVX2 is ~2.5x scalar popcnt in cache, vpopcntq another ~3x. Out of cache every vector variant
+// runs at memory bandwidth, and AND/OR/XOR cost no more than reading the second bitmap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "popcount.h"
+#include "bench.h"
+
+#define CHECK_MAX_SIZE 600
+#define BENCH_MIN_SIZE 1024
+#define BENCH_MAX_SIZE (64 << 20)
+#define BENCH_BYTES_PER_POINT (256ULL << 20)
+
+typedef uint64_t (*PopcountFn)(const void *, size_t);
+
+// one bit at a time, the reference
+static uint64_t bitLoopCount(const uint8_t *p, size_t len)
+{
+  uint64_t cnt = 0;
+  for (size_t i = 0; i < len; i++)
+  {
+    for (uint8_t b = p[i]; b; b >>= 1)
+      cnt += b & 1;
+  }
+  return cnt;
+}
+
+static uint64_t refCombined(const uint8_t *a, const uint8_t *b, size_t len, char op)
+{
+  uint64_t cnt = 0;
+  for (size_t i = 0; i < len; i++)
+  {
+    uint8_t x = op == '&' ? a[i] & b[i] : (op == '|' ? a[i] | b[i] : a[i] ^ b[i]);
+    cnt += bitLoopCount(&x, 1);
+  }
+  return cnt;
+}
+
+static uint64_t rnd = 88172645463325252ULL;
+
+static uint64_t nextRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+static void fillRandom(uint8_t *p, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    p[i] = (uint8_t)nextRandom();
+}
+
+#if defined(__x86_64__)
+static const char *const variantNames[] = {"generic", "popcnt", "avx2", "avx512"};
+static const PopcountFn variants[] = {popcount_generic, popcount_popcnt, popcount_avx2, popcount_avx512};
+
+static bool variantSupported(int v)
+{
+  __builtin_cpu_init();
+  switch (v)
+  {
+  case 1:
+    return __builtin_cpu_supports("popcnt");
+  case 2:
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+  case 3:
+    return __builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512bw");
+  default:
+    return true;
+  }
+}
+#define NUM_VARIANTS 4
+#endif
+
+static bool checkPopcount()
+{
+  static uint8_t a[CHECK_MAX_SIZE + 64];
+  static uint8_t b[CHECK_MAX_SIZE + 64];
+  for (size_t len = 0; len <= CHECK_MAX_SIZE; len++)
+  {
+    for (size_t off = 0; off < 64; off++)
+    {
+      fillRandom(a, sizeof(a));
+      fillRandom(b, sizeof(b));
+      if (len % 7 == 0)
+        memset(a + off, 0xff, len); // all ones: every carry save adder level set
+      const uint8_t *p = a + off;
+      const uint8_t *q = b + (off * 5) % 64;
+      uint64_t expect = bitLoopCount(p, len);
+      if (popcount_array(p, len) != expect)
+      {
+        printf("popcount_array FAILED: len %zu offset %zu\n", len, off);
+        return false;
+      }
+#if defined(__x86_64__)
+      for (int v = 0; v < NUM_VARIANTS; v++)
+      {
+        if (variantSupported(v) && variants[v](p, len) != expect)
+        {
+          printf("popcount_%s FAILED: len %zu offset %zu\n", variantNames[v], len, off);
+          return false;
+        }
+      }
+#endif
+      if (popcount_and(p, q, len) != refCombined(p, q, len, '&') ||
+          popcount_or(p, q, len) != refCombined(p, q, len, '|') ||
+          popcount_xor(p, q, len) != refCombined(p, q, len, '^'))
+      {
+        printf("popcount_and/or/xor FAILED: len %zu offset %zu\n", len, off);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// buffers ending right before an inaccessible page
+static bool checkPageBoundary()
+{
+  long page = sysconf(_SC_PAGESIZE);
+  uint8_t *map = (uint8_t *)mmap(NULL, 3 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  mprotect(map + page, page, PROT_NONE);
+  fillRandom(map, page);
+  fillRandom(map + 2 * page, page);
+  bool ok = true;
+  for (size_t len = 0; len <= 256 && ok; len++)
+  {
+    const uint8_t *p = map + page - len;
+    const uint8_t *q = map + 3 * page - len;
+    ok = popcount_array(p, len) == bitLoopCount(p, len) && popcount_and(p, q, len) == refCombined(p, q, len, '&');
+  }
+  munmap(map, 3 * page);
+  if (!ok)
+    printf("page boundary check FAILED\n");
+  return ok;
+}
+
+// ---------------- benchmark ----------------
+
+template <typename Fn>
+static double measureGBs(size_t bytes, Fn fn)
+{
+  uint64_t iters = BENCH_BYTES_PER_POINT / bytes;
+  iters = iters < 4 ? 4 : iters;
+  fn();
+  uint64_t t0 = nowNs();
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    fn();
+    clobberMemory();
+  }
+  return (double)bytes * iters / (nowNs() - t0);
+}
+
+int main_popcount_bench()
+{
+  printf("popcount dispatched to %s\n", popcount_isa());
+  if (!checkPopcount() || !checkPageBoundary())
+    return 1;
+  printf("all variants verified for sizes 0..%d, all offsets, and flush against a protected page\n\n",
+         CHECK_MAX_SIZE);
+
+  uint8_t *a = (uint8_t *)aligned_alloc(4096, BENCH_MAX_SIZE);
+  uint8_t *b = (uint8_t *)aligned_alloc(4096, BENCH_MAX_SIZE);
+  fillRandom(a, BENCH_MAX_SIZE);
+  fillRandom(b, BENCH_MAX_SIZE);
+
+  printf("GB/s%8s %9s", "size", "bit loop");
+#if defined(__x86_64__)
+  for (int v = 0; v < NUM_VARIANTS; v++)
+    printf(" %9s", variantNames[v]);
+#endif
+  printf(" %9s %9s %9s %9s\n", "array", "and", "or", "xor");
+  for (size_t len = BENCH_MIN_SIZE; len <= BENCH_MAX_SIZE; len *= 16)
+  {
+    printf("%12zu", len);
+    if (len <= BENCH_MIN_SIZE) // 8 iterations per byte, too slow for more
+      printf(" %9.2f", measureGBs(len, [&] { doNotOptimize(bitLoopCount(a, len)); }));
+    else
+      printf(" %9s", "");
+#if defined(__x86_64__)
+    for (int v = 0; v < NUM_VARIANTS; v++)
+    {
+      if (variantSupported(v))
+        printf(" %9.2f", measureGBs(len, [&] { doNotOptimize(variants[v](a, len)); }));
+      else
+        printf(" %9s", "-");
+    }
+#endif
+    printf(" %9.2f", measureGBs(len, [&] { doNotOptimize(popcount_array(a, len)); }));
+    printf(" %9.2f", measureGBs(2 * len, [&] { doNotOptimize(popcount_and(a, b, len)); }));
+    printf(" %9.2f", measureGBs(2 * len, [&] { doNotOptimize(popcount_or(a, b, len)); }));
+    printf(" %9.2f\n", measureGBs(2 * len, [&] { doNotOptimize(popcount_xor(a, b, len)); }));
+  }
+  free(a);
+  free(b);
+  return 0;
+}
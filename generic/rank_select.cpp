@@ -0,0 +1,462 @@
+// rank/select of rank_select.h, with runtime ISA dispatch like popcount.cpp, and building, saving and mapping
+// of RankSelectBitmap.
+//
+// generic: __builtin_popcountll without -mpopcnt is a libgcc call (table lookups), broadword in-word select.
+// popcnt: one instruction per word. bmi2: popcnt and pdep + tzcnt for the in-word select.
+// In-word select is the last step of select, the rest (sample, binary search, counters) is the same.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <new>
+#include "popcount.h"
+#include "rank_select.h"
+#include "simd_vec.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define BLOCK_SHIFT 11                                         // log2(RANK_SELECT_BLOCK_BITS)
+#define SUB_SHIFT 9                                            // log2(RANK_SELECT_SUB_BITS)
+#define WORDS_PER_BLOCK (RANK_SELECT_BLOCK_BITS / 64)
+#define WORDS_PER_SUB (RANK_SELECT_SUB_BITS / 64)
+#define BLOCKS_PER_SUPER_SHIFT (RANK_SELECT_SUPER_SHIFT - BLOCK_SHIFT)
+
+static_assert(RANK_SELECT_SUPER_SHIFT > BLOCK_SHIFT && RANK_SELECT_SUPER_SHIFT <= 31, "counters are 31 bits");
+
+// ---------------- rank / select ----------------
+
+// ones in the sub-blocks before sub (0 to 3) of a block
+static ALWAYS_INLINE uint64_t subBlockRank(uint64_t entry, uint64_t sub)
+{
+  return sub ? (entry >> (20 + 11 * sub)) & 0x7ff : 0;
+}
+
+// ones before block b
+static ALWAYS_INLINE uint64_t blockRank(const RankSelectIndex *index, uint64_t b)
+{
+  return index->upper[b >> BLOCKS_PER_SUPER_SHIFT] + (index->blocks[b] & 0x7fffffff);
+}
+
+template <typename Popcount>
+ALWAYS_INLINE uint64_t rankBody(const RankSelectIndex *index, uint64_t i, Popcount popcount)
+{
+  uint64_t b = i >> BLOCK_SHIFT;
+  uint64_t r = blockRank(index, b) + subBlockRank(index->blocks[b], (i >> SUB_SHIFT) & 3);
+  const uint64_t *w = index->words + ((i >> SUB_SHIFT) * WORDS_PER_SUB);
+  const uint64_t *last = index->words + (i >> 6);
+  for (; w < last; w++)
+    r += popcount(*w);
+  return r + popcount(*last & ((1ULL << (i & 63)) - 1));
+}
+
+// sel.pos[r][b]: position of the r-th one of byte b
+struct SelectInByteTable
+{
+  uint8_t pos[8][256];
+  constexpr SelectInByteTable() : pos()
+  {
+    for (int b = 0; b < 256; b++)
+    {
+      for (int bit = 0, r = 0; bit < 8; bit++)
+      {
+        if ((b >> bit) & 1)
+          pos[r++][b] = (uint8_t)bit;
+      }
+    }
+  }
+};
+
+static constexpr SelectInByteTable selectInByte;
+
+// position of the r-th one of w (r < popcount(w)) without pdep: ones per byte by SWAR, prefix sums of the
+// bytes by one multiplication, the byte where the prefix sum passes r by a parallel compare of all bytes
+static ALWAYS_INLINE uint64_t selectInWordBroadword(uint64_t w, uint64_t r)
+{
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+  uint64_t s = w - ((w >> 1) & 0x5555555555555555ULL);
+  s = (s & 0x3333333333333333ULL) + ((s >> 2) & 0x3333333333333333ULL);
+  s = (s + (s >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  uint64_t prefix = s * ones; // byte i: ones in bytes 0 to i
+  // high bit of byte i set when prefix_i <= r: the bytes before the one holding the r-th one. No borrow
+  // between bytes, r + 128 >= 64 >= prefix_i
+  uint64_t before = (((r * ones) | highs) - prefix) & highs;
+  uint64_t byte = ((before >> 7) * ones) >> 56;
+  uint64_t skipped = ((prefix << 8) >> (byte * 8)) & 0xff;
+  return byte * 8 + selectInByte.pos[r - skipped][(w >> (byte * 8)) & 0xff];
+}
+
+template <typename Popcount, typename SelectInWord>
+ALWAYS_INLINE uint64_t selectBody(const RankSelectIndex *index, uint64_t k, Popcount popcount,
+                                  SelectInWord selectInWord)
+{
+  if (k >= index->numOnes)
+    return index->numBits;
+  // last block with rank <= k, it lies between the blocks of the samples around k
+  uint64_t lo = index->samples[k / RANK_SELECT_SAMPLE];
+  uint64_t hi = index->samples[k / RANK_SELECT_SAMPLE + 1];
+  while (lo < hi)
+  {
+    uint64_t mid = (lo + hi + 1) / 2;
+    if (blockRank(index, mid) <= k)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  uint64_t entry = index->blocks[lo];
+  k -= blockRank(index, lo);
+  uint64_t sub = (k >= subBlockRank(entry, 1)) + (k >= subBlockRank(entry, 2)) + (k >= subBlockRank(entry, 3));
+  k -= subBlockRank(entry, sub);
+  const uint64_t *w = index->words + lo * WORDS_PER_BLOCK + sub * WORDS_PER_SUB;
+  for (;; w++)
+  {
+    uint64_t cnt = popcount(*w);
+    if (k < cnt)
+      break;
+    k -= cnt;
+  }
+  return (uint64_t)(w - index->words) * 64 + selectInWord(*w, k);
+}
+
+uint64_t rank_select_rank_generic(const RankSelectIndex *index, uint64_t i)
+{
+  return rankBody(index, i, [](uint64_t w) { return (uint64_t)__builtin_popcountll(w); });
+}
+
+uint64_t rank_select_select_generic(const RankSelectIndex *index, uint64_t k)
+{
+  return selectBody(index, k, [](uint64_t w) { return (uint64_t)__builtin_popcountll(w); },
+                    selectInWordBroadword);
+}
+
+#if defined(__x86_64__)
+
+#define POPCNT __attribute__((target("popcnt")))
+#define BMI2 __attribute__((target("popcnt,bmi,bmi2")))
+
+POPCNT uint64_t rank_select_rank_popcnt(const RankSelectIndex *index, uint64_t i)
+{
+  return rankBody(index, i, [](uint64_t w) POPCNT { return (uint64_t)__builtin_popcountll(w); });
+}
+
+POPCNT uint64_t rank_select_select_popcnt(const RankSelectIndex *index, uint64_t k)
+{
+  return selectBody(index, k, [](uint64_t w) POPCNT { return (uint64_t)__builtin_popcountll(w); },
+                    selectInWordBroadword);
+}
+
+// pdep puts the bits of 1 << r at the set bits of w: a single one, at the r-th set bit
+BMI2 uint64_t rank_select_select_bmi2(const RankSelectIndex *index, uint64_t k)
+{
+  return selectBody(index, k, [](uint64_t w) BMI2 { return (uint64_t)__builtin_popcountll(w); },
+                    [](uint64_t w, uint64_t r) BMI2 { return (uint64_t)_tzcnt_u64(_pdep_u64(1ULL << r, w)); });
+}
+
+#undef POPCNT
+#undef BMI2
+
+// ---------------- dispatch ----------------
+
+typedef uint64_t (*QueryFn)(const RankSelectIndex *, uint64_t);
+
+// 0 generic, 1 popcnt, 2 popcnt and fast pdep (not microcoded: AMD before Zen 3 has slow pdep).
+// Called from ifunc resolvers, so no global data
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE int rankSelectIsaLevel()
+{
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("popcnt"))
+    return 0;
+  if (__builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2"))
+    return 2;
+  return 1;
+}
+
+IFUNC_RESOLVER QueryFn resolveRank()
+{
+  return rankSelectIsaLevel() ? rank_select_rank_popcnt : rank_select_rank_generic;
+}
+
+IFUNC_RESOLVER QueryFn resolveSelect()
+{
+  switch (rankSelectIsaLevel())
+  {
+  case 2:
+    return rank_select_select_bmi2;
+  case 1:
+    return rank_select_select_popcnt;
+  default:
+    return rank_select_select_generic;
+  }
+}
+
+#if defined(__ELF__)
+uint64_t rank_select_rank(const RankSelectIndex *index, uint64_t i) __attribute__((ifunc("resolveRank")));
+uint64_t rank_select_select(const RankSelectIndex *index, uint64_t k) __attribute__((ifunc("resolveSelect")));
+#else
+static QueryFn rankImpl = resolveRank();
+static QueryFn selectImpl = resolveSelect();
+
+uint64_t rank_select_rank(const RankSelectIndex *index, uint64_t i)
+{
+  return rankImpl(index, i);
+}
+
+uint64_t rank_select_select(const RankSelectIndex *index, uint64_t k)
+{
+  return selectImpl(index, k);
+}
+#endif
+
+const char *rank_select_isa()
+{
+  static const char *names[] = {"generic", "popcnt", "bmi2"};
+  return names[rankSelectIsaLevel()];
+}
+
+#else
+
+uint64_t rank_select_rank(const RankSelectIndex *index, uint64_t i)
+{
+  return rank_select_rank_generic(index, i);
+}
+
+uint64_t rank_select_select(const RankSelectIndex *index, uint64_t k)
+{
+  return rank_select_select_generic(index, k);
+}
+
+const char *rank_select_isa()
+{
+  return "generic";
+}
+
+#endif
+
+// ---------------- RankSelectBitmap ----------------
+
+static uint64_t numUpper(uint64_t numBlocks)
+{
+  return (numBlocks >> BLOCKS_PER_SUPER_SHIFT) + 1;
+}
+
+static uint64_t numSamples(uint64_t numOnes)
+{
+  return numOnes / RANK_SELECT_SAMPLE + 2;
+}
+
+static uint64_t alignTo64(uint64_t bytes)
+{
+  return (bytes + 63) & ~63ULL;
+}
+
+RankSelectBitmap::RankSelectBitmap(uint64_t numBits)
+{
+  // at least one word past bit numBits - 1, rank(numBits) reads it
+  index.numBlocks = (numBits >> BLOCK_SHIFT) + 1;
+  if (index.numBlocks > UINT32_MAX) // samples hold 32 bit block numbers
+    throw std::bad_alloc();
+  size_t bytes = index.numBlocks * WORDS_PER_BLOCK * sizeof(uint64_t);
+  bits = (uint64_t *)aligned_alloc(64, bytes);
+  if (!bits)
+    throw std::bad_alloc();
+  memset(bits, 0, bytes);
+  index.words = bits;
+  index.numBits = numBits;
+}
+
+void RankSelectBitmap::build()
+{
+  uint64_t numWords = index.numBlocks * WORDS_PER_BLOCK;
+  // bits past numBits written through data() would be counted
+  if (index.numBits & 63)
+    bits[index.numBits >> 6] &= (1ULL << (index.numBits & 63)) - 1;
+  for (uint64_t w = (index.numBits + 63) >> 6; w < numWords; w++)
+    bits[w] = 0;
+
+  index.numOnes = popcount_array(bits, numWords * sizeof(uint64_t));
+  uint64_t upperBytes = alignTo64(numUpper(index.numBlocks) * sizeof(uint64_t));
+  uint64_t blocksBytes = alignTo64(index.numBlocks * sizeof(uint64_t));
+  uint64_t samplesBytes = alignTo64(numSamples(index.numOnes) * sizeof(uint32_t));
+  free(owned);
+  owned = (uint64_t *)aligned_alloc(64, upperBytes + blocksBytes + samplesBytes);
+  if (!owned)
+    throw std::bad_alloc();
+  uint64_t *upper = owned;
+  uint64_t *blocks = (uint64_t *)((uint8_t *)owned + upperBytes);
+  uint32_t *samples = (uint32_t *)((uint8_t *)blocks + blocksBytes);
+  uint32_t lastBlock = (uint32_t)(index.numBlocks - 1);
+  for (uint64_t j = 0; j < numSamples(index.numOnes); j++)
+    samples[j] = lastBlock;
+
+  uint64_t total = 0, superStart = 0, nextSample = 0;
+  for (uint64_t b = 0; b < index.numBlocks; b++)
+  {
+    if ((b & ((1ULL << BLOCKS_PER_SUPER_SHIFT) - 1)) == 0)
+    {
+      upper[b >> BLOCKS_PER_SUPER_SHIFT] = total;
+      superStart = total;
+    }
+    uint64_t entry = total - superStart;
+    uint64_t inBlock = 0;
+    for (uint64_t sub = 0; sub < 4; sub++)
+    {
+      if (sub)
+        entry |= inBlock << (20 + 11 * sub);
+      inBlock += popcount_array(bits + b * WORDS_PER_BLOCK + sub * WORDS_PER_SUB, RANK_SELECT_SUB_BITS / 8);
+    }
+    blocks[b] = entry;
+    total += inBlock;
+    for (; nextSample < total; nextSample += RANK_SELECT_SAMPLE)
+      samples[nextSample / RANK_SELECT_SAMPLE] = (uint32_t)b;
+  }
+  if ((index.numBlocks & ((1ULL << BLOCKS_PER_SUPER_SHIFT) - 1)) == 0)
+    upper[index.numBlocks >> BLOCKS_PER_SUPER_SHIFT] = total;
+
+  index.upper = upper;
+  index.blocks = blocks;
+  index.samples = samples;
+}
+
+size_t RankSelectBitmap::indexBytes() const
+{
+  return (numUpper(index.numBlocks) + index.numBlocks) * sizeof(uint64_t) +
+         numSamples(index.numOnes) * sizeof(uint32_t);
+}
+
+void RankSelectBitmap::release()
+{
+  free(bits);
+  free(owned);
+  if (mapping)
+    munmap(mapping, mappingSize);
+  bits = owned = NULL;
+  mapping = NULL;
+  mappingSize = 0;
+  index = RankSelectIndex();
+}
+
+// ---------------- file ----------------
+
+// header, then words, upper, blocks, samples, each at a multiple of 64 bytes
+struct RankSelectFileHeader
+{
+  char magic[8];
+  uint32_t superShift;
+  uint32_t sample;
+  uint64_t numBits;
+  uint64_t numOnes;
+  uint64_t numBlocks;
+  uint64_t reserved[3];
+};
+
+static_assert(sizeof(RankSelectFileHeader) == 64);
+
+static const char fileMagic[8] = {'R', 'S', 'B', 'I', 'T', 'M', 'A', 'P'};
+
+struct RankSelectFileLayout
+{
+  uint64_t words, upper, blocks, samples, end; // offsets
+};
+
+static RankSelectFileLayout fileLayout(uint64_t numBlocks, uint64_t numOnes)
+{
+  RankSelectFileLayout l;
+  l.words = sizeof(RankSelectFileHeader);
+  l.upper = l.words + numBlocks * WORDS_PER_BLOCK * sizeof(uint64_t);
+  l.blocks = l.upper + alignTo64(numUpper(numBlocks) * sizeof(uint64_t));
+  l.samples = l.blocks + alignTo64(numBlocks * sizeof(uint64_t));
+  l.end = l.samples + alignTo64(numSamples(numOnes) * sizeof(uint32_t));
+  return l;
+}
+
+static bool writeAt(FILE *f, uint64_t offset, const void *data, uint64_t len)
+{
+  return fseek(f, (long)offset, SEEK_SET) == 0 && fwrite(data, 1, len, f) == len;
+}
+
+bool RankSelectBitmap::save(const char *path) const
+{
+  RankSelectFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, fileMagic, sizeof(h.magic));
+  h.superShift = RANK_SELECT_SUPER_SHIFT;
+  h.sample = RANK_SELECT_SAMPLE;
+  h.numBits = index.numBits;
+  h.numOnes = index.numOnes;
+  h.numBlocks = index.numBlocks;
+  RankSelectFileLayout l = fileLayout(index.numBlocks, index.numOnes);
+
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return false;
+  static const uint8_t zeros[64] = {0};
+  bool ok = writeAt(f, 0, &h, sizeof(h)) &&
+            writeAt(f, l.words, index.words, index.numBlocks * WORDS_PER_BLOCK * sizeof(uint64_t)) &&
+            writeAt(f, l.upper, index.upper, numUpper(index.numBlocks) * sizeof(uint64_t)) &&
+            writeAt(f, l.blocks, index.blocks, index.numBlocks * sizeof(uint64_t)) &&
+            writeAt(f, l.samples, index.samples, numSamples(index.numOnes) * sizeof(uint32_t)) &&
+            writeAt(f, l.end - 1, zeros, 1); // padding of the last array
+  int err = errno;
+  if (fclose(f) != 0 && ok)
+    return false;
+  errno = err;
+  return ok;
+}
+
+bool RankSelectBitmap::mapFile(const char *path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    return false;
+  }
+  if ((uint64_t)st.st_size < sizeof(RankSelectFileHeader))
+  {
+    close(fd);
+    errno = EINVAL;
+    return false;
+  }
+  // the mapping keeps the file open
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const RankSelectFileHeader *h = (const RankSelectFileHeader *)map;
+  RankSelectFileLayout l = fileLayout(h->numBlocks, h->numOnes);
+  if (memcmp(h->magic, fileMagic, sizeof(fileMagic)) != 0 || h->superShift != RANK_SELECT_SUPER_SHIFT ||
+      h->sample != RANK_SELECT_SAMPLE || h->numBits >= (uint64_t)UINT32_MAX << BLOCK_SHIFT ||
+      h->numBlocks != (h->numBits >> BLOCK_SHIFT) + 1 ||
+      h->numOnes > h->numBits || l.end > (uint64_t)st.st_size)
+  {
+    munmap(map, st.st_size);
+    errno = EINVAL;
+    return false;
+  }
+  // queries touch a few scattered cache lines, read ahead would fetch pages nobody asked for
+  madvise(map, st.st_size, MADV_RANDOM);
+
+  release();
+  mapping = map;
+  mappingSize = st.st_size;
+  const uint8_t *base = (const uint8_t *)map;
+  index.words = (const uint64_t *)(base + l.words);
+  index.upper = (const uint64_t *)(base + l.upper);
+  index.blocks = (const uint64_t *)(base + l.blocks);
+  index.samples = (const uint32_t *)(base + l.samples);
+  index.numBits = h->numBits;
+  index.numOnes = h->numOnes;
+  index.numBlocks = h->numBlocks;
+  return true;
+}
@@ -0,0 +1,109 @@
+#ifndef __RANK_SELECT_H
+#define __RANK_SELECT_H
+
+// Bitmap with constant time rank and select, for succinct structures (wavelet trees, Elias-Fano lists,
+// compressed tries) and large occupancy maps.
+//   rank(i):   number of ones in bits [0, i)
+//   select(k): position of the k-th one (k counted from 0), so rank(select(k)) == k
+//
+// Index (layout of "poppy", Zhou, Andersen, Kaminsky: Space-Efficient, High-Performance Rank & Select
+// Structures on Uncompressed Bit Sequences), 3.2% on top of the bits:
+//   upper[]   64 bit count of ones before each superblock of 2^31 bits (a few entries even for GBs)
+//   blocks[]  one 64 bit word per block of 2048 bits, counters interleaved in it:
+//             bits 0-30   ones from superblock start to block start
+//             bits 31-63  ones in the first 1, 2 and 3 sub-blocks of 512 bits, 11 bits each (cumulative, so
+//                         rank adds one of them instead of summing)
+//   samples[] block holding every 8192nd one, 0.4% at most. Narrows select's search to a few blocks
+// rank: one blocks[] word and at most 8 popcounts inside one 512 bit sub-block (one cache line).
+// select: sample, binary search over the blocks between two samples, sub-block from the 3 counters,
+//   popcount over at most 8 words, then the k-th one inside a word: pdep deposits a single 1 at the k-th set
+//   bit of the word and tzcnt gives its position. Without fast pdep a broadword version (byte prefix sums by
+//   multiplication, then a table for the byte).
+// Hardware popcnt and pdep are picked at load time (rank_select.cpp).
+//
+// Bits are set with set()/clear() (or written through data()), then build() computes the index. Changing
+// bits later needs another build().
+// save() writes bits and index to a file; mapFile() maps it back read only, so multi-GB bitmaps are queried
+// without reading them in: pages come from the page cache on first touch and are shared between processes.
+// Mapped bitmaps can't be changed.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RANK_SELECT_BLOCK_BITS 2048
+#define RANK_SELECT_SUB_BITS 512
+#define RANK_SELECT_SUPER_SHIFT 31 // log2 of bits per superblock. At most 31, counters are 31 bits
+#define RANK_SELECT_SAMPLE 8192    // ones between select samples
+
+// arrays read by rank and select, in heap memory or in a mapped file
+struct RankSelectIndex
+{
+  const uint64_t *words = NULL;
+  const uint64_t *upper = NULL;
+  const uint64_t *blocks = NULL;
+  const uint32_t *samples = NULL; // numOnes / RANK_SELECT_SAMPLE + 2, unused ones point to the last block
+  uint64_t numBits = 0;
+  uint64_t numOnes = 0;
+  uint64_t numBlocks = 0;
+};
+
+// rank_select.cpp. i <= numBits; k < numOnes, else returns numBits
+uint64_t rank_select_rank(const RankSelectIndex *index, uint64_t i);
+uint64_t rank_select_select(const RankSelectIndex *index, uint64_t k);
+const char *rank_select_isa();
+
+#if defined(__x86_64__)
+// individual variants, for benchmarking. Caller must check cpu support (__builtin_cpu_supports)
+uint64_t rank_select_rank_generic(const RankSelectIndex *index, uint64_t i);
+uint64_t rank_select_rank_popcnt(const RankSelectIndex *index, uint64_t i);
+uint64_t rank_select_select_generic(const RankSelectIndex *index, uint64_t k);
+uint64_t rank_select_select_popcnt(const RankSelectIndex *index, uint64_t k); // broadword inside the word
+uint64_t rank_select_select_bmi2(const RankSelectIndex *index, uint64_t k);   // pdep inside the word
+#endif
+
+class RankSelectBitmap
+{
+public:
+  RankSelectBitmap() {}
+  // numBits zero bits. Throws std::bad_alloc
+  explicit RankSelectBitmap(uint64_t numBits);
+  ~RankSelectBitmap() { release(); }
+  RankSelectBitmap(const RankSelectBitmap &) = delete;
+  RankSelectBitmap &operator=(const RankSelectBitmap &) = delete;
+
+  void set(uint64_t i) { bits[i >> 6] |= 1ULL << (i & 63); }
+  void clear(uint64_t i) { bits[i >> 6] &= ~(1ULL << (i & 63)); }
+  bool get(uint64_t i) const { return (index.words[i >> 6] >> (i & 63)) & 1; }
+  // (numBits + 63) / 64 words for bulk writes, bit i in bit i % 64 of word i / 64. NULL when mapped
+  uint64_t *data() { return bits; }
+
+  // counts ones into the index. Throws std::bad_alloc
+  void build();
+
+  uint64_t rank(uint64_t i) const { return rank_select_rank(&index, i); }
+  uint64_t select(uint64_t k) const { return rank_select_select(&index, k); }
+
+  uint64_t size() const { return index.numBits; }
+  uint64_t ones() const { return index.numOnes; }
+  bool isMapped() const { return mapping != NULL; }
+  // bytes of the index (upper, blocks, samples), without the bits
+  size_t indexBytes() const;
+  const RankSelectIndex *getIndex() const { return &index; }
+
+  // false with errno set on failure. Needs build() first
+  bool save(const char *path) const;
+  // replaces current contents with the bitmap in path, read only. false with errno set on failure
+  // (EINVAL: not a bitmap file or truncated)
+  bool mapFile(const char *path);
+
+private:
+  void release();
+
+  RankSelectIndex index;
+  uint64_t *bits = NULL;  // owned bits, numBlocks * 32 words
+  uint64_t *owned = NULL; // index arrays of build(), one allocation
+  void *mapping = NULL;
+  size_t mappingSize = 0;
+};
+
+#endif
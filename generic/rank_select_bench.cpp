@@ -0,0 +1,310 @@
+// Check and benchmark of rank_select.h.
+// Checks: every variant the cpu supports against a prefix count array, rank at every position and select of
+// every one, for bitmaps of 0 to 5000 bits and a few million bits at densities from empty to full.
+// Then a bitmap of LARGE_BITS (512 MB, over two superblocks) is saved, mapped back, and the mapped copy
+// compared with the one in memory at random points, and rank with popcount_array over the whole prefix.
+// Benchmark: ns per random query, in cache (2 MB bitmap) and out of it (128 MB), against a linear rank
+// (popcount_array of the prefix) and select by binary search on that rank.
+//
+// Typical result (1 core VM, Intel with fast pdep, g++ -O2), ns per random query:
+//   bits   rank generic  popcnt   select generic  popcnt (broadword)  bmi2 (pdep)
+//   2^24   ~42           ~21      ~85             ~75                 ~67
+//   2^30   ~125          ~55      ~330            ~205                ~150
+//   without index, 2^24 bits: rank by popcount_array of the prefix ~12000, select by binary search ~200000
+// Rank out of cache is two cache misses (blocks word, then the line of bits), select adds the binary search
+// over blocks, so hardware popcnt and pdep save instructions mostly where the misses don't dominate.
+// Index: 3.1% of the bits plus 0.2% of select samples at density 1/2.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "rank_select.h"
+#include "popcount.h"
+#include "bench.h"
+
+#define CHECK_SMALL_MAX 5000
+#define CHECK_BITS 3000017ULL
+#define LARGE_BITS ((1ULL << 32) + 4097) // superblocks of 2^31 bits: two boundaries
+#define LARGE_FILE "/tmp/rank_select_bench.bin"
+#define QUERIES (1 << 18)
+
+typedef uint64_t (*QueryFn)(const RankSelectIndex *, uint64_t);
+
+struct Variant
+{
+  const char *name;
+  QueryFn rank;
+  QueryFn select;
+  bool supported;
+};
+
+static std::vector<Variant> variants()
+{
+  std::vector<Variant> v;
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  bool popcnt = __builtin_cpu_supports("popcnt");
+  v.push_back({"generic", rank_select_rank_generic, rank_select_select_generic, true});
+  v.push_back({"popcnt", rank_select_rank_popcnt, rank_select_select_popcnt, popcnt});
+  v.push_back({"bmi2", rank_select_rank_popcnt, rank_select_select_bmi2, popcnt && __builtin_cpu_supports("bmi2")});
+#endif
+  v.push_back({"dispatched", rank_select_rank, rank_select_select, true});
+  return v;
+}
+
+static uint64_t rnd = 88172645463325252ULL;
+
+static uint64_t nextRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+// each bit set with probability density / 1024
+static void fillRandom(RankSelectBitmap &bm, uint64_t density)
+{
+  for (uint64_t i = 0; i < bm.size(); i++)
+  {
+    if (density >= 1024 || (nextRandom() & 1023) < density)
+      bm.set(i);
+  }
+  bm.build();
+}
+
+static bool checkBitmap(const RankSelectBitmap &bm, const char *what)
+{
+  uint64_t n = bm.size();
+  std::vector<uint64_t> ranks(n + 1);
+  std::vector<uint64_t> positions;
+  ranks[0] = 0;
+  for (uint64_t i = 0; i < n; i++)
+  {
+    ranks[i + 1] = ranks[i] + bm.get(i);
+    if (bm.get(i))
+      positions.push_back(i);
+  }
+  if (bm.ones() != ranks[n])
+  {
+    printf("%s: ones %llu, expected %llu FAILED\n", what, (unsigned long long)bm.ones(),
+           (unsigned long long)ranks[n]);
+    return false;
+  }
+  for (const Variant &v : variants())
+  {
+    if (!v.supported)
+      continue;
+    for (uint64_t i = 0; i <= n; i++)
+    {
+      if (v.rank(bm.getIndex(), i) != ranks[i])
+      {
+        printf("%s: %s rank(%llu) %llu, expected %llu FAILED\n", what, v.name, (unsigned long long)i,
+               (unsigned long long)v.rank(bm.getIndex(), i), (unsigned long long)ranks[i]);
+        return false;
+      }
+    }
+    for (uint64_t k = 0; k <= positions.size(); k++)
+    {
+      uint64_t expected = k < positions.size() ? positions[k] : n;
+      if (v.select(bm.getIndex(), k) != expected)
+      {
+        printf("%s: %s select(%llu) %llu, expected %llu FAILED\n", what, v.name, (unsigned long long)k,
+               (unsigned long long)v.select(bm.getIndex(), k), (unsigned long long)expected);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool checkSmall()
+{
+  char what[64];
+  for (uint64_t n = 0; n <= CHECK_SMALL_MAX; n += n < 130 ? 1 : 97)
+  {
+    for (uint64_t density : {0, 3, 512, 1024})
+    {
+      RankSelectBitmap bm(n);
+      fillRandom(bm, density);
+      snprintf(what, sizeof(what), "%llu bits, density %llu/1024", (unsigned long long)n,
+               (unsigned long long)density);
+      if (!checkBitmap(bm, what))
+        return false;
+    }
+  }
+  for (uint64_t density : {0, 1, 10, 512, 1014, 1024})
+  {
+    RankSelectBitmap bm(CHECK_BITS);
+    fillRandom(bm, density);
+    snprintf(what, sizeof(what), "%llu bits, density %llu/1024", CHECK_BITS, (unsigned long long)density);
+    if (!checkBitmap(bm, what))
+      return false;
+  }
+  // bits written through data() past the end are not counted
+  RankSelectBitmap bm(100);
+  bm.data()[1] = ~0ULL;
+  bm.build();
+  return bm.ones() == 36 && bm.select(35) == 99 && bm.select(36) == 100 && bm.rank(100) == 36;
+}
+
+static bool checkLarge()
+{
+  RankSelectBitmap bm(LARGE_BITS);
+  uint64_t *words = bm.data();
+  for (uint64_t w = 0; w < (LARGE_BITS + 63) / 64; w++)
+    words[w] = nextRandom() & nextRandom(); // density 1/4
+  bm.build();
+  if (!bm.save(LARGE_FILE))
+  {
+    perror(LARGE_FILE);
+    return false;
+  }
+  RankSelectBitmap mapped;
+  bool ok = mapped.mapFile(LARGE_FILE);
+  unlink(LARGE_FILE); // mapping stays valid
+  if (!ok)
+  {
+    perror(LARGE_FILE);
+    return false;
+  }
+  ok = mapped.isMapped() && mapped.size() == bm.size() && mapped.ones() == bm.ones();
+  // around superblock boundaries, and random
+  uint64_t points[] = {0, 1, (1ULL << 31) - 1, 1ULL << 31, (1ULL << 31) + 1, (1ULL << 32) - 1, 1ULL << 32,
+                       LARGE_BITS - 1, LARGE_BITS};
+  for (uint64_t i : points)
+  {
+    uint64_t prefix = popcount_array(words, i / 8) + __builtin_popcount(((uint8_t *)words)[i / 8] & ((1U << (i % 8)) - 1));
+    ok = ok && mapped.rank(i) == bm.rank(i) && mapped.rank(i) == prefix;
+  }
+  for (int q = 0; q < QUERIES && ok; q++)
+  {
+    uint64_t i = nextRandom() % (LARGE_BITS + 1);
+    uint64_t k = nextRandom() % (bm.ones() + 1);
+    uint64_t r = mapped.rank(i);
+    uint64_t s = mapped.select(k);
+    ok = r == bm.rank(i) && s == bm.select(k);
+    // select(rank(i)) is the first one at or after i
+    uint64_t next = mapped.select(r);
+    ok = ok && next >= i && (next == LARGE_BITS || mapped.get(next)) && mapped.rank(next) == r;
+    ok = ok && (s == LARGE_BITS ? k == bm.ones() : mapped.get(s) && mapped.rank(s) == k);
+  }
+  if (!ok)
+    printf("%llu bit mapped bitmap FAILED\n", (unsigned long long)LARGE_BITS);
+  return ok;
+}
+
+static uint64_t queries[QUERIES];
+
+template <typename Fn>
+static double nsPerQuery(Fn fn)
+{
+  double best = 1e9;
+  for (int r = 0; r < 3; r++)
+  {
+    uint64_t sum = 0;
+    uint64_t t0 = nowNs();
+    for (int q = 0; q < QUERIES; q++)
+      sum += fn(queries[q]);
+    double ns = (double)(nowNs() - t0) / QUERIES;
+    doNotOptimize(sum);
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+static void benchSize(uint64_t numBits)
+{
+  RankSelectBitmap bm(numBits);
+  uint64_t *words = bm.data();
+  for (uint64_t w = 0; w < (numBits + 63) / 64; w++)
+    words[w] = nextRandom();
+  bm.build();
+  const RankSelectIndex *index = bm.getIndex();
+
+  printf("2^%-4d %7.1f%%", 63 - __builtin_clzll(numBits), 100.0 * bm.indexBytes() * 8 / numBits);
+  for (int q = 0; q < QUERIES; q++)
+    queries[q] = nextRandom() % numBits;
+  for (const Variant &v : variants())
+  {
+    if (v.supported)
+      printf(" %10.1f", nsPerQuery([&](uint64_t i) { return v.rank(index, i); }));
+    else
+      printf(" %10s", "-");
+  }
+  for (int q = 0; q < QUERIES; q++)
+    queries[q] = nextRandom() % bm.ones();
+  for (const Variant &v : variants())
+  {
+    if (v.supported)
+      printf(" %10.1f", nsPerQuery([&](uint64_t k) { return v.select(index, k); }));
+    else
+      printf(" %10s", "-");
+  }
+  printf("\n");
+}
+
+// what rank and select cost without an index
+static void benchLinear(uint64_t numBits)
+{
+  RankSelectBitmap bm(numBits);
+  uint64_t *words = bm.data();
+  for (uint64_t w = 0; w < (numBits + 63) / 64; w++)
+    words[w] = nextRandom();
+  bm.build();
+  uint64_t linearRank = 0, t0 = nowNs();
+  const int rounds = 64;
+  for (int r = 0; r < rounds; r++)
+    linearRank += popcount_array(words, (nextRandom() % numBits) / 8);
+  doNotOptimize(linearRank);
+  printf("2^%d bits without index: rank by popcount_array of the prefix %.0f ns", 63 - __builtin_clzll(numBits),
+         (double)(nowNs() - t0) / rounds);
+
+  // select: binary search for the first position with popcount_array rank > k, in whole bytes
+  t0 = nowNs();
+  uint64_t found = 0;
+  for (int r = 0; r < rounds; r++)
+  {
+    uint64_t k = nextRandom() % bm.ones();
+    uint64_t lo = 0, hi = numBits / 8;
+    while (lo < hi)
+    {
+      uint64_t mid = (lo + hi) / 2;
+      if (popcount_array(words, mid + 1) > k)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    found += lo;
+  }
+  doNotOptimize(found);
+  printf(", select by binary search on it %.0f ns\n", (double)(nowNs() - t0) / rounds);
+}
+
+int main_rank_select_bench()
+{
+  printf("rank/select dispatched to %s\n", rank_select_isa());
+  if (!checkSmall())
+    return 1;
+  printf("rank and select of every position verified, every variant\n");
+  if (!checkLarge())
+    return 1;
+  printf("2^32 + 4097 bit bitmap saved, mapped read only and verified\n\n");
+
+  size_t numVariants = variants().size();
+  printf("ns per random query %-*s %s\n%-6s %8s", (int)numVariants * 11 - 4, "rank", "select", "bits", "index");
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (const Variant &v : variants())
+      printf(" %10s", v.name);
+  }
+  printf("\n");
+  for (uint64_t bits : {1ULL << 24, 1ULL << 30})
+    benchSize(bits);
+  benchLinear(1ULL << 24);
+
+  return 0;
+}
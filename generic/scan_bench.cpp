@@ -0,0 +1,240 @@
+// Check and benchmark of simd_scan.cpp routines against glibc, same style as mem_bench.cpp.
+// Checks: every size up to 300 bytes at every offset in a cache line, match at every position or absent,
+// then every length up to 256 bytes placed flush against a PROT_NONE page (before and after),
+// where a load crossing into the protected page would crash the demo.
+// Benchmark: hot cache GB/s, 16 B to 1 MB. Multi byte memchr is compared with strcspn (needs NUL terminated
+// input) and with a plain byte loop over a 256 bit set.
+//
+// Results on an AVX-512 machine (dispatch picks avx512bw): from 1 KB up, memset, memcmp, memchr and strlen
+// run at about glibc speed (glibc already has hand written AVX2/EVEX versions), within 10-20% either way.
+// Multi byte memchr with an 8 byte delimiter set: ~40 GB/s from 16 KB up, vs ~10 GB/s for strcspn and
+// under 1 GB/s for the byte loop. Below 64 bytes call overhead dominates all of them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "mem_operation.h"
+#include "bench.h"
+
+#define CHECK_MAX_SIZE 300
+#define PAGE_CHECK_MAX_SIZE 256
+#define BENCH_MAX_SIZE (1 << 20)
+#define BENCH_BYTES_PER_POINT (64ULL << 20)
+
+static const char delimiters[] = " ,;:\t\r\n\"";
+
+static const uint8_t *refFindAny(const uint8_t *p, size_t len, const char *set, size_t setLen)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    if (memchr(set, p[i], setLen))
+      return p + i;
+  }
+  return NULL;
+}
+
+static int sign(int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+static bool checkScan()
+{
+  static uint8_t buf[CHECK_MAX_SIZE + 128];
+  static uint8_t other[CHECK_MAX_SIZE + 128];
+  static uint8_t expect[CHECK_MAX_SIZE + 128];
+  uint64_t rnd = 88172645463325252ULL;
+  // random sets: small, spread over more than 8 high nibbles (bitmap fallback), and more than 16 bytes
+  char sets[4][40];
+  size_t setLens[4] = {2, 8, 12, 40};
+  memcpy(sets[0], "\n,", 2);
+  memcpy(sets[1], delimiters, 8);
+  for (int i = 0; i < 12; i++)
+    sets[2][i] = (char)(i * 0x15 + 3);
+  for (int i = 0; i < 40; i++)
+    sets[3][i] = (char)(i * 7 + 200);
+
+  for (size_t len = 0; len <= CHECK_MAX_SIZE; len++)
+  {
+    for (size_t off = 0; off < 64; off++)
+    {
+      uint8_t *p = buf + off;
+      // memset with guard bytes
+      memset(buf, 0xAA, sizeof(buf));
+      memset(expect, 0xAA, sizeof(expect));
+      memset(expect + off, 0x5C, len);
+      if (simd_memset(p, 0x5C, len) != p || memcmp(buf, expect, sizeof(buf)))
+      {
+        printf("simd_memset FAILED: len %zu offset %zu\n", len, off);
+        return false;
+      }
+
+      // memchr and strlen: no zero/needle bytes in filler, needle at every position then absent
+      for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = 1 + (uint8_t)(i % 200);
+      for (size_t pos = 0; pos <= len; pos++)
+      {
+        uint8_t saved = p[pos];
+        p[pos] = 0;
+        if (simd_memchr(p, 0, len) != memchr(p, 0, len) || simd_strlen((const char *)p) != pos)
+        {
+          printf("simd_memchr/strlen FAILED: len %zu offset %zu position %zu\n", len, off, pos);
+          return false;
+        }
+        p[pos] = saved;
+      }
+
+      // memcmp: equal, then one difference at a random position with random sign
+      for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = other[i] = (uint8_t)(i * 31);
+      uint8_t *q = other + (off * 7) % 64; // different alignment than p
+      memcpy(q, p, len);
+      if (simd_memcmp(p, q, len) != 0)
+      {
+        printf("simd_memcmp FAILED (equal): len %zu offset %zu\n", len, off);
+        return false;
+      }
+      if (len)
+      {
+        rnd ^= rnd << 13, rnd ^= rnd >> 7, rnd ^= rnd << 17;
+        size_t pos = rnd % len;
+        q[pos] = (uint8_t)(q[pos] + 1 + (rnd >> 32) % 255);
+        if (sign(simd_memcmp(p, q, len)) != sign(memcmp(p, q, len)))
+        {
+          printf("simd_memcmp FAILED: len %zu offset %zu difference at %zu\n", len, off, pos);
+          return false;
+        }
+      }
+
+      // multi byte memchr: random bytes, each set
+      for (size_t i = 0; i < sizeof(buf); i++)
+      {
+        rnd ^= rnd << 13, rnd ^= rnd >> 7, rnd ^= rnd << 17;
+        buf[i] = (uint8_t)rnd;
+      }
+      for (int s = 0; s < 4; s++)
+      {
+        if (simd_memchr_any(p, len, sets[s], setLens[s]) != refFindAny(p, len, sets[s], setLens[s]))
+        {
+          printf("simd_memchr_any FAILED: len %zu offset %zu set %d\n", len, off, s);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// buffers flush against a protected page on either side. A load crossing into it crashes right here
+static bool checkPageBoundary()
+{
+  long pageSize = sysconf(_SC_PAGESIZE);
+  uint8_t *map = (uint8_t *)mmap(NULL, 3 * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    return false;
+  mprotect(map, pageSize, PROT_NONE);
+  mprotect(map + 2 * pageSize, pageSize, PROT_NONE);
+  uint8_t *page = map + pageSize;
+  uint8_t *pageEnd = page + pageSize;
+  memset(page, 'x', pageSize);
+  bool ok = true;
+  for (size_t len = 0; len <= PAGE_CHECK_MAX_SIZE && ok; len++)
+  {
+    // at end of page: needle absent, string ends at last byte, compare against start of page
+    uint8_t *tail = pageEnd - len;
+    ok = ok && simd_memchr(tail, 'y', len) == NULL;
+    ok = ok && simd_memchr_any(tail, len, delimiters, sizeof(delimiters) - 1) == NULL;
+    ok = ok && simd_memcmp(tail, page, len) == 0;
+    if (len)
+    {
+      pageEnd[-1] = 0;
+      ok = ok && simd_strlen((const char *)tail) == len - 1;
+      pageEnd[-1] = 'x';
+    }
+    // at start of page
+    ok = ok && simd_memchr(page, 'y', len) == NULL;
+    ok = ok && simd_memcmp(page, tail, len) == 0;
+    ok = ok && simd_memchr_any(page, len, delimiters, sizeof(delimiters) - 1) == NULL;
+    simd_memset(tail, 'x', len);
+    simd_memset(page, 'x', len);
+  }
+  munmap(map, 3 * pageSize);
+  if (!ok)
+    printf("page boundary check FAILED\n");
+  return ok;
+}
+
+// ---------------- benchmark ----------------
+
+template <typename Fn>
+static double measureGBs(size_t len, Fn fn)
+{
+  uint64_t iters = BENCH_BYTES_PER_POINT / len;
+  iters = iters < 16 ? 16 : (iters > 4000000 ? 4000000 : iters);
+  fn();
+  uint64_t t0 = nowNs();
+  for (uint64_t i = 0; i < iters; i++)
+  {
+    fn();
+    clobberMemory();
+  }
+  return (double)len * iters / (nowNs() - t0);
+}
+
+static const uint8_t *byteLoopFindAny(const uint8_t *p, size_t len, const uint64_t *bitmap)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    if (bitmap[p[i] >> 6] & (1ULL << (p[i] & 63)))
+      return p + i;
+  }
+  return NULL;
+}
+
+int main_scan_bench()
+{
+  printf("simd scan routines dispatched to %s\n", simd_scan_isa());
+  if (!checkScan() || !checkPageBoundary())
+    return 1;
+  printf("all routines verified for sizes 0..%d, all offsets, and flush against protected pages\n\n", CHECK_MAX_SIZE);
+
+  uint8_t *a = (uint8_t *)aligned_alloc(4096, BENCH_MAX_SIZE + 4096);
+  uint8_t *b = (uint8_t *)aligned_alloc(4096, BENCH_MAX_SIZE + 4096);
+  memset(a, 'a', BENCH_MAX_SIZE + 4096);
+  memset(b, 'a', BENCH_MAX_SIZE + 4096);
+  uint64_t bitmap[4] = {};
+  for (const char *d = delimiters; *d; d++)
+    bitmap[(uint8_t)*d >> 6] |= 1ULL << ((uint8_t)*d & 63);
+
+  // worst case for scans: nothing found, whole buffer read. Buffers start 3 bytes past page boundary
+  printf("%9s %15s %15s %15s %15s %15s %23s\n", "size", "memset", "memcmp", "memchr", "strlen", "memchr_any",
+         "strcspn / byte loop");
+  printf("%9s %15s %15s %15s %15s %15s   (GB/s glibc / simd)\n", "", "", "", "", "", "");
+  for (size_t len = 16; len <= BENCH_MAX_SIZE; len *= 4)
+  {
+    uint8_t *p = a + 3;
+    uint8_t *q = b + 7;
+    p[len] = 0; // terminator for strlen and strcspn
+    size_t setLen = sizeof(delimiters) - 1;
+    printf("%9zu", len);
+    printf("  %6.2f/%6.2f", measureGBs(len, [&] { memset(p, 'a', len); }),
+           measureGBs(len, [&] { simd_memset(p, 'a', len); }));
+    printf("  %6.2f/%6.2f", measureGBs(len, [&] { doNotOptimize(memcmp(p, q, len)); }),
+           measureGBs(len, [&] { doNotOptimize(simd_memcmp(p, q, len)); }));
+    printf("  %6.2f/%6.2f", measureGBs(len, [&] { doNotOptimize(memchr(p, 'z', len)); }),
+           measureGBs(len, [&] { doNotOptimize(simd_memchr(p, 'z', len)); }));
+    printf("  %6.2f/%6.2f", measureGBs(len, [&] { doNotOptimize(strlen((const char *)p)); }),
+           measureGBs(len, [&] { doNotOptimize(simd_strlen((const char *)p)); }));
+    printf("  %6.2f       ", measureGBs(len, [&] { doNotOptimize(simd_memchr_any(p, len, delimiters, setLen)); }));
+    printf("  %6.2f/%6.2f", measureGBs(len, [&] { doNotOptimize(strcspn((const char *)p, delimiters)); }),
+           measureGBs(len, [&] { doNotOptimize(byteLoopFindAny(p, len, bitmap)); }));
+    printf("\n");
+    p[len] = 'a';
+  }
+  free(a);
+  free(b);
+  return 0;
+}
@@ -0,0 +1,193 @@
+// memcpy in which every load and every store is aligned, even when src and dst are misaligned
+// relative to each other (src % V != dst % V). Matters on cores where unaligned access traps or is split
+// in two (many ARM/embedded parts), and for loads that would otherwise cross a cache line.
+//
+// Same idea as mismatched branch of faster_memcopy, with vectors instead of 64 bit words:
+// dst is first aligned to V. Then src is sh bytes past a V boundary. Load aligned vectors lo, hi around
+// src and take bytes [sh, sh + V) of the pair:
+//   SSSE3 : palignr(hi, lo, sh)                                  16 bytes
+//   AVX2  : vpalignr works inside each 128 bit lane, so middle vector [lo.high lane, hi.low lane] is built
+//           with vperm2i128 and then vpalignr(mid, lo, sh) for sh < 16 or vpalignr(hi, mid, sh - 16)
+//   NEON  : vext(lo, hi, sh)                                     16 bytes
+// Shift count is an immediate in all three, so the loop is a template on sh and a table picks one of V loops.
+// hi becomes lo of next block, each source vector is loaded once.
+//
+// Loads may touch bytes just before src and just past its end, but only inside aligned V byte blocks that
+// also hold bytes of src. Such block never crosses a page so it can't fault; address sanitizer would still
+// report it, hence no_sanitize on the loops.
+// Head bytes (until dst is aligned) and tail (< V bytes) go through faster_memcopy.
+
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+#include "mem_operation.h"
+#include "simd_vec.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// d is V aligned, s is V aligned start of block holding first source byte, copies blocks * V bytes
+typedef void (*MergeLoopFn)(uint8_t *d, const uint8_t *s, size_t blocks);
+
+template <size_t V>
+static void *shiftMergeCopy(void *dst, const void *src, size_t len, const MergeLoopFn *loops)
+{
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  size_t head = (0 - (uintptr_t)d) & (V - 1);
+  if (head >= len)
+    return faster_memcopy(dst, src, len);
+  faster_memcopy(d, s, head);
+  d += head;
+  s += head;
+  len -= head;
+
+  size_t blocks = len / V;
+  if (blocks)
+  {
+    size_t sh = (uintptr_t)s & (V - 1);
+    loops[sh](d, s - sh, blocks);
+    d += blocks * V;
+    s += blocks * V;
+    len -= blocks * V;
+  }
+  faster_memcopy(d, s, len);
+  return dst;
+}
+
+// table of loops for shift 0..V-1: MergeLoopTable<Loop, std::make_integer_sequence<int, V>>::loops
+template <template <int> class Loop, typename Seq>
+struct MergeLoopTable;
+
+template <template <int> class Loop, int... SH>
+struct MergeLoopTable<Loop, std::integer_sequence<int, SH...>>
+{
+  static constexpr MergeLoopFn loops[] = {Loop<SH>::run...};
+};
+
+#if defined(__x86_64__)
+
+template <int SH>
+struct MergeLoopSsse3
+{
+  __attribute__((target("ssse3"), no_sanitize("address"))) static void run(uint8_t *d, const uint8_t *s, size_t blocks)
+  {
+    const __m128i *sp = (const __m128i *)s;
+    __m128i *dp = (__m128i *)d;
+    if (SH == 0) // same alignment, no look ahead: block after last one may be on next page
+    {
+      for (size_t i = 0; i < blocks; i++)
+        _mm_store_si128(dp + i, _mm_load_si128(sp + i));
+      return;
+    }
+    __m128i lo = _mm_load_si128(sp);
+    for (size_t i = 0; i < blocks; i++)
+    {
+      __m128i hi = _mm_load_si128(sp + i + 1);
+      _mm_store_si128(dp + i, _mm_alignr_epi8(hi, lo, SH));
+      lo = hi;
+    }
+  }
+};
+
+template <int SH>
+struct MergeLoopAvx2
+{
+  __attribute__((target("avx2"), no_sanitize("address"))) static void run(uint8_t *d, const uint8_t *s, size_t blocks)
+  {
+    const __m256i *sp = (const __m256i *)s;
+    __m256i *dp = (__m256i *)d;
+    if (SH == 0)
+    {
+      for (size_t i = 0; i < blocks; i++)
+        _mm256_store_si256(dp + i, _mm256_load_si256(sp + i));
+      return;
+    }
+    __m256i lo = _mm256_load_si256(sp);
+    for (size_t i = 0; i < blocks; i++)
+    {
+      __m256i hi = _mm256_load_si256(sp + i + 1);
+      __m256i mid = _mm256_permute2x128_si256(lo, hi, 0x21); // [lo.high, hi.low]
+      __m256i out;
+      if constexpr (SH < 16)
+        out = _mm256_alignr_epi8(mid, lo, SH);
+      else
+        out = _mm256_alignr_epi8(hi, mid, SH - 16);
+      _mm256_store_si256(dp + i, out);
+      lo = hi;
+    }
+  }
+};
+
+void *shift_merge_memcpy_ssse3(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return shiftMergeCopy<16>(dst, src, len, MergeLoopTable<MergeLoopSsse3, std::make_integer_sequence<int, 16>>::loops);
+}
+
+void *shift_merge_memcpy_avx2(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return shiftMergeCopy<32>(dst, src, len, MergeLoopTable<MergeLoopAvx2, std::make_integer_sequence<int, 32>>::loops);
+}
+
+typedef void *(*MemcpyFn)(void *__restrict, const void *__restrict, size_t);
+
+IFUNC_RESOLVER MemcpyFn resolveShiftMergeMemcpy()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return shift_merge_memcpy_avx2;
+  if (__builtin_cpu_supports("ssse3"))
+    return shift_merge_memcpy_ssse3;
+  return (MemcpyFn)faster_memcopy;
+}
+
+#if defined(__ELF__)
+void *shift_merge_memcpy(void *__restrict dst, const void *__restrict src, size_t len) __attribute__((ifunc("resolveShiftMergeMemcpy")));
+#else
+static MemcpyFn shiftMergeMemcpyImpl = resolveShiftMergeMemcpy();
+
+void *shift_merge_memcpy(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return shiftMergeMemcpyImpl(dst, src, len);
+}
+#endif
+
+#elif defined(__ARM_NEON)
+
+template <int SH>
+struct MergeLoopNeon
+{
+  __attribute__((no_sanitize("address"))) static void run(uint8_t *d, const uint8_t *s, size_t blocks)
+  {
+    if (SH == 0)
+    {
+      for (size_t i = 0; i < blocks; i++)
+        vst1q_u8(d + 16 * i, vld1q_u8(s + 16 * i));
+      return;
+    }
+    uint8x16_t lo = vld1q_u8(s);
+    for (size_t i = 0; i < blocks; i++)
+    {
+      uint8x16_t hi = vld1q_u8(s + 16 * (i + 1));
+      vst1q_u8(d + 16 * i, vextq_u8(lo, hi, SH));
+      lo = hi;
+    }
+  }
+};
+
+void *shift_merge_memcpy(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return shiftMergeCopy<16>(dst, src, len, MergeLoopTable<MergeLoopNeon, std::make_integer_sequence<int, 16>>::loops);
+}
+
+#else
+
+// 64 bit shift merge of faster_memcopy is the portable variant
+void *shift_merge_memcpy(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return faster_memcopy(dst, src, len);
+}
+
+#endif
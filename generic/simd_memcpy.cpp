@@ -0,0 +1,532 @@
+// Vector memcpy and memmove with runtime ISA dispatch.
+//
+// Size classes (W = vector width: 16 SSE2/NEON, 32 AVX2, 64 AVX-512):
+// tiny   (<= 16 B)    : two possibly overlapping scalar loads/stores. For 13 bytes copy [0,8) and [5,13).
+//                       No loop and no byte by byte tail like fast_memcpy
+// small  (<= 2W)      : same trick with two vectors (head and tail) of the largest width that fits
+// medium (<= 8W)      : 4 or 8 vectors loaded from head and tail, all loads before stores, no loop
+// large  (> 8W)       : first vector stored unaligned, then destination is aligned to W and loop copies
+//                       4 vectors per iteration with aligned stores. Last 4W bytes stored from tail vectors.
+//                       Aligned stores never split cache line; misaligned loads are cheap on modern cores
+// Correct for all sizes and alignments since every access is either unaligned load/store or explicitly aligned.
+//
+// Streaming (x86 only): above a threshold derived from last level cache size (3/4 of it) the copy uses
+// non-temporal stores. Normal store of a line first reads it into cache (read for ownership), so a copy
+// moves 3 bytes over the memory bus per byte copied and leaves destination in cache, evicting everything
+// else. NT stores go through write combining buffers straight to memory: no RFO read and no eviction of
+// other data. Source is software prefetched ahead of the loads (T0, not NTA: prefetchnta keeps lines out of L2,
+// which defeats the L2 streamer and measured at half the bandwidth). NT stores are weakly ordered so the
+// copy ends with sfence. simd_memcpy_mode() lets caller force either behaviour regardless of size.
+//
+// Dispatch: on x86-64 ELF, simd_memcpy and simd_memmove are GNU ifuncs. Dynamic loader runs resolver once while relocating
+// and patches the PLT/GOT slot, so there is no per call branch or function pointer load in our code.
+// Elsewhere (ARM etc) the 16 byte variant is used directly.
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include "mem_operation.h"
+#include "simd_vec.h"
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#define STREAM_MIN_SIZE 512            // forced streaming below this size is not worth the fence
+#define STREAM_PREFETCH_DISTANCE 512   // bytes ahead of current load. Hardware prefetcher does most of the work,
+                                       // larger distances measured slower
+#define DEFAULT_LLC_SIZE (8 << 20)     // if cache size can't be detected
+
+ALWAYS_INLINE void copyTiny(uint8_t *d, const uint8_t *s, size_t n)
+{
+  // n <= 16. Pair of overlapping loads covers every size in [k, 2k] with two accesses of size k
+  if (n >= 8)
+  {
+    uint64_t head = loadScalar<uint64_t>(s);
+    uint64_t tail = loadScalar<uint64_t>(s + n - 8);
+    storeScalar<uint64_t>(d, head);
+    storeScalar<uint64_t>(d + n - 8, tail);
+  }
+  else if (n >= 4)
+  {
+    uint32_t head = loadScalar<uint32_t>(s);
+    uint32_t tail = loadScalar<uint32_t>(s + n - 4);
+    storeScalar<uint32_t>(d, head);
+    storeScalar<uint32_t>(d + n - 4, tail);
+  }
+  else if (n >= 2)
+  {
+    uint16_t head = loadScalar<uint16_t>(s);
+    uint16_t tail = loadScalar<uint16_t>(s + n - 2);
+    storeScalar<uint16_t>(d, head);
+    storeScalar<uint16_t>(d + n - 2, tail);
+  }
+  else if (n)
+  {
+    *d = *s;
+  }
+}
+
+// V <= n <= 2V
+template <size_t V>
+ALWAYS_INLINE void copyHeadTail(uint8_t *d, const uint8_t *s, size_t n)
+{
+  typename VecOf<V>::Type head = vecLoad<V>(s);
+  typename VecOf<V>::Type tail = vecLoad<V>(s + n - V);
+  vecStore<V>(d, head);
+  vecStore<V>(d + n - V, tail);
+}
+
+// n <= 2W: pick largest width V such that V <= n
+template <size_t W>
+ALWAYS_INLINE void copySmall(uint8_t *d, const uint8_t *s, size_t n)
+{
+  if (W >= 64 && n > 64)
+    copyHeadTail<(W >= 64 ? 64 : 16)>(d, s, n);
+  else if (W >= 32 && n > 32)
+    copyHeadTail<(W >= 32 ? 32 : 16)>(d, s, n);
+  else
+    copyHeadTail<16>(d, s, n);
+}
+
+// 2W < n <= 8W
+template <size_t W>
+ALWAYS_INLINE void copyMedium(uint8_t *d, const uint8_t *s, size_t n)
+{
+  typedef typename VecOf<W>::Type Vec;
+  if (n <= 4 * W)
+  {
+    Vec v0 = vecLoad<W>(s);
+    Vec v1 = vecLoad<W>(s + W);
+    Vec v2 = vecLoad<W>(s + n - 2 * W);
+    Vec v3 = vecLoad<W>(s + n - W);
+    vecStore<W>(d, v0);
+    vecStore<W>(d + W, v1);
+    vecStore<W>(d + n - 2 * W, v2);
+    vecStore<W>(d + n - W, v3);
+    return;
+  }
+  Vec v0 = vecLoad<W>(s);
+  Vec v1 = vecLoad<W>(s + W);
+  Vec v2 = vecLoad<W>(s + 2 * W);
+  Vec v3 = vecLoad<W>(s + 3 * W);
+  Vec v4 = vecLoad<W>(s + n - 4 * W);
+  Vec v5 = vecLoad<W>(s + n - 3 * W);
+  Vec v6 = vecLoad<W>(s + n - 2 * W);
+  Vec v7 = vecLoad<W>(s + n - W);
+  vecStore<W>(d, v0);
+  vecStore<W>(d + W, v1);
+  vecStore<W>(d + 2 * W, v2);
+  vecStore<W>(d + 3 * W, v3);
+  vecStore<W>(d + n - 4 * W, v4);
+  vecStore<W>(d + n - 3 * W, v5);
+  vecStore<W>(d + n - 2 * W, v6);
+  vecStore<W>(d + n - W, v7);
+}
+
+// n > 8W
+template <size_t W>
+ALWAYS_INLINE void copyLarge(uint8_t *d, const uint8_t *s, size_t n)
+{
+  typedef typename VecOf<W>::Type Vec;
+  // tail and head are loaded up front; stored last so that loop can run over them freely
+  Vec head = vecLoad<W>(s);
+  Vec t0 = vecLoad<W>(s + n - 4 * W);
+  Vec t1 = vecLoad<W>(s + n - 3 * W);
+  Vec t2 = vecLoad<W>(s + n - 2 * W);
+  Vec t3 = vecLoad<W>(s + n - W);
+  uint8_t *dEnd = d + n;
+
+  // align destination: skip 1..W bytes, they are covered by head
+  size_t skip = W - ((uintptr_t)d & (W - 1));
+  uint8_t *dp = d + skip;
+  const uint8_t *sp = s + skip;
+  // n > 8W and skip <= W, so loop runs at least once. Remaining <= 4W bytes are covered by tail vectors
+  while ((size_t)(dEnd - dp) > 4 * W)
+  {
+    Vec v0 = vecLoad<W>(sp);
+    Vec v1 = vecLoad<W>(sp + W);
+    Vec v2 = vecLoad<W>(sp + 2 * W);
+    Vec v3 = vecLoad<W>(sp + 3 * W);
+    vecStoreAligned<W>(dp, v0);
+    vecStoreAligned<W>(dp + W, v1);
+    vecStoreAligned<W>(dp + 2 * W, v2);
+    vecStoreAligned<W>(dp + 3 * W, v3);
+    dp += 4 * W;
+    sp += 4 * W;
+  }
+  vecStore<W>(dEnd - 4 * W, t0);
+  vecStore<W>(dEnd - 3 * W, t1);
+  vecStore<W>(dEnd - 2 * W, t2);
+  vecStore<W>(dEnd - W, t3);
+  vecStore<W>(d, head);
+}
+
+template <size_t W>
+ALWAYS_INLINE void *copyVec(void *__restrict dst, const void *__restrict src, size_t n)
+{
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  if (n <= 16)
+    copyTiny(d, s, n);
+  else if (n <= 2 * W)
+    copySmall<W>(d, s, n);
+  else if (n <= 8 * W)
+    copyMedium<W>(d, s, n);
+  else
+    copyLarge<W>(d, s, n);
+  return dst;
+}
+
+// ---------------- memmove ----------------
+// Size classes up to 8W load everything before storing anything, so they are already safe for overlap.
+// Large moves run forward when dst is below src (copyLarge: loop reads ahead of what it writes) and
+// backward when dst is above src. Each iteration loads its 4 vectors before storing them, and earlier
+// iterations only stored over source bytes already read, so overlap distance can be anything, even
+// 1 byte, shorter than the vector. No __restrict anywhere on this path.
+
+// n > 8W, d > s. Mirror of copyLarge
+template <size_t W>
+ALWAYS_INLINE void moveLargeBackward(uint8_t *d, const uint8_t *s, size_t n)
+{
+  typedef typename VecOf<W>::Type Vec;
+  Vec h0 = vecLoad<W>(s);
+  Vec h1 = vecLoad<W>(s + W);
+  Vec h2 = vecLoad<W>(s + 2 * W);
+  Vec h3 = vecLoad<W>(s + 3 * W);
+  Vec tail = vecLoad<W>(s + n - W);
+
+  // align end of destination down: skipped 0..W-1 bytes are covered by tail
+  size_t skip = (uintptr_t)(d + n) & (W - 1);
+  uint8_t *dp = d + n - skip;
+  const uint8_t *sp = s + n - skip;
+  while ((size_t)(dp - d) > 4 * W)
+  {
+    Vec v0 = vecLoad<W>(sp - W);
+    Vec v1 = vecLoad<W>(sp - 2 * W);
+    Vec v2 = vecLoad<W>(sp - 3 * W);
+    Vec v3 = vecLoad<W>(sp - 4 * W);
+    vecStoreAligned<W>(dp - W, v0);
+    vecStoreAligned<W>(dp - 2 * W, v1);
+    vecStoreAligned<W>(dp - 3 * W, v2);
+    vecStoreAligned<W>(dp - 4 * W, v3);
+    dp -= 4 * W;
+    sp -= 4 * W;
+  }
+  vecStore<W>(d, h0);
+  vecStore<W>(d + W, h1);
+  vecStore<W>(d + 2 * W, h2);
+  vecStore<W>(d + 3 * W, h3);
+  vecStore<W>(d + n - W, tail);
+}
+
+template <size_t W>
+ALWAYS_INLINE void *moveVec(void *dst, const void *src, size_t n)
+{
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  if (n <= 16)
+    copyTiny(d, s, n);
+  else if (n <= 2 * W)
+    copySmall<W>(d, s, n);
+  else if (n <= 8 * W)
+    copyMedium<W>(d, s, n);
+  else if ((uintptr_t)d - (uintptr_t)s >= n) // dst below src (wraps around) or no overlap
+    copyLarge<W>(d, s, n);
+  else if (d != s)
+    moveLargeBackward<W>(d, s, n);
+  return dst;
+}
+
+// ---------------- streaming threshold ----------------
+
+static std::atomic<size_t> streamThreshold(0); // 0 = not detected yet
+
+static size_t detectLlcSize()
+{
+  long size = 0;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+  size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (size <= 0)
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+#if defined(__x86_64__)
+  // sysconf unsupported: cpuid leaf 4 (deterministic cache parameters) lists every cache, keep the largest
+  unsigned int a, b, c, d;
+  bool useCpuid = size <= 0 && __get_cpuid_max(0, NULL) >= 4;
+  for (unsigned int i = 0; useCpuid; i++)
+  {
+    __cpuid_count(4, i, a, b, c, d);
+    if ((a & 0x1f) == 0) // no more caches
+      break;
+    long ways = ((b >> 22) & 0x3ff) + 1;
+    long partitions = ((b >> 12) & 0x3ff) + 1;
+    long lineSize = (b & 0xfff) + 1;
+    long sets = (long)c + 1;
+    long levelSize = ways * partitions * lineSize * sets;
+    if (levelSize > size)
+      size = levelSize;
+  }
+#endif
+  return size > 0 ? (size_t)size : DEFAULT_LLC_SIZE;
+}
+
+size_t simd_memcpy_stream_threshold()
+{
+  size_t t = streamThreshold.load(std::memory_order_relaxed);
+  if (t == 0)
+  {
+    // copy larger than this can't stay in cache anyway, it would only evict everything else.
+    // Racing threads compute the same value so plain store is fine
+    t = detectLlcSize() / 4 * 3;
+    streamThreshold.store(t, std::memory_order_relaxed);
+  }
+  return t;
+}
+
+void simd_memcpy_set_stream_threshold(size_t bytes)
+{
+  streamThreshold.store(bytes ? bytes : 1, std::memory_order_relaxed);
+}
+
+#if defined(__x86_64__)
+
+typedef void *(*MemcpyFn)(void *__restrict, const void *__restrict, size_t);
+typedef void (*StreamLoopFn)(uint8_t *, const uint8_t *, size_t);
+
+// ---------------- non temporal loops ----------------
+// d is 64 byte aligned and n is multiple of 64: every iteration writes one full cache line,
+// so write combining buffer is flushed as a complete line without reading it from memory.
+// Prefetch beyond end of source is harmless, prefetch never faults
+
+static void streamLoopSse2(uint8_t *d, const uint8_t *s, size_t n)
+{
+  for (size_t i = 0; i < n; i += 64)
+  {
+    _mm_prefetch((const char *)s + i + STREAM_PREFETCH_DISTANCE, _MM_HINT_T0);
+    __m128i v0 = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(s + i + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i *)(s + i + 32));
+    __m128i v3 = _mm_loadu_si128((const __m128i *)(s + i + 48));
+    _mm_stream_si128((__m128i *)(d + i), v0);
+    _mm_stream_si128((__m128i *)(d + i + 16), v1);
+    _mm_stream_si128((__m128i *)(d + i + 32), v2);
+    _mm_stream_si128((__m128i *)(d + i + 48), v3);
+  }
+}
+
+__attribute__((target("avx2"))) static void streamLoopAvx2(uint8_t *d, const uint8_t *s, size_t n)
+{
+  for (size_t i = 0; i < n; i += 64)
+  {
+    _mm_prefetch((const char *)s + i + STREAM_PREFETCH_DISTANCE, _MM_HINT_T0);
+    __m256i v0 = _mm256_loadu_si256((const __m256i *)(s + i));
+    __m256i v1 = _mm256_loadu_si256((const __m256i *)(s + i + 32));
+    _mm256_stream_si256((__m256i *)(d + i), v0);
+    _mm256_stream_si256((__m256i *)(d + i + 32), v1);
+  }
+}
+
+__attribute__((target("avx512f"))) static void streamLoopAvx512(uint8_t *d, const uint8_t *s, size_t n)
+{
+  for (size_t i = 0; i < n; i += 64)
+  {
+    _mm_prefetch((const char *)s + i + STREAM_PREFETCH_DISTANCE, _MM_HINT_T0);
+    __m512i v = _mm512_loadu_si512(s + i);
+    _mm512_stream_si512((__m512i *)(d + i), v);
+  }
+}
+
+// unaligned head and partial tail line go through normal cached copy, body is streamed
+static void *copyStreaming(void *dst, const void *src, size_t n, StreamLoopFn loop, MemcpyFn cached)
+{
+  if (n < STREAM_MIN_SIZE)
+    return cached(dst, src, n);
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  size_t head = (0 - (uintptr_t)d) & 63;
+  size_t body = (n - head) & ~(size_t)63;
+  cached(d, s, head);
+  loop(d + head, s + head, body);
+  cached(d + head + body, s + head + body, n - head - body);
+  // NT stores may become visible after later stores; fence so that e.g. a "data ready" flag
+  // written after the copy can't be seen before the data
+  _mm_sfence();
+  return dst;
+}
+
+// ---------------- per ISA entry points ----------------
+
+static void *cachedSse2(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return copyVec<16>(dst, src, len);
+}
+
+__attribute__((target("avx2"))) static void *cachedAvx2(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return copyVec<32>(dst, src, len);
+}
+
+__attribute__((target("avx512f"))) static void *cachedAvx512(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return copyVec<64>(dst, src, len);
+}
+
+static void *streamSse2(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return copyStreaming(dst, src, len, streamLoopSse2, cachedSse2);
+}
+
+static void *streamAvx2(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return copyStreaming(dst, src, len, streamLoopAvx2, cachedAvx2);
+}
+
+static void *streamAvx512(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return copyStreaming(dst, src, len, streamLoopAvx512, cachedAvx512);
+}
+
+// threshold is only looked at for large copies, small ones pay nothing
+void *memcpy_sse2(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  if (len > 8 * 16 && len >= simd_memcpy_stream_threshold())
+    return streamSse2(dst, src, len);
+  return copyVec<16>(dst, src, len);
+}
+
+__attribute__((target("avx2"))) void *memcpy_avx2(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  if (len > 8 * 32 && len >= simd_memcpy_stream_threshold())
+    return streamAvx2(dst, src, len);
+  return copyVec<32>(dst, src, len);
+}
+
+__attribute__((target("avx512f"))) void *memcpy_avx512(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  if (len > 8 * 64 && len >= simd_memcpy_stream_threshold())
+    return streamAvx512(dst, src, len);
+  return copyVec<64>(dst, src, len);
+}
+
+IFUNC_RESOLVER MemcpyFn resolveSimdMemcpy()
+{
+  // ifunc resolver runs before constructors, cpu model must be initialized explicitly
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return memcpy_avx512;
+  if (__builtin_cpu_supports("avx2"))
+    return memcpy_avx2;
+  return memcpy_sse2;
+}
+
+#if defined(__ELF__)
+void *simd_memcpy(void *__restrict dst, const void *__restrict src, size_t len) __attribute__((ifunc("resolveSimdMemcpy")));
+#else
+static MemcpyFn simdMemcpyImpl = resolveSimdMemcpy();
+
+void *simd_memcpy(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return simdMemcpyImpl(dst, src, len);
+}
+#endif
+
+const char *simd_memcpy_isa()
+{
+  MemcpyFn fn = resolveSimdMemcpy();
+  return fn == memcpy_avx512 ? "avx512" : (fn == memcpy_avx2 ? "avx2" : "sse2");
+}
+
+void *memmove_sse2(void *dst, const void *src, size_t len)
+{
+  return moveVec<16>(dst, src, len);
+}
+
+__attribute__((target("avx2"))) void *memmove_avx2(void *dst, const void *src, size_t len)
+{
+  return moveVec<32>(dst, src, len);
+}
+
+__attribute__((target("avx512f"))) void *memmove_avx512(void *dst, const void *src, size_t len)
+{
+  return moveVec<64>(dst, src, len);
+}
+
+typedef void *(*MemmoveFn)(void *, const void *, size_t);
+
+IFUNC_RESOLVER MemmoveFn resolveSimdMemmove()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return memmove_avx512;
+  if (__builtin_cpu_supports("avx2"))
+    return memmove_avx2;
+  return memmove_sse2;
+}
+
+#if defined(__ELF__)
+void *simd_memmove(void *dst, const void *src, size_t len) __attribute__((ifunc("resolveSimdMemmove")));
+#else
+static MemmoveFn simdMemmoveImpl = resolveSimdMemmove();
+
+void *simd_memmove(void *dst, const void *src, size_t len)
+{
+  return simdMemmoveImpl(dst, src, len);
+}
+#endif
+
+typedef struct
+{
+  MemcpyFn cached;
+  MemcpyFn streaming;
+} CopyModeImpl;
+
+static CopyModeImpl resolveCopyModeImpl()
+{
+  if (__builtin_cpu_supports("avx512f"))
+    return {cachedAvx512, streamAvx512};
+  if (__builtin_cpu_supports("avx2"))
+    return {cachedAvx2, streamAvx2};
+  return {cachedSse2, streamSse2};
+}
+
+void *simd_memcpy_mode(void *__restrict dst, const void *__restrict src, size_t len, CopyMode mode)
+{
+  static const CopyModeImpl impl = resolveCopyModeImpl();
+  if (mode == COPY_CACHED)
+    return impl.cached(dst, src, len);
+  if (mode == COPY_STREAMING)
+    return impl.streaming(dst, src, len);
+  return simd_memcpy(dst, src, len);
+}
+
+#else
+
+void *simd_memcpy(void *__restrict dst, const void *__restrict src, size_t len)
+{
+  return copyVec<16>(dst, src, len);
+}
+
+void *simd_memmove(void *dst, const void *src, size_t len)
+{
+  return moveVec<16>(dst, src, len);
+}
+
+// no non temporal path here (ARM would need STNP), every mode is a cached copy
+void *simd_memcpy_mode(void *__restrict dst, const void *__restrict src, size_t len, CopyMode mode)
+{
+  (void)mode;
+  return copyVec<16>(dst, src, len);
+}
+
+const char *simd_memcpy_isa()
+{
+#if defined(__ARM_NEON)
+  return "neon";
+#else
+  return "generic16";
+#endif
+}
+
+#endif
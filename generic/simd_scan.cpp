@@ -0,0 +1,589 @@
+// Vector memset, memcmp, memchr, strlen and multi byte memchr (first byte from a delimiter set),
+// with runtime ISA dispatch like simd_memcpy.cpp (GNU ifunc on x86-64 ELF: SSE2, AVX2, AVX-512BW).
+//
+// memset uses the width generic vector helpers of simd_vec.h, same size classes as simd_memcpy.
+// Scanning needs compare + movemask which GCC vector extension can't express, so those kernels are
+// templates over an ISA ops struct (Sse2Ops, Avx2Ops, Avx512Ops) whose members carry the target attribute.
+// Kernel is always_inline into a target function, ops are then inlined there too: no calls in the loop.
+//
+// Page safety: memchr, strlen and memchr_any only do aligned W byte loads. First load is the aligned block
+// holding the first byte and match bits before it are shifted out; last load may run past the end, but an
+// aligned block never straddles a page, so no load touches a page that holds no byte of the buffer.
+// memcmp has two pointers that can't both be aligned: it loads unaligned but only inside [0, len),
+// using an overlapping last vector. Below W bytes it loads a full vector only when that can't cross into
+// next page, else compares bytes. Reads outside the buffer (inside the same page) are intended, so address
+// sanitizer is disabled on these functions.
+//
+// Multi byte memchr uses nibble lookup ("shufti"): high nibbles present in the set get one bit each (up to 8),
+// lo[l] holds bits of high nibbles h for which byte (h << 4 | l) is in the set, hi[h] holds bit of h.
+// Byte b is in the set iff lo[b & 15] & hi[b >> 4] != 0: two pshufb, one and, one compare per vector,
+// for any set size. Sets with more than 8 distinct high nibbles fall back to a 256 bit bitmap.
+// SSE2 has no pshufb: compares against each set byte (up to 16) and ORs the masks.
+
+#include <stdint.h>
+#include <string.h>
+#include "mem_operation.h"
+#include "simd_vec.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define PAGE_SIZE_MIN 4096    // smallest page size, page crossing checks use it
+#define MAX_COMPARE_SET 16    // SSE2 multi byte memchr: set bytes compared one by one
+#define MAX_NIBBLE_BUCKETS 8  // shufti: bits available per table byte
+
+// scan kernels and ISA ops are inlined into the entry points, which read past buffers on purpose.
+// GCC won't inline across different sanitizer settings, so helpers carry the same no_sanitize.
+// Ops members are not forced inline: that would be tried inside the kernel template, which lacks the target
+#define SCAN_LAMBDA __attribute__((always_inline, no_sanitize("address")))
+#define SCAN_INLINE SCAN_LAMBDA inline
+#define SCAN_OP __attribute__((no_sanitize("address"))) inline
+
+// ---------------- delimiter set ----------------
+
+typedef struct
+{
+  uint64_t bitmap[4];          // scalar fallback, bit b set if byte b is in set
+  uint8_t lo[16];              // shufti tables
+  uint8_t hi[16];
+  bool shuftiExact;            // at most 8 distinct high nibbles
+  uint8_t chars[MAX_COMPARE_SET]; // distinct bytes, for SSE2
+  size_t numChars;             // > MAX_COMPARE_SET means too many for compare path
+} DelimSet;
+
+static void buildDelimSet(DelimSet *ds, const char *set, size_t setLen)
+{
+  memset(ds, 0, sizeof(*ds));
+  for (size_t i = 0; i < setLen; i++)
+  {
+    uint8_t b = (uint8_t)set[i];
+    if (ds->bitmap[b >> 6] & (1ULL << (b & 63)))
+      continue; // duplicate
+    ds->bitmap[b >> 6] |= 1ULL << (b & 63);
+    if (ds->numChars < MAX_COMPARE_SET)
+      ds->chars[ds->numChars] = b;
+    ds->numChars++;
+  }
+  int buckets = 0;
+  for (int h = 0; h < 16; h++)
+  {
+    uint16_t lowsOfH = (uint16_t)(ds->bitmap[h >> 2] >> ((h & 3) * 16)); // bytes h0..hF
+    if (!lowsOfH)
+      continue;
+    if (buckets == MAX_NIBBLE_BUCKETS)
+    {
+      ds->shuftiExact = false;
+      return;
+    }
+    uint8_t bit = 1 << buckets++;
+    ds->hi[h] = bit;
+    for (int l = 0; l < 16; l++)
+    {
+      if (lowsOfH & (1 << l))
+        ds->lo[l] |= bit;
+    }
+  }
+  ds->shuftiExact = true;
+}
+
+static const uint8_t *findAnyScalar(const uint8_t *p, size_t len, const DelimSet *ds)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    if (ds->bitmap[p[i] >> 6] & (1ULL << (p[i] & 63)))
+      return p + i;
+  }
+  return NULL;
+}
+
+// ---------------- memset ----------------
+
+template <size_t V>
+ALWAYS_INLINE void setHeadTail(uint8_t *d, const typename VecOf<V>::Type &v, size_t n)
+{
+  vecStore<V>(d, v);
+  vecStore<V>(d + n - V, v);
+}
+
+template <size_t W>
+ALWAYS_INLINE void *setVec(void *dst, int c, size_t n)
+{
+  typedef typename VecOf<W>::Type Vec;
+  uint8_t *d = (uint8_t *)dst;
+  if (n <= 16)
+  {
+    // overlapping scalar stores like copyTiny
+    uint64_t pattern = 0x0101010101010101ULL * (uint8_t)c;
+    if (n >= 8)
+    {
+      storeScalar<uint64_t>(d, pattern);
+      storeScalar<uint64_t>(d + n - 8, pattern);
+    }
+    else if (n >= 4)
+    {
+      storeScalar<uint32_t>(d, (uint32_t)pattern);
+      storeScalar<uint32_t>(d + n - 4, (uint32_t)pattern);
+    }
+    else if (n >= 2)
+    {
+      storeScalar<uint16_t>(d, (uint16_t)pattern);
+      storeScalar<uint16_t>(d + n - 2, (uint16_t)pattern);
+    }
+    else if (n)
+    {
+      *d = (uint8_t)c;
+    }
+    return dst;
+  }
+  Vec v = (Vec){} + (uint8_t)c;
+  if (n <= 2 * W)
+  {
+    if (W >= 64 && n > 64)
+      setHeadTail<(W >= 64 ? 64 : 16)>(d, (typename VecOf<(W >= 64 ? 64 : 16)>::Type){} + (uint8_t)c, n);
+    else if (W >= 32 && n > 32)
+      setHeadTail<(W >= 32 ? 32 : 16)>(d, (typename VecOf<(W >= 32 ? 32 : 16)>::Type){} + (uint8_t)c, n);
+    else
+      setHeadTail<16>(d, (typename VecOf<16>::Type){} + (uint8_t)c, n);
+    return dst;
+  }
+  uint8_t *dEnd = d + n;
+  if (n <= 4 * W)
+  {
+    vecStore<W>(d, v);
+    vecStore<W>(d + W, v);
+    vecStore<W>(dEnd - 2 * W, v);
+    vecStore<W>(dEnd - W, v);
+    return dst;
+  }
+  // head unaligned, body aligned 4 vectors at a time, last 4W bytes unaligned from the end
+  vecStore<W>(d, v);
+  uint8_t *dp = d + W - ((uintptr_t)d & (W - 1));
+  while ((size_t)(dEnd - dp) > 4 * W)
+  {
+    vecStoreAligned<W>(dp, v);
+    vecStoreAligned<W>(dp + W, v);
+    vecStoreAligned<W>(dp + 2 * W, v);
+    vecStoreAligned<W>(dp + 3 * W, v);
+    dp += 4 * W;
+  }
+  vecStore<W>(dEnd - 4 * W, v);
+  vecStore<W>(dEnd - 3 * W, v);
+  vecStore<W>(dEnd - 2 * W, v);
+  vecStore<W>(dEnd - W, v);
+  return dst;
+}
+
+#if defined(__x86_64__)
+
+// ---------------- ISA ops ----------------
+
+struct Sse2Ops
+{
+  typedef __m128i Vec;
+  static const size_t W = 16;
+  static const uint64_t ALL = 0xffff;
+  static const bool HAS_SHUFFLE = false;
+  static SCAN_OP Vec load(const void *p) { return _mm_load_si128((const __m128i *)p); }
+  static SCAN_OP Vec loadu(const void *p) { return _mm_loadu_si128((const __m128i *)p); }
+  static SCAN_OP Vec set1(uint8_t c) { return _mm_set1_epi8((char)c); }
+  static SCAN_OP uint64_t eqMask(Vec a, Vec b) { return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)); }
+  // no table()/inSetMask(): pshufb is SSSE3
+};
+
+#define AVX2 __attribute__((target("avx2")))
+struct Avx2Ops
+{
+  typedef __m256i Vec;
+  static const size_t W = 32;
+  static const uint64_t ALL = 0xffffffff;
+  static const bool HAS_SHUFFLE = true;
+  AVX2 static SCAN_OP Vec load(const void *p) { return _mm256_load_si256((const __m256i *)p); }
+  AVX2 static SCAN_OP Vec loadu(const void *p) { return _mm256_loadu_si256((const __m256i *)p); }
+  AVX2 static SCAN_OP Vec set1(uint8_t c) { return _mm256_set1_epi8((char)c); }
+  AVX2 static SCAN_OP uint64_t eqMask(Vec a, Vec b) { return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)); }
+  // 16 byte table in both lanes, vpshufb looks up inside each lane
+  AVX2 static SCAN_OP Vec table(const uint8_t *t) { return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t)); }
+  AVX2 static SCAN_OP uint64_t inSetMask(Vec v, Vec lo, Vec hi)
+  {
+    Vec nibble = _mm256_set1_epi8(0x0f);
+    Vec lowBits = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, nibble));
+    Vec highBits = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    return ~eqMask(_mm256_and_si256(lowBits, highBits), _mm256_setzero_si256()) & ALL;
+  }
+};
+#undef AVX2
+
+#define AVX512 __attribute__((target("avx512bw")))
+struct Avx512Ops
+{
+  typedef __m512i Vec;
+  static const size_t W = 64;
+  static const uint64_t ALL = ~0ULL;
+  static const bool HAS_SHUFFLE = true;
+  AVX512 static SCAN_OP Vec load(const void *p) { return _mm512_load_si512(p); }
+  AVX512 static SCAN_OP Vec loadu(const void *p) { return _mm512_loadu_si512(p); }
+  AVX512 static SCAN_OP Vec set1(uint8_t c) { return _mm512_set1_epi8((char)c); }
+  AVX512 static SCAN_OP uint64_t eqMask(Vec a, Vec b) { return _mm512_cmpeq_epi8_mask(a, b); }
+  AVX512 static SCAN_OP Vec table(const uint8_t *t)
+  {
+    return _mm512_mask_broadcast_i32x4(_mm512_setzero_si512(), (__mmask16)-1, _mm_loadu_si128((const __m128i *)t));
+  }
+  AVX512 static SCAN_OP uint64_t inSetMask(Vec v, Vec lo, Vec hi)
+  {
+    Vec nibble = _mm512_set1_epi8(0x0f);
+    Vec lowBits = _mm512_shuffle_epi8(lo, _mm512_and_si512(v, nibble));
+    Vec highBits = _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi16(v, 4), nibble));
+    return _mm512_test_epi8_mask(lowBits, highBits);
+  }
+};
+#undef AVX512
+
+// ---------------- scanning kernels ----------------
+
+// first position in [p, p + len) where maskOf(aligned block) has a bit set, NULL if none
+template <class Isa, class MaskFn>
+SCAN_INLINE const uint8_t *scanAligned(const uint8_t *p, size_t len, MaskFn maskOf)
+{
+  if (len == 0)
+    return NULL;
+  const size_t W = Isa::W;
+  const uint8_t *end = p + len;
+  size_t off = (uintptr_t)p & (W - 1);
+  const uint8_t *block = p - off;
+  uint64_t m = maskOf(Isa::load(block)) >> off; // drop bytes before p
+  while (!m)
+  {
+    block += W;
+    if (block >= end)
+      return NULL;
+    m = maskOf(Isa::load(block));
+    off = 0;
+  }
+  const uint8_t *hit = block + off + __builtin_ctzll(m);
+  return hit < end ? hit : NULL;
+}
+
+template <class Isa>
+SCAN_INLINE const uint8_t *findByte(const uint8_t *p, uint8_t c, size_t len)
+{
+  typename Isa::Vec needle = Isa::set1(c);
+  return scanAligned<Isa>(p, len, [&](const typename Isa::Vec &v) SCAN_LAMBDA { return Isa::eqMask(v, needle); });
+}
+
+template <class Isa>
+SCAN_INLINE size_t stringLength(const char *s)
+{
+  const size_t W = Isa::W;
+  const uint8_t *p = (const uint8_t *)s;
+  size_t off = (uintptr_t)p & (W - 1);
+  const uint8_t *block = p - off;
+  typename Isa::Vec zero = Isa::set1(0);
+  uint64_t m = Isa::eqMask(Isa::load(block), zero) >> off;
+  if (m)
+    return __builtin_ctzll(m);
+  for (;;)
+  {
+    block += W;
+    m = Isa::eqMask(Isa::load(block), zero);
+    if (m)
+      return block + __builtin_ctzll(m) - p;
+  }
+}
+
+template <class Isa>
+SCAN_INLINE const uint8_t *findAny(const uint8_t *p, size_t len, const DelimSet *ds)
+{
+  typedef typename Isa::Vec Vec;
+  if (ds->numChars == 0)
+    return NULL;
+  if (ds->numChars == 1)
+    return findByte<Isa>(p, ds->chars[0], len);
+  if constexpr (Isa::HAS_SHUFFLE)
+  {
+    if (ds->shuftiExact)
+    {
+      Vec lo = Isa::table(ds->lo);
+      Vec hi = Isa::table(ds->hi);
+      return scanAligned<Isa>(p, len, [&](const Vec &v) SCAN_LAMBDA { return Isa::inSetMask(v, lo, hi); });
+    }
+  }
+  else
+  {
+    if (ds->numChars <= MAX_COMPARE_SET)
+    {
+      Vec needles[MAX_COMPARE_SET];
+      size_t num = ds->numChars;
+      for (size_t i = 0; i < num; i++)
+        needles[i] = Isa::set1(ds->chars[i]);
+      return scanAligned<Isa>(p, len, [&](const Vec &v) SCAN_LAMBDA {
+        uint64_t m = 0;
+        for (size_t i = 0; i < num; i++)
+          m |= Isa::eqMask(v, needles[i]);
+        return m;
+      });
+    }
+  }
+  return findAnyScalar(p, len, ds);
+}
+
+SCAN_INLINE bool loadStaysInPage(const void *p, size_t w)
+{
+  return ((uintptr_t)p & (PAGE_SIZE_MIN - 1)) <= PAGE_SIZE_MIN - w;
+}
+
+template <class Isa>
+SCAN_INLINE int compareBytes(const uint8_t *a, const uint8_t *b, size_t len)
+{
+  const size_t W = Isa::W;
+  uint64_t diff;
+  size_t base;
+  if (len == 0) // pointer may be one past a page end, nothing may be loaded
+    return 0;
+  if (len < W)
+  {
+    if (!loadStaysInPage(a, W) || !loadStaysInPage(b, W))
+    {
+      for (size_t i = 0; i < len; i++)
+      {
+        if (a[i] != b[i])
+          return a[i] - b[i];
+      }
+      return 0;
+    }
+    // bytes past len are loaded but masked out
+    uint64_t valid = ~0ULL >> (64 - len);
+    diff = ~Isa::eqMask(Isa::loadu(a), Isa::loadu(b)) & valid;
+    base = 0;
+  }
+  else
+  {
+    size_t i = 0;
+    diff = 0;
+    for (; i + W <= len; i += W)
+    {
+      diff = ~Isa::eqMask(Isa::loadu(a + i), Isa::loadu(b + i)) & Isa::ALL;
+      if (diff)
+        break;
+    }
+    base = i;
+    if (!diff && i != len)
+    {
+      // last W bytes, overlapping bytes already known equal
+      base = len - W;
+      diff = ~Isa::eqMask(Isa::loadu(a + base), Isa::loadu(b + base)) & Isa::ALL;
+    }
+  }
+  if (!diff)
+    return 0;
+  size_t idx = base + __builtin_ctzll(diff);
+  return a[idx] - b[idx];
+}
+
+// ---------------- per ISA entry points ----------------
+
+#define SCAN_FN(isa) __attribute__((target(isa), no_sanitize("address"))) static
+
+static void *memset_sse2(void *dst, int c, size_t len)
+{
+  return setVec<16>(dst, c, len);
+}
+
+__attribute__((target("avx2"))) static void *memset_avx2(void *dst, int c, size_t len)
+{
+  return setVec<32>(dst, c, len);
+}
+
+__attribute__((target("avx512bw"))) static void *memset_avx512(void *dst, int c, size_t len)
+{
+  return setVec<64>(dst, c, len);
+}
+
+SCAN_FN("sse2") int memcmp_sse2(const void *a, const void *b, size_t len)
+{
+  return compareBytes<Sse2Ops>((const uint8_t *)a, (const uint8_t *)b, len);
+}
+
+SCAN_FN("avx2") int memcmp_avx2(const void *a, const void *b, size_t len)
+{
+  return compareBytes<Avx2Ops>((const uint8_t *)a, (const uint8_t *)b, len);
+}
+
+SCAN_FN("avx512bw") int memcmp_avx512(const void *a, const void *b, size_t len)
+{
+  return compareBytes<Avx512Ops>((const uint8_t *)a, (const uint8_t *)b, len);
+}
+
+SCAN_FN("sse2") void *memchr_sse2(const void *s, int c, size_t len)
+{
+  return (void *)findByte<Sse2Ops>((const uint8_t *)s, (uint8_t)c, len);
+}
+
+SCAN_FN("avx2") void *memchr_avx2(const void *s, int c, size_t len)
+{
+  return (void *)findByte<Avx2Ops>((const uint8_t *)s, (uint8_t)c, len);
+}
+
+SCAN_FN("avx512bw") void *memchr_avx512(const void *s, int c, size_t len)
+{
+  return (void *)findByte<Avx512Ops>((const uint8_t *)s, (uint8_t)c, len);
+}
+
+SCAN_FN("sse2") size_t strlen_sse2(const char *s)
+{
+  return stringLength<Sse2Ops>(s);
+}
+
+SCAN_FN("avx2") size_t strlen_avx2(const char *s)
+{
+  return stringLength<Avx2Ops>(s);
+}
+
+SCAN_FN("avx512bw") size_t strlen_avx512(const char *s)
+{
+  return stringLength<Avx512Ops>(s);
+}
+
+SCAN_FN("sse2") const uint8_t *findany_sse2(const uint8_t *p, size_t len, const DelimSet *ds)
+{
+  return findAny<Sse2Ops>(p, len, ds);
+}
+
+SCAN_FN("avx2") const uint8_t *findany_avx2(const uint8_t *p, size_t len, const DelimSet *ds)
+{
+  return findAny<Avx2Ops>(p, len, ds);
+}
+
+SCAN_FN("avx512bw") const uint8_t *findany_avx512(const uint8_t *p, size_t len, const DelimSet *ds)
+{
+  return findAny<Avx512Ops>(p, len, ds);
+}
+
+#undef SCAN_FN
+
+// ---------------- dispatch ----------------
+
+typedef void *(*MemsetFn)(void *, int, size_t);
+typedef int (*MemcmpFn)(const void *, const void *, size_t);
+typedef void *(*MemchrFn)(const void *, int, size_t);
+typedef size_t (*StrlenFn)(const char *);
+typedef const uint8_t *(*FindAnyFn)(const uint8_t *, size_t, const DelimSet *);
+
+// 0 sse2, 1 avx2, 2 avx512bw. Called from ifunc resolvers, so no global data
+__attribute__((no_sanitize("address", "thread", "undefined"))) static ALWAYS_INLINE int scanIsaLevel()
+{
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw"))
+    return 2;
+  if (__builtin_cpu_supports("avx2"))
+    return 1;
+  return 0;
+}
+
+IFUNC_RESOLVER MemsetFn resolveSimdMemset()
+{
+  int level = scanIsaLevel();
+  return level == 2 ? memset_avx512 : (level == 1 ? memset_avx2 : memset_sse2);
+}
+
+IFUNC_RESOLVER MemcmpFn resolveSimdMemcmp()
+{
+  int level = scanIsaLevel();
+  return level == 2 ? memcmp_avx512 : (level == 1 ? memcmp_avx2 : memcmp_sse2);
+}
+
+IFUNC_RESOLVER MemchrFn resolveSimdMemchr()
+{
+  int level = scanIsaLevel();
+  return level == 2 ? memchr_avx512 : (level == 1 ? memchr_avx2 : memchr_sse2);
+}
+
+IFUNC_RESOLVER StrlenFn resolveSimdStrlen()
+{
+  int level = scanIsaLevel();
+  return level == 2 ? strlen_avx512 : (level == 1 ? strlen_avx2 : strlen_sse2);
+}
+
+#if defined(__ELF__)
+void *simd_memset(void *dst, int c, size_t len) __attribute__((ifunc("resolveSimdMemset")));
+int simd_memcmp(const void *a, const void *b, size_t len) __attribute__((ifunc("resolveSimdMemcmp")));
+void *simd_memchr(const void *s, int c, size_t len) __attribute__((ifunc("resolveSimdMemchr")));
+size_t simd_strlen(const char *s) __attribute__((ifunc("resolveSimdStrlen")));
+#else
+static MemsetFn simdMemsetImpl = resolveSimdMemset();
+static MemcmpFn simdMemcmpImpl = resolveSimdMemcmp();
+static MemchrFn simdMemchrImpl = resolveSimdMemchr();
+static StrlenFn simdStrlenImpl = resolveSimdStrlen();
+
+void *simd_memset(void *dst, int c, size_t len)
+{
+  return simdMemsetImpl(dst, c, len);
+}
+
+int simd_memcmp(const void *a, const void *b, size_t len)
+{
+  return simdMemcmpImpl(a, b, len);
+}
+
+void *simd_memchr(const void *s, int c, size_t len)
+{
+  return simdMemchrImpl(s, c, len);
+}
+
+size_t simd_strlen(const char *s)
+{
+  return simdStrlenImpl(s);
+}
+#endif
+
+// set is prepared on every call, so this one dispatches through a pointer picked on first use
+void *simd_memchr_any(const void *buf, size_t len, const char *set, size_t setLen)
+{
+  static const FindAnyFn findAnyImpl[3] = {findany_sse2, findany_avx2, findany_avx512};
+  static const int level = scanIsaLevel();
+  DelimSet ds;
+  buildDelimSet(&ds, set, setLen);
+  return (void *)findAnyImpl[level]((const uint8_t *)buf, len, &ds);
+}
+
+const char *simd_scan_isa()
+{
+  int level = scanIsaLevel();
+  return level == 2 ? "avx512bw" : (level == 1 ? "avx2" : "sse2");
+}
+
+#else
+
+// other architectures: vector memset, libc for the rest
+void *simd_memset(void *dst, int c, size_t len)
+{
+  return setVec<16>(dst, c, len);
+}
+
+int simd_memcmp(const void *a, const void *b, size_t len)
+{
+  return memcmp(a, b, len);
+}
+
+void *simd_memchr(const void *s, int c, size_t len)
+{
+  return (void *)memchr(s, c, len);
+}
+
+size_t simd_strlen(const char *s)
+{
+  return strlen(s);
+}
+
+void *simd_memchr_any(const void *buf, size_t len, const char *set, size_t setLen)
+{
+  DelimSet ds;
+  buildDelimSet(&ds, set, setLen);
+  return (void *)findAnyScalar((const uint8_t *)buf, len, &ds);
+}
+
+const char *simd_scan_isa()
+{
+  return "generic";
+}
+
+#endif
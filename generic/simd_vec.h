@@ -0,0 +1,88 @@
+#ifndef __SIMD_VEC_H
+#define __SIMD_VEC_H
+
+// Width generic vector helpers built on GCC vector extension.
+// VecOf<16/32/64>::Type is a plain N byte vector. Helpers are always_inline templates without target attribute,
+// so when inlined into function marked __attribute__((target("avx2"))) they compile to ymm instructions,
+// into target("avx512f") to zmm, and into plain function to SSE2 (x86_64 baseline) or NEON (ARM).
+// This lets one copy algorithm be written once and instantiated per ISA.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#pragma GCC diagnostic ignored "-Wpsabi" // vector ABI warning is irrelevant, helpers are always inlined
+
+#define ALWAYS_INLINE __attribute__((always_inline)) inline
+
+// GNU ifunc resolver runs while loader is still relocating, so it must not touch global data.
+// Same goes for sanitizer instrumentation, hence no_sanitize
+#define IFUNC_RESOLVER extern "C" __attribute__((no_sanitize("address", "thread", "undefined")))
+
+template <size_t W>
+struct VecOf
+{
+  typedef uint8_t Type __attribute__((vector_size(W)));
+};
+
+// W bytes of T lanes, N of them
+template <typename T, size_t W>
+struct Lanes
+{
+  typedef T Vec __attribute__((vector_size(W)));
+  static const size_t N = W / sizeof(T);
+};
+
+// x in every lane: lane 0 and a shuffle, one broadcast instruction. (Vec){} + x would turn -0.0f into 0.0f,
+// and GCC 12 builds it lane by lane (64 byte vectors, inlined from a function without the target attribute)
+template <typename T, size_t W>
+ALWAYS_INLINE typename Lanes<T, W>::Vec splat(T x)
+{
+  typename Lanes<T, W>::Vec v = {};
+  v[0] = x;
+  return __builtin_shuffle(v, (decltype(v < v)){});
+}
+
+// memcpy to/from vector compiles to single unaligned load/store (movdqu/vmovdqu)
+template <size_t W>
+ALWAYS_INLINE typename VecOf<W>::Type vecLoad(const void *p)
+{
+  typename VecOf<W>::Type v;
+  __builtin_memcpy(&v, p, W);
+  return v;
+}
+
+template <size_t W>
+ALWAYS_INLINE void vecStore(void *p, const typename VecOf<W>::Type &v)
+{
+  __builtin_memcpy(p, &v, W);
+}
+
+// p must be W byte aligned
+template <size_t W>
+ALWAYS_INLINE typename VecOf<W>::Type vecLoadAligned(const void *p)
+{
+  return *(const typename VecOf<W>::Type *)__builtin_assume_aligned(p, W);
+}
+
+template <size_t W>
+ALWAYS_INLINE void vecStoreAligned(void *p, const typename VecOf<W>::Type &v)
+{
+  *(typename VecOf<W>::Type *)__builtin_assume_aligned(p, W) = v;
+}
+
+// scalar load/store of any size without alignment or aliasing issues
+template <typename T>
+ALWAYS_INLINE T loadScalar(const void *p)
+{
+  T v;
+  __builtin_memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+template <typename T>
+ALWAYS_INLINE void storeScalar(void *p, T v)
+{
+  __builtin_memcpy(p, &v, sizeof(T));
+}
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef __SOA_H
+#define __SOA_H
+
+// Structure of arrays container: one array per field instead of one array of structs.
+//
+// A scan that reads 2 fields of a 24 byte record out of an array of structs still pulls all 24 bytes of
+// every record through the caches, 2/3 of each line is never looked at. With one array per field the scan
+// reads only the 2 columns it needs: 1/3 of the memory traffic, and a column of plain ints is exactly what
+// the compiler's auto vectorizer (or hand written SIMD) wants.
+//
+// SoA<Ts...>: columns of types Ts..., column<I>() is a pointer to column I.
+//   Every column is 64 byte aligned and allocated in whole 64 byte blocks, so a vector loop may load past
+//   size() up to the next 64 byte boundary without leaving the allocation (values there are unspecified).
+// SOA_STRUCT(Name, Record, fields...): SoA with one column per listed field of an existing struct, and
+//   accessors that read like the array of structs it replaces:
+//     SOA_STRUCT(ProcessTable, Process, pid, arrival, service, wait, tat, rt)
+//     ProcessTable t;
+//     t.push_back(process);             // from a Record
+//     t[i].rt--;                        // t[i] is a proxy of references, one per field
+//     Process p = t[i];                 // back to a Record
+//     for (uint32_t &rt : t.rtColumn()) // column wise
+//     for (auto row : t)                // row wise, rows are proxies
+//   A function template written for Record arrays (p[i].field) then works unchanged on the table.
+//
+// Fields must be trivially copyable and not arrays (columns grow with memcpy, proxies hold references).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#define SOA_ALIGN 64
+#define SOA_MIN_CAPACITY 16
+
+// column of a SoA, usable in range for
+template <typename T>
+struct ColumnSpan
+{
+  T *first;
+  T *last;
+  T *begin() const { return first; }
+  T *end() const { return last; }
+  size_t size() const { return last - first; }
+  T &operator[](size_t i) const { return first[i]; }
+};
+
+template <typename... Ts>
+class SoA
+{
+  static_assert((std::is_trivially_copyable<Ts>::value && ...), "SoA columns are moved with memcpy");
+  static_assert((!std::is_array<Ts>::value && ...), "array fields can't be columns");
+
+public:
+  static const size_t NUM_COLUMNS = sizeof...(Ts);
+
+  SoA() {}
+  ~SoA() { freeColumns(cols); }
+  SoA(const SoA &) = delete;
+  SoA &operator=(const SoA &) = delete;
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  size_t capacity() const { return cap; }
+
+  void reserve(size_t n)
+  {
+    if (n > cap)
+      grow(n);
+  }
+
+  // new rows are zero
+  void resize(size_t n)
+  {
+    reserve(n);
+    if (n > count)
+      forEachColumn([&](auto *col) { memset((void *)(col + count), 0, (n - count) * sizeof(*col)); });
+    count = n;
+  }
+
+  void clear() { count = 0; }
+
+  void push_back(const Ts &...values)
+  {
+    if (count == cap)
+      grow(cap ? 2 * cap : SOA_MIN_CAPACITY);
+    setRow(count, values..., std::index_sequence_for<Ts...>());
+    count++;
+  }
+
+  template <size_t I>
+  auto *column() { return std::get<I>(cols); }
+  template <size_t I>
+  const auto *column() const { return std::get<I>(cols); }
+
+  template <size_t I>
+  auto columnSpan() { return ColumnSpan<std::remove_pointer_t<std::tuple_element_t<I, Columns>>>{column<I>(), column<I>() + count}; }
+
+  template <size_t I>
+  auto &get(size_t i) { return column<I>()[i]; }
+
+  // row as tuple of references, for code that doesn't know field names
+  std::tuple<Ts &...> row(size_t i) { return rowRefs(i, std::index_sequence_for<Ts...>()); }
+
+private:
+  typedef std::tuple<Ts *...> Columns;
+
+  template <size_t... I>
+  void setRow(size_t i, const Ts &...values, std::index_sequence<I...>)
+  {
+    ((std::get<I>(cols)[i] = values), ...);
+  }
+
+  template <size_t... I>
+  std::tuple<Ts &...> rowRefs(size_t i, std::index_sequence<I...>)
+  {
+    return std::tuple<Ts &...>(std::get<I>(cols)[i]...);
+  }
+
+  template <typename Fn>
+  void forEachColumn(Fn fn)
+  {
+    std::apply([&](auto *...col) { (fn(col), ...); }, cols);
+  }
+
+  template <typename T>
+  static size_t columnBytes(size_t n)
+  {
+    return (n * sizeof(T) + SOA_ALIGN - 1) & ~(size_t)(SOA_ALIGN - 1);
+  }
+
+  void grow(size_t n)
+  {
+    Columns fresh{};
+    if (!allocColumns(fresh, n, std::index_sequence_for<Ts...>()))
+    {
+      freeColumns(fresh);
+      throw std::bad_alloc();
+    }
+    copyColumns(fresh, std::index_sequence_for<Ts...>());
+    freeColumns(cols);
+    cols = fresh;
+    cap = n;
+  }
+
+  template <size_t... I>
+  static bool allocColumns(Columns &to, size_t n, std::index_sequence<I...>)
+  {
+    ((std::get<I>(to) = (Ts *)aligned_alloc(SOA_ALIGN, columnBytes<Ts>(n))), ...);
+    return (std::get<I>(to) && ...);
+  }
+
+  template <size_t... I>
+  void copyColumns(Columns &to, std::index_sequence<I...>)
+  {
+    ((count ? (void)memcpy(std::get<I>(to), std::get<I>(cols), count * sizeof(Ts)) : (void)0), ...);
+  }
+
+  static void freeColumns(Columns &c)
+  {
+    std::apply([](auto *...col) { (free(col), ...); }, c);
+  }
+
+  Columns cols{};
+  size_t count = 0;
+  size_t cap = 0;
+};
+
+// row wise iteration over a SOA_STRUCT table, rows are proxies
+template <typename Table>
+struct SoARowIterator
+{
+  Table *table;
+  size_t i;
+  auto operator*() const { return (*table)[i]; }
+  SoARowIterator &operator++()
+  {
+    i++;
+    return *this;
+  }
+  bool operator!=(const SoARowIterator &o) const { return i != o.i; }
+};
+
+// ---------------- named tables ----------------
+
+// M(Record, index, field) for each field, S() between them. Index is a constant expression (0 + 1 + 1 ...)
+#define SOA_COMMA() ,
+#define SOA_NOTHING()
+#define SOA_EACH_1(M, S, R, I, a) M(R, I, a)
+#define SOA_EACH_2(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_1(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_3(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_2(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_4(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_3(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_5(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_4(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_6(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_5(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_7(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_6(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_8(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_7(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_9(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_8(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_10(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_9(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_11(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_10(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_EACH_12(M, S, R, I, a, ...) M(R, I, a) S() SOA_EACH_11(M, S, R, I + 1, __VA_ARGS__)
+#define SOA_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, NAME, ...) NAME
+#define SOA_EACH(M, S, R, ...)                                                                                    \
+  SOA_PICK(__VA_ARGS__, SOA_EACH_12, SOA_EACH_11, SOA_EACH_10, SOA_EACH_9, SOA_EACH_8, SOA_EACH_7, SOA_EACH_6,      \
+           SOA_EACH_5, SOA_EACH_4, SOA_EACH_3, SOA_EACH_2, SOA_EACH_1)                                            \
+  (M, S, R, 0, __VA_ARGS__)
+
+#define SOA_TYPE(R, I, f) decltype(R::f)
+#define SOA_REF(R, I, f) decltype(R::f) &f;
+#define SOA_CONST_REF(R, I, f) const decltype(R::f) &f;
+#define SOA_CELL(R, I, f) this->template column<I>()[i]
+#define SOA_TO_RECORD(R, I, f) r.f = f;
+#define SOA_FROM_RECORD(R, I, f) f = r.f;
+#define SOA_ARG(R, I, f) r.f
+#define SOA_COLUMN(R, I, f)                                                                                       \
+  ColumnSpan<decltype(R::f)> f##Column() { return this->template columnSpan<I>(); }
+
+// up to 12 fields
+#define SOA_STRUCT(Name, Record, ...)                                                                             \
+  struct Name : SoA<SOA_EACH(SOA_TYPE, SOA_COMMA, Record, __VA_ARGS__)>                                          \
+  {                                                                                                               \
+    struct Ref                                                                                                    \
+    {                                                                                                             \
+      SOA_EACH(SOA_REF, SOA_NOTHING, Record, __VA_ARGS__)                                                         \
+      operator Record() const                                                                                     \
+      {                                                                                                           \
+        Record r{};                                                                                               \
+        SOA_EACH(SOA_TO_RECORD, SOA_NOTHING, Record, __VA_ARGS__)                                                 \
+        return r;                                                                                                 \
+      }                                                                                                           \
+      Ref &operator=(const Record &r)                                                                             \
+      {                                                                                                           \
+        SOA_EACH(SOA_FROM_RECORD, SOA_NOTHING, Record, __VA_ARGS__)                                               \
+        return *this;                                                                                             \
+      }                                                                                                           \
+    };                                                                                                            \
+    struct ConstRef                                                                                               \
+    {                                                                                                             \
+      SOA_EACH(SOA_CONST_REF, SOA_NOTHING, Record, __VA_ARGS__)                                                   \
+      operator Record() const                                                                                     \
+      {                                                                                                           \
+        Record r{};                                                                                               \
+        SOA_EACH(SOA_TO_RECORD, SOA_NOTHING, Record, __VA_ARGS__)                                                 \
+        return r;                                                                                                 \
+      }                                                                                                           \
+    };                                                                                                            \
+    using SoA::push_back;                                                                                         \
+    void push_back(const Record &r) { SoA::push_back(SOA_EACH(SOA_ARG, SOA_COMMA, Record, __VA_ARGS__)); }        \
+    Ref operator[](size_t i) { return Ref{SOA_EACH(SOA_CELL, SOA_COMMA, Record, __VA_ARGS__)}; }                  \
+    ConstRef operator[](size_t i) const { return ConstRef{SOA_EACH(SOA_CELL, SOA_COMMA, Record, __VA_ARGS__)}; }  \
+    SoARowIterator<Name> begin() { return {this, 0}; }                                                            \
+    SoARowIterator<Name> end() { return {this, size()}; }                                                         \
+    SOA_EACH(SOA_COLUMN, SOA_NOTHING, Record, __VA_ARGS__)                                                        \
+  }
+
+#endif
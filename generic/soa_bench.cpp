@@ -0,0 +1,201 @@
+// Benchmark of soa.h: array of Process structs (AoS) against a SOA_STRUCT table of the same fields (SoA).
+//
+// Scans read some fields of every process, as the schedulers in os_concepts/scheduling do:
+//   shortest   SRT's getShortestProcess (arrival, rt: 8 of 24 bytes), one function template for both
+//              layouts, p[i].field unchanged. SoA columns: same scan over column pointers
+//   sum        total service time (4 of 24 bytes)
+//   all        sum of all 6 fields, every byte of the record is used
+// ns per process, best of ROUNDS, from tables in L1 to tables in DRAM.
+// Build with -O3 -march=native: g++ 12 -O2 doesn't vectorize loops of unknown length.
+//
+// Typical result (1 core VM, AVX-512, g++ 12 -O3 -march=native):
+//   processes   short AoS  short SoA  short cols   sum AoS  sum SoA   all AoS  all SoA
+//        4096       ~4-6       ~5-6       ~0.4       ~0.4     ~0.08     ~1.4     ~0.25
+//      262144       ~7-9       ~8-9       ~0.2       ~1.1     ~0.08     ~1.6     ~1.0
+//     2097152      ~10        ~9-10       ~0.4       ~1.4-3   ~0.2      ~4.2     ~1.1
+// getShortestProcess is bound by mispredicted branches (random rt), the same code on either layout
+// runs the same: proxies cost nothing once inlined, and SoA helps a little only once the table is in DRAM.
+// Rewritten over columns without branches it vectorizes and is 20-30x faster. Field sums vectorize on
+// columns too, while AoS loads stride over unused fields: 5x for one field, and even reading all fields
+// SoA is faster here (6 unit stride streams vectorize, 24 byte records don't). At -O2 (no vectorization)
+// SoA only saves memory traffic: sum ~0.65 vs ~0.75 in cache, ~0.65 vs ~2.8 from DRAM.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "soa.h"
+#include "bench.h"
+#include "../os_concepts/scheduling/process.h"
+
+#define ROUNDS 5
+#define MAX_PROCESSES (4 << 20)
+
+SOA_STRUCT(ProcessTable, Process, pid, arrival, service, wait, tat, rt);
+
+static uint64_t rnd = 88172645463325252ULL;
+
+static uint32_t nextRandom()
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return (uint32_t)rnd;
+}
+
+// getShortestProcess of SRT.cpp made a template, body unchanged: Procs is Process * or ProcessTable
+template <typename Procs>
+static int getShortestProcess(Procs &&p, int num, int currTime)
+{
+  int idx = -1;
+  int shortestTime = INT32_MAX;
+  for (int i = 0; i < num; i++)
+  {
+    if ((p[i].arrival < (uint32_t)currTime) && (p[i].rt != 0) && (p[i].rt < (uint32_t)shortestTime))
+    {
+      shortestTime = p[i].rt;
+      idx = i;
+    }
+  }
+  return idx;
+}
+
+// same result from column pointers, in two passes that vectorize: branchless min of eligible rt, then
+// first process with that rt (stops early, rarely reads the whole column again)
+static int getShortestColumns(const uint32_t *arrival, const uint32_t *rt, int num, int currTime)
+{
+  uint32_t shortest = UINT32_MAX;
+  for (int i = 0; i < num; i++)
+  {
+    uint32_t keep = 0u - (uint32_t)((arrival[i] < (uint32_t)currTime) & (rt[i] != 0)); // all ones if eligible
+    uint32_t t = (rt[i] & keep) | ~keep;
+    shortest = t < shortest ? t : shortest;
+  }
+  if (shortest >= INT32_MAX)
+    return -1;
+  for (int i = 0; i < num; i++)
+  {
+    if (rt[i] == shortest && arrival[i] < (uint32_t)currTime)
+      return i;
+  }
+  return -1;
+}
+
+template <typename Procs>
+static uint64_t sumService(Procs &&p, int num)
+{
+  uint64_t sum = 0;
+  for (int i = 0; i < num; i++)
+    sum += p[i].service;
+  return sum;
+}
+
+static uint64_t sumColumn(const uint32_t *col, int num)
+{
+  uint64_t sum = 0;
+  for (int i = 0; i < num; i++)
+    sum += col[i];
+  return sum;
+}
+
+template <typename Procs>
+static uint64_t sumAll(Procs &&p, int num)
+{
+  uint64_t sum = 0;
+  for (int i = 0; i < num; i++)
+    sum += (uint32_t)p[i].pid + p[i].arrival + p[i].service + p[i].wait + p[i].tat + p[i].rt;
+  return sum;
+}
+
+// best ns per process of fn() over ROUNDS
+template <typename Fn>
+static double nsPerProcess(Fn fn, int num)
+{
+  double best = 1e9;
+  for (int r = 0; r < ROUNDS; r++)
+  {
+    uint64_t t0 = nowNs();
+    doNotOptimize(fn());
+    double ns = (double)(nowNs() - t0) / num;
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+static void fill(Process *aos, ProcessTable &soa, int num)
+{
+  soa.clear();
+  for (int i = 0; i < num; i++)
+  {
+    uint32_t service = 1 + nextRandom() % 1000;
+    aos[i] = {i, nextRandom() % 100000, service, 0, 0, nextRandom() % 4 ? service : 0};
+    soa.push_back(aos[i]);
+  }
+}
+
+static bool check(Process *aos, ProcessTable &soa, int num)
+{
+  bool ok = soa.size() == (size_t)num;
+  for (int i = 0; i < num && ok; i++)
+  {
+    Process p = soa[i];
+    ok = p.pid == aos[i].pid && p.arrival == aos[i].arrival && p.service == aos[i].service && p.rt == aos[i].rt;
+  }
+  for (int currTime = 0; currTime <= 100000 && ok; currTime += 5000)
+  {
+    int a = getShortestProcess(aos, num, currTime);
+    ok = a == getShortestProcess(soa, num, currTime) &&
+         a == getShortestColumns(soa.arrivalColumn().begin(), soa.rtColumn().begin(), num, currTime);
+  }
+  return ok && sumService(aos, num) == sumService(soa, num) && sumAll(aos, num) == sumAll(soa, num) &&
+         sumService(aos, num) == sumColumn(soa.serviceColumn().begin(), num);
+}
+
+int main_soa_bench()
+{
+  Process *aos = (Process *)aligned_alloc(64, MAX_PROCESSES * sizeof(Process));
+  ProcessTable soa;
+
+  // container basics: growth keeps values, columns aligned, proxies write through, resize zeroes new rows
+  fill(aos, soa, 1000);
+  if ((uintptr_t)soa.column<0>() % SOA_ALIGN || (uintptr_t)soa.column<5>() % SOA_ALIGN)
+    printf("SoA column alignment FAILED\n");
+  soa[7].rt--;
+  soa[8] = aos[9];
+  if (soa[7].rt != aos[7].rt - 1 || soa[8].pid != 9)
+    printf("SoA proxy write FAILED\n");
+  soa.resize(2000);
+  size_t rows = 0;
+  uint64_t zeroes = 0;
+  for (auto row : soa)
+  {
+    rows++;
+    zeroes += row.pid == 0 && row.service == 0;
+  }
+  if (rows != 2000 || zeroes != 1000)
+    printf("SoA resize/iteration FAILED\n");
+
+  printf("ns per process, AoS: Process[], SoA: ProcessTable\n");
+  printf("%10s %11s %11s %11s %11s %11s %11s %11s\n", "processes", "short AoS", "short SoA", "short cols",
+         "sum AoS", "sum SoA", "all AoS", "all SoA");
+  for (int num = 4 << 10; num <= MAX_PROCESSES; num *= 8)
+  {
+    fill(aos, soa, num);
+    if (!check(aos, soa, num))
+      printf("AoS and SoA results differ FAILED\n");
+
+    int currTime = 50000;
+    const uint32_t *arrival = soa.arrivalColumn().begin();
+    const uint32_t *rt = soa.rtColumn().begin();
+    const uint32_t *service = soa.serviceColumn().begin();
+    printf("%10d %11.3f %11.3f %11.3f %11.3f %11.3f %11.3f %11.3f\n", num,
+           nsPerProcess([&] { return getShortestProcess(aos, num, currTime); }, num),
+           nsPerProcess([&] { return getShortestProcess(soa, num, currTime); }, num),
+           nsPerProcess([&] { return getShortestColumns(arrival, rt, num, currTime); }, num),
+           nsPerProcess([&] { return sumService(aos, num); }, num),
+           nsPerProcess([&] { return sumColumn(service, num); }, num),
+           nsPerProcess([&] { return sumAll(aos, num); }, num),
+           nsPerProcess([&] { return sumAll(soa, num); }, num));
+  }
+  free(aos);
+  return 0;
+}
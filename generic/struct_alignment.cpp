@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <string.h>
+#include "struct_layout.h"
+#include "../linked_list/list.h"
+#include "../os_concepts/scheduling/process.h"
 
 typedef struct
 {
@@ -8,6 +11,9 @@ typedef struct
   int c;   // 4 byte
 } myStruct;
 
+// same picture as comments below, computed by compiler (struct_layout.h)
+STRUCT_LAYOUT(myStruct, a, b, c)
+
 int main1()
 {
   printf("sizeof myStruct %lu alignment %lu\n", sizeof(myStruct), __alignof(myStruct));
@@ -21,5 +27,9 @@ int main1()
   // For example without final padding, b will be only 4 bytes aligned for 2nd struct element
   // P represents padding
 
+  printLayout(layoutOf<myStruct>());
+  printLayout(layoutOf<Node>());
+  printLayout(layoutOf<Process>());
+
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+#ifndef __STRUCT_LAYOUT_H
+#define __STRUCT_LAYOUT_H
+
+// Struct layout computed by the compiler instead of drawn by hand (see struct_alignment.cpp).
+//
+// C++ has no reflection, so fields are listed once next to the struct:
+//   STRUCT_LAYOUT(Process, pid, arrival, service, wait, tat, rt);
+// which records name, offset (offsetof), size and alignment of each field in a constexpr StructLayout.
+// From that, at compile time:
+//   paddingBefore(i), tailPadding(), wastedBytes()   padding inserted by the compiler
+//   linesSpanned()                                   cache lines touched by an object starting on a line
+//   worstCaseLines()                                 same for an object anywhere its alignment allows
+//                                                    (array elements, malloc'ed objects)
+//   fieldStraddles(i), straddlingFields()            fields split between two lines (two misses to read)
+//   optimalOrder(), optimalSize()                    padding minimizing field order
+// and printLayout() shows it all at run time, with a byte map like the comments in struct_alignment.cpp.
+//
+// Optimal order: sorting fields by decreasing alignment leaves no padding between fields, since every size
+// is a multiple of its alignment and each field then starts where the previous one ended, at an offset that
+// is a multiple of all following alignments. Only tail padding up to struct alignment remains, which no
+// order can avoid. Ties keep declaration order (then larger first), so related fields stay together.
+//
+// Budgets fail the build when a hot struct grows:
+//   LAYOUT_BUDGET(Node, 1);      // one cache line, no field straddles a line, wherever its alignment puts it
+//   LAYOUT_BUDGET_LINE_ALIGNED(Process, 1); // same, only for an object starting on a line
+//   LAYOUT_OPTIMAL(Process);     // no field order would make it smaller
+// A 24 byte struct aligned to 8 fits a line at offset 0 but not at 48, where element 2 of an array starts:
+// LAYOUT_BUDGET wants alignas(32) there.
+//
+// Every field must be listed: a missing field is counted as padding. Bit fields can't be listed (offsetof).
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <array>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+typedef struct
+{
+  const char *name;
+  size_t offset;
+  size_t size;
+  size_t align;
+} FieldInfo;
+
+template <size_t N>
+struct StructLayout
+{
+  const char *name;
+  size_t size;
+  size_t align;
+  std::array<FieldInfo, N> fields; // by offset
+
+  constexpr size_t fieldEnd(size_t i) const { return fields[i].offset + fields[i].size; }
+
+  constexpr size_t paddingBefore(size_t i) const { return fields[i].offset - (i ? fieldEnd(i - 1) : 0); }
+
+  constexpr size_t tailPadding() const { return size - (N ? fieldEnd(N - 1) : 0); }
+
+  constexpr size_t fieldBytes() const
+  {
+    size_t sum = 0;
+    for (size_t i = 0; i < N; i++)
+      sum += fields[i].size;
+    return sum;
+  }
+
+  constexpr size_t wastedBytes() const { return size - fieldBytes(); }
+
+  constexpr size_t linesSpanned(size_t line = CACHE_LINE_SIZE) const { return linesAt(0, line); }
+
+  // object may start at any multiple of its alignment
+  constexpr size_t worstCaseLines(size_t line = CACHE_LINE_SIZE) const
+  {
+    size_t worst = 0;
+    for (size_t start = 0; start < line; start += align)
+    {
+      size_t lines = linesAt(start, line);
+      worst = lines > worst ? lines : worst;
+    }
+    return worst;
+  }
+
+  // object starting on a line boundary
+  constexpr bool fieldStraddles(size_t i, size_t line = CACHE_LINE_SIZE) const { return straddlesAt(i, 0, line); }
+
+  constexpr size_t straddlingFields(size_t line = CACHE_LINE_SIZE) const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < N; i++)
+      count += fieldStraddles(i, line);
+    return count;
+  }
+
+  // fields straddling a line for some start of the object its alignment allows
+  constexpr size_t worstCaseStraddlingFields(size_t line = CACHE_LINE_SIZE) const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+      bool straddles = false;
+      for (size_t start = 0; start < line; start += align)
+        straddles = straddles || straddlesAt(i, start, line);
+      count += straddles;
+    }
+    return count;
+  }
+
+  // field indices by decreasing alignment, then decreasing size, then declaration order
+  constexpr std::array<size_t, N> optimalOrder() const
+  {
+    std::array<size_t, N> order{};
+    for (size_t i = 0; i < N; i++)
+      order[i] = i;
+    for (size_t i = 1; i < N; i++) // insertion sort, stable
+    {
+      size_t cur = order[i];
+      size_t j = i;
+      while (j > 0 && goesBefore(cur, order[j - 1]))
+      {
+        order[j] = order[j - 1];
+        j--;
+      }
+      order[j] = cur;
+    }
+    return order;
+  }
+
+  constexpr size_t optimalSize() const
+  {
+    std::array<size_t, N> order = optimalOrder();
+    size_t offset = 0;
+    for (size_t k = 0; k < N; k++)
+    {
+      const FieldInfo &f = fields[order[k]];
+      offset = (offset + f.align - 1) / f.align * f.align + f.size;
+    }
+    return (offset + align - 1) / align * align;
+  }
+
+private:
+  constexpr size_t linesAt(size_t start, size_t line) const
+  {
+    return size ? (start + size - 1) / line - start / line + 1 : 0;
+  }
+
+  constexpr bool straddlesAt(size_t i, size_t start, size_t line) const
+  {
+    return fields[i].size && (start + fields[i].offset) / line != (start + fieldEnd(i) - 1) / line;
+  }
+
+  constexpr bool goesBefore(size_t a, size_t b) const
+  {
+    if (fields[a].align != fields[b].align)
+      return fields[a].align > fields[b].align;
+    return fields[a].size > fields[b].size;
+  }
+};
+
+template <typename... Fields>
+constexpr StructLayout<sizeof...(Fields)> makeLayout(const char *name, size_t size, size_t align, Fields... f)
+{
+  const size_t N = sizeof...(Fields);
+  std::array<FieldInfo, N> fields{f...};
+  for (size_t i = 1; i < N; i++) // fields may be listed in any order
+  {
+    FieldInfo cur = fields[i];
+    size_t j = i;
+    while (j > 0 && cur.offset < fields[j - 1].offset)
+    {
+      fields[j] = fields[j - 1];
+      j--;
+    }
+    fields[j] = cur;
+  }
+  return StructLayout<N>{name, size, align, fields};
+}
+
+// ---------------- registration ----------------
+
+#define LAYOUT_FIELD(T, f) FieldInfo{#f, offsetof(T, f), sizeof(T::f), alignof(decltype(T::f))}
+
+#define LAYOUT_F1(T, a) LAYOUT_FIELD(T, a)
+#define LAYOUT_F2(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F1(T, __VA_ARGS__)
+#define LAYOUT_F3(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F2(T, __VA_ARGS__)
+#define LAYOUT_F4(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F3(T, __VA_ARGS__)
+#define LAYOUT_F5(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F4(T, __VA_ARGS__)
+#define LAYOUT_F6(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F5(T, __VA_ARGS__)
+#define LAYOUT_F7(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F6(T, __VA_ARGS__)
+#define LAYOUT_F8(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F7(T, __VA_ARGS__)
+#define LAYOUT_F9(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F8(T, __VA_ARGS__)
+#define LAYOUT_F10(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F9(T, __VA_ARGS__)
+#define LAYOUT_F11(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F10(T, __VA_ARGS__)
+#define LAYOUT_F12(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F11(T, __VA_ARGS__)
+#define LAYOUT_F13(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F12(T, __VA_ARGS__)
+#define LAYOUT_F14(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F13(T, __VA_ARGS__)
+#define LAYOUT_F15(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F14(T, __VA_ARGS__)
+#define LAYOUT_F16(T, a, ...) LAYOUT_FIELD(T, a), LAYOUT_F15(T, __VA_ARGS__)
+#define LAYOUT_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, NAME, ...) NAME
+#define LAYOUT_FIELDS(T, ...)                                                                                     \
+  LAYOUT_PICK(__VA_ARGS__, LAYOUT_F16, LAYOUT_F15, LAYOUT_F14, LAYOUT_F13, LAYOUT_F12, LAYOUT_F11, LAYOUT_F10,      \
+              LAYOUT_F9, LAYOUT_F8, LAYOUT_F7, LAYOUT_F6, LAYOUT_F5, LAYOUT_F4, LAYOUT_F3, LAYOUT_F2, LAYOUT_F1)    \
+  (T, __VA_ARGS__)
+
+// up to 16 fields. Defines structLayout(const T *), found by layoutOf<T>()
+#define STRUCT_LAYOUT(T, ...)                                                                                     \
+  constexpr auto structLayout(const T *)                                                                          \
+  {                                                                                                               \
+    return makeLayout(#T, sizeof(T), alignof(T), LAYOUT_FIELDS(T, __VA_ARGS__));                                  \
+  }
+
+template <typename T>
+constexpr auto layoutOf()
+{
+  return structLayout((const T *)NULL);
+}
+
+// wherever an object of T may start (array element, pool slot, malloc): at most maxLines lines, no field
+// split between two lines
+#define LAYOUT_BUDGET(T, maxLines)                                                                                \
+  static_assert(layoutOf<T>().worstCaseLines() <= (maxLines), #T " is larger than its budget of " #maxLines       \
+                                                              " cache line(s) at some offset");                   \
+  static_assert(layoutOf<T>().worstCaseStraddlingFields() == 0,                                                   \
+                #T " has a field crossing a cache line boundary at some offset")
+
+// only for an object starting on a cache line. Elements of a dense array of T may still cross lines
+#define LAYOUT_BUDGET_LINE_ALIGNED(T, maxLines)                                                                   \
+  static_assert(layoutOf<T>().linesSpanned() <= (maxLines), #T " is larger than its budget of " #maxLines         \
+                                                            " cache line(s)");                                    \
+  static_assert(layoutOf<T>().straddlingFields() == 0, #T " has a field crossing a cache line boundary")
+
+#define LAYOUT_OPTIMAL(T)                                                                                         \
+  static_assert(layoutOf<T>().size == layoutOf<T>().optimalSize(), #T " could be smaller with optimalOrder()")
+
+// ---------------- report ----------------
+
+template <size_t N>
+void printLayout(const StructLayout<N> &l, size_t line = CACHE_LINE_SIZE)
+{
+  printf("%s: size %zu align %zu, fields %zu bytes, padding %zu (%zu%%), %zu cache line(s), worst case %zu\n",
+         l.name, l.size, l.align, l.fieldBytes(), l.wastedBytes(), l.size ? 100 * l.wastedBytes() / l.size : 0,
+         l.linesSpanned(line), l.worstCaseLines(line));
+  printf("  %6s %5s %5s %7s  %s\n", "offset", "size", "align", "padding", "field");
+  for (size_t i = 0; i < N; i++)
+  {
+    printf("  %6zu %5zu %5zu %7zu  %s%s\n", l.fields[i].offset, l.fields[i].size, l.fields[i].align,
+           l.paddingBefore(i), l.fields[i].name, l.fieldStraddles(i, line) ? "  (crosses cache line)" : "");
+  }
+  printf("  tail padding %zu\n", l.tailPadding());
+
+  // one character per byte: first letter of field, P for padding, | between bytes
+  if (l.size <= line)
+  {
+    printf("  ");
+    for (size_t b = 0; b < l.size; b++)
+    {
+      char c = 'P';
+      for (size_t i = 0; i < N; i++)
+      {
+        if (b >= l.fields[i].offset && b < l.fieldEnd(i))
+          c = l.fields[i].name[0];
+      }
+      printf(b ? "|%c" : "%c", c);
+    }
+    printf("\n");
+  }
+
+  size_t best = l.optimalSize();
+  if (best < l.size)
+  {
+    std::array<size_t, N> order = l.optimalOrder();
+    printf("  reorder to save %zu bytes (size %zu):", l.size - best, best);
+    for (size_t k = 0; k < N; k++)
+      printf(" %s", l.fields[order[k]].name);
+    printf("\n");
+  }
+  else
+  {
+    printf("  field order is already optimal\n");
+  }
+}
+
+#endif
@@ -1,23 +1,16 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include "list.h"
+#include "../generic/allocator.h"
 
-#if 1
-#define DOUBLY_LINKED_LIST
-#endif
-
-typedef struct _Node
-{
-    int data;
-    struct _Node *next;
-#if defined(DOUBLY_LINKED_LIST)
-    struct _Node *prev;
-#endif
-} Node;
+// every node comes from one slab pool: no malloc header per node, and nodes created one after
+// another sit next to each other, so walking the list streams through a few cache lines
+static SlabPool nodePool(sizeof(Node), alignof(Node));
 
 Node* createNode(int data)
 {
-    Node *newNode = (Node*)malloc(sizeof(Node));
+    Node *newNode = (Node*)nodePool.allocate();
     newNode->data = data;
     newNode->next = NULL;
 #if defined(DOUBLY_LINKED_LIST)
@@ -26,6 +19,11 @@ Node* createNode(int data)
     return newNode;
 }
 
+void freeNode(Node *node)
+{
+    nodePool.deallocate(node);
+}
+
 Node* insertNode(Node *head, int pos, int data)
 {
     if (pos < 1) return head;
@@ -71,7 +69,7 @@ Node* deleteNode(Node *head, int pos)
 #if defined(DOUBLY_LINKED_LIST)
         head->prev = NULL;
 #endif
-        free(curr);
+        freeNode(curr);
         return head;
     }
 
@@ -94,7 +92,7 @@ Node* deleteNode(Node *head, int pos)
             curr->next->prev = curr->prev;
         }
 #endif
-        free(curr);
+        freeNode(curr);
     }
 
     return head;
@@ -0,0 +1,42 @@
+#ifndef __LIST_H
+#define __LIST_H
+
+#include "../generic/struct_layout.h"
+
+#if 1
+#define DOUBLY_LINKED_LIST
+#endif
+
+// list walk is a pointer chase: one miss per node at best, so a node must not span two lines wherever it
+// is allocated. The doubly linked node has 20 bytes of fields: aligned to 32, never across a line
+#if defined(DOUBLY_LINKED_LIST)
+#define NODE_ALIGN 32
+#else
+#define NODE_ALIGN 16
+#endif
+
+typedef struct alignas(NODE_ALIGN) _Node
+{
+    int data;
+    struct _Node *next;
+#if defined(DOUBLY_LINKED_LIST)
+    struct _Node *prev;
+#endif
+} Node;
+
+#if defined(DOUBLY_LINKED_LIST)
+STRUCT_LAYOUT(Node, data, next, prev)
+#else
+STRUCT_LAYOUT(Node, data, next)
+#endif
+LAYOUT_BUDGET(Node, 1);
+LAYOUT_OPTIMAL(Node);
+
+Node* createNode(int data);
+void freeNode(Node *node);
+Node* insertNode(Node *head, int pos, int data);
+Node* deleteNode(Node *head, int pos);
+Node* reverseList(Node *head);
+void printList(Node *head);
+
+#endif
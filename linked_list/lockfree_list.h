@@ -0,0 +1,300 @@
+#ifndef __LOCKFREE_LIST_H
+#define __LOCKFREE_LIST_H
+
+// Lock free ordered singly linked list (Harris / Michael) keyed on data, with epoch based memory reclamation.
+//
+// Deleting node is two steps:
+// 1. logical delete: set mark bit (bit 0) in deleted node's own next pointer. Any CAS that tries to link
+//    after this node now fails, so nobody can insert behind a node that is being removed
+// 2. physical delete: CAS predecessor's next from node to its successor. Any thread traversing
+//    (find) helps finishing step 2 when it sees marked node
+//
+// Reclamation: after unlinking, other threads may still be reading the node, so free() can't be called right away.
+// Every operation runs inside epoch guard. Node unlinked while global epoch was e is freed only once global epoch
+// reached e + 2; epoch advances only when every thread inside a guard has seen current epoch,
+// which means no thread can still hold pointer to that node.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <atomic>
+
+#define EPOCH_ADVANCE_INTERVAL 64 // retirements between attempts to advance global epoch
+
+typedef struct _LFNode
+{
+    int data;
+    std::atomic<uintptr_t> next;    // pointer to next node, bit 0 = this node is logically deleted
+    struct _LFNode *retireNext;     // link in retire list once node is unlinked
+} LFNode;
+
+static inline LFNode *lfPtr(uintptr_t p) { return (LFNode *)(p & ~(uintptr_t)1); }
+static inline bool lfMarked(uintptr_t p) { return p & 1; }
+
+// ---------------- epoch based reclamation ----------------
+
+typedef struct _EpochRecord
+{
+    std::atomic<uint64_t> epoch;    // global epoch seen when thread entered guard
+    std::atomic<bool> active;       // thread is inside guard
+    std::atomic<bool> inUse;        // record owned by a live thread
+    struct _EpochRecord *next;
+    int depth;                      // guard nesting
+    LFNode *retired[3];             // nodes retired in epoch retiredEpoch[i], i = epoch % 3
+    uint64_t retiredEpoch[3];
+    uint32_t numRetired;
+} EpochRecord;
+
+inline std::atomic<uint64_t> globalEpoch{2};    // start at 2 so that e - 2 never underflows
+inline std::atomic<EpochRecord *> epochRecords{NULL};
+
+static inline void epochFreeList(LFNode *n)
+{
+    while (n)
+    {
+        LFNode *next = n->retireNext;
+        free(n);
+        n = next;
+    }
+}
+
+inline EpochRecord *epochAcquireRecord()
+{
+    // reuse record of thread that already exited, otherwise add new one. Records are never freed
+    for (EpochRecord *r = epochRecords.load(std::memory_order_acquire); r; r = r->next)
+    {
+        bool expected = false;
+        if (!r->inUse.load(std::memory_order_relaxed) && r->inUse.compare_exchange_strong(expected, true))
+            return r;
+    }
+    EpochRecord *r = new EpochRecord();
+    r->inUse.store(true, std::memory_order_relaxed);
+    EpochRecord *head = epochRecords.load(std::memory_order_relaxed);
+    do
+    {
+        r->next = head;
+    } while (!epochRecords.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+    return r;
+}
+
+struct EpochThreadHandle
+{
+    EpochRecord *rec = epochAcquireRecord();
+    // retired nodes stay with record and are freed by the next thread that takes it over
+    ~EpochThreadHandle() { rec->inUse.store(false, std::memory_order_release); }
+};
+
+inline EpochRecord *epochRecord()
+{
+    static thread_local EpochThreadHandle handle;
+    return handle.rec;
+}
+
+inline void epochEnter()
+{
+    EpochRecord *r = epochRecord();
+    if (r->depth++)
+        return;
+    r->active.store(true, std::memory_order_relaxed);
+    r->epoch.store(globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // announcement must be visible before any shared pointer is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void epochExit()
+{
+    EpochRecord *r = epochRecord();
+    if (--r->depth)
+        return;
+    r->active.store(false, std::memory_order_release);
+}
+
+inline void epochTryAdvance()
+{
+    uint64_t g = globalEpoch.load(std::memory_order_acquire);
+    for (EpochRecord *r = epochRecords.load(std::memory_order_acquire); r; r = r->next)
+    {
+        if (r->active.load(std::memory_order_acquire) && r->epoch.load(std::memory_order_acquire) != g)
+            return; // some thread may still see older epoch
+    }
+    globalEpoch.compare_exchange_strong(g, g + 1, std::memory_order_acq_rel);
+}
+
+// node is already unlinked from list. Must be called inside guard
+inline void epochRetire(LFNode *node)
+{
+    EpochRecord *r = epochRecord();
+    uint64_t g = globalEpoch.load(std::memory_order_acquire);
+    for (int i = 0; i < 3; i++)
+    {
+        if (r->retired[i] && r->retiredEpoch[i] + 2 <= g)
+        {
+            epochFreeList(r->retired[i]);
+            r->retired[i] = NULL;
+        }
+    }
+    int slot = g % 3;
+    r->retiredEpoch[slot] = g;
+    node->retireNext = r->retired[slot];
+    r->retired[slot] = node;
+    if (++r->numRetired % EPOCH_ADVANCE_INTERVAL == 0)
+        epochTryAdvance();
+}
+
+// frees every retired node of every thread. Only safe when no thread is using any lock free list
+inline void epochReclaimAll()
+{
+    for (EpochRecord *r = epochRecords.load(std::memory_order_acquire); r; r = r->next)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            epochFreeList(r->retired[i]);
+            r->retired[i] = NULL;
+        }
+    }
+}
+
+class EpochGuard
+{
+public:
+    EpochGuard() { epochEnter(); }
+    ~EpochGuard() { epochExit(); }
+};
+
+// ---------------- the list ----------------
+
+class LockFreeList
+{
+public:
+    LockFreeList()
+    {
+        head.data = INT_MIN;
+        head.next.store(0, std::memory_order_relaxed);
+    }
+
+    // not thread safe: no other thread may use list anymore
+    ~LockFreeList()
+    {
+        LFNode *curr = lfPtr(head.next.load(std::memory_order_relaxed));
+        while (curr)
+        {
+            LFNode *next = lfPtr(curr->next.load(std::memory_order_relaxed));
+            free(curr);
+            curr = next;
+        }
+    }
+
+    // returns false if key already present
+    bool insert(int data)
+    {
+        EpochGuard guard;
+        LFNode *newNode = NULL;
+        while (true)
+        {
+            LFNode *prev, *curr;
+            if (find(data, &prev, &curr))
+            {
+                free(newNode);
+                return false;
+            }
+            if (!newNode)
+            {
+                newNode = (LFNode *)malloc(sizeof(LFNode));
+                newNode->data = data;
+            }
+            newNode->next.store((uintptr_t)curr, std::memory_order_relaxed);
+            uintptr_t expected = (uintptr_t)curr;
+            // fails if prev got marked or something was inserted/removed between prev and curr
+            if (prev->next.compare_exchange_strong(expected, (uintptr_t)newNode, std::memory_order_release,
+                                                   std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+    // returns false if key not present
+    bool remove(int data)
+    {
+        EpochGuard guard;
+        while (true)
+        {
+            LFNode *prev, *curr;
+            if (!find(data, &prev, &curr))
+                return false;
+            uintptr_t succ = curr->next.load(std::memory_order_acquire);
+            if (lfMarked(succ))
+                continue; // other thread is deleting it, find() will help and tell whether key still exists
+            if (!curr->next.compare_exchange_strong(succ, succ | 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                continue;
+            // logically deleted by us. Try unlinking, otherwise some find() will do it
+            uintptr_t expected = (uintptr_t)curr;
+            if (prev->next.compare_exchange_strong(expected, succ, std::memory_order_release, std::memory_order_relaxed))
+                epochRetire(curr);
+            else
+                find(data, &prev, &curr);
+            return true;
+        }
+    }
+
+    // wait free: never writes, never restarts
+    bool contains(int data)
+    {
+        EpochGuard guard;
+        LFNode *curr = lfPtr(head.next.load(std::memory_order_acquire));
+        while (curr && curr->data < data)
+            curr = lfPtr(curr->next.load(std::memory_order_acquire));
+        return curr && curr->data == data && !lfMarked(curr->next.load(std::memory_order_acquire));
+    }
+
+    // not linearizable with concurrent updates; for printing / debugging
+    size_t size()
+    {
+        EpochGuard guard;
+        size_t cnt = 0;
+        for (uintptr_t p = head.next.load(std::memory_order_acquire); lfPtr(p);)
+        {
+            uintptr_t next = lfPtr(p)->next.load(std::memory_order_acquire);
+            cnt += !lfMarked(next);
+            p = next;
+        }
+        return cnt;
+    }
+
+private:
+    // position prev/curr such that prev->data < data <= curr->data (curr may be NULL).
+    // Unlinks marked nodes on the way. Returns true if curr holds data
+    bool find(int data, LFNode **prevOut, LFNode **currOut)
+    {
+    retry:
+        LFNode *prev = &head;
+        LFNode *curr = lfPtr(prev->next.load(std::memory_order_acquire));
+        while (curr)
+        {
+            uintptr_t succ = curr->next.load(std::memory_order_acquire);
+            if (lfMarked(succ))
+            {
+                uintptr_t expected = (uintptr_t)curr;
+                if (!prev->next.compare_exchange_strong(expected, (uintptr_t)lfPtr(succ), std::memory_order_acq_rel,
+                                                        std::memory_order_relaxed))
+                    goto retry; // prev changed or got marked itself
+                epochRetire(curr);
+                curr = lfPtr(succ);
+                continue;
+            }
+            if (curr->data >= data)
+            {
+                *prevOut = prev;
+                *currOut = curr;
+                return curr->data == data;
+            }
+            prev = curr;
+            curr = lfPtr(succ);
+        }
+        *prevOut = prev;
+        *currOut = NULL;
+        return false;
+    }
+
+    LFNode head; // sentinel
+};
+
+#endif
@@ -0,0 +1,215 @@
+// Scaling benchmark: lock free list (lockfree_list.h) vs existing Node list protected by single mutex.
+// Both are ordered by data. Mixed find/insert/delete workload on keys in [0, KEY_RANGE),
+// list prefilled with half the keys so inserts and deletes succeed about half the time
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <atomic>
+#include "list.h"
+#include "lockfree_list.h"
+#include "../generic/bench.h"
+
+#define BENCH_DURATION_MS 100
+#define KEY_RANGE 1024
+
+// ---------------- mutex protected version of existing list ----------------
+
+typedef struct
+{
+    Node *head;
+    pthread_mutex_t lock;
+} LockedList;
+
+static bool lockedInsert(LockedList *l, int data)
+{
+    pthread_mutex_lock(&l->lock);
+    Node *prev = NULL;
+    Node *curr = l->head;
+    while (curr && curr->data < data)
+    {
+        prev = curr;
+        curr = curr->next;
+    }
+    bool inserted = !(curr && curr->data == data);
+    if (inserted)
+    {
+        Node *newNode = createNode(data);
+        newNode->next = curr;
+#if defined(DOUBLY_LINKED_LIST)
+        newNode->prev = prev;
+        if (curr)
+            curr->prev = newNode;
+#endif
+        if (prev)
+            prev->next = newNode;
+        else
+            l->head = newNode;
+    }
+    pthread_mutex_unlock(&l->lock);
+    return inserted;
+}
+
+static bool lockedDelete(LockedList *l, int data)
+{
+    pthread_mutex_lock(&l->lock);
+    Node *prev = NULL;
+    Node *curr = l->head;
+    while (curr && curr->data < data)
+    {
+        prev = curr;
+        curr = curr->next;
+    }
+    bool deleted = curr && curr->data == data;
+    if (deleted)
+    {
+        if (prev)
+            prev->next = curr->next;
+        else
+            l->head = curr->next;
+#if defined(DOUBLY_LINKED_LIST)
+        if (curr->next)
+            curr->next->prev = prev;
+#endif
+        freeNode(curr);
+    }
+    pthread_mutex_unlock(&l->lock);
+    return deleted;
+}
+
+static bool lockedFind(LockedList *l, int data)
+{
+    pthread_mutex_lock(&l->lock);
+    Node *curr = l->head;
+    while (curr && curr->data < data)
+        curr = curr->next;
+    bool found = curr && curr->data == data;
+    pthread_mutex_unlock(&l->lock);
+    return found;
+}
+
+// ---------------- benchmark ----------------
+
+typedef struct
+{
+    int findPercent;
+    int insertPercent; // rest are deletes
+} Workload;
+
+typedef struct
+{
+    bool lockFree;
+    Workload wl;
+    LockedList *locked;
+    LockFreeList *lf;
+    int idx;
+    uint64_t ops;
+    int64_t sizeDelta; // successful inserts - successful deletes, for consistency check
+} WorkerArg;
+
+static std::atomic<bool> stopFlag;
+
+static void *listWorker(void *arg)
+{
+    WorkerArg *wa = (WorkerArg *)arg;
+    uint32_t rnd = 0x9e3779b9 * (wa->idx + 1);
+    uint64_t ops = 0;
+    int64_t delta = 0;
+    while (!stopFlag.load(std::memory_order_relaxed))
+    {
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 17;
+        rnd ^= rnd << 5;
+        int key = (rnd >> 8) % KEY_RANGE;
+        int op = rnd % 100;
+        if (op < wa->wl.findPercent)
+        {
+            // result must be consumed, otherwise compiler drops the whole traversal of side effect free find
+            bool found = wa->lockFree ? wa->lf->contains(key) : lockedFind(wa->locked, key);
+            doNotOptimize(found);
+        }
+        else if (op < wa->wl.findPercent + wa->wl.insertPercent)
+        {
+            delta += wa->lockFree ? wa->lf->insert(key) : lockedInsert(wa->locked, key);
+        }
+        else
+        {
+            delta -= wa->lockFree ? wa->lf->remove(key) : lockedDelete(wa->locked, key);
+        }
+        ops++;
+    }
+    wa->ops = ops;
+    wa->sizeDelta = delta;
+    return NULL;
+}
+
+static void runList(bool lockFree, Workload wl, int numThreads)
+{
+    LockedList locked = {NULL, PTHREAD_MUTEX_INITIALIZER};
+    LockFreeList *lf = new LockFreeList();
+    for (int k = 0; k < KEY_RANGE; k += 2)
+    {
+        lockFree ? lf->insert(k) : lockedInsert(&locked, k);
+    }
+
+    pthread_t tids[numThreads];
+    WorkerArg args[numThreads];
+    stopFlag = false;
+    for (int i = 0; i < numThreads; i++)
+    {
+        args[i] = {lockFree, wl, &locked, lf, i, 0, 0};
+        pthread_create(&tids[i], NULL, listWorker, &args[i]);
+    }
+    usleep(BENCH_DURATION_MS * 1000);
+    stopFlag = true;
+    uint64_t total = 0;
+    int64_t expectedSize = KEY_RANGE / 2;
+    for (int i = 0; i < numThreads; i++)
+    {
+        pthread_join(tids[i], NULL);
+        total += args[i].ops;
+        expectedSize += args[i].sizeDelta;
+    }
+
+    size_t size = 0;
+    if (lockFree)
+    {
+        size = lf->size();
+    }
+    else
+    {
+        for (Node *n = locked.head; n; n = n->next)
+            size++;
+    }
+    printf("%-10s thr=%-3d find/ins/del=%d/%d/%d  %8.2f Mops/s%s\n", lockFree ? "lock free" : "mutex", numThreads,
+           wl.findPercent, wl.insertPercent, 100 - wl.findPercent - wl.insertPercent,
+           total / (BENCH_DURATION_MS * 1000.0), (int64_t)size == expectedSize ? "" : "  SIZE MISMATCH!");
+
+    delete lf;
+    epochReclaimAll(); // all workers joined, nobody is inside epoch guard
+    while (locked.head)
+    {
+        Node *next = locked.head->next;
+        freeNode(locked.head);
+        locked.head = next;
+    }
+}
+
+int main_lflist()
+{
+    int numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int maxThreads = 2 * numCpus < 4 ? 4 : 2 * numCpus;
+    const Workload workloads[] = {{90, 5}, {50, 25}, {0, 50}};
+    printf("key range %d, list prefilled with %d keys\n", KEY_RANGE, KEY_RANGE / 2);
+    for (const Workload &wl : workloads)
+    {
+        for (int t = 1; t <= maxThreads; t *= 2)
+        {
+            runList(false, wl, t);
+            runList(true, wl, t);
+        }
+    }
+    return 0;
+}
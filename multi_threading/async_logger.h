@@ -0,0 +1,293 @@
+#ifndef __ASYNC_LOGGER_H
+#define __ASYNC_LOGGER_H
+
+// Asynchronous printf style logger that keeps stdio out of critical sections.
+//
+// printf takes stdio's internal lock and (with fflush or line buffered terminal) makes a write syscall.
+// Calling it while holding mutex/semaphore serializes all threads on stdio as well.
+// asyncLog() instead copies format pointer and raw argument bits into per thread ring buffer and returns.
+// Background thread formats records later and writes whole batch with single writev().
+//
+// Hot path: no lock, no syscall, no formatting. One TSC read and ~64 byte store into own ring.
+// Ring is single producer (owner thread) single consumer (logger thread), so only acquire/release loads and stores.
+// If ring is full record is dropped (and counted) rather than blocking the caller.
+//
+// Restrictions:
+// - format string and any char* argument must stay valid till it is printed (string literals are fine)
+// - at most LOG_MAX_ARGS arguments, each trivially copyable and at most 8 bytes
+// - records of different threads are ordered by timestamp only within one batch of the logger thread
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <type_traits>
+#include <utility>
+#include "../generic/bench.h"
+
+#define LOG_RING_SIZE 4096          // records per thread, must be power of 2
+#define LOG_MAX_ARGS 5              // keeps record at 64 bytes (one cache line)
+#define LOG_CHUNK_SIZE 4096         // formatted text is collected in chunks of this size
+#define LOG_MAX_CHUNKS 16           // chunks written by one writev
+#define LOG_IDLE_SLEEP_US 200       // logger thread sleep when all rings are empty
+
+typedef int (*LogFormatFn)(char *out, size_t size, const char *fmt, const uint64_t *args);
+
+typedef struct alignas(64)
+{
+  LogFormatFn format; // knows argument types, generated per call signature
+  const char *fmt;
+  uint64_t timestamp;
+  uint64_t args[LOG_MAX_ARGS];
+} LogRecord;
+
+typedef struct LogRing
+{
+  alignas(64) std::atomic<uint64_t> head; // next slot to write. Written only by owner thread
+  uint64_t cachedTail;                    // owner's copy of tail; avoids reading consumer's cache line on every call
+  std::atomic<uint64_t> dropped;
+  alignas(64) std::atomic<uint64_t> tail; // next slot to read. Written only by logger thread
+  struct LogRing *next;
+  LogRecord records[LOG_RING_SIZE];
+} LogRing;
+
+typedef struct
+{
+  std::atomic<LogRing *> rings{NULL};
+  std::atomic<bool> started{false};
+  std::atomic<bool> running{false};
+  int fd = STDOUT_FILENO;
+  pthread_t tid;
+  char chunks[LOG_MAX_CHUNKS][LOG_CHUNK_SIZE];
+} AsyncLogger;
+
+inline AsyncLogger asyncLogger;
+
+template <typename T>
+inline uint64_t logEncodeArg(T val)
+{
+  static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(uint64_t),
+                "asyncLog arguments must be scalars or pointers");
+  uint64_t word = 0;
+  memcpy(&word, &val, sizeof(T));
+  return word;
+}
+
+template <typename T>
+inline T logDecodeArg(uint64_t word)
+{
+  T val;
+  memcpy(&val, &word, sizeof(T));
+  return val;
+}
+
+template <typename... Args, size_t... I>
+inline int logFormatImpl(char *out, size_t size, const char *fmt, const uint64_t *args, std::index_sequence<I...>)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#pragma GCC diagnostic ignored "-Wformat-security"
+  // arguments are decoded back to their original types, so default argument promotions are same as direct printf call
+  return snprintf(out, size, fmt, logDecodeArg<Args>(args[I])...);
+#pragma GCC diagnostic pop
+}
+
+template <typename... Args>
+inline int logFormat(char *out, size_t size, const char *fmt, const uint64_t *args)
+{
+  return logFormatImpl<Args...>(out, size, fmt, args, std::index_sequence_for<Args...>{});
+}
+
+// pick ring with oldest pending record. Number of rings = number of threads that ever logged, so linear scan is fine
+inline LogRing *logOldestRing()
+{
+  LogRing *oldest = NULL;
+  uint64_t oldestTs = UINT64_MAX;
+  for (LogRing *r = asyncLogger.rings.load(std::memory_order_acquire); r; r = r->next)
+  {
+    uint64_t tail = r->tail.load(std::memory_order_relaxed);
+    if (tail != r->head.load(std::memory_order_acquire))
+    {
+      uint64_t ts = r->records[tail & (LOG_RING_SIZE - 1)].timestamp;
+      if (ts < oldestTs)
+      {
+        oldestTs = ts;
+        oldest = r;
+      }
+    }
+  }
+  return oldest;
+}
+
+inline void logWriteAll(struct iovec *iov, int cnt)
+{
+  // writev may write partially (pipe, signal), advance iovec till everything is written
+  while (cnt > 0)
+  {
+    ssize_t written = writev(asyncLogger.fd, iov, cnt);
+    if (written < 0)
+      return;
+    while (cnt > 0 && (size_t)written >= iov->iov_len)
+    {
+      written -= iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (cnt > 0)
+    {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+// format pending records into chunks and write them with one syscall. Returns number of records written
+inline size_t logDrainBatch()
+{
+  struct iovec iov[LOG_MAX_CHUNKS];
+  int chunk = 0;
+  size_t used = 0;
+  size_t numRecords = 0;
+  LogRing *r;
+  while (chunk < LOG_MAX_CHUNKS && (r = logOldestRing()))
+  {
+    uint64_t tail = r->tail.load(std::memory_order_relaxed);
+    LogRecord *rec = &r->records[tail & (LOG_RING_SIZE - 1)];
+    char *out = asyncLogger.chunks[chunk] + used;
+    int len = rec->format(out, LOG_CHUNK_SIZE - used, rec->fmt, rec->args);
+    if (len < 0)
+    {
+      len = 0; // bad format string, drop record
+    }
+    else if ((size_t)len >= LOG_CHUNK_SIZE - used)
+    {
+      if (used == 0)
+      {
+        len = LOG_CHUNK_SIZE - 1; // single record longer than chunk, truncate
+      }
+      else
+      {
+        // doesn't fit, close this chunk and retry same record in next one
+        iov[chunk].iov_base = asyncLogger.chunks[chunk];
+        iov[chunk].iov_len = used;
+        chunk++;
+        used = 0;
+        continue;
+      }
+    }
+    used += len;
+    numRecords++;
+    // slot can be reused by owner thread only after formatting is done
+    r->tail.store(tail + 1, std::memory_order_release);
+  }
+  if (chunk < LOG_MAX_CHUNKS && used)
+  {
+    iov[chunk].iov_base = asyncLogger.chunks[chunk];
+    iov[chunk].iov_len = used;
+    chunk++;
+  }
+  if (chunk)
+  {
+    logWriteAll(iov, chunk);
+  }
+  return numRecords;
+}
+
+inline void *logThreadMain(void *arg)
+{
+  (void)arg;
+  while (asyncLogger.running.load(std::memory_order_acquire))
+  {
+    if (!logDrainBatch())
+    {
+      usleep(LOG_IDLE_SLEEP_US);
+    }
+  }
+  while (logDrainBatch())
+  {
+  }
+  return NULL;
+}
+
+// flush everything logged so far and stop logger thread. Registered with atexit on first use
+inline void asyncLogShutdown()
+{
+  if (!asyncLogger.running.exchange(false))
+    return;
+  pthread_join(asyncLogger.tid, NULL);
+  uint64_t dropped = 0;
+  for (LogRing *r = asyncLogger.rings.load(std::memory_order_acquire); r; r = r->next)
+  {
+    dropped += r->dropped.load(std::memory_order_relaxed);
+  }
+  if (dropped)
+  {
+    fprintf(stderr, "async logger dropped %lu records (ring full)\n", dropped);
+  }
+}
+
+// optional: choose output fd before first log call. Default is stdout
+inline void asyncLogInit(int fd)
+{
+  if (asyncLogger.started.exchange(true))
+    return;
+  asyncLogger.fd = fd;
+  asyncLogger.running.store(true, std::memory_order_release);
+  pthread_create(&asyncLogger.tid, NULL, logThreadMain, NULL);
+  atexit(asyncLogShutdown);
+}
+
+// slow path: once per thread
+inline LogRing *logCreateRing()
+{
+  asyncLogInit(STDOUT_FILENO);
+  LogRing *r = new LogRing();
+  LogRing *head = asyncLogger.rings.load(std::memory_order_relaxed);
+  do
+  {
+    r->next = head;
+  } while (!asyncLogger.rings.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+  return r;
+}
+
+inline LogRing *logThreadRing()
+{
+  // ring is never freed: records logged just before thread exit are still printed
+  static thread_local LogRing *ring = NULL;
+  if (__builtin_expect(!ring, 0))
+    ring = logCreateRing();
+  return ring;
+}
+
+// printf replacement. Returns false if record was dropped because ring is full
+template <typename... Args>
+inline bool asyncLog(const char *fmt, Args... args)
+{
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many asyncLog arguments");
+  LogRing *r = logThreadRing();
+  uint64_t head = r->head.load(std::memory_order_relaxed);
+  if (head - r->cachedTail >= LOG_RING_SIZE)
+  {
+    r->cachedTail = r->tail.load(std::memory_order_acquire);
+    if (head - r->cachedTail >= LOG_RING_SIZE)
+    {
+      r->dropped.store(r->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  LogRecord *rec = &r->records[head & (LOG_RING_SIZE - 1)];
+  rec->format = logFormat<Args...>;
+  rec->fmt = fmt;
+  rec->timestamp = readCycles();
+  uint64_t words[LOG_MAX_ARGS + 1] = {logEncodeArg(args)...};
+  memcpy(rec->args, words, sizeof(rec->args));
+  r->head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+#endif
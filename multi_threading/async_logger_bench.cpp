@@ -0,0 +1,64 @@
+// Cost of a log call on the calling thread: asyncLog vs fprintf (+ fflush as done in producer_consumer.cpp)
+// Output goes to /dev/null so that only the caller side overhead is measured
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "async_logger.h"
+#include "../generic/bench.h"
+
+#define LOG_BURST 2048   // stay below ring size so that no record is dropped
+#define LOG_BURSTS 200
+
+int main_logger()
+{
+  int fd = open("/dev/null", O_WRONLY);
+  FILE *devNull = fdopen(dup(fd), "w");
+  asyncLogInit(fd);
+  uint64_t total;
+
+  total = 0;
+  for (int b = 0; b < LOG_BURSTS; b++)
+  {
+    uint64_t t0 = nowNs();
+    for (int i = 0; i < LOG_BURST; i++)
+    {
+      asyncLog("produced %d item: %d\n", i, b);
+    }
+    total += nowNs() - t0;
+    usleep(2000); // let logger thread drain the ring
+  }
+  printf("asyncLog          %6.1f ns/call\n", (double)total / (LOG_BURSTS * LOG_BURST));
+
+  total = 0;
+  for (int b = 0; b < LOG_BURSTS; b++)
+  {
+    uint64_t t0 = nowNs();
+    for (int i = 0; i < LOG_BURST; i++)
+    {
+      fprintf(devNull, "produced %d item: %d\n", i, b);
+    }
+    total += nowNs() - t0;
+  }
+  printf("fprintf           %6.1f ns/call\n", (double)total / (LOG_BURSTS * LOG_BURST));
+
+  total = 0;
+  for (int b = 0; b < LOG_BURSTS / 10; b++)
+  {
+    uint64_t t0 = nowNs();
+    for (int i = 0; i < LOG_BURST; i++)
+    {
+      fprintf(devNull, "produced %d item: %d\n", i, b);
+      fflush(devNull);
+    }
+    total += nowNs() - t0;
+  }
+  printf("fprintf + fflush  %6.1f ns/call\n", (double)total / (LOG_BURSTS / 10 * LOG_BURST));
+
+  asyncLogShutdown();
+  fclose(devNull);
+  close(fd);
+  return 0;
+}
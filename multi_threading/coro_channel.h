@@ -0,0 +1,313 @@
+#ifndef __CORO_CHANNEL_H
+#define __CORO_CHANNEL_H
+
+// C++20 coroutine building blocks for pipelined producer/consumer stages.
+//
+// CoroTask     - fire and forget coroutine started on executor. Frame is freed when coroutine finishes
+// CoroExecutor - small pool of OS threads resuming ready coroutines. Thousands of coroutines share few threads
+// Channel<T>   - bounded FIFO. co_await send(v) suspends the coroutine (not the thread) when channel is full,
+//                co_await recv() suspends when it is empty. So back-pressure never parks an OS thread;
+//                the thread simply picks up next ready coroutine
+//
+// Compared with pthread + semaphore version (producer_consumer.cpp) a blocked stage costs a few hundred bytes
+// of coroutine frame instead of a thread stack, and handover is a queue push instead of futex wake + context switch.
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <atomic>
+#include "locks.h"
+
+#define CORO_RESUME_BATCH 32 // ready coroutines a worker takes from shared queue at once
+
+class CoroExecutor;
+
+class CoroTask
+{
+public:
+  struct promise_type
+  {
+    CoroExecutor *executor = NULL;
+    CoroTask get_return_object() { return CoroTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; } // started by executor, not by caller
+    std::suspend_never final_suspend() noexcept;                  // frame destroyed automatically at the end
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  explicit CoroTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+  std::coroutine_handle<promise_type> handle;
+};
+
+class CoroExecutor
+{
+public:
+  explicit CoroExecutor(int threads) : numThreads(threads)
+  {
+    pthread_mutex_init(&m, NULL);
+    pthread_cond_init(&cond, NULL);
+  }
+
+  ~CoroExecutor()
+  {
+    pthread_mutex_destroy(&m);
+    pthread_cond_destroy(&cond);
+  }
+
+  void spawn(CoroTask task)
+  {
+    task.handle.promise().executor = this;
+    live.fetch_add(1, std::memory_order_relaxed);
+    schedule(task.handle);
+  }
+
+  // make suspended coroutine ready. Can be called from any thread
+  void schedule(std::coroutine_handle<> h)
+  {
+    pthread_mutex_lock(&m);
+    ready.push_back(h);
+    bool wake = numIdle > 0;
+    pthread_mutex_unlock(&m);
+    if (wake)
+      pthread_cond_signal(&cond);
+  }
+
+  // run worker threads till every spawned coroutine finished
+  void run()
+  {
+    std::vector<pthread_t> tids(numThreads);
+    stopping = false;
+    for (int i = 0; i < numThreads; i++)
+      pthread_create(&tids[i], NULL, workerMain, this);
+    for (int i = 0; i < numThreads; i++)
+      pthread_join(tids[i], NULL);
+  }
+
+  void taskDone()
+  {
+    if (live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      pthread_mutex_lock(&m);
+      stopping = true;
+      pthread_mutex_unlock(&m);
+      pthread_cond_broadcast(&cond);
+    }
+  }
+
+  // co_await executor.yield(): reschedule current coroutine behind other ready ones
+  auto yield()
+  {
+    struct YieldAwaiter
+    {
+      CoroExecutor *ex;
+      bool await_ready() { return false; }
+      void await_suspend(std::coroutine_handle<> h) { ex->schedule(h); }
+      void await_resume() {}
+    };
+    return YieldAwaiter{this};
+  }
+
+private:
+  static void *workerMain(void *arg)
+  {
+    CoroExecutor *ex = (CoroExecutor *)arg;
+    std::coroutine_handle<> batch[CORO_RESUME_BATCH];
+    while (true)
+    {
+      // take several handles per lock acquisition to reduce contention on shared queue
+      int n = 0;
+      pthread_mutex_lock(&ex->m);
+      while (ex->ready.empty() && !ex->stopping)
+      {
+        ex->numIdle++;
+        pthread_cond_wait(&ex->cond, &ex->m);
+        ex->numIdle--;
+      }
+      if (ex->ready.empty())
+      {
+        pthread_mutex_unlock(&ex->m);
+        return NULL;
+      }
+      // leave some work for other threads when queue is short
+      size_t take = ex->ready.size() / ex->numThreads + 1;
+      while (n < CORO_RESUME_BATCH && (size_t)n < take)
+      {
+        batch[n++] = ex->ready.front();
+        ex->ready.pop_front();
+      }
+      pthread_mutex_unlock(&ex->m);
+      for (int i = 0; i < n; i++)
+        batch[i].resume();
+    }
+  }
+
+  int numThreads;
+  pthread_mutex_t m;
+  pthread_cond_t cond;
+  std::deque<std::coroutine_handle<>> ready;
+  int numIdle = 0;
+  bool stopping = false;
+  std::atomic<int> live{0};
+};
+
+inline std::suspend_never CoroTask::promise_type::final_suspend() noexcept
+{
+  if (executor)
+    executor->taskDone();
+  return {};
+}
+
+template <typename T>
+class Channel
+{
+public:
+  Channel(CoroExecutor &ex, size_t cap) : executor(ex), capacity(cap) {}
+
+  struct SendAwaiter
+  {
+    Channel *ch;
+    T value;
+    bool ok = true;
+
+    bool await_ready() { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+      ch->lock.lock();
+      if (ch->closed)
+      {
+        ok = false;
+        ch->lock.unlock();
+        return false;
+      }
+      if (!ch->receivers.empty())
+      {
+        // receiver is waiting, so buffer is empty. Hand value over directly
+        Waiter r = ch->receivers.front();
+        ch->receivers.pop_front();
+        r.slot->emplace(std::move(value));
+        ch->lock.unlock();
+        ch->executor.schedule(r.handle);
+        return false;
+      }
+      if (ch->buffer.size() < ch->capacity)
+      {
+        ch->buffer.push_back(std::move(value));
+        ch->lock.unlock();
+        return false;
+      }
+      // channel full: park coroutine. Receiver moves value out of this awaiter and resumes us.
+      // Awaiter lives in coroutine frame which may be resumed on other thread right after unlock, so don't touch it after that
+      ch->senders.push_back(Sender{h, this});
+      ch->lock.unlock();
+      return true;
+    }
+
+    bool await_resume() { return ok; }
+  };
+
+  struct RecvAwaiter
+  {
+    Channel *ch;
+    std::optional<T> result;
+
+    bool await_ready() { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+      ch->lock.lock();
+      if (!ch->buffer.empty())
+      {
+        result.emplace(std::move(ch->buffer.front()));
+        ch->buffer.pop_front();
+        // space freed, admit one waiting sender
+        std::coroutine_handle<> wake = ch->admitSender();
+        ch->lock.unlock();
+        if (wake)
+          ch->executor.schedule(wake);
+        return false;
+      }
+      if (!ch->senders.empty())
+      {
+        // unbuffered channel (capacity 0): take value directly from sender
+        Sender s = ch->senders.front();
+        ch->senders.pop_front();
+        result.emplace(std::move(s.awaiter->value));
+        ch->lock.unlock();
+        ch->executor.schedule(s.handle);
+        return false;
+      }
+      if (ch->closed)
+      {
+        ch->lock.unlock();
+        return false; // result stays empty
+      }
+      ch->receivers.push_back(Waiter{h, &result});
+      ch->lock.unlock();
+      return true;
+    }
+
+    // empty optional means channel was closed and drained
+    std::optional<T> await_resume() { return std::move(result); }
+  };
+
+  SendAwaiter send(T value) { return SendAwaiter{this, std::move(value)}; }
+  RecvAwaiter recv() { return RecvAwaiter{this, std::nullopt}; }
+
+  // no more values. Waiting receivers get empty result, waiting senders get false
+  void close()
+  {
+    lock.lock();
+    closed = true;
+    std::deque<Waiter> r;
+    std::deque<Sender> s;
+    r.swap(receivers);
+    s.swap(senders);
+    lock.unlock();
+    for (Waiter &w : r)
+      executor.schedule(w.handle);
+    for (Sender &w : s)
+    {
+      w.awaiter->ok = false;
+      executor.schedule(w.handle);
+    }
+  }
+
+private:
+  struct Waiter
+  {
+    std::coroutine_handle<> handle;
+    std::optional<T> *slot;
+  };
+
+  struct Sender
+  {
+    std::coroutine_handle<> handle;
+    SendAwaiter *awaiter;
+  };
+
+  // called with lock held after buffer space is freed
+  std::coroutine_handle<> admitSender()
+  {
+    if (senders.empty())
+      return std::coroutine_handle<>();
+    Sender s = senders.front();
+    senders.pop_front();
+    buffer.push_back(std::move(s.awaiter->value));
+    return s.handle;
+  }
+
+  CoroExecutor &executor;
+  size_t capacity;
+  TTASLock lock; // critical sections are a few pointer moves, spinning is cheaper than futex
+  std::deque<T> buffer;
+  std::deque<Waiter> receivers;
+  std::deque<Sender> senders;
+  bool closed = false;
+};
+
+#endif
@@ -0,0 +1,215 @@
+// Three stage producer -> transformer -> consumer pipeline.
+// Same pipeline is run twice:
+// 1. pthread version in style of producer_consumer.cpp: bounded buffer guarded by mutex + empty/full semaphores,
+//    one OS thread per stage worker. Blocked stage parks its thread in kernel
+// 2. coroutine version: thousands of stage coroutines multiplexed on few OS threads, connected by Channel.
+//    Full/empty channel suspends only the coroutine
+// No usleep throttling in either; stages run as fast as hand over allows.
+// Reports throughput and end to end latency (item created by producer -> seen by consumer)
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <atomic>
+#include "coro_channel.h"
+#include "../generic/bench.h"
+
+#define PIPE_ITEMS 200000      // total items flowing through pipeline
+#define PIPE_CAPACITY 64       // bound of each stage buffer / channel
+#define PIPE_THREADS 4         // OS threads per stage (pthread) / in executor (coroutines)
+#define PIPE_COROUTINES 1000   // coroutines per stage
+
+typedef struct
+{
+  uint32_t id;
+  uint32_t value;
+  uint64_t created;
+} PipeItem;
+
+static uint64_t *latencyNs; // indexed by item id, so consumers never write same slot
+
+static void reportPipeline(const char *name, uint64_t elapsedNs, uint64_t checksum)
+{
+  sortSamples(latencyNs, PIPE_ITEMS);
+  printf("%-26s %8.2f Mitems/s  latency p50 %8lu p99 %9lu p99.9 %9lu ns  checksum %lu\n", name,
+         PIPE_ITEMS * 1000.0 / elapsedNs, percentile(latencyNs, PIPE_ITEMS, 50), percentile(latencyNs, PIPE_ITEMS, 99),
+         percentile(latencyNs, PIPE_ITEMS, 99.9), checksum);
+}
+
+static inline uint32_t transform(uint32_t v)
+{
+  return v * 2654435761U + 1;
+}
+
+// ---------------- pthread + semaphore version ----------------
+
+typedef struct
+{
+  PipeItem buff[PIPE_CAPACITY];
+  int produced, consumed;
+  pthread_mutex_t mutex;
+  sem_t empty, full;
+} BoundedBuffer;
+
+static void bufferInit(BoundedBuffer *b)
+{
+  b->produced = b->consumed = 0;
+  pthread_mutex_init(&b->mutex, NULL);
+  sem_init(&b->empty, 0, PIPE_CAPACITY);
+  sem_init(&b->full, 0, 0);
+}
+
+static void bufferPut(BoundedBuffer *b, PipeItem item)
+{
+  sem_wait(&b->empty);
+  pthread_mutex_lock(&b->mutex);
+  b->buff[b->produced++ % PIPE_CAPACITY] = item;
+  pthread_mutex_unlock(&b->mutex);
+  sem_post(&b->full);
+}
+
+static PipeItem bufferGet(BoundedBuffer *b)
+{
+  sem_wait(&b->full);
+  pthread_mutex_lock(&b->mutex);
+  PipeItem item = b->buff[b->consumed++ % PIPE_CAPACITY];
+  pthread_mutex_unlock(&b->mutex);
+  sem_post(&b->empty);
+  return item;
+}
+
+static BoundedBuffer stage1, stage2;
+static std::atomic<uint64_t> threadChecksum;
+
+static void *threadProducer(void *arg)
+{
+  long idx = (long)arg;
+  for (uint32_t i = idx; i < PIPE_ITEMS; i += PIPE_THREADS)
+  {
+    PipeItem item = {i, i, nowNs()};
+    bufferPut(&stage1, item);
+  }
+  return NULL;
+}
+
+static void *threadTransformer(void *arg)
+{
+  long idx = (long)arg;
+  for (uint32_t i = idx; i < PIPE_ITEMS; i += PIPE_THREADS)
+  {
+    PipeItem item = bufferGet(&stage1);
+    item.value = transform(item.value);
+    bufferPut(&stage2, item);
+  }
+  return NULL;
+}
+
+static void *threadConsumer(void *arg)
+{
+  long idx = (long)arg;
+  uint64_t sum = 0;
+  for (uint32_t i = idx; i < PIPE_ITEMS; i += PIPE_THREADS)
+  {
+    PipeItem item = bufferGet(&stage2);
+    latencyNs[item.id] = nowNs() - item.created;
+    sum += item.value;
+  }
+  threadChecksum += sum;
+  return NULL;
+}
+
+static void runThreadPipeline()
+{
+  pthread_t tids[3 * PIPE_THREADS];
+  bufferInit(&stage1);
+  bufferInit(&stage2);
+  threadChecksum = 0;
+  uint64_t start = nowNs();
+  for (long i = 0; i < PIPE_THREADS; i++)
+  {
+    pthread_create(&tids[i], NULL, threadConsumer, (void *)i);
+    pthread_create(&tids[PIPE_THREADS + i], NULL, threadTransformer, (void *)i);
+    pthread_create(&tids[2 * PIPE_THREADS + i], NULL, threadProducer, (void *)i);
+  }
+  for (int i = 0; i < 3 * PIPE_THREADS; i++)
+    pthread_join(tids[i], NULL);
+  reportPipeline("pthread + semaphore", nowNs() - start, threadChecksum);
+}
+
+// ---------------- coroutine version ----------------
+
+typedef struct
+{
+  std::atomic<int> producersLeft;
+  std::atomic<int> transformersLeft;
+  std::atomic<uint64_t> checksum;
+} PipeState;
+
+CoroTask coroProducer(Channel<PipeItem> &out, PipeState &st, uint32_t first)
+{
+  for (uint32_t i = first; i < PIPE_ITEMS; i += PIPE_COROUTINES)
+  {
+    PipeItem item = {i, i, nowNs()};
+    co_await out.send(item);
+  }
+  // last producer closes channel so that transformers know stream ended
+  if (st.producersLeft.fetch_sub(1) == 1)
+    out.close();
+}
+
+CoroTask coroTransformer(Channel<PipeItem> &in, Channel<PipeItem> &out, PipeState &st)
+{
+  while (std::optional<PipeItem> item = co_await in.recv())
+  {
+    item->value = transform(item->value);
+    co_await out.send(*item);
+  }
+  if (st.transformersLeft.fetch_sub(1) == 1)
+    out.close();
+}
+
+CoroTask coroConsumer(Channel<PipeItem> &in, PipeState &st)
+{
+  uint64_t sum = 0;
+  while (std::optional<PipeItem> item = co_await in.recv())
+  {
+    latencyNs[item->id] = nowNs() - item->created;
+    sum += item->value;
+  }
+  st.checksum += sum;
+}
+
+static void runCoroutinePipeline()
+{
+  CoroExecutor executor(PIPE_THREADS);
+  Channel<PipeItem> ch1(executor, PIPE_CAPACITY);
+  Channel<PipeItem> ch2(executor, PIPE_CAPACITY);
+  PipeState st;
+  st.producersLeft = PIPE_COROUTINES;
+  st.transformersLeft = PIPE_COROUTINES;
+  st.checksum = 0;
+  uint64_t start = nowNs();
+  for (uint32_t i = 0; i < PIPE_COROUTINES; i++)
+  {
+    executor.spawn(coroConsumer(ch2, st));
+    executor.spawn(coroTransformer(ch1, ch2, st));
+    executor.spawn(coroProducer(ch1, st, i));
+  }
+  executor.run();
+  char name[64];
+  snprintf(name, sizeof(name), "coroutines (%dx3 on %d thr)", PIPE_COROUTINES, PIPE_THREADS);
+  reportPipeline(name, nowNs() - start, st.checksum);
+}
+
+int main_coro()
+{
+  latencyNs = (uint64_t *)malloc(PIPE_ITEMS * sizeof(uint64_t));
+  printf("%d items through 3 stage pipeline, stage capacity %d\n", PIPE_ITEMS, PIPE_CAPACITY);
+  runThreadPipeline();
+  runCoroutinePipeline();
+  free(latencyNs);
+  return 0;
+}
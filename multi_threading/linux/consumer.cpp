@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <sys/shm.h>
 #include <sys/mman.h>
+#include "../lock_profiler.h"
 
 #define SEM_EMPTY "/sem_empty"
 #define SEM_FULL "/sem_full"
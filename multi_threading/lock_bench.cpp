@@ -0,0 +1,466 @@
+// Contention scaling benchmark of locks in locks.h against pthread mutex / rwlock
+// Sweeps thread count, critical section length and (for reader-writer locks) read ratio.
+// Reports throughput, fairness and acquisition latency tail for every configuration.
+//
+// fairness: Jain's index over per thread acquisition count. 1.0 = all threads got equal share, 1/n = one thread got all
+// latency : time from calling lock() till it returned. Tail (p99, p99.9) is what hurts on hot paths
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <atomic>
+#include "locks.h"
+#include "../generic/bench.h"
+
+#define BENCH_DURATION_MS 50
+#define MAX_SAMPLES_PER_THREAD 8192 // latency samples kept per thread (ring buffer, latest ones win)
+#define NON_CS_WORK 50              // private work between two acquisitions so that it's not 100% lock handover
+#define SHORT_LIVED_ACQUISITIONS 16 // per thread in the thread churn stress, then the thread exits
+
+typedef struct alignas(CACHE_LINE_SIZE)
+{
+  uint64_t ops;
+  uint64_t numSamples;
+  uint64_t samples[MAX_SAMPLES_PER_THREAD];
+} ThreadStats;
+
+typedef struct
+{
+  void *bench;
+  int idx;
+} WorkerArg;
+
+static std::atomic<int> readyThreads;
+static std::atomic<bool> startFlag;
+static std::atomic<bool> stopFlag;
+
+static inline void spinWork(uint32_t iters)
+{
+  uint64_t x = 0;
+  for (uint32_t i = 0; i < iters; i++)
+  {
+    x += i;
+    doNotOptimize(x);
+  }
+}
+
+static inline void recordSample(ThreadStats *st, uint64_t cycles)
+{
+  st->samples[st->numSamples++ % MAX_SAMPLES_PER_THREAD] = cycles;
+}
+
+static void waitForStart()
+{
+  readyThreads.fetch_add(1);
+  while (!startFlag.load(std::memory_order_acquire))
+  {
+    sched_yield();
+  }
+}
+
+// spawn threads, let them run for BENCH_DURATION_MS and stop them
+static void runThreads(int numThreads, void *(*worker)(void *), void *bench)
+{
+  pthread_t tids[numThreads];
+  WorkerArg args[numThreads];
+  readyThreads = 0;
+  startFlag = false;
+  stopFlag = false;
+  for (int i = 0; i < numThreads; i++)
+  {
+    args[i].bench = bench;
+    args[i].idx = i;
+    pthread_create(&tids[i], NULL, worker, &args[i]);
+  }
+  while (readyThreads.load() < numThreads)
+  {
+    sched_yield();
+  }
+  startFlag.store(true, std::memory_order_release);
+  usleep(BENCH_DURATION_MS * 1000);
+  stopFlag.store(true, std::memory_order_release);
+  for (int i = 0; i < numThreads; i++)
+  {
+    pthread_join(tids[i], NULL);
+  }
+}
+
+static void report(const char *name, int numThreads, const char *param, uint32_t paramVal, ThreadStats *stats)
+{
+  uint64_t total = 0;
+  uint64_t minOps = UINT64_MAX, maxOps = 0;
+  double sumSq = 0;
+  size_t numSamples = 0;
+  for (int i = 0; i < numThreads; i++)
+  {
+    total += stats[i].ops;
+    sumSq += (double)stats[i].ops * stats[i].ops;
+    minOps = stats[i].ops < minOps ? stats[i].ops : minOps;
+    maxOps = stats[i].ops > maxOps ? stats[i].ops : maxOps;
+    numSamples += stats[i].numSamples < MAX_SAMPLES_PER_THREAD ? stats[i].numSamples : MAX_SAMPLES_PER_THREAD;
+  }
+
+  uint64_t *all = (uint64_t *)malloc((numSamples + 1) * sizeof(uint64_t));
+  size_t n = 0;
+  for (int i = 0; i < numThreads; i++)
+  {
+    size_t cnt = stats[i].numSamples < MAX_SAMPLES_PER_THREAD ? stats[i].numSamples : MAX_SAMPLES_PER_THREAD;
+    for (size_t j = 0; j < cnt; j++)
+    {
+      all[n++] = stats[i].samples[j];
+    }
+  }
+  sortSamples(all, n);
+  double ratio = cyclesPerNs();
+
+  double jain = sumSq > 0 ? ((double)total * total) / (numThreads * sumSq) : 0;
+  printf("%-14s thr=%-3d %s=%-5u %9.3f Mops/s  jain=%.3f min/max=%.2f  p50=%7.0f p99=%9.0f p99.9=%10.0f ns\n",
+         name, numThreads, param, paramVal, total / (BENCH_DURATION_MS * 1000.0), jain,
+         maxOps ? (double)minOps / maxOps : 0.0, percentile(all, n, 50) / ratio, percentile(all, n, 99) / ratio,
+         percentile(all, n, 99.9) / ratio);
+  free(all);
+}
+
+// ---------------- mutual exclusion sweep ----------------
+
+template <typename Lock>
+struct MutexBench
+{
+  Lock lock;
+  alignas(CACHE_LINE_SIZE) uint64_t sharedCounter;
+  uint32_t csWork;
+  ThreadStats *stats;
+};
+
+template <typename Lock>
+void *mutexWorker(void *arg)
+{
+  WorkerArg *wa = (WorkerArg *)arg;
+  MutexBench<Lock> *b = (MutexBench<Lock> *)wa->bench;
+  ThreadStats *st = &b->stats[wa->idx];
+  waitForStart();
+  while (!stopFlag.load(std::memory_order_relaxed))
+  {
+    uint64_t t0 = readCycles();
+    b->lock.lock();
+    uint64_t t1 = readCycles();
+    b->sharedCounter++;
+    spinWork(b->csWork);
+    b->lock.unlock();
+    recordSample(st, t1 - t0);
+    st->ops++;
+    spinWork(NON_CS_WORK);
+  }
+  return NULL;
+}
+
+template <typename Lock>
+void benchMutex(const char *name, int numThreads, uint32_t csWork)
+{
+  MutexBench<Lock> *b = new MutexBench<Lock>();
+  b->sharedCounter = 0;
+  b->csWork = csWork;
+  b->stats = new ThreadStats[numThreads]();
+  runThreads(numThreads, mutexWorker<Lock>, b);
+
+  uint64_t total = 0;
+  for (int i = 0; i < numThreads; i++)
+    total += b->stats[i].ops;
+  if (total != b->sharedCounter)
+  {
+    printf("%s: mutual exclusion violated! counter %lu expected %lu\n", name, b->sharedCounter, total);
+  }
+  report(name, numThreads, "cs", csWork, b->stats);
+  delete[] b->stats;
+  delete b;
+}
+
+// ---------------- tryLock stress ----------------
+
+// threads mix tryLock() and lock(), a queue lock has to keep mutual exclusion when a tryLock races with
+// nodes being recycled by lock()/unlock(). No timing, only the check
+template <typename Lock>
+struct TryLockStress
+{
+  Lock lock;
+  alignas(CACHE_LINE_SIZE) uint64_t sharedCounter;
+  std::atomic<uint32_t> inside;
+  std::atomic<uint64_t> overlaps;
+  ThreadStats *stats;
+};
+
+// one acquisition by tryLock (odd rnd, may fail) or lock(), critical section checked for overlap
+template <typename Lock>
+static void stressOnce(TryLockStress<Lock> *b, ThreadStats *st, uint32_t rnd)
+{
+  if (rnd & 1)
+  {
+    if (!b->lock.tryLock())
+      return;
+  }
+  else
+  {
+    b->lock.lock();
+  }
+  if (b->inside.exchange(1, std::memory_order_relaxed))
+    b->overlaps.fetch_add(1, std::memory_order_relaxed);
+  b->sharedCounter++;
+  spinWork(rnd % 16);
+  if ((rnd & 0x70) == 0)
+    sched_yield(); // holder preempted now and then, so others run while it's inside even on a single core
+  b->inside.store(0, std::memory_order_relaxed);
+  b->lock.unlock();
+  st->ops++;
+}
+
+static inline uint32_t nextRnd(uint32_t rnd)
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 17;
+  rnd ^= rnd << 5;
+  return rnd;
+}
+
+template <typename Lock>
+void *tryLockWorker(void *arg)
+{
+  WorkerArg *wa = (WorkerArg *)arg;
+  TryLockStress<Lock> *b = (TryLockStress<Lock> *)wa->bench;
+  ThreadStats *st = &b->stats[wa->idx];
+  uint32_t rnd = 0x9e3779b9 * (wa->idx + 1);
+  waitForStart();
+  while (!stopFlag.load(std::memory_order_relaxed))
+  {
+    rnd = nextRnd(rnd);
+    stressOnce(b, st, rnd);
+    spinWork(rnd % 32);
+  }
+  return NULL;
+}
+
+// a short lived thread: a few acquisitions, then exit (and thread local queue nodes go away with it)
+template <typename Lock>
+void *shortLivedWorker(void *arg)
+{
+  WorkerArg *wa = (WorkerArg *)arg;
+  TryLockStress<Lock> *b = (TryLockStress<Lock> *)wa->bench;
+  uint32_t rnd = 0x9e3779b9 * (wa->idx + 1) + (uint32_t)b->stats[wa->idx].ops;
+  for (int i = 0; i < SHORT_LIVED_ACQUISITIONS; i++)
+  {
+    rnd = nextRnd(rnd) & ~1u; // lock(), the long lived threads do the tryLocks
+    stressOnce(b, &b->stats[wa->idx], rnd);
+  }
+  return NULL;
+}
+
+// even threads hammer tryLock/lock, odd ones keep creating short lived threads and joining them
+template <typename Lock>
+void *churnWorker(void *arg)
+{
+  WorkerArg *wa = (WorkerArg *)arg;
+  if (wa->idx % 2 == 0)
+    return tryLockWorker<Lock>(arg);
+  waitForStart();
+  while (!stopFlag.load(std::memory_order_relaxed))
+  {
+    pthread_t t;
+    if (pthread_create(&t, NULL, shortLivedWorker<Lock>, arg) != 0)
+      break;
+    pthread_join(t, NULL);
+  }
+  return NULL;
+}
+
+// churn: threads exit and new ones start while others tryLock, so a queue lock must not free a node a
+// stalled tryLock can still read
+template <typename Lock>
+void stressTryLock(const char *name, int numThreads, bool churn)
+{
+  TryLockStress<Lock> *b = new TryLockStress<Lock>();
+  b->sharedCounter = 0;
+  b->inside = 0;
+  b->overlaps = 0;
+  b->stats = new ThreadStats[numThreads]();
+  runThreads(numThreads, churn ? churnWorker<Lock> : tryLockWorker<Lock>, b);
+
+  const char *what = churn ? "tryLock/lock with thread churn" : "tryLock/lock mix";
+  uint64_t total = 0;
+  for (int i = 0; i < numThreads; i++)
+    total += b->stats[i].ops;
+  if (total != b->sharedCounter || b->overlaps)
+  {
+    printf("%s: %s violated mutual exclusion! counter %lu expected %lu, %lu overlaps\n", name, what,
+           b->sharedCounter, total, b->overlaps.load());
+  }
+  else
+  {
+    printf("%-14s thr=%-3d %s ok, %lu acquisitions\n", name, numThreads, what, total);
+  }
+  delete[] b->stats;
+  delete b;
+}
+
+// ---------------- reader-writer sweep ----------------
+
+// readers verify that they never observe half written data
+typedef struct
+{
+  uint64_t a, b, c, d;
+} SharedData;
+
+static inline bool isConsistent(const SharedData &d)
+{
+  return d.b == d.a + 1 && d.c == d.a + 2 && d.d == d.a + 3;
+}
+
+static inline SharedData nextData(const SharedData &d)
+{
+  SharedData n = {d.a + 1, d.a + 2, d.a + 3, d.a + 4};
+  return n;
+}
+
+// mutual exclusion lock used for both readers and writers
+template <typename Lock>
+struct ExclusiveAccess
+{
+  Lock l;
+  SharedData data = {0, 1, 2, 3};
+  SharedData read() { l.lock(); SharedData d = data; l.unlock(); return d; }
+  void update() { l.lock(); data = nextData(data); l.unlock(); }
+};
+
+struct SharedAccess
+{
+  RWLock l;
+  SharedData data = {0, 1, 2, 3};
+  SharedData read() { l.lockShared(); SharedData d = data; l.unlockShared(); return d; }
+  void update() { l.lock(); data = nextData(data); l.unlock(); }
+};
+
+struct PthreadRWAccess
+{
+  pthread_rwlock_t l = PTHREAD_RWLOCK_INITIALIZER;
+  SharedData data = {0, 1, 2, 3};
+  SharedData read() { pthread_rwlock_rdlock(&l); SharedData d = data; pthread_rwlock_unlock(&l); return d; }
+  void update() { pthread_rwlock_wrlock(&l); data = nextData(data); pthread_rwlock_unlock(&l); }
+};
+
+struct SeqAccess
+{
+  SeqLock<SharedData> l;
+  SeqAccess() { SharedData d = {0, 1, 2, 3}; l.write(d); }
+  SharedData read() { return l.read(); }
+  // only one writer at a time inside write(), but read-modify-write needs outer serialization
+  void update() { writers.lock(); l.write(nextData(l.read())); writers.unlock(); }
+  TTASLock writers;
+};
+
+template <typename Access>
+struct RWBench
+{
+  Access access;
+  uint32_t readPercent;
+  std::atomic<uint64_t> torn;
+  ThreadStats *stats;
+};
+
+template <typename Access>
+void *rwWorker(void *arg)
+{
+  WorkerArg *wa = (WorkerArg *)arg;
+  RWBench<Access> *b = (RWBench<Access> *)wa->bench;
+  ThreadStats *st = &b->stats[wa->idx];
+  uint32_t rnd = 0x9e3779b9 * (wa->idx + 1);
+  waitForStart();
+  while (!stopFlag.load(std::memory_order_relaxed))
+  {
+    // xorshift: cheap per thread random number, rand() has internal lock
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    uint64_t t0 = readCycles();
+    if (rnd % 100 < b->readPercent)
+    {
+      SharedData d = b->access.read();
+      if (!isConsistent(d))
+        b->torn.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+      b->access.update();
+    }
+    recordSample(st, readCycles() - t0);
+    st->ops++;
+    spinWork(NON_CS_WORK);
+  }
+  return NULL;
+}
+
+template <typename Access>
+void benchRW(const char *name, int numThreads, uint32_t readPercent)
+{
+  RWBench<Access> *b = new RWBench<Access>();
+  b->readPercent = readPercent;
+  b->torn = 0;
+  b->stats = new ThreadStats[numThreads]();
+  runThreads(numThreads, rwWorker<Access>, b);
+  if (b->torn)
+  {
+    printf("%s: readers observed %lu torn values!\n", name, b->torn.load());
+  }
+  report(name, numThreads, "read%", readPercent, b->stats);
+  delete[] b->stats;
+  delete b;
+}
+
+int main_locks()
+{
+  int numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int maxThreads = 2 * numCpus < 4 ? 4 : 2 * numCpus; // go past core count to see oversubscription behaviour
+  const uint32_t csWork[] = {0, 100, 1000};
+  const uint32_t readPercent[] = {50, 90, 99};
+  cyclesPerNs(); // calibrate before spawning threads
+
+  printf("online cpus %d. latency = lock() call to return (mutex) or whole operation (rw)\n", numCpus);
+  for (uint32_t cs : csWork)
+  {
+    printf("\n--- mutual exclusion, critical section %u iterations ---\n", cs);
+    for (int t = 1; t <= maxThreads; t *= 2)
+    {
+      benchMutex<PthreadMutexLock>("pthread_mutex", t, cs);
+      benchMutex<TTASLock>("ttas", t, cs);
+      benchMutex<TicketLock>("ticket", t, cs);
+      benchMutex<MCSLock>("mcs", t, cs);
+      benchMutex<CLHLock>("clh", t, cs);
+    }
+  }
+
+  printf("\n--- tryLock mixed with lock ---\n");
+  for (int t = 2; t <= maxThreads; t *= 2)
+  {
+    stressTryLock<TTASLock>("ttas", t, false);
+    stressTryLock<TicketLock>("ticket", t, false);
+    stressTryLock<MCSLock>("mcs", t, false);
+    stressTryLock<CLHLock>("clh", t, false);
+  }
+  for (int t = 2; t <= maxThreads; t *= 2)
+  {
+    stressTryLock<MCSLock>("mcs", t, true);
+    stressTryLock<CLHLock>("clh", t, true);
+  }
+
+  for (uint32_t rp : readPercent)
+  {
+    printf("\n--- read/write, %u%% reads ---\n", rp);
+    for (int t = 1; t <= maxThreads; t *= 2)
+    {
+      benchRW<ExclusiveAccess<PthreadMutexLock>>("pthread_mutex", t, rp);
+      benchRW<PthreadRWAccess>("pthread_rwlock", t, rp);
+      benchRW<SharedAccess>("rwlock", t, rp);
+      benchRW<SeqAccess>("seqlock", t, rp);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,340 @@
+#ifndef __LOCK_PROFILER_H
+#define __LOCK_PROFILER_H
+
+// Lock contention profiler for pthread mutex, condition variable and semaphores.
+//
+// Usage: include this header after pthread.h/semaphore.h and compile with -DLOCK_PROFILE
+// Calls to pthread_mutex_lock/unlock, pthread_cond_wait and sem_wait in that file are redirected through
+// macros to profiled versions which record against call site (file:line):
+// - acquisitions and how many of them were contended
+// - wait time: how long thread was blocked before getting lock/semaphore/condition
+// - hold time: how long mutex was held, attributed to site which acquired it
+// Without LOCK_PROFILE this header compiles to nothing, so demos can always include it.
+//
+// Wrappers are inline (not static) so that every file of the program shares one per thread buffer.
+// Every thread records into its own buffer (no shared cache line written on lock path), buffers are
+// never freed so that threads which already exited are still part of report. Report with log2 histograms
+// is printed at exit, on SIGINT/SIGTERM (demos here loop forever) or by calling lockProfDump().
+// Uncontended acquisition costs one trylock and one timestamp, so it can be left enabled under load.
+// Hold time for semaphores is not recorded as they are often posted by another thread (producer/consumer)
+
+#if defined(LOCK_PROFILE)
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include "../generic/bench.h"
+
+#define LOCK_PROF_MAX_SITES 64      // per thread, must be power of 2
+#define LOCK_PROF_MAX_HELD 16       // mutexes held at same time by one thread
+#define LOCK_PROF_BUCKETS 40        // log2 histogram buckets of time in cycles
+
+typedef enum
+{
+  SITE_MUTEX,
+  SITE_COND,
+  SITE_SEM
+} LockSiteKind;
+
+typedef struct
+{
+  const char *file;             // NULL for unused entry
+  int line;
+  LockSiteKind kind;
+  std::atomic<uint64_t> acquisitions;
+  std::atomic<uint64_t> contended;
+  std::atomic<uint64_t> waitCycles;
+  std::atomic<uint64_t> maxWaitCycles;
+  std::atomic<uint64_t> holdCycles;
+  std::atomic<uint64_t> waitHist[LOCK_PROF_BUCKETS];
+  std::atomic<uint64_t> holdHist[LOCK_PROF_BUCKETS];
+} LockSiteStats;
+
+typedef struct
+{
+  const void *lock;
+  LockSiteStats *site;
+  uint64_t since;
+} HeldLock;
+
+typedef struct ThreadLockProfile
+{
+  LockSiteStats sites[LOCK_PROF_MAX_SITES];
+  LockSiteStats overflow;       // used when site table is full
+  HeldLock held[LOCK_PROF_MAX_HELD];
+  int numHeld;
+  struct ThreadLockProfile *next;
+} ThreadLockProfile;
+
+inline std::atomic<ThreadLockProfile *> lockProfThreads{NULL};
+inline std::atomic<bool> lockProfInstalled{false};
+inline std::atomic<bool> lockProfDumped{false};
+
+// only owner thread writes, so plain load + store (no locked instruction) is enough.
+// Atomic type only makes concurrent read from dump well defined
+inline void lockProfAdd(std::atomic<uint64_t> &counter, uint64_t val)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+inline int lockProfBucket(uint64_t cycles)
+{
+  int b = cycles ? 64 - __builtin_clzll(cycles) : 0;
+  return b < LOCK_PROF_BUCKETS ? b : LOCK_PROF_BUCKETS - 1;
+}
+
+inline void lockProfDump()
+{
+  if (lockProfDumped.exchange(true))
+    return;
+
+  // merge per thread tables by site. Sites are few, so quadratic merge is fine
+  static LockSiteStats merged[LOCK_PROF_MAX_SITES * 4];
+  int numMerged = 0;
+  for (ThreadLockProfile *t = lockProfThreads.load(std::memory_order_acquire); t; t = t->next)
+  {
+    for (int i = 0; i <= LOCK_PROF_MAX_SITES; i++)
+    {
+      LockSiteStats *s = i < LOCK_PROF_MAX_SITES ? &t->sites[i] : &t->overflow;
+      if (!s->file || !s->acquisitions.load(std::memory_order_relaxed))
+        continue;
+      int m = 0;
+      while (m < numMerged && !(merged[m].file == s->file && merged[m].line == s->line && merged[m].kind == s->kind))
+        m++;
+      if (m == numMerged)
+      {
+        if (numMerged == LOCK_PROF_MAX_SITES * 4)
+          continue;
+        merged[numMerged].file = s->file;
+        merged[numMerged].line = s->line;
+        merged[numMerged].kind = s->kind;
+        numMerged++;
+      }
+      lockProfAdd(merged[m].acquisitions, s->acquisitions.load(std::memory_order_relaxed));
+      lockProfAdd(merged[m].contended, s->contended.load(std::memory_order_relaxed));
+      lockProfAdd(merged[m].waitCycles, s->waitCycles.load(std::memory_order_relaxed));
+      lockProfAdd(merged[m].holdCycles, s->holdCycles.load(std::memory_order_relaxed));
+      if (s->maxWaitCycles.load(std::memory_order_relaxed) > merged[m].maxWaitCycles.load(std::memory_order_relaxed))
+        merged[m].maxWaitCycles.store(s->maxWaitCycles.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      for (int b = 0; b < LOCK_PROF_BUCKETS; b++)
+      {
+        lockProfAdd(merged[m].waitHist[b], s->waitHist[b].load(std::memory_order_relaxed));
+        lockProfAdd(merged[m].holdHist[b], s->holdHist[b].load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  static const char *kindName[] = {"mutex", "cond", "sem"};
+  double ratio = cyclesPerNs();
+  fprintf(stderr, "\n==== lock profile (times in ns, histogram bucket = [2^(b-1), 2^b) ns) ====\n");
+  for (int m = 0; m < numMerged; m++)
+  {
+    LockSiteStats *s = &merged[m];
+    uint64_t acq = s->acquisitions.load(std::memory_order_relaxed);
+    fprintf(stderr, "%s:%d %s acquisitions %lu contended %lu (%.1f%%) wait total %.0f avg %.0f max %.0f",
+            s->file, s->line, kindName[s->kind], acq, s->contended.load(std::memory_order_relaxed),
+            100.0 * s->contended.load(std::memory_order_relaxed) / acq, s->waitCycles.load(std::memory_order_relaxed) / ratio,
+            s->waitCycles.load(std::memory_order_relaxed) / ratio / acq, s->maxWaitCycles.load(std::memory_order_relaxed) / ratio);
+    if (s->kind == SITE_MUTEX || s->kind == SITE_COND)
+    {
+      fprintf(stderr, " hold total %.0f avg %.0f", s->holdCycles.load(std::memory_order_relaxed) / ratio,
+              s->holdCycles.load(std::memory_order_relaxed) / ratio / acq);
+    }
+    fprintf(stderr, "\n");
+    for (int h = 0; h < 2; h++)
+    {
+      std::atomic<uint64_t> *hist = h ? s->holdHist : s->waitHist;
+      // histogram is collected in cycles; rebin to ns buckets for printing
+      uint64_t nsHist[LOCK_PROF_BUCKETS] = {0};
+      bool any = false;
+      for (int b = 0; b < LOCK_PROF_BUCKETS; b++)
+      {
+        uint64_t cnt = hist[b].load(std::memory_order_relaxed);
+        if (cnt)
+        {
+          uint64_t ns = b ? (uint64_t)((1ULL << (b - 1)) / ratio) : 0;
+          nsHist[lockProfBucket(ns)] += cnt;
+          any = true;
+        }
+      }
+      if (!any)
+        continue;
+      fprintf(stderr, "    %s:", h ? "hold" : "wait");
+      for (int b = 0; b < LOCK_PROF_BUCKETS; b++)
+      {
+        if (nsHist[b])
+          fprintf(stderr, " <%lu:%lu", 1UL << b, nsHist[b]);
+      }
+      fprintf(stderr, "\n");
+    }
+  }
+}
+
+inline void lockProfSignal(int sig)
+{
+  // best effort: stdio isn't async signal safe, but demos are stopped by ctrl+c and report is the whole point
+  lockProfDump();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+inline ThreadLockProfile *lockProfCreate()
+{
+  ThreadLockProfile *t = new ThreadLockProfile();
+  // lock free push to global list. Happens once per thread
+  ThreadLockProfile *head = lockProfThreads.load(std::memory_order_relaxed);
+  do
+  {
+    t->next = head;
+  } while (!lockProfThreads.compare_exchange_weak(head, t, std::memory_order_release, std::memory_order_relaxed));
+
+  if (!lockProfInstalled.exchange(true))
+  {
+    cyclesPerNs(); // calibrate now rather than in signal handler
+    atexit(lockProfDump);
+    signal(SIGINT, lockProfSignal);
+    signal(SIGTERM, lockProfSignal);
+  }
+  return t;
+}
+
+inline ThreadLockProfile *lockProfThread()
+{
+  static thread_local ThreadLockProfile *t = NULL;
+  if (__builtin_expect(!t, 0))
+    t = lockProfCreate();
+  return t;
+}
+
+inline LockSiteStats *lockProfSite(ThreadLockProfile *t, const char *file, int line, LockSiteKind kind)
+{
+  // open addressing on (file, line). file is string literal, so pointer comparison is enough
+  uint32_t h = (uint32_t)(((uintptr_t)file >> 3) * 31 + line * 2654435761U + kind);
+  for (int probe = 0; probe < LOCK_PROF_MAX_SITES; probe++)
+  {
+    LockSiteStats *s = &t->sites[(h + probe) & (LOCK_PROF_MAX_SITES - 1)];
+    if (s->file == file && s->line == line && s->kind == kind)
+      return s;
+    if (!s->file)
+    {
+      s->line = line;
+      s->kind = kind;
+      s->file = file;
+      return s;
+    }
+  }
+  t->overflow.file = "<other sites>";
+  t->overflow.kind = kind;
+  return &t->overflow;
+}
+
+inline void lockProfRecordWait(LockSiteStats *s, uint64_t wait, bool contended)
+{
+  lockProfAdd(s->acquisitions, 1);
+  if (contended)
+  {
+    lockProfAdd(s->contended, 1);
+    lockProfAdd(s->waitCycles, wait);
+    if (wait > s->maxWaitCycles.load(std::memory_order_relaxed))
+      s->maxWaitCycles.store(wait, std::memory_order_relaxed);
+  }
+  lockProfAdd(s->waitHist[lockProfBucket(wait)], 1);
+}
+
+inline void lockProfPushHeld(ThreadLockProfile *t, const void *lock, LockSiteStats *s, uint64_t now)
+{
+  if (t->numHeld < LOCK_PROF_MAX_HELD)
+  {
+    t->held[t->numHeld].lock = lock;
+    t->held[t->numHeld].site = s;
+    t->held[t->numHeld].since = now;
+    t->numHeld++;
+  }
+}
+
+inline void lockProfPopHeld(ThreadLockProfile *t, const void *lock, uint64_t now)
+{
+  // usually the most recently acquired lock is released first
+  for (int i = t->numHeld - 1; i >= 0; i--)
+  {
+    if (t->held[i].lock == lock)
+    {
+      uint64_t hold = now - t->held[i].since;
+      lockProfAdd(t->held[i].site->holdCycles, hold);
+      lockProfAdd(t->held[i].site->holdHist[lockProfBucket(hold)], 1);
+      t->held[i] = t->held[--t->numHeld];
+      return;
+    }
+  }
+}
+
+inline int lockProfMutexLock(pthread_mutex_t *m, const char *file, int line)
+{
+  ThreadLockProfile *t = lockProfThread();
+  LockSiteStats *s = lockProfSite(t, file, line, SITE_MUTEX);
+  int ret = pthread_mutex_trylock(m);
+  uint64_t now = readCycles();
+  uint64_t wait = 0;
+  if (ret == EBUSY)
+  {
+    ret = pthread_mutex_lock(m);
+    uint64_t acquired = readCycles();
+    wait = acquired - now;
+    now = acquired;
+  }
+  lockProfRecordWait(s, wait, wait != 0);
+  if (ret == 0)
+    lockProfPushHeld(t, m, s, now);
+  return ret;
+}
+
+inline int lockProfMutexUnlock(pthread_mutex_t *m)
+{
+  lockProfPopHeld(lockProfThread(), m, readCycles());
+  return pthread_mutex_unlock(m);
+}
+
+inline int lockProfCondWait(pthread_cond_t *c, pthread_mutex_t *m, const char *file, int line)
+{
+  // mutex is released while waiting: close hold interval and start new one (attributed to this site) on wakeup
+  ThreadLockProfile *t = lockProfThread();
+  LockSiteStats *s = lockProfSite(t, file, line, SITE_COND);
+  uint64_t start = readCycles();
+  lockProfPopHeld(t, m, start);
+  int ret = pthread_cond_wait(c, m);
+  uint64_t end = readCycles();
+  lockProfRecordWait(s, end - start, true);
+  lockProfPushHeld(t, m, s, end);
+  return ret;
+}
+
+inline int lockProfSemWait(sem_t *sem, const char *file, int line)
+{
+  LockSiteStats *s = lockProfSite(lockProfThread(), file, line, SITE_SEM);
+  if (sem_trywait(sem) == 0)
+  {
+    lockProfRecordWait(s, 0, false);
+    return 0;
+  }
+  uint64_t start = readCycles();
+  int ret = sem_wait(sem);
+  lockProfRecordWait(s, readCycles() - start, true);
+  return ret;
+}
+
+// macros are defined after the wrappers so that wrappers themselves call real functions
+#define pthread_mutex_lock(m) lockProfMutexLock((m), __FILE__, __LINE__)
+#define pthread_mutex_unlock(m) lockProfMutexUnlock((m))
+#define pthread_cond_wait(c, m) lockProfCondWait((c), (m), __FILE__, __LINE__)
+#define sem_wait(s) lockProfSemWait((s), __FILE__, __LINE__)
+
+#endif // LOCK_PROFILE
+
+#endif
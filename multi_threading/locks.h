@@ -0,0 +1,552 @@
+#ifndef __LOCKS_H
+#define __LOCKS_H
+
+// Family of user space locks. All mutual exclusion locks expose same lock()/tryLock()/unlock() interface
+// so that benchmark (lock_bench.cpp) and callers can be templated on the lock type.
+// Reader-writer lock additionally exposes lockShared()/unlockShared() and SeqLock has its own read/write API.
+//
+// Rough guide:
+// TTASLock   - smallest (1 byte), fastest uncontended. Unfair, all waiters hammer same cache line on release
+// TicketLock - FIFO fair. Still single cache line spun on by all waiters, so release invalidates every waiter
+// MCSLock    - FIFO fair queue lock. Each waiter spins on its own node -> O(1) cache line transfers per handover
+// CLHLock    - same idea as MCS but waiter spins on predecessor's node. Unlock is a single store. Tail carries
+//              an enqueue count next to the node, so tryLock can't be fooled by a recycled node (ABA)
+// RWLock     - many readers or single writer. Writer preferring so continuous readers can't starve writer
+// SeqLock    - readers never write shared memory, they retry if writer was active. Best for small, read mostly data
+
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+#define MAX_LOCK_NESTING 8  // queue lock nodes per thread. Locks of same type must be released in LIFO order
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause(); // hints cpu that we are spinning. Saves power and avoids memory order violation flush on exit
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+// exponential backoff. Once spinning for long, give cpu away so that lock holder can run
+// on an oversubscribed machine (more threads than cores), pure spinning would burn whole time slice
+class Backoff
+{
+public:
+  void pause()
+  {
+    if (spins < MAX_SPINS)
+    {
+      for (uint32_t i = 0; i < spins; i++)
+      {
+        cpuRelax();
+      }
+      spins <<= 1;
+    }
+    else
+    {
+      sched_yield();
+    }
+  }
+
+  void reset()
+  {
+    spins = MIN_SPINS;
+  }
+
+private:
+  static const uint32_t MIN_SPINS = 4;
+  static const uint32_t MAX_SPINS = 1024;
+  uint32_t spins = MIN_SPINS;
+};
+
+// baseline: thin wrapper so that pthread mutex can be benchmarked against others
+class PthreadMutexLock
+{
+public:
+  PthreadMutexLock() { pthread_mutex_init(&m, NULL); }
+  ~PthreadMutexLock() { pthread_mutex_destroy(&m); }
+  void lock() { pthread_mutex_lock(&m); }
+  bool tryLock() { return pthread_mutex_trylock(&m) == 0; }
+  void unlock() { pthread_mutex_unlock(&m); }
+
+private:
+  pthread_mutex_t m;
+};
+
+// Test and Test-And-Set spinlock.
+// Plain TAS does atomic exchange in loop, every exchange needs cache line in exclusive state and causes coherence traffic.
+// TTAS spins on plain load (cache line stays shared in every waiter cache) and attempts exchange only when lock looks free
+class TTASLock
+{
+public:
+  void lock()
+  {
+    Backoff backoff;
+    while (true)
+    {
+      while (locked.load(std::memory_order_relaxed))
+      {
+        backoff.pause();
+      }
+      if (!locked.exchange(true, std::memory_order_acquire))
+      {
+        return;
+      }
+      // lost the race with other waiter. Back off so that all waiters don't retry at same time
+      backoff.pause();
+    }
+  }
+
+  bool tryLock()
+  {
+    return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+  }
+
+  void unlock()
+  {
+    locked.store(false, std::memory_order_release);
+  }
+
+private:
+  std::atomic<bool> locked{false};
+};
+
+// Ticket lock: take a ticket, wait till it is served. Grants lock in FIFO order.
+// Waiter knows its position in queue (myTicket - nowServing), so it backs off proportionally
+class TicketLock
+{
+public:
+  void lock()
+  {
+    uint32_t myTicket = next.fetch_add(1, std::memory_order_relaxed);
+    uint32_t spinCount = 0;
+    while (true)
+    {
+      uint32_t serving = nowServing.load(std::memory_order_acquire);
+      if (serving == myTicket)
+      {
+        return;
+      }
+      uint32_t ahead = myTicket - serving;  // unsigned subtraction handles wrap around
+      for (uint32_t i = 0; i < ahead * BACKOFF_BASE; i++)
+      {
+        cpuRelax();
+      }
+      // FIFO lock is worst case when oversubscribed: next in line may be descheduled, yield to let it run
+      if (++spinCount > YIELD_THRESHOLD)
+      {
+        sched_yield();
+      }
+    }
+  }
+
+  bool tryLock()
+  {
+    uint32_t serving = nowServing.load(std::memory_order_relaxed);
+    uint32_t expected = serving;
+    // lock is free only if no ticket is outstanding
+    return next.compare_exchange_strong(expected, serving + 1, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+  void unlock()
+  {
+    // only lock holder writes nowServing, so no atomic increment is required
+    nowServing.store(nowServing.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+private:
+  static const uint32_t BACKOFF_BASE = 16;
+  static const uint32_t YIELD_THRESHOLD = 256;
+  // keep both counters on separate cache lines. Taking a ticket shouldn't invalidate line waiters are spinning on
+  alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> next{0};
+  alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> nowServing{0};
+};
+
+// Mellor-Crummey & Scott queue lock.
+// Waiters form linked list. Each waiter spins on flag in its own node, predecessor hands over lock
+// by clearing that flag, so handover touches only one remote cache line regardless of number of waiters
+class MCSLock
+{
+public:
+  void lock()
+  {
+    QNode *node = &threadNodes()[depth()++];
+    node->next.store(NULL, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+    QNode *pred = tail.exchange(node, std::memory_order_acq_rel);
+    if (pred)
+    {
+      // link behind predecessor and wait for it to pass the lock
+      pred->next.store(node, std::memory_order_release);
+      Backoff backoff;
+      while (node->locked.load(std::memory_order_acquire))
+      {
+        backoff.pause();
+      }
+    }
+    holder = node;  // only read by lock holder in unlock()
+  }
+
+  bool tryLock()
+  {
+    QNode *node = &threadNodes()[depth()];
+    node->next.store(NULL, std::memory_order_relaxed);
+    QNode *expected = NULL;
+    if (tail.compare_exchange_strong(expected, node, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+      depth()++;
+      holder = node;
+      return true;
+    }
+    return false;
+  }
+
+  void unlock()
+  {
+    QNode *node = holder;
+    QNode *succ = node->next.load(std::memory_order_acquire);
+    if (!succ)
+    {
+      // no known successor. If we are still tail, queue becomes empty
+      QNode *expected = node;
+      if (tail.compare_exchange_strong(expected, NULL, std::memory_order_release, std::memory_order_relaxed))
+      {
+        depth()--;
+        return;
+      }
+      // some thread swapped tail but didn't link yet. Wait for the link
+      while (!(succ = node->next.load(std::memory_order_acquire)))
+      {
+        cpuRelax();
+      }
+    }
+    succ->locked.store(false, std::memory_order_release);
+    depth()--;
+  }
+
+private:
+  struct alignas(CACHE_LINE_SIZE) QNode
+  {
+    std::atomic<QNode *> next;
+    std::atomic<bool> locked;
+  };
+
+  static QNode *threadNodes()
+  {
+    static thread_local QNode nodes[MAX_LOCK_NESTING];
+    return nodes;
+  }
+
+  static uint32_t &depth()
+  {
+    static thread_local uint32_t d = 0;
+    return d;
+  }
+
+  std::atomic<QNode *> tail{NULL};
+  QNode *holder = NULL;
+};
+
+// Craig, Landin & Hagersten queue lock.
+// Implicit queue: each waiter spins on node of its predecessor. On unlock thread recycles predecessor's node
+// (nobody else references it anymore) and leaves its own node to the successor.
+// Because nodes are recycled, a node can come back as tail: tryLock that read tail X (free), then stalled while
+// another thread enqueued behind X, took X over on unlock and enqueued X again, would see X as tail again and
+// take the lock held by that thread (ABA). So tail holds the node together with the count of times its owner
+// enqueued it; every enqueue stores a new value and the stale compare exchange of such tryLock fails.
+// Such stale tail may also point to a node whose last owner exited since: nodes are never freed, threads and
+// locks going away put them on a free list that new ones take from, so a stale read is of a valid node
+class CLHLock
+{
+public:
+  CLHLock() : tail(pack(takeNode())) {}
+  ~CLHLock() { giveNode(nodeOf(tail.load(std::memory_order_relaxed))); }
+
+  void lock()
+  {
+    CLHNode *node = threadNodes().slot[depth()++];
+    node->locked.store(true, std::memory_order_relaxed);
+    node->enqueues++;
+    CLHNode *pred = nodeOf(tail.exchange(pack(node), std::memory_order_acq_rel));
+    Backoff backoff;
+    while (pred->locked.load(std::memory_order_acquire))
+    {
+      backoff.pause();
+    }
+    holder = node;
+    holderPred = pred;
+  }
+
+  bool tryLock()
+  {
+    uint64_t t = tail.load(std::memory_order_acquire); // acquire: node published by another thread is read
+    CLHNode *pred = nodeOf(t);
+    if (pred->locked.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    CLHNode *node = threadNodes().slot[depth()];
+    node->locked.store(true, std::memory_order_relaxed);
+    node->enqueues++;
+    if (tail.compare_exchange_strong(t, pack(node), std::memory_order_acq_rel, std::memory_order_relaxed))
+    {
+      depth()++;
+      holder = node;
+      holderPred = pred;
+      return true;
+    }
+    return false;
+  }
+
+  void unlock()
+  {
+    CLHNode *node = holder;
+    CLHNode *pred = holderPred;
+    node->locked.store(false, std::memory_order_release);
+    // node now belongs to successor (or stays as tail). Take over predecessor's node
+    threadNodes().slot[--depth()] = pred;
+  }
+
+private:
+  struct alignas(CACHE_LINE_SIZE) CLHNode
+  {
+    std::atomic<bool> locked{false};
+    uint32_t enqueues = 0;    // only written by thread owning the node, before it's published in tail.
+                              // Kept across reuse, so the tail values of a node stay distinct
+    CLHNode *nextFree = NULL; // on free list
+  };
+
+  // nodes of exited threads and destroyed locks, for all CLHLocks. Never destructed (trivial members), so
+  // threads exiting after static destruction can still give their nodes back
+  struct FreeNodes
+  {
+    pthread_mutex_t lock;
+    CLHNode *head;
+  };
+
+  static FreeNodes &freeNodes()
+  {
+    static FreeNodes list = {PTHREAD_MUTEX_INITIALIZER, NULL};
+    return list;
+  }
+
+  static CLHNode *takeNode()
+  {
+    FreeNodes &f = freeNodes();
+    pthread_mutex_lock(&f.lock);
+    CLHNode *node = f.head;
+    if (node)
+      f.head = node->nextFree;
+    pthread_mutex_unlock(&f.lock);
+    return node ? node : new CLHNode(); // nodes given back are free (locked false)
+  }
+
+  static void giveNode(CLHNode *node)
+  {
+    FreeNodes &f = freeNodes();
+    pthread_mutex_lock(&f.lock);
+    node->nextFree = f.head;
+    f.head = node;
+    pthread_mutex_unlock(&f.lock);
+  }
+
+  // tail word: node address / CACHE_LINE_SIZE in low NODE_BITS, enqueue count of node (mod 2^22) above.
+  // User space addresses are below 2^48 on x86-64 and AArch64 (unless mmap is asked for more explicitly).
+  // tryLock is fooled only if stalled between its load and compare exchange for 2^22 enqueues of same node
+  static const int NODE_BITS = 42;
+
+  static uint64_t pack(CLHNode *node)
+  {
+    return ((uint64_t)node->enqueues << NODE_BITS) | ((uintptr_t)node / CACHE_LINE_SIZE);
+  }
+
+  static CLHNode *nodeOf(uint64_t t)
+  {
+    return (CLHNode *)(uintptr_t)((t & ((1ULL << NODE_BITS) - 1)) * CACHE_LINE_SIZE);
+  }
+
+  // nodes owned by this thread. Back to the free list when thread exits
+  struct ThreadNodes
+  {
+    CLHNode *slot[MAX_LOCK_NESTING];
+    ThreadNodes()
+    {
+      for (int i = 0; i < MAX_LOCK_NESTING; i++)
+        slot[i] = takeNode();
+    }
+    ~ThreadNodes()
+    {
+      for (int i = 0; i < MAX_LOCK_NESTING; i++)
+        giveNode(slot[i]);
+    }
+  };
+
+  static ThreadNodes &threadNodes()
+  {
+    static thread_local ThreadNodes nodes;
+    return nodes;
+  }
+
+  static uint32_t &depth()
+  {
+    static thread_local uint32_t d = 0;
+    return d;
+  }
+
+  std::atomic<uint64_t> tail;
+  CLHNode *holder = NULL;
+  CLHNode *holderPred = NULL;
+};
+
+// Spinning reader-writer lock in single word
+// bit 0: writer holds lock, bit 1: writer waiting, bits 2..31: number of readers
+// New readers back off while writer is waiting so that stream of readers can't starve writers
+class RWLock
+{
+public:
+  void lock()
+  {
+    Backoff backoff;
+    while (true)
+    {
+      uint32_t s = state.load(std::memory_order_relaxed);
+      if ((s & ~WRITER_WAITING) == 0)
+      {
+        // no readers and no writer. Taking lock also clears waiting bit; other waiting writers set it again
+        if (state.compare_exchange_weak(s, WRITER, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+          return;
+        }
+      }
+      else if (!(s & WRITER_WAITING))
+      {
+        state.fetch_or(WRITER_WAITING, std::memory_order_relaxed);
+      }
+      backoff.pause();
+    }
+  }
+
+  bool tryLock()
+  {
+    uint32_t s = state.load(std::memory_order_relaxed);
+    return ((s & ~WRITER_WAITING) == 0) &&
+           state.compare_exchange_strong(s, WRITER, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+  void unlock()
+  {
+    state.fetch_and(~WRITER, std::memory_order_release);
+  }
+
+  void lockShared()
+  {
+    Backoff backoff;
+    while (true)
+    {
+      uint32_t s = state.load(std::memory_order_relaxed);
+      if (!(s & (WRITER | WRITER_WAITING)) &&
+          state.compare_exchange_weak(s, s + READER, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        return;
+      }
+      backoff.pause();
+    }
+  }
+
+  void unlockShared()
+  {
+    state.fetch_sub(READER, std::memory_order_release);
+  }
+
+private:
+  static const uint32_t WRITER = 1;
+  static const uint32_t WRITER_WAITING = 2;
+  static const uint32_t READER = 4;
+  std::atomic<uint32_t> state{0};
+};
+
+// Sequence lock protecting a small trivially copyable value T.
+// Writer makes sequence odd while updating. Reader copies value and retries if sequence was odd or changed.
+// Readers never write shared cache line, so read side scales perfectly; writers are never blocked by readers.
+// Data is kept as array of relaxed atomic words so that racy reads are well defined
+template <typename T>
+class SeqLock
+{
+public:
+  SeqLock()
+  {
+    for (size_t i = 0; i < NUM_WORDS; i++)
+      words[i].store(0, std::memory_order_relaxed);
+  }
+
+  T read() const
+  {
+    uint64_t buf[NUM_WORDS];
+    T val;
+    while (true)
+    {
+      uint32_t s1 = seq.load(std::memory_order_acquire);
+      if (s1 & 1)
+      {
+        cpuRelax(); // write in progress
+        continue;
+      }
+      for (size_t i = 0; i < NUM_WORDS; i++)
+      {
+        buf[i] = words[i].load(std::memory_order_relaxed);
+      }
+      // order data loads before re-reading sequence
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) == s1)
+      {
+        break;
+      }
+    }
+    memcpy(&val, buf, sizeof(T));
+    return val;
+  }
+
+  void write(const T &val)
+  {
+    uint64_t buf[NUM_WORDS] = {0};
+    memcpy(buf, &val, sizeof(T));
+    writerLock.lock(); // serialize writers
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    // sequence must be visibly odd before any data word changes
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < NUM_WORDS; i++)
+    {
+      words[i].store(buf[i], std::memory_order_relaxed);
+    }
+    seq.store(s + 2, std::memory_order_release);
+    writerLock.unlock();
+  }
+
+private:
+  static const size_t NUM_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+  std::atomic<uint32_t> seq{0};
+  TTASLock writerLock;
+  std::atomic<uint64_t> words[NUM_WORDS];
+};
+
+// RAII helper usable with any lock above
+template <typename Lock>
+class LockGuard
+{
+public:
+  explicit LockGuard(Lock &l) : lk(l) { lk.lock(); }
+  ~LockGuard() { lk.unlock(); }
+  LockGuard(const LockGuard &) = delete;
+  LockGuard &operator=(const LockGuard &) = delete;
+
+private:
+  Lock &lk;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <unistd.h>
+#include "lock_profiler.h"
+#include "async_logger.h"
 
 pthread_mutex_t m;
 pthread_cond_t cond;
@@ -18,7 +20,7 @@ void *printOdd(void *arg)
       pthread_cond_wait(&cond, &m);
       // mutex acquired again when call is returned (by call to pthread_cond_signal from other thread)
     }
-    printf("%d ", count++);
+    asyncLog("%d ", count++); // formatting and write happen on logger thread, outside the mutex
     // only one of the thread waiting on cond gets unblocked depending on scheduling policy.
     // pthread_cond_broadcast signals should be used to unblock all
     // pthread_cond_signal or pthread_cond_broadcast doesn't automatically release mutex
@@ -39,7 +41,7 @@ void *printEven(void *arg)
     {
       pthread_cond_wait(&cond, &m);
     }
-    printf("%d ", count++);
+    asyncLog("%d ", count++);
     pthread_cond_signal(&cond);
     pthread_mutex_unlock(&m);
   }
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include "lock_profiler.h"
+#include "async_logger.h"
 
 #define MAX_ITEMS 10
 int buff[MAX_ITEMS];
@@ -20,8 +22,8 @@ void *producer(void *arg)
     pthread_mutex_lock(&mutex);
     item = rand() % 100;
     buff[produced++ % MAX_ITEMS] = item;
-    printf("produced %d item: %d\n", produced, item);
-    fflush(stdout);
+    // printf + fflush here would serialize both threads on stdio lock and write syscall while holding mutex
+    asyncLog("produced %d item: %d\n", produced, item);
     item = (item + 1) % MAX_ITEMS;
     pthread_mutex_unlock(&mutex);
     sem_post(&full);
@@ -36,8 +38,7 @@ void *consumer(void *arg)
     sem_wait(&full);
     pthread_mutex_lock(&mutex);
     int item = buff[consumed++ % MAX_ITEMS];
-    printf("consumed %d item: %d\n", consumed, item);
-    fflush(stdout);
+    asyncLog("consumed %d item: %d\n", consumed, item);
     pthread_mutex_unlock(&mutex);
     sem_post(&empty);
     usleep(200000);
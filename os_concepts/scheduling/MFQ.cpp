@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "../../generic/allocator.h"
 
 #define NUM_QUEUES 3
 
@@ -24,9 +25,14 @@ typedef struct Queue
   Process *rear;
 } Queue;
 
+// queues live as long as the scheduler: bump allocated from an arena, released together at the end.
+// Processes come and go: fixed size slab pool, a finished process's slot is reused by the next one
+static Arena schedulerArena(4096);
+static SlabPool processPool(sizeof(Process), alignof(Process));
+
 Queue *createQueue()
 {
-  Queue *q = (Queue *)malloc(sizeof(Queue));
+  Queue *q = schedulerArena.create<Queue>();
   q->front = q->rear = NULL;
   return q;
 }
@@ -62,7 +68,7 @@ Process *dequeue(Queue *q)
 
 Process *createProcess(int pid, int burst_time)
 {
-  Process *p = (Process *)malloc(sizeof(Process));
+  Process *p = (Process *)processPool.allocate();
   p->pid = pid;
   p->burst_time = burst_time;
   p->remaining_time = burst_time;
@@ -128,7 +134,7 @@ int main_mfq()
         }
         else
         {
-          free(current);
+          processPool.deallocate(current);
         }
         break;
       }
@@ -139,10 +145,7 @@ int main_mfq()
     }
   }
 
-  for (int i = 0; i < NUM_QUEUES; i++)
-  {
-    free(queues[i]);
-  }
+  schedulerArena.release();
 
   return 0;
 }
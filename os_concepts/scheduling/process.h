@@ -2,6 +2,7 @@
 #define __PROCESS_H
 
 #include <stdint.h>
+#include "../../generic/struct_layout.h"
 
 typedef struct __Process
 {
@@ -18,6 +19,13 @@ typedef struct __Process
   }
 } Process;
 
+// schedulers walk arrays of Process in order: keep it small and without padding. Dense 24 byte elements
+// are not line aligned, p[2] and p[5] of every 8 cross a line, but an in order walk reads both lines anyway;
+// padding to 32 would read a third more lines. So the budget only holds for a process starting on a line
+STRUCT_LAYOUT(Process, pid, arrival, service, wait, tat, rt)
+LAYOUT_BUDGET_LINE_ALIGNED(Process, 1);
+LAYOUT_OPTIMAL(Process);
+
 void runFCFS(Process p[], int num);
 void runSJFS(Process p[], int num);
 void runRR(Process p[], int num);